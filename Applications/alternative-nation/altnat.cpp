@@ -16,6 +16,7 @@
 using MTV::CacheAccessRecord;
 using MTV::CacheStatusReport;
 using MTV::CacheSimulator;
+using MTV::ChunkedDeltaMementoRecorder;
 using MTV::DeltaMementoRecorder;
 using MTV::ImmediateDeltaMementoRecorder;
 using MTV::Memorable;
@@ -37,6 +38,8 @@ int main(int argc, char *argv[]){
 
   // Process command line arguments.
   std::string tracefile, registrationfile, cachespecfile;
+  unsigned chunksize;
+  bool immediate;
 
   try{
     // Create a command line parser.
@@ -69,6 +72,21 @@ int main(int argc, char *argv[]){
                                               "filename",
                                               cmd);
 
+    // Number of events per compressed chunk.
+    TCLAP::ValueArg<unsigned> chunkSizeArg("k",
+                                           "chunk-size",
+                                           "Number of events per compressed chunk of the event trace (default 4096).",
+                                           false,
+                                           4096,
+                                           "events",
+                                           cmd);
+
+    // Uncompressed output.
+    TCLAP::SwitchArg immediateArg("i",
+                                  "immediate",
+                                  "Write an uncompressed, forward-only event trace instead of a chunked one.",
+                                  cmd);
+
     // Parse command line.
     cmd.parse(argc, argv);
 
@@ -76,6 +94,8 @@ int main(int argc, char *argv[]){
     tracefile = reftraceArg.getValue();
     registrationfile = registrationArg.getValue();
     cachespecfile = cacheSpecArg.getValue();
+    chunksize = chunkSizeArg.getValue();
+    immediate = immediateArg.getValue();
   }
   catch(TCLAP::ArgException& e){
     std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
@@ -125,7 +145,19 @@ int main(int argc, char *argv[]){
 
   // TODO(choudhury): get list of Memorables and attach
   // DeltaMementoRecorders to them.
-  DeltaMementoRecorder::ptr deltaSink(new ImmediateDeltaMementoRecorder(tracefile + ".event"));
+  DeltaMementoRecorder::ptr deltaSink;
+  if(immediate){
+    deltaSink = boost::make_shared<ImmediateDeltaMementoRecorder>(tracefile + ".event");
+  }
+  else{
+    deltaSink = boost::make_shared<ChunkedDeltaMementoRecorder>(tracefile + ".event", chunksize);
+  }
+
+  if(!*deltaSink){
+    std::cerr << "error: could not open event trace file '" << tracefile << ".event' for writing." << std::endl;
+    exit(1);
+  }
+
   std::vector<Memorable::ptr> mem = net->getMemorables();
   for(unsigned i=0; i<mem.size(); i++){
     Memorable::ptr p = mem[i];
@@ -137,6 +169,9 @@ int main(int argc, char *argv[]){
   // TODO(choudhury): run the trace from start to finish.
   try{
     while(true){
+      // Stamp the events with the index of the record that causes
+      // them.
+      deltaSink->setTraceIndex(trace->getTracePoint());
       trace->nextRecord();
     }
   }
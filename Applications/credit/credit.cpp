@@ -8,10 +8,13 @@
 #include <Core/Dataflow/AddressRangeFilter.h>
 #include <Core/Dataflow/CacheAccessRecord.h>
 #include <Core/Dataflow/CachePerformanceCounter.h>
+#include <Core/Dataflow/CacheSampler.h>
 #include <Core/Dataflow/CacheSimulator.h>
 #include <Core/Dataflow/HitLevelCounter.h>
+#include <Core/Dataflow/Instrumentation.h>
 #include <Core/Dataflow/MemoryRecordFilter.h>
 #include <Core/Dataflow/Printer.h>
+#include <Core/Dataflow/TraceIndex.h>
 #include <Core/Dataflow/TraceReader.h>
 #include <Core/Util/BoostForeach.h>
 #include <Tools/CacheSimulator/Cache.h>
@@ -24,24 +27,35 @@ using MTV::CacheSimulator;
 using MTV::CacheHitRates;
 using MTV::CacheMissCountPolicy;
 using MTV::CachePerformanceCounter;
+using MTV::CacheSampler;
 using MTV::CacheTemperaturePolicy;
 using MTV::HitHistoryManager;
 using MTV::HitLevelCounter;
+using MTV::Instrumentation;
 using MTV::LevelToLevelBandwidthPolicy;
 using MTV::MemoryRecordFilter;
 using MTV::PerformanceCounterPolicy;
 using MTV::Printer;
+using MTV::SampledCacheStats;
+using MTV::TraceIndex;
 using MTV::TraceReader;
 
 // TCLAP headers.
 #include <tclap/CmdLine.h>
 
+// Boost headers.
+#include <boost/math/common_factor.hpp>
+
 // System headers.
+#include <algorithm>
 #include <iostream>
 #include <signal.h>
+#include <sstream>
 #include <string>
 #include <vector>
 
+MTV_INSTRUMENT_ALLOCATIONS
+
 void sighandler(int sig){
   if(sig == SIGINT){
     std::cerr << "interrupt" << std::endl;;
@@ -65,9 +79,18 @@ int main(int argc, char *argv[]){
   unsigned long numrecords, period;
   long windowsize;
   long numrefs;
+  bool progress;
+  unsigned readahead;
   std::string bsfile;
   unsigned numstreams;
   std::vector<std::string> rangestrings, cachespecfile, dump;
+  std::string instrumentfile;
+  unsigned long instrumentperiod;
+  unsigned sampleinterval;
+  unsigned samplesets;
+  unsigned long sampleperiod, samplewindow;
+  long samplewarmup;
+  double confidence, sampleerror;
 
   try{
     // Create a command line parser.
@@ -151,6 +174,23 @@ int main(int argc, char *argv[]){
                                      "number",
                                      cmd);
 
+    // Draw a progress meter, counting the records with the trace's
+    // index.
+    TCLAP::SwitchArg progressArg("",
+                                 "progress",
+                                 "Draw a progress bar, taking the number of records from the trace's index (built on first use)",
+                                 cmd,
+                                 false);
+
+    // Read the trace on a background thread.
+    TCLAP::ValueArg<unsigned> readaheadArg("",
+                                           "read-ahead",
+                                           "Read and decompress the trace on a background thread, keeping this many 1MB chunks ready (0 to read synchronously)",
+                                           false,
+                                           0,
+                                           "number",
+                                           cmd);
+
     // Blockstream file.
     TCLAP::ValueArg<std::string> bsfileArg("",
                                            "blockstream-file",
@@ -169,6 +209,80 @@ int main(int argc, char *argv[]){
                                        "non-negative number",
                                        cmd);
 
+    // Dataflow instrumentation.
+    TCLAP::ValueArg<std::string> instrumentfileArg("",
+                                                   "instrument",
+                                                   "Profile the dataflow network, saving a Chrome trace-event file",
+                                                   false,
+                                                   "",
+                                                   "filename",
+                                                   cmd);
+
+    TCLAP::ValueArg<unsigned long> instrumentperiodArg("",
+                                                       "instrument-period",
+                                                       "Profile the dataflow network, printing stats every this many records",
+                                                       false,
+                                                       0,
+                                                       "records",
+                                                       cmd);
+
+    TCLAP::ValueArg<unsigned> sampleintervalArg("",
+                                                "sample-interval",
+                                                "Time one record in this many when profiling",
+                                                false,
+                                                64,
+                                                "positive number",
+                                                cmd);
+
+    // Sampling.
+    TCLAP::ValueArg<unsigned> samplesetsArg("",
+                                            "sample-sets",
+                                            "Simulate only one in this many cache sets",
+                                            false,
+                                            1,
+                                            "number",
+                                            cmd);
+
+    TCLAP::ValueArg<unsigned long> sampleperiodArg("",
+                                                   "sample-period",
+                                                   "Measure one window of records in each period of this many (0 to measure every record)",
+                                                   false,
+                                                   0,
+                                                   "number",
+                                                   cmd);
+
+    TCLAP::ValueArg<unsigned long> samplewindowArg("",
+                                                   "sample-window",
+                                                   "Number of records in each measurement window",
+                                                   false,
+                                                   10000,
+                                                   "number",
+                                                   cmd);
+
+    TCLAP::ValueArg<long> samplewarmupArg("",
+                                          "sample-warmup",
+                                          "Number of records simulated before each measurement window (-1 to simulate every record)",
+                                          false,
+                                          -1,
+                                          "number",
+                                          cmd);
+
+    TCLAP::ValueArg<double> confidenceArg("",
+                                          "confidence",
+                                          "Confidence level for the sampled estimates",
+                                          false,
+                                          0.95,
+                                          "fraction",
+                                          cmd);
+
+    TCLAP::ValueArg<double> sampleerrorArg("",
+                                           "sample-error",
+                                           "Stop once every level's sampled miss rate is within this relative error (requires --sample-period; 0 to run the whole trace)",
+                                           false,
+                                           0.0,
+                                           "fraction",
+                                           cmd);
+
     // Parse command line.
     cmd.parse(argc, argv);
 
@@ -182,21 +296,49 @@ int main(int argc, char *argv[]){
     windowsize = windowsizeArg.getValue();
     period = periodArg.getValue();
     numrefs = numrefsArg.getValue();
+    progress = progressArg.getValue();
+    readahead = readaheadArg.getValue();
     bsfile = bsfileArg.getValue();
     numstreams = numstreamsArg.getValue();
+    instrumentfile = instrumentfileArg.getValue();
+    instrumentperiod = instrumentperiodArg.getValue();
+    sampleinterval = sampleintervalArg.getValue();
+    samplesets = samplesetsArg.getValue();
+    sampleperiod = sampleperiodArg.getValue();
+    samplewindow = samplewindowArg.getValue();
+    samplewarmup = samplewarmupArg.getValue();
+    confidence = confidenceArg.getValue();
+    sampleerror = sampleerrorArg.getValue();
   }
   catch(TCLAP::ArgException& e){
     std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
     exit(1);
   }
 
+  if(instrumentfile != "" or instrumentperiod > 0){
+    Instrumentation::enable(sampleinterval, instrumentperiod, instrumentfile);
+  }
+
   // Open the trace file.
   TraceReader::ptr trace(new TraceReader);
+  trace->setReadAhead(readahead);
   if(!trace->open(tracefile)){
     std::cerr << "error: cannot open trace file '" << tracefile << "' for reading." << std::endl;
     exit(1);
   }
 
+  // Look up the trace length in its index, rather than requiring it on
+  // the command line.
+  if(progress and numrefs == -1){
+    TraceIndex index;
+    if(!index.open(tracefile)){
+      std::cerr << "error: " << index.error() << std::endl;
+      exit(1);
+    }
+
+    numrefs = static_cast<long>(std::min<uint64_t>(index.num_records(), numrecords));
+  }
+
   // Validate the policy string.
   if(policy != "" and
      policy != "temperature" and
@@ -206,6 +348,26 @@ int main(int argc, char *argv[]){
     exit(1);
   }
 
+  // Validate the sampling options.
+  const bool sampling = (samplesets > 1 or sampleperiod > 0);
+  if(sampleperiod > 0 and (samplewindow == 0 or samplewindow > sampleperiod)){
+    std::cerr << "error: the sample window must be positive and no longer than the sample period." << std::endl;
+    exit(1);
+  }
+
+  // NOTE(choudhury): stopping early is only sound when the windows
+  // are drawn from across the trace; set sampling alone would measure
+  // a prefix of it and say nothing about the rest.
+  if(sampleerror > 0.0 and sampleperiod == 0){
+    std::cerr << "error: --sample-error requires --sample-period." << std::endl;
+    exit(1);
+  }
+
+  if(confidence <= 0.0 or confidence >= 1.0){
+    std::cerr << "error: the confidence level must lie strictly between 0 and 1." << std::endl;
+    exit(1);
+  }
+
   // Validate the dump string.
   foreach(const std::string& s, dump){
     if(s != "hit-level"){
@@ -266,6 +428,8 @@ int main(int argc, char *argv[]){
   // For each cache set in the list of cache set specs, create one
   // simulation network.
   std::vector<std::vector<CachePerformanceCounter::ptr> > perfs;
+  std::vector<CacheSampler::ptr> samplers;
+  std::vector<std::vector<SampledCacheStats::ptr> > samplestats;
   Printer<CacheHitRates>::ptr printer(new Printer<CacheHitRates>(std::cout, false));
   for(unsigned k=0; k<cachespecfile.size(); k++){
     // Create a cache set.
@@ -322,18 +486,72 @@ int main(int argc, char *argv[]){
     foreach(Cache::ptr c, caches->getCaches()){
       CacheSimulator::ptr p(new CacheSimulator(c));
       simulators.push_back(p);
+
+      std::stringstream name;
+      name << "cache simulator " << k << "." << simulators.size() - 1;
+      Instrumentation::name(p, name.str());
     }
 
     // TraceReader -> MFilter -> Filter{i} -> Cache{j} -> Averager{j} -> File
     MemoryRecordFilter::ptr mfilter(new MemoryRecordFilter);
     trace->addConsumer(mfilter);
 
+    Instrumentation::name(trace, "trace reader");
+    Instrumentation::name(mfilter, "memory record filter");
+
+    // In sampling mode, a sampler sits between the memory records and
+    // the address filters, and the simulators report to sampled stats
+    // collectors instead of performance counters.
+    MTV::Producer<MTR::Record>::ptr source = mfilter;
+    if(sampling){
+      // Set classes must cover whole sets in every level of every
+      // cache.
+      unsigned groups = 0;
+      foreach(Cache::ptr c, caches->getCaches()){
+        if(c->block_size() != caches->getCaches()[0]->block_size()){
+          std::cerr << "error: set sampling requires the caches to share a block size." << std::endl;
+          exit(1);
+        }
+
+        for(unsigned L=0; L<c->num_levels(); L++){
+          groups = boost::math::gcd(groups, c->level(L)->numSets());
+        }
+      }
+
+      if(samplesets > groups){
+        std::cerr << "error: simulation " << k << " cannot sample one in " << samplesets << " sets, as its levels have only " << groups << " sets in common." << std::endl;
+        exit(1);
+      }
+
+      CacheSampler::ptr sampler = boost::make_shared<CacheSampler>(caches->getCaches()[0]->block_size(),
+                                                                   groups,
+                                                                   samplesets,
+                                                                   sampleperiod,
+                                                                   samplewindow,
+                                                                   samplewarmup < 0 ? CacheSampler::Unbounded : samplewarmup,
+                                                                   k);
+      mfilter->addConsumer(sampler);
+      source = sampler;
+      samplers.push_back(sampler);
+
+      std::stringstream name;
+      name << "cache sampler " << k;
+      Instrumentation::name(sampler, name.str());
+
+      samplestats.push_back(std::vector<SampledCacheStats::ptr>());
+      for(unsigned i=0; i<simulators.size(); i++){
+        SampledCacheStats::ptr stats = boost::make_shared<SampledCacheStats>(sampler, caches->getCaches()[i]->num_levels(), caches->getCaches()[i]->block_size());
+        simulators[i]->MTV::Producer<CacheAccessRecord>::addConsumer(stats);
+        samplestats.back().push_back(stats);
+      }
+    }
+
     // Set up a path for each address range, so the addresses can be
     // funneled to the proper cache simulator.
     if(ranges.find(k) == ranges.end()){
       std::cerr << "warning: simulation " << k << " has no address ranges specified - passing all addresses." << std::endl;
       AddressRangePass::ptr allpass = AddressRangePass::all();
-      mfilter->addConsumer(allpass);
+      source->addConsumer(allpass);
       foreach(CacheSimulator::ptr p, simulators){
         allpass->MTV::Producer<MTR::Record>::addConsumer(p);
       }
@@ -342,10 +560,14 @@ int main(int argc, char *argv[]){
       foreach(const WhichCache& range, ranges[k]){
         // Connect the trace reader to an address filter.
         AddressRangePass::ptr pass(new AddressRangePass(range.base, range.limit));
-        mfilter->addConsumer(pass);
+        source->addConsumer(pass);
 
         // Connect the address filter to the appropriate cache simulator.
         pass->MTV::Producer<MTR::Record>::addConsumer(simulators[range.which]);
+
+        std::stringstream name;
+        name << "range pass " << k << " 0x" << std::hex << range.base;
+        Instrumentation::name(pass, name.str());
       }
     }
 
@@ -375,7 +597,11 @@ int main(int argc, char *argv[]){
       abort();
     }
 
-    if(counters.size() == 0){
+    if(sampling){
+      // The sampled stats stand in for the performance counters.
+      counters.clear();
+    }
+    else if(counters.size() == 0){
       std::cerr << "warning: no performance metric specified." << std::endl;
     }
 
@@ -388,6 +614,10 @@ int main(int argc, char *argv[]){
 
         simulators[i]->MTV::Producer<CacheAccessRecord>::addConsumer(perf);
 
+        std::stringstream name;
+        name << "performance counter " << k << "." << i;
+        Instrumentation::name(perf, name.str());
+
         perfs.push_back(std::vector<CachePerformanceCounter::ptr>());
         perfs.back().push_back(perf);
 
@@ -436,6 +666,22 @@ int main(int argc, char *argv[]){
 
       trace->nextRecord();
 
+      // Every so often, check whether the estimates are good enough to
+      // stop.
+      if(sampling and sampleerror > 0.0 and i > 0 and i % SampledCacheStats::CheckInterval == 0){
+        bool done = true;
+        for(unsigned k=0; k<samplestats.size(); k++){
+          foreach(SampledCacheStats::const_ptr s, samplestats[k]){
+            done = done and s->converged(sampleerror, confidence);
+          }
+        }
+
+        if(done){
+          std::cerr << "sampled estimates reached the requested error after " << samplers[0]->records() << " records." << std::endl;
+          break;
+        }
+      }
+
       if(period > 0 and i % period == 0){
         for(unsigned k=0; k<perfs.size(); k++){
           foreach(CachePerformanceCounter::ptr p, perfs[k]){
@@ -495,5 +741,14 @@ int main(int argc, char *argv[]){
     }
   }
 
+  for(unsigned k=0; k<samplers.size(); k++){
+    std::cout << "simulation " << k << " ";
+    samplers[k]->describe(std::cout);
+    for(unsigned i=0; i<samplestats[k].size(); i++){
+      std::cout << "cache " << i << " ";
+      samplestats[k][i]->report(std::cout, confidence, policy);
+    }
+  }
+
   return 0;
 }
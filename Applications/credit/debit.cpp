@@ -6,38 +6,70 @@
 #include <Core/Dataflow/AddressRangeFilter.h>
 #include <Core/Dataflow/CacheAccessRecord.h>
 #include <Core/Dataflow/CachePerformanceCounter.h>
+#include <Core/Dataflow/CacheSampler.h>
 #include <Core/Dataflow/CacheSimulator.h>
+#include <Core/Dataflow/CallTreeProfile.h>
+#include <Core/Dataflow/ConflictMatrix.h>
 #include <Core/Dataflow/HitLevelCounter.h>
+#include <Core/Dataflow/LineProfile.h>
+#include <Core/Dataflow/LineRecordFilter.h>
 #include <Core/Dataflow/MemoryRecordFilter.h>
 #include <Core/Dataflow/Printer.h>
+#include <Core/Dataflow/TLBLevelCounter.h>
+#include <Core/Dataflow/TLBSimulator.h>
+#include <Core/Dataflow/TraceIndex.h>
 #include <Core/Dataflow/TraceReader.h>
 #include <Core/Util/BoostForeach.h>
 #include <Tools/NewCacheSimulator/CacheLevel.h>
+#include <Tools/NewCacheSimulator/MissStream.h>
 #include <Tools/NewCacheSimulator/NewCache.h>
 #include <Tools/NewCacheSimulator/NewCacheSet.h>
+#include <Tools/NewCacheSimulator/TLB.h>
+#include <Tools/ReferenceTrace/StackIndex.h>
 using MTV::AddressRangePass;
 using MTV::CacheLevel;
 using MTV::CacheAccessRecord;
+using MTV::CacheSampler;
 using MTV::NewCacheSimulator;
 using MTV::CacheHitRates;
+using MTV::CallTreeProfile;
+using MTV::ConflictMatrix;
 using MTV::CachePerformanceCounter;
 using MTV::HitLevelCounter;
+using MTV::LineProfile;
+using MTV::LineRecordFilter;
 using MTV::MemoryRecordFilter;
+using MTV::MissStreamReader;
+using MTV::MissStreamReplayer;
+using MTV::MissStreamWriter;
 using MTV::NewCache;
 using MTV::NewCacheLevelToLevelBandwidthPolicy;
 using MTV::NewCacheMissCountPolicy;
+using MTV::NewCachePrefetchBandwidthPolicy;
 using MTV::NewCacheSet;
 using MTV::NewCacheTemperaturePolicy;
 using MTV::NewHitHistoryManager;
 using MTV::PerformanceCounterPolicy;
 using MTV::Printer;
+using MTV::SampledCacheStats;
+using MTV::StackIndex;
+using MTV::TLB;
+using MTV::TLBLevelCounter;
+using MTV::TLBSimulator;
+using MTV::TraceIndex;
 using MTV::TraceReader;
 
 // TCLAP headers.
 #include <tclap/CmdLine.h>
 
+// Boost headers.
+#include <boost/math/common_factor.hpp>
+
 // System headers.
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <map>
 #include <signal.h>
 #include <string>
 #include <vector>
@@ -65,10 +97,25 @@ int main(int argc, char *argv[]){
   unsigned long numrecords, period;
   long windowsize;
   long numrefs;
+  bool progress;
+  unsigned readahead;
   std::string bsfile;
   unsigned numstreams;
   std::string cachespecfile;
   std::vector<std::string> rangestrings, dump;
+  unsigned samplesets;
+  unsigned long sampleperiod, samplewindow;
+  long samplewarmup;
+  double confidence, sampleerror;
+  std::string tlbspecfile, regfile;
+  std::vector<std::string> pagesizestrings;
+  std::string mithrilfile;
+  unsigned conflicttop;
+  unsigned long profileperiod;
+  std::string calltreemetric;
+  unsigned calltreetop;
+  std::string recordfile, replayfile;
+  unsigned misslevel;
 
   try{
     // Create a command line parser.
@@ -77,8 +124,8 @@ int main(int argc, char *argv[]){
     // Reference trace file.
     TCLAP::ValueArg<std::string> tracefileArg("t",
                                              "trace-file",
-                                             "Reference trace file to use as data source.",
-                                             true,
+                                             "Reference trace file to use as data source (not used when replaying a miss stream).",
+                                             false,
                                              "",
                                              "filename",
                                              cmd);
@@ -112,7 +159,7 @@ int main(int argc, char *argv[]){
     // Performance policy.
     TCLAP::ValueArg<std::string> policyArg("m",
                                            "peformance-metric",
-                                           "Which performance metric to use (options: temperature, bandwidth, miss-count).",
+                                           "Which performance metric to use (options: temperature, bandwidth, prefetch-bandwidth, miss-count).",
                                            false,
                                            "",
                                            "policy",
@@ -121,7 +168,7 @@ int main(int argc, char *argv[]){
     // Extra information to dump.
     TCLAP::MultiArg<std::string> dumpArg("d",
                                          "dump",
-                                         "extra information to dump (options: hit-level).",
+                                         "extra information to dump (options: hit-level, tlb-level, conflicts, line-profile, call-tree).",
                                          false,
                                          "dumper",
                                          cmd);
@@ -153,6 +200,23 @@ int main(int argc, char *argv[]){
                                      "number",
                                      cmd);
 
+    // Draw a progress meter, counting the records with the trace's
+    // index.
+    TCLAP::SwitchArg progressArg("",
+                                 "progress",
+                                 "Draw a progress bar, taking the number of records from the trace's index (built on first use)",
+                                 cmd,
+                                 false);
+
+    // Read the trace on a background thread.
+    TCLAP::ValueArg<unsigned> readaheadArg("",
+                                           "read-ahead",
+                                           "Read and decompress the trace on a background thread, keeping this many 1MB chunks ready (0 to read synchronously)",
+                                           false,
+                                           0,
+                                           "number",
+                                           cmd);
+
     // Blockstream file.
     TCLAP::ValueArg<std::string> bsfileArg("",
                                            "blockstream-file",
@@ -171,6 +235,147 @@ int main(int argc, char *argv[]){
                                        "non-negative number",
                                        cmd);
 
+    // Sampling.
+    TCLAP::ValueArg<unsigned> samplesetsArg("",
+                                            "sample-sets",
+                                            "Simulate only one in this many cache sets",
+                                            false,
+                                            1,
+                                            "number",
+                                            cmd);
+
+    TCLAP::ValueArg<unsigned long> sampleperiodArg("",
+                                                   "sample-period",
+                                                   "Measure one window of records in each period of this many (0 to measure every record)",
+                                                   false,
+                                                   0,
+                                                   "number",
+                                                   cmd);
+
+    TCLAP::ValueArg<unsigned long> samplewindowArg("",
+                                                   "sample-window",
+                                                   "Number of records in each measurement window",
+                                                   false,
+                                                   10000,
+                                                   "number",
+                                                   cmd);
+
+    TCLAP::ValueArg<long> samplewarmupArg("",
+                                          "sample-warmup",
+                                          "Number of records simulated before each measurement window (-1 to simulate every record)",
+                                          false,
+                                          -1,
+                                          "number",
+                                          cmd);
+
+    TCLAP::ValueArg<double> confidenceArg("",
+                                          "confidence",
+                                          "Confidence level for the sampled estimates",
+                                          false,
+                                          0.95,
+                                          "fraction",
+                                          cmd);
+
+    TCLAP::ValueArg<double> sampleerrorArg("",
+                                           "sample-error",
+                                           "Stop once every level's sampled miss rate is within this relative error (requires --sample-period; 0 to run the whole trace)",
+                                           false,
+                                           0.0,
+                                           "fraction",
+                                           cmd);
+
+    // TLB simulation.
+    TCLAP::ValueArg<std::string> tlbspecfileArg("",
+                                                "tlb-config-file",
+                                                "XML file describing a TLB hierarchy to simulate alongside the caches",
+                                                false,
+                                                "",
+                                                "filename",
+                                                cmd);
+
+    TCLAP::ValueArg<std::string> regfileArg("",
+                                            "registration",
+                                            "Region registration file; TLB statistics and conflicts are reported per region",
+                                            false,
+                                            "",
+                                            "filename",
+                                            cmd);
+
+    TCLAP::MultiArg<std::string> pagesizestringsArg("",
+                                                    "page-size",
+                                                    "Page size backing a registered region (e.g. \"matrix=2M\"; sizes are 4K, 2M, or 1G)",
+                                                    false,
+                                                    "strings",
+                                                    cmd);
+
+    // Conflict attribution.
+    TCLAP::ValueArg<std::string> mithrilfileArg("",
+                                                "mithril-file",
+                                                "Mithril debug info file; the conflicts dumper also attributes conflicts to global variables, and the call-tree dumper names functions",
+                                                false,
+                                                "",
+                                                "filename",
+                                                cmd);
+
+    TCLAP::ValueArg<unsigned> conflicttopArg("",
+                                             "conflict-top",
+                                             "Number of worst conflicts to report",
+                                             false,
+                                             10,
+                                             "number",
+                                             cmd);
+
+    // Line profile snapshots.
+    TCLAP::ValueArg<unsigned long> profileperiodArg("",
+                                                    "profile-period",
+                                                    "Number of memory references between line profile snapshots (0 to write the profile only at the end)",
+                                                    false,
+                                                    0,
+                                                    "number",
+                                                    cmd);
+
+    // Call tree profile.
+    TCLAP::ValueArg<std::string> calltreemetricArg("",
+                                                   "call-tree-metric",
+                                                   "Counter written to the call tree's collapsed stacks (references, misses, writebacks, or a level such as L1 for its hits)",
+                                                   false,
+                                                   "misses",
+                                                   "counter",
+                                                   cmd);
+
+    TCLAP::ValueArg<unsigned> calltreetopArg("",
+                                             "call-tree-top",
+                                             "Number of call paths to report",
+                                             false,
+                                             10,
+                                             "number",
+                                             cmd);
+
+    // Miss streams.
+    TCLAP::ValueArg<std::string> recordfileArg("",
+                                               "record-misses",
+                                               "Record the requests the first cache's upper levels send below them to this file, for later replay",
+                                               false,
+                                               "",
+                                               "filename",
+                                               cmd);
+
+    TCLAP::ValueArg<std::string> replayfileArg("",
+                                               "replay-misses",
+                                               "Replay a recorded miss stream through the cache's lower levels instead of running a trace (supports the hit-level dumper and the miss-count metric, reported at the end)",
+                                               false,
+                                               "",
+                                               "filename",
+                                               cmd);
+
+    TCLAP::ValueArg<unsigned> misslevelArg("",
+                                           "miss-level",
+                                           "Number of upper levels whose outgoing requests are recorded",
+                                           false,
+                                           1,
+                                           "number",
+                                           cmd);
+
     // Parse command line.
     cmd.parse(argc, argv);
 
@@ -184,21 +389,64 @@ int main(int argc, char *argv[]){
     windowsize = windowsizeArg.getValue();
     period = periodArg.getValue();
     numrefs = numrefsArg.getValue();
+    progress = progressArg.getValue();
+    readahead = readaheadArg.getValue();
     bsfile = bsfileArg.getValue();
     numstreams = numstreamsArg.getValue();
+    samplesets = samplesetsArg.getValue();
+    sampleperiod = sampleperiodArg.getValue();
+    samplewindow = samplewindowArg.getValue();
+    samplewarmup = samplewarmupArg.getValue();
+    confidence = confidenceArg.getValue();
+    sampleerror = sampleerrorArg.getValue();
+    tlbspecfile = tlbspecfileArg.getValue();
+    regfile = regfileArg.getValue();
+    pagesizestrings = pagesizestringsArg.getValue();
+    mithrilfile = mithrilfileArg.getValue();
+    conflicttop = conflicttopArg.getValue();
+    profileperiod = profileperiodArg.getValue();
+    calltreemetric = calltreemetricArg.getValue();
+    calltreetop = calltreetopArg.getValue();
+    recordfile = recordfileArg.getValue();
+    replayfile = replayfileArg.getValue();
+    misslevel = misslevelArg.getValue();
   }
   catch(TCLAP::ArgException& e){
     std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
     exit(1);
   }
 
+  // A replay takes the place of the trace.
+  if(replayfile == "" and tracefile == ""){
+    std::cerr << "error: a trace file is required (unless replaying a miss stream)." << std::endl;
+    exit(1);
+  }
+
+  if(replayfile != "" and (tracefile != "" or recordfile != "")){
+    std::cerr << "error: a miss stream replay cannot run a trace or record another miss stream." << std::endl;
+    exit(1);
+  }
+
   // Open the trace file.
   TraceReader::ptr trace(new TraceReader);
-  if(!trace->open(tracefile)){
+  trace->setReadAhead(readahead);
+  if(replayfile == "" and !trace->open(tracefile)){
     std::cerr << "error: cannot open trace file '" << tracefile << "' for reading." << std::endl;
     exit(1);
   }
 
+  // Look up the trace length in its index, rather than requiring it on
+  // the command line.
+  if(progress and numrefs == -1 and replayfile == ""){
+    TraceIndex index;
+    if(!index.open(tracefile)){
+      std::cerr << "error: " << index.error() << std::endl;
+      exit(1);
+    }
+
+    numrefs = static_cast<long>(std::min<uint64_t>(index.num_records(), numrecords));
+  }
+
   // Create a blockstream reader (if the file was supplied).  Leave an
   // empty pointer if there is no block stream file to use.
   BlockStreamReader::ptr bsreader;
@@ -215,17 +463,157 @@ int main(int argc, char *argv[]){
   if(policy != "" and
      policy != "temperature" and
      policy != "bandwidth" and
+     policy != "prefetch-bandwidth" and
      policy != "miss-count"){
     std::cerr << "error: invalid policy '" << policy << "'" << std::endl;
     exit(1);
   }
 
+  // Validate the sampling options.
+  const bool sampling = (samplesets > 1 or sampleperiod > 0);
+  if(sampleperiod > 0 and (samplewindow == 0 or samplewindow > sampleperiod)){
+    std::cerr << "error: the sample window must be positive and no longer than the sample period." << std::endl;
+    exit(1);
+  }
+
+  // NOTE(choudhury): stopping early is only sound when the windows
+  // are drawn from across the trace; set sampling alone would measure
+  // a prefix of it and say nothing about the rest.
+  if(sampleerror > 0.0 and sampleperiod == 0){
+    std::cerr << "error: --sample-error requires --sample-period." << std::endl;
+    exit(1);
+  }
+
+  if(confidence <= 0.0 or confidence >= 1.0){
+    std::cerr << "error: the confidence level must lie strictly between 0 and 1." << std::endl;
+    exit(1);
+  }
+
   // Validate the dump string.
+  bool conflicts = false;
   foreach(const std::string& s, dump){
-    if(s != "hit-level"){
+    if(s != "hit-level" and s != "tlb-level" and s != "conflicts" and s != "line-profile" and s != "call-tree"){
       std::cerr << "error: invalid dumper '" << s << "'" << std::endl;
       exit(1);
     }
+
+    if(s == "tlb-level" and tlbspecfile == ""){
+      std::cerr << "error: the tlb-level dumper requires a TLB config file." << std::endl;
+      exit(1);
+    }
+
+    if(s == "conflicts"){
+      if(regfile == "" and mithrilfile == ""){
+        std::cerr << "error: the conflicts dumper requires a registration file or a mithril file." << std::endl;
+        exit(1);
+      }
+
+      conflicts = true;
+    }
+  }
+
+  // Parse the region page sizes.
+  std::map<std::string, TLB::PageSize> pagesizes;
+  foreach(const std::string& s, pagesizestrings){
+    const std::string::size_type eq = s.rfind('=');
+    TLB::PageSize page;
+    if(eq == std::string::npos or not TLB::page_size(s.substr(eq + 1), page)){
+      std::cerr << "error: malformed page size specification \"" << s << "\" (expected \"region=size\", with size one of 4K, 2M, or 1G)." << std::endl;
+      exit(1);
+    }
+
+    pagesizes[s.substr(0, eq)] = page;
+  }
+
+  if(pagesizes.size() > 0 and tlbspecfile == ""){
+    std::cerr << "error: page sizes apply only to TLB simulation." << std::endl;
+    exit(1);
+  }
+
+  if(regfile != "" and tlbspecfile == "" and not conflicts){
+    std::cerr << "error: region registration applies only to TLB simulation and the conflicts dumper." << std::endl;
+    exit(1);
+  }
+
+  // A replay reproduces only the lower levels' results, so it can
+  // feed only the consumers that depend on nothing else.
+  if(replayfile != ""){
+    if(sampling or tlbspecfile != "" or (policy != "" and policy != "miss-count")){
+      std::cerr << "error: a miss stream replay supports only the miss-count metric, without sampling or TLB simulation." << std::endl;
+      exit(1);
+    }
+
+    foreach(const std::string& s, dump){
+      if(s != "hit-level"){
+        std::cerr << "error: a miss stream replay supports only the hit-level dumper." << std::endl;
+        exit(1);
+      }
+    }
+  }
+
+  if(recordfile != "" and sampling){
+    std::cerr << "error: miss streams cannot be recorded while sampling." << std::endl;
+    exit(1);
+  }
+
+  const bool calltree = std::find(dump.begin(), dump.end(), "call-tree") != dump.end();
+  if(mithrilfile != "" and not conflicts and not calltree){
+    std::cerr << "error: the mithril file applies only to the conflicts and call-tree dumpers." << std::endl;
+    exit(1);
+  }
+
+  // Read the registered regions, gathering the array and matrix
+  // regions alike.
+  std::vector<MTR::ArrayRegion> regions;
+  if(regfile != ""){
+    MTR::RegionRegistration reg;
+    reg.read(regfile.c_str());
+    if(reg.hasError()){
+      std::cerr << "error: " << reg.error() << std::endl;
+      exit(1);
+    }
+
+    regions = reg.arrayRegions;
+    for(unsigned i=0; i<regions.size(); i++){
+      if(regions[i].title == ""){
+        std::stringstream ss;
+        ss << "array" << i;
+        regions[i].title = ss.str();
+      }
+    }
+
+    for(unsigned i=0; i<reg.matrixRegions.size(); i++){
+      const MTR::MatrixRegion& m = reg.matrixRegions[i];
+
+      std::string name = m.title;
+      if(name == ""){
+        std::stringstream ss;
+        ss << "matrix" << i;
+        name = ss.str();
+      }
+
+      regions.push_back(MTR::ArrayRegion(m.base, m.size, m.type, name));
+    }
+  }
+
+  // Read the global variables.
+  std::vector<StackIndex::Global> globals;
+  if(mithrilfile != "" and conflicts){
+    std::string err;
+    if(not StackIndex::read_globals(mithrilfile, globals, err)){
+      std::cerr << "error: " << err << std::endl;
+      exit(1);
+    }
+  }
+
+  // Read the function names.
+  std::vector<StackIndex::Function> functions;
+  if(mithrilfile != "" and calltree){
+    std::string err;
+    if(not StackIndex::read_functions(mithrilfile, functions, err)){
+      std::cerr << "error: " << err << std::endl;
+      exit(1);
+    }
   }
 
   // Parse the address ranges.
@@ -301,6 +689,33 @@ int main(int argc, char *argv[]){
   //   std::cout << std::endl;
   // }
 
+  // Create the TLB, if one was requested, and back the registered
+  // regions with their pages.
+  TLB::ptr tlb;
+  if(tlbspecfile != ""){
+    tlb = TLB::newFromSpec(tlbspecfile, error);
+    if(!tlb){
+      std::cerr << error << std::endl;
+      exit(1);
+    }
+
+    foreach(const MTR::ArrayRegion& r, regions){
+      TLB::PageSize page = tlb->default_page_size();
+      std::map<std::string, TLB::PageSize>::iterator p = pagesizes.find(r.title);
+      if(p != pagesizes.end()){
+        page = p->second;
+        pagesizes.erase(p);
+      }
+
+      tlb->addRegion(r.title, r.base, r.base + r.size, page);
+    }
+
+    if(pagesizes.size() > 0){
+      std::cerr << "error: page size given for unregistered region '" << pagesizes.begin()->first << "'." << std::endl;
+      exit(1);
+    }
+  }
+
   // Set up CacheSimulator objects, one per cache in the set.
   std::vector<NewCacheSimulator::ptr> simulators;
   foreach(NewCache::ptr c, caches->getCaches()){
@@ -308,16 +723,100 @@ int main(int argc, char *argv[]){
     simulators.push_back(p);
   }
 
+  // The sources of the caches' access records: the simulators, unless
+  // a replay stands in for them.
+  std::vector<MTV::Producer<CacheAccessRecord>::ptr> results(simulators.begin(), simulators.end());
+
+  // Record the first cache's miss stream, or replay one through it.
+  MissStreamWriter::ptr misswriter;
+  if(recordfile != ""){
+    misswriter = boost::make_shared<MissStreamWriter>(misslevel);
+    if(!misswriter->open(recordfile, *caches->getCaches()[0])){
+      std::cerr << "error: " << misswriter->error() << std::endl;
+      exit(1);
+    }
+
+    caches->getCaches()[0]->set_miss_stream(misswriter);
+  }
+
+  MissStreamReader::ptr missreader;
+  MissStreamReplayer::ptr replayer;
+  if(replayfile != ""){
+    if(caches->getCaches().size() != 1){
+      std::cerr << "error: a miss stream can only be replayed through a single cache." << std::endl;
+      exit(1);
+    }
+
+    missreader = boost::make_shared<MissStreamReader>();
+    if(!missreader->open(replayfile, *caches->getCaches()[0])){
+      std::cerr << "error: " << missreader->error() << std::endl;
+      exit(1);
+    }
+
+    replayer = boost::make_shared<MissStreamReplayer>(caches->getCaches()[0], missreader);
+    results[0] = replayer;
+  }
+
   // TraceReader -> MFilter -> Filter{i} -> NewCache{j} -> Averager{j} -> File
   MemoryRecordFilter::ptr mfilter(new MemoryRecordFilter);
   trace->addConsumer(mfilter);
 
+  // The TLB sees every memory record, whichever cache handles it (and
+  // whether or not it is sampled).
+  TLBSimulator::ptr tlbsim;
+  if(tlb){
+    tlbsim = boost::make_shared<TLBSimulator>(tlb);
+    mfilter->addConsumer(tlbsim);
+  }
+
+  // In sampling mode, a sampler sits between the memory records and
+  // the address filters, and the simulators report to sampled stats
+  // collectors instead of performance counters.
+  CacheSampler::ptr sampler;
+  std::vector<SampledCacheStats::ptr> samplestats;
+  if(sampling){
+    // Set classes must cover whole sets in every level of every cache.
+    uint64_t groups = 0;
+    foreach(NewCache::ptr c, caches->getCaches()){
+      if(c->block_size() != caches->getCaches()[0]->block_size()){
+        std::cerr << "error: set sampling requires the caches to share a block size." << std::endl;
+        exit(1);
+      }
+
+      for(unsigned L=0; L<c->num_levels(); L++){
+        groups = boost::math::gcd(groups, c->level(L)->num_sets());
+      }
+    }
+
+    if(samplesets > groups){
+      std::cerr << "error: cannot sample one in " << samplesets << " sets, as the levels have only " << groups << " sets in common." << std::endl;
+      exit(1);
+    }
+
+    sampler = boost::make_shared<CacheSampler>(caches->getCaches()[0]->block_size(),
+                                               groups,
+                                               samplesets,
+                                               sampleperiod,
+                                               samplewindow,
+                                               samplewarmup < 0 ? CacheSampler::Unbounded : samplewarmup);
+    mfilter->addConsumer(sampler);
+
+    for(unsigned i=0; i<simulators.size(); i++){
+      SampledCacheStats::ptr stats = boost::make_shared<SampledCacheStats>(sampler, caches->getCaches()[i]->num_levels(), caches->getCaches()[i]->block_size());
+      simulators[i]->MTV::Producer<CacheAccessRecord>::addConsumer(stats);
+      samplestats.push_back(stats);
+    }
+  }
+
+  // The source of records for the address filters.
+  MTV::Producer<MTR::Record>::ptr source = sampler ? MTV::Producer<MTR::Record>::ptr(sampler) : MTV::Producer<MTR::Record>::ptr(mfilter);
+
   // Set up a path for each address range, so the addresses can be
   // funneled to the proper cache simulator.
   if(ranges.size() == 0){
     std::cerr << "warning: no address ranges specified - passing all addresses." << std::endl;
     AddressRangePass::ptr allpass = AddressRangePass::all();
-    mfilter->addConsumer(allpass);
+    source->addConsumer(allpass);
     foreach(NewCacheSimulator::ptr p, simulators){
       allpass->MTV::Producer<MTR::Record>::addConsumer(p);
     }
@@ -326,7 +825,7 @@ int main(int argc, char *argv[]){
     foreach(const WhichCache& range, ranges){
       // Connect the trace reader to an address filter.
       AddressRangePass::ptr pass(new AddressRangePass(range.base, range.limit));
-      mfilter->addConsumer(pass);
+      source->addConsumer(pass);
 
       // Connect the address filter to the appropriate cache simulator.
       pass->MTV::Producer<MTR::Record>::addConsumer(simulators[range.which]);
@@ -347,6 +846,11 @@ int main(int argc, char *argv[]){
       counters.push_back(boost::make_shared<NewCacheLevelToLevelBandwidthPolicy>(s->getCache()));
     }
   }
+  else if(policy == "prefetch-bandwidth"){
+    foreach(NewCacheSimulator::const_ptr s, simulators){
+      counters.push_back(boost::make_shared<NewCachePrefetchBandwidthPolicy>(s->getCache()));
+    }
+  }
   else if(policy == "miss-count"){
     foreach(NewCacheSimulator::const_ptr s, simulators){
       counters.push_back(boost::make_shared<NewCacheMissCountPolicy>(s->getCache()));
@@ -359,7 +863,11 @@ int main(int argc, char *argv[]){
     abort();
   }
 
-  if(counters.size() == 0){
+  if(sampling){
+    // The sampled stats stand in for the performance counters.
+    counters.clear();
+  }
+  else if(counters.size() == 0){
     std::cerr << "warning: no performance metric specified." << std::endl;
   }
 
@@ -370,7 +878,7 @@ int main(int argc, char *argv[]){
       CachePerformanceCounter::ptr perf = boost::make_shared<CachePerformanceCounter>(period);
       perf->setPolicy(counters[i]);
 
-      simulators[i]->MTV::Producer<CacheAccessRecord>::addConsumer(perf);
+      results[i]->addConsumer(perf);
 
       perfs.push_back(perf);
 
@@ -392,9 +900,108 @@ int main(int argc, char *argv[]){
 
         // TODO(choudhury): this dumper just connects to the first
         // cache within a set.  Need a better way to handle this.
-        simulators[0]->MTV::Producer<CacheAccessRecord>::addConsumer(h);
+        results[0]->addConsumer(h);
+      }
+    }
+  }
+
+  foreach(const std::string& s, dump){
+    if(s == "tlb-level"){
+      TLBLevelCounter::ptr t = boost::make_shared<TLBLevelCounter>();
+      if(!t->open("tlb-level.dat")){
+        std::cerr << "error: could not open file 'tlb-level.dat' for writing (for use with TLBLevelCounter)." << std::endl;
+        exit(1);
+      }
+
+      tlbsim->addConsumer(t);
+    }
+  }
+
+  // The conflict matrices, by registered region and by global
+  // variable.  Like the hit-level dumper, these watch only the first
+  // cache of a set.
+  ConflictMatrix::ptr regionconflicts, varconflicts;
+  if(conflicts){
+    NewCache::const_ptr c = caches->getCaches()[0];
+
+    if(regions.size() > 0){
+      regionconflicts = boost::make_shared<ConflictMatrix>(c->num_levels(), c->block_size());
+      foreach(const MTR::ArrayRegion& r, regions){
+        regionconflicts->addRegion(r.title, r.base, r.base + r.size);
+      }
+
+      simulators[0]->MTV::Producer<CacheAccessRecord>::addConsumer(regionconflicts);
+    }
+
+    if(globals.size() > 0){
+      varconflicts = boost::make_shared<ConflictMatrix>(c->num_levels(), c->block_size());
+      foreach(const StackIndex::Global& g, globals){
+        varconflicts->addRegion(g.name, g.base, g.base + g.size);
+      }
+
+      simulators[0]->MTV::Producer<CacheAccessRecord>::addConsumer(varconflicts);
+    }
+    else if(mithrilfile != ""){
+      std::cerr << "warning: mithril file '" << mithrilfile << "' has no global variables." << std::endl;
+    }
+  }
+
+  // The line profile takes the line records straight from the trace,
+  // and the cache results from the first cache of the set.
+  LineProfile::ptr lineprofile;
+  if(std::find(dump.begin(), dump.end(), "line-profile") != dump.end()){
+    lineprofile = boost::make_shared<LineProfile>(caches->getCaches()[0]->num_levels());
+    if(profileperiod > 0){
+      lineprofile->setSnapshot("line-profile.dat", profileperiod);
+    }
+
+    LineRecordFilter::ptr lfilter = boost::make_shared<LineRecordFilter>();
+    trace->addConsumer(lfilter);
+    lfilter->addConsumer(lineprofile);
+
+    simulators[0]->MTV::Producer<CacheAccessRecord>::addConsumer(lineprofile);
+  }
+
+  // The call tree profile follows the function records straight from
+  // the trace, and takes the cache results from the first cache of the
+  // set.
+  CallTreeProfile::ptr calltreeprofile;
+  unsigned calltreecounter = 0;
+  if(calltree){
+    NewCache::const_ptr c = caches->getCaches()[0];
+    calltreeprofile = boost::make_shared<CallTreeProfile>(c->num_levels(), c->block_size());
+    if(not calltreeprofile->counter(calltreemetric, calltreecounter)){
+      std::cerr << "error: invalid call tree metric '" << calltreemetric << "'." << std::endl;
+      exit(1);
+    }
+
+    foreach(const StackIndex::Function& f, functions){
+      calltreeprofile->addFunction(f.name, f.low_pc, f.high_pc);
+    }
+
+    trace->addConsumer(calltreeprofile);
+    simulators[0]->MTV::Producer<CacheAccessRecord>::addConsumer(calltreeprofile);
+  }
+
+  // A replay drives the lower levels straight from the miss stream,
+  // reporting once at the end.
+  if(replayer){
+    while(replayer->step()){}
+
+    if(missreader->hasError()){
+      std::cerr << "error: " << missreader->error() << std::endl;
+      exit(1);
+    }
+
+    if(perfs.size() > 0){
+      foreach(CachePerformanceCounter::ptr p, perfs){
+        printer->consume(p->rates());
+        std::cout << " ";
       }
+      std::cout << std::endl;
     }
+
+    return 0;
   }
 
   // The network is now complete.  Each record that comes from the
@@ -411,6 +1018,20 @@ int main(int argc, char *argv[]){
     for(unsigned long i=0; i < numrecords; i++){
       trace->nextRecord();
 
+      // Every so often, check whether the estimates are good enough to
+      // stop.
+      if(sampler and sampleerror > 0.0 and i > 0 and i % SampledCacheStats::CheckInterval == 0){
+        bool done = true;
+        foreach(SampledCacheStats::const_ptr s, samplestats){
+          done = done and s->converged(sampleerror, confidence);
+        }
+
+        if(done){
+          std::cerr << "sampled estimates reached the requested error after " << sampler->records() << " records." << std::endl;
+          break;
+        }
+      }
+
       if(period > 0 and i % period == 0){
         foreach(CachePerformanceCounter::ptr p, perfs){
           printer->consume(p->rates());
@@ -466,5 +1087,76 @@ int main(int argc, char *argv[]){
     }
   }
 
+  if(misswriter and !misswriter->close()){
+    std::cerr << "error: could not write miss stream '" << recordfile << "'." << std::endl;
+    exit(1);
+  }
+
+  // Summarize the prefetchers, if there were any.
+  for(unsigned i=0; i<caches->getCaches().size(); i++){
+    NewCache::const_ptr c = caches->getCaches()[i];
+    for(unsigned L=0; L<c->num_levels(); L++){
+      if(not c->level(L)->prefetcher()){
+        continue;
+      }
+
+      const NewCache::PrefetchStats stats = c->prefetch_stats(L);
+      std::cerr << "cache " << i << " L" << (L+1) << " prefetches: "
+                << stats.issued << " issued, "
+                << stats.useful << " useful, "
+                << stats.late << " late, "
+                << stats.polluting << " polluting" << std::endl;
+    }
+  }
+
+  if(tlb){
+    tlb->report(std::cout);
+  }
+
+  if(lineprofile and not lineprofile->save("line-profile.dat")){
+    std::cerr << "error: could not write file 'line-profile.dat'." << std::endl;
+    exit(1);
+  }
+
+  if(calltreeprofile){
+    std::ofstream out("call-tree.folded");
+    calltreeprofile->writeCollapsed(out, calltreecounter);
+    if(!out){
+      std::cerr << "error: could not write file 'call-tree.folded'." << std::endl;
+      exit(1);
+    }
+
+    std::cout << "call tree (" << calltreemetric << "):" << std::endl;
+    calltreeprofile->report(std::cout, calltreecounter, calltreetop);
+  }
+
+  if(regionconflicts){
+    if(not regionconflicts->save("conflicts.dat")){
+      std::cerr << "error: could not write file 'conflicts.dat'." << std::endl;
+      exit(1);
+    }
+
+    std::cout << "regions: ";
+    regionconflicts->report(std::cout, conflicttop);
+  }
+
+  if(varconflicts){
+    if(not varconflicts->save("conflict-variables.dat")){
+      std::cerr << "error: could not write file 'conflict-variables.dat'." << std::endl;
+      exit(1);
+    }
+
+    std::cout << "variables: ";
+    varconflicts->report(std::cout, conflicttop);
+  }
+
+  if(sampling){
+    sampler->describe(std::cout);
+    for(unsigned i=0; i<samplestats.size(); i++){
+      std::cout << "cache " << i << " ";
+      samplestats[i]->report(std::cout, confidence, policy);
+    }
+  }
+
   return 0;
 }
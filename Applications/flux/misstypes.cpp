@@ -5,6 +5,8 @@
 
 // MTV headers.
 #include <Core/Dataflow/TraceReader.h>
+#include <Core/Util/BlockInterner.h>
+using MTV::BlockInterner;
 using MTV::TraceReader;
 
 // TCLAP headers.
@@ -107,9 +109,9 @@ int main(int argc, char *argv[]){
     exit(1);
   }
 
-  // Instantiate a set object, used to watch for previously unseen
-  // block addresses.
-  boost::unordered_set<uint64_t> blocks;
+  // Intern the block addresses to watch for previously unseen ones -
+  // a new block gets the next ID.
+  BlockInterner blocks(blocksize);
 
   // Use this to count the miss types.
   MissCounts counts;
@@ -118,8 +120,8 @@ int main(int argc, char *argv[]){
   uint64_t trace_size;
   try{
     for(trace_size = 0; ; trace_size++){
-      // Grab a record and compute its block address.
-      const uint64_t block_addr = reader.nextRecord().addr / blocksize;
+      // Grab a record.
+      const MTR::addr_t addr = reader.nextRecord().addr;
 
       // Read out one record from each of the hit level files - this
       // needs to be done even if the miss is compulsory, so just do
@@ -131,10 +133,9 @@ int main(int argc, char *argv[]){
 
       // Check whether this is the first time this block has been
       // accessed - if so, it is a compulsory miss.
-      boost::unordered_set<uint64_t>::const_iterator i = blocks.find(block_addr);
-      if(i == blocks.end()){
+      const BlockInterner::id_t seen = blocks.size();
+      if(blocks.intern(addr) == seen){
         counts.compulsory++;
-        blocks.insert(block_addr);
       }
       else{
         // If the access is not a hit, then this filter of if-else
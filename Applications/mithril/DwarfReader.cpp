@@ -0,0 +1,1214 @@
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// DwarfReader.cpp
+
+// MTV headers.
+#include <Applications/mithril/DwarfReader.h>
+#include <Core/Util/BoostForeach.h>
+using MTV::Mithril::LexicalBlock;
+using MTV::Mithril::LexicalBlockList;
+using MTV::Mithril::Locator;
+using MTV::Mithril::Loclist;
+using MTV::Mithril::Subprogram;
+using MTV::Mithril::SubprogramList;
+using MTV::Mithril::Type;
+using MTV::Mithril::TypeList;
+using MTV::Mithril::Variable;
+using MTV::Mithril::VariableList;
+
+// Boost headers.
+#include <boost/bind.hpp>
+#include <boost/unordered_map.hpp>
+
+// System headers.
+#include <cstring>
+#include <elf.h>
+#include <limits>
+#include <sstream>
+
+namespace{
+  // The DWARF constants mithril cares about (see the DWARF 4
+  // standard, section 7).
+  enum{
+    DW_TAG_array_type = 0x01,
+    DW_TAG_class_type = 0x02,
+    DW_TAG_formal_parameter = 0x05,
+    DW_TAG_lexical_block = 0x0b,
+    DW_TAG_pointer_type = 0x0f,
+    DW_TAG_reference_type = 0x10,
+    DW_TAG_compile_unit = 0x11,
+    DW_TAG_structure_type = 0x13,
+    DW_TAG_subroutine_type = 0x15,
+    DW_TAG_typedef = 0x16,
+    DW_TAG_base_type = 0x24,
+    DW_TAG_const_type = 0x26,
+    DW_TAG_subprogram = 0x2e,
+    DW_TAG_variable = 0x34,
+    DW_TAG_namespace = 0x39
+  };
+
+  enum{
+    DW_AT_location = 0x02,
+    DW_AT_name = 0x03,
+    DW_AT_byte_size = 0x0b,
+    DW_AT_stmt_list = 0x10,
+    DW_AT_low_pc = 0x11,
+    DW_AT_high_pc = 0x12,
+    DW_AT_comp_dir = 0x1b,
+    DW_AT_abstract_origin = 0x31,
+    DW_AT_artificial = 0x34,
+    DW_AT_decl_file = 0x3a,
+    DW_AT_decl_line = 0x3b,
+    DW_AT_declaration = 0x3c,
+    DW_AT_frame_base = 0x40,
+    DW_AT_specification = 0x47,
+    DW_AT_type = 0x49,
+    DW_AT_ranges = 0x55
+  };
+
+  enum{
+    DW_FORM_addr = 0x01,
+    DW_FORM_block2 = 0x03,
+    DW_FORM_block4 = 0x04,
+    DW_FORM_data2 = 0x05,
+    DW_FORM_data4 = 0x06,
+    DW_FORM_data8 = 0x07,
+    DW_FORM_string = 0x08,
+    DW_FORM_block = 0x09,
+    DW_FORM_block1 = 0x0a,
+    DW_FORM_data1 = 0x0b,
+    DW_FORM_flag = 0x0c,
+    DW_FORM_sdata = 0x0d,
+    DW_FORM_strp = 0x0e,
+    DW_FORM_udata = 0x0f,
+    DW_FORM_ref_addr = 0x10,
+    DW_FORM_ref1 = 0x11,
+    DW_FORM_ref2 = 0x12,
+    DW_FORM_ref4 = 0x13,
+    DW_FORM_ref8 = 0x14,
+    DW_FORM_ref_udata = 0x15,
+    DW_FORM_indirect = 0x16,
+    DW_FORM_sec_offset = 0x17,
+    DW_FORM_exprloc = 0x18,
+    DW_FORM_flag_present = 0x19,
+    DW_FORM_ref_sig8 = 0x20
+  };
+
+  enum{
+    DW_OP_addr = 0x03,
+    DW_OP_breg0 = 0x70,
+    DW_OP_breg31 = 0x8f,
+    DW_OP_fbreg = 0x91
+  };
+
+  // Reads little-endian values and LEB128 numbers out of a section,
+  // remembering (rather than crashing on) any read past the end.
+  class Cursor{
+  public:
+    Cursor(const unsigned char *p, const unsigned char *end)
+      : p(p),
+        end(end),
+        ok(p <= end)
+    {}
+
+    bool good() const { return ok; }
+    const unsigned char *pos() const { return p; }
+    bool done() const { return !ok or p >= end; }
+
+    uint64_t fixed(unsigned bytes){
+      if(!this->have(bytes)){
+        return 0;
+      }
+
+      uint64_t v = 0;
+      for(unsigned i=0; i<bytes; i++){
+        v |= static_cast<uint64_t>(p[i]) << (8*i);
+      }
+      p += bytes;
+      return v;
+    }
+
+    uint64_t uleb(){
+      uint64_t v = 0;
+      unsigned shift = 0;
+      while(this->have(1)){
+        const unsigned char b = *p++;
+        if(shift < 64){
+          v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        }
+        shift += 7;
+        if(!(b & 0x80)){
+          break;
+        }
+      }
+      return v;
+    }
+
+    int64_t sleb(){
+      int64_t v = 0;
+      unsigned shift = 0;
+      unsigned char b = 0;
+      while(this->have(1)){
+        b = *p++;
+        if(shift < 64){
+          v |= static_cast<int64_t>(b & 0x7f) << shift;
+        }
+        shift += 7;
+        if(!(b & 0x80)){
+          break;
+        }
+      }
+      if(shift < 64 and (b & 0x40)){
+        v |= -(static_cast<int64_t>(1) << shift);
+      }
+      return v;
+    }
+
+    const char *cstr(){
+      const unsigned char *s = p;
+      while(p < end and *p){
+        ++p;
+      }
+      if(!this->have(1)){
+        return "";
+      }
+      ++p;
+      return reinterpret_cast<const char *>(s);
+    }
+
+    const unsigned char *skip(uint64_t bytes){
+      const unsigned char *s = p;
+      if(this->have(bytes)){
+        p += bytes;
+      }
+      return s;
+    }
+
+  private:
+    bool have(uint64_t bytes){
+      if(ok and static_cast<uint64_t>(end - p) >= bytes){
+        return true;
+      }
+      ok = false;
+      return false;
+    }
+
+  private:
+    const unsigned char *p, *end;
+    bool ok;
+  };
+
+  // A decoded attribute value.  References are converted to
+  // .debug_info offsets, so that they match DIE ids.
+  struct Value{
+    Value()
+      : form(0),
+        u(0),
+        s(0),
+        str(0),
+        block(0),
+        len(0)
+    {}
+
+    uint64_t form;
+    uint64_t u;
+    int64_t s;
+    const char *str;
+    const unsigned char *block;
+    uint64_t len;
+  };
+
+  struct Abbrev{
+    Abbrev()
+      : tag(0),
+        children(false)
+    {}
+
+    uint64_t tag;
+    bool children;
+    std::vector<std::pair<uint64_t, uint64_t> > specs;
+  };
+
+  struct Die{
+    uint64_t offset;
+    uint64_t tag;
+    std::vector<std::pair<uint64_t, Value> > attrs;
+    std::vector<unsigned> children;
+  };
+
+  bool is_type_tag(uint64_t tag){
+    return (tag == DW_TAG_base_type or
+            tag == DW_TAG_class_type or tag == DW_TAG_structure_type or
+            tag == DW_TAG_typedef or tag == DW_TAG_subroutine_type or
+            tag == DW_TAG_const_type or
+            tag == DW_TAG_pointer_type or
+            tag == DW_TAG_reference_type or
+            tag == DW_TAG_array_type);
+  }
+
+  std::string join_path(const std::string& dir, const std::string& name){
+    if(dir == "" or (name.length() > 0 and name[0] == '/')){
+      return name;
+    }
+    return dir[dir.length() - 1] == '/' ? dir + name : dir + "/" + name;
+  }
+
+  // Decodes a single compilation unit and walks its DIE tree the same
+  // way DwarfParser walks the dwarfdump text, appending to the lists
+  // passed in.
+  //
+  // NOTE(choudhury): elements the text parser has no handler for (and
+  // would abort on) are skipped here instead, and the ids are
+  // .debug_info offsets rather than dwarfdump's CU-relative ones, so
+  // that type references stay unique across compilation units.
+  class UnitDecoder{
+  public:
+    UnitDecoder(const DwarfReader::Sections& sections, uint64_t offset,
+                TypeList& types, VariableList& vars, SubprogramList& subprograms, LexicalBlockList& scopes,
+                std::vector<std::string>& warnings)
+      : sections(sections),
+        offset(offset),
+        types(types),
+        vars(vars),
+        subprograms(subprograms),
+        scopes(scopes),
+        warnings(warnings)
+    {}
+
+    // Returns an empty string on success, or an error message.
+    std::string decode(){
+      std::string err;
+      if((err = this->parse_header()) != "" or
+         (err = this->parse_abbrevs()) != "" or
+         (err = this->parse_dies()) != ""){
+        return err;
+      }
+
+      foreach(unsigned root, roots){
+        if(dies[root].tag == DW_TAG_compile_unit){
+          this->parse_line_table(dies[root]);
+          this->compile_unit(dies[root]);
+        }
+        else{
+          this->warn(dies[root], "skipping non-compile-unit element at top level");
+        }
+      }
+
+      return "";
+    }
+
+  private:
+    std::string parse_header(){
+      Cursor c(sections.info.data + offset, sections.info.data + sections.info.size);
+
+      uint64_t length = c.fixed(4);
+      offset_size = 4;
+      if(length == 0xffffffff){
+        length = c.fixed(8);
+        offset_size = 8;
+      }
+      end = (c.pos() - sections.info.data) + length;
+
+      version = c.fixed(2);
+      abbrev_offset = c.fixed(offset_size);
+      address_size = c.fixed(1);
+      first = c.pos() - sections.info.data;
+
+      std::stringstream ss;
+      if(!c.good() or end > sections.info.size){
+        ss << "truncated compilation unit header at offset 0x" << std::hex << offset;
+      }
+      else if(version < 2 or version > 4){
+        ss << "compilation unit at offset 0x" << std::hex << offset << " is DWARF version " << std::dec << version
+           << " (only versions 2-4 are supported; try compiling with -gdwarf-4)";
+      }
+      else if(address_size != 4 and address_size != 8){
+        ss << "unsupported address size " << address_size << " in compilation unit at offset 0x" << std::hex << offset;
+      }
+      return ss.str();
+    }
+
+    std::string parse_abbrevs(){
+      if(abbrev_offset >= sections.abbrev.size){
+        return "abbreviation table offset out of range";
+      }
+
+      Cursor c(sections.abbrev.data + abbrev_offset, sections.abbrev.data + sections.abbrev.size);
+      while(!c.done()){
+        const uint64_t code = c.uleb();
+        if(code == 0){
+          break;
+        }
+
+        // NOTE(choudhury): abbreviation codes are in practice numbered
+        // densely from 1, so a vector serves as the lookup table.
+        if(code > (1 << 20)){
+          return "abbreviation code out of range";
+        }
+        if(code >= abbrevs.size()){
+          abbrevs.resize(code + 1);
+        }
+
+        Abbrev& a = abbrevs[code];
+        a.tag = c.uleb();
+        a.children = c.fixed(1) != 0;
+        while(c.good()){
+          const uint64_t name = c.uleb();
+          const uint64_t form = c.uleb();
+          if(name == 0 and form == 0){
+            break;
+          }
+          a.specs.push_back(std::make_pair(name, form));
+        }
+      }
+
+      return c.good() ? "" : "truncated abbreviation table";
+    }
+
+    bool read_value(Cursor& c, uint64_t form, Value& v){
+      v.form = form;
+      switch(form){
+      case DW_FORM_addr: v.u = c.fixed(address_size); break;
+      case DW_FORM_data1: v.u = c.fixed(1); break;
+      case DW_FORM_data2: v.u = c.fixed(2); break;
+      case DW_FORM_data4: v.u = c.fixed(4); break;
+      case DW_FORM_data8: v.u = c.fixed(8); break;
+      case DW_FORM_sdata: v.s = c.sleb(); v.u = static_cast<uint64_t>(v.s); break;
+      case DW_FORM_udata: v.u = c.uleb(); break;
+      case DW_FORM_flag: v.u = c.fixed(1); break;
+      case DW_FORM_flag_present: v.u = 1; break;
+      case DW_FORM_sec_offset: v.u = c.fixed(offset_size); break;
+      case DW_FORM_ref_sig8: v.u = c.fixed(8); break;
+
+      case DW_FORM_ref1: v.u = offset + c.fixed(1); break;
+      case DW_FORM_ref2: v.u = offset + c.fixed(2); break;
+      case DW_FORM_ref4: v.u = offset + c.fixed(4); break;
+      case DW_FORM_ref8: v.u = offset + c.fixed(8); break;
+      case DW_FORM_ref_udata: v.u = offset + c.uleb(); break;
+      case DW_FORM_ref_addr: v.u = c.fixed(version == 2 ? address_size : offset_size); break;
+
+      case DW_FORM_string: v.str = c.cstr(); break;
+      case DW_FORM_strp:
+        v.u = c.fixed(offset_size);
+        v.str = v.u < sections.str.size ? reinterpret_cast<const char *>(sections.str.data + v.u) : "";
+        break;
+
+      case DW_FORM_block1: v.len = c.fixed(1); v.block = c.skip(v.len); break;
+      case DW_FORM_block2: v.len = c.fixed(2); v.block = c.skip(v.len); break;
+      case DW_FORM_block4: v.len = c.fixed(4); v.block = c.skip(v.len); break;
+      case DW_FORM_block:
+      case DW_FORM_exprloc: v.len = c.uleb(); v.block = c.skip(v.len); break;
+
+      case DW_FORM_indirect: return this->read_value(c, c.uleb(), v);
+
+      default:
+        return false;
+      }
+
+      return c.good();
+    }
+
+    std::string parse_dies(){
+      Cursor c(sections.info.data + first, sections.info.data + end);
+
+      // The chain of DIEs whose children are currently being read.
+      std::vector<unsigned> parents;
+
+      while(!c.done()){
+        const uint64_t die_offset = c.pos() - sections.info.data;
+        const uint64_t code = c.uleb();
+        if(code == 0){
+          // A null entry ends a list of siblings.
+          if(!parents.empty()){
+            parents.pop_back();
+          }
+          continue;
+        }
+
+        if(code >= abbrevs.size() or abbrevs[code].tag == 0){
+          std::stringstream ss;
+          ss << "unknown abbreviation code " << code << " at offset 0x" << std::hex << die_offset;
+          return ss.str();
+        }
+        const Abbrev& a = abbrevs[code];
+
+        const unsigned index = dies.size();
+        dies.push_back(Die());
+        Die& d = dies.back();
+        d.offset = die_offset;
+        d.tag = a.tag;
+        d.attrs.resize(a.specs.size());
+        for(unsigned i=0; i<a.specs.size(); i++){
+          d.attrs[i].first = a.specs[i].first;
+          if(!this->read_value(c, a.specs[i].second, d.attrs[i].second)){
+            std::stringstream ss;
+            ss << "could not decode attribute form 0x" << std::hex << a.specs[i].second << " at offset 0x" << die_offset;
+            return ss.str();
+          }
+        }
+
+        index_of[die_offset] = index;
+        if(parents.empty()){
+          roots.push_back(index);
+        }
+        else{
+          dies[parents.back()].children.push_back(index);
+        }
+
+        if(a.children){
+          parents.push_back(index);
+        }
+      }
+
+      return c.good() ? "" : "truncated debugging information entry";
+    }
+
+    // Reads the file name table out of the compilation unit's line
+    // number program header, so that DW_AT_decl_file indices can be
+    // turned into paths the way dwarfdump prints them.
+    void parse_line_table(const Die& cu){
+      const Value *comp_dir_v = this->attr(cu, DW_AT_comp_dir);
+      const std::string comp_dir = comp_dir_v and comp_dir_v->str ? comp_dir_v->str : "";
+
+      const Value *stmt = this->attr(cu, DW_AT_stmt_list);
+      if(!stmt or stmt->u >= sections.line.size){
+        return;
+      }
+
+      Cursor c(sections.line.data + stmt->u, sections.line.data + sections.line.size);
+      unsigned size = 4;
+      if(c.fixed(4) == 0xffffffff){
+        c.fixed(8);
+        size = 8;
+      }
+
+      const uint64_t line_version = c.fixed(2);
+      if(line_version < 2 or line_version > 4){
+        this->warn(cu, "unsupported line table version - file names will be missing");
+        return;
+      }
+
+      c.fixed(size);
+      c.fixed(1);
+      if(line_version >= 4){
+        c.fixed(1);
+      }
+      c.fixed(1);
+      c.fixed(1);
+      c.fixed(1);
+      const unsigned opcode_base = c.fixed(1);
+      c.skip(opcode_base > 0 ? opcode_base - 1 : 0);
+
+      std::vector<std::string> dirs;
+      dirs.push_back(comp_dir);
+      while(c.good()){
+        const std::string dir = c.cstr();
+        if(dir == ""){
+          break;
+        }
+        dirs.push_back(join_path(comp_dir, dir));
+      }
+
+      // File numbering starts at 1.
+      files.push_back("");
+      while(c.good()){
+        const std::string name = c.cstr();
+        if(name == ""){
+          break;
+        }
+        const uint64_t dir = c.uleb();
+        c.uleb();
+        c.uleb();
+
+        files.push_back(join_path(dir < dirs.size() ? dirs[dir] : comp_dir, name));
+      }
+    }
+
+    const Value *attr(const Die& d, uint64_t name) const {
+      for(unsigned i=0; i<d.attrs.size(); i++){
+        if(d.attrs[i].first == name){
+          return &d.attrs[i].second;
+        }
+      }
+      return 0;
+    }
+
+    // Like attr(), but also looks through DW_AT_specification and
+    // DW_AT_abstract_origin, which is where out-of-line definitions
+    // (e.g. of C++ member functions) keep their names and types.
+    const Value *inherited_attr(const Die& d, uint64_t name) const {
+      const Die *cur = &d;
+      for(int hops=0; hops<8; hops++){
+        const Value *v = this->attr(*cur, name);
+        if(v){
+          return v;
+        }
+
+        const Value *ref = this->attr(*cur, DW_AT_specification);
+        if(!ref){
+          ref = this->attr(*cur, DW_AT_abstract_origin);
+        }
+        if(!ref){
+          return 0;
+        }
+
+        boost::unordered_map<uint64_t, unsigned>::const_iterator i = index_of.find(ref->u);
+        if(i == index_of.end()){
+          return 0;
+        }
+        cur = &dies[i->second];
+      }
+      return 0;
+    }
+
+    std::string name_of(const Die& d) const {
+      const Value *v = this->inherited_attr(d, DW_AT_name);
+      return v and v->str ? v->str : "";
+    }
+
+    uint64_t uint_of(const Die& d, uint64_t name, uint64_t dflt, bool inherit = false) const {
+      const Value *v = inherit ? this->inherited_attr(d, name) : this->attr(d, name);
+      return v ? v->u : dflt;
+    }
+
+    static bool is_constant(const Value& v){
+      return (v.form == DW_FORM_data1 or v.form == DW_FORM_data2 or v.form == DW_FORM_data4 or
+              v.form == DW_FORM_data8 or v.form == DW_FORM_udata or v.form == DW_FORM_sdata);
+    }
+
+    // Returns a DIE's [low_pc, high_pc) range, converting a DWARF 4
+    // style high_pc (an offset from low_pc) to an address.
+    void pc_range(const Die& d, uint64_t& low_pc, uint64_t& high_pc) const {
+      low_pc = this->uint_of(d, DW_AT_low_pc, 0x0);
+      high_pc = 0x0;
+
+      const Value *high = this->attr(d, DW_AT_high_pc);
+      if(high){
+        high_pc = is_constant(*high) ? low_pc + high->u : high->u;
+      }
+    }
+
+    // Computes the hull of a DW_AT_ranges list from .debug_ranges.
+    void range_hull(const Die& d, uint64_t base, uint64_t& low_pc, uint64_t& high_pc) const {
+      const Value *ranges = this->attr(d, DW_AT_ranges);
+      if(!ranges or ranges->u >= sections.ranges.size){
+        return;
+      }
+
+      const uint64_t max_address = address_size == 8 ? std::numeric_limits<uint64_t>::max() : 0xffffffff;
+      uint64_t lo = std::numeric_limits<uint64_t>::max(), hi = 0;
+
+      Cursor c(sections.ranges.data + ranges->u, sections.ranges.data + sections.ranges.size);
+      while(c.good()){
+        const uint64_t begin = c.fixed(address_size);
+        const uint64_t finish = c.fixed(address_size);
+        if(!c.good() or (begin == 0 and finish == 0)){
+          break;
+        }
+
+        if(begin == max_address){
+          base = finish;
+        }
+        else if(begin != finish){
+          lo = std::min(lo, base + begin);
+          hi = std::max(hi, base + finish);
+        }
+      }
+
+      if(lo < hi){
+        low_pc = lo;
+        high_pc = hi;
+      }
+    }
+
+    void warn(const Die& d, const std::string& msg){
+      std::stringstream ss;
+      ss << "warning (DIE 0x" << std::hex << d.offset << "): " << msg;
+      warnings.push_back(ss.str());
+    }
+
+    void compile_unit(const Die& cu){
+      uint64_t low_pc, high_pc;
+      this->pc_range(cu, low_pc, high_pc);
+
+      // Code spread over several sections gives a compile unit a
+      // DW_AT_ranges list instead of a pc range; take its hull.
+      if(low_pc == 0x0 or high_pc == 0x0){
+        this->range_hull(cu, low_pc, low_pc, high_pc);
+      }
+
+      foreach(unsigned i, cu.children){
+        const Die& d = dies[i];
+
+        if(is_type_tag(d.tag)){
+          this->type_element(d);
+        }
+        else if(d.tag == DW_TAG_subprogram){
+          if(low_pc == 0x0){
+            this->warn(d, "compile unit did not specify low_pc, but has subprogram element - skipping");
+          }
+          else{
+            this->subprogram(d, low_pc);
+          }
+        }
+        else if(d.tag == DW_TAG_variable){
+          if(low_pc == 0x0 or high_pc == 0x0){
+            this->warn(d, "low_pc or high_pc unspecified, but variable element encountered - skipping");
+          }
+          else{
+            this->variable(d, low_pc, high_pc);
+          }
+        }
+        else if(d.tag == DW_TAG_namespace){
+          if(low_pc == 0x0 or high_pc == 0x0){
+            this->warn(d, "low_pc or high_pc unspecified, but namespace element encountered - skipping");
+          }
+          else{
+            this->namespace_element(d, low_pc, high_pc);
+          }
+        }
+      }
+    }
+
+    void namespace_element(const Die& ns, uint64_t low_pc, uint64_t high_pc, const std::string& prefix_base = ""){
+      const std::string name = this->name_of(ns);
+      const std::string prefix = name == "" ? "" : prefix_base + name + "::";
+
+      // NOTE(choudhury): as in DwarfParser::parse_namespace(), types
+      // and subprograms take the enclosing prefix, and only nested
+      // namespaces see this namespace's own.
+      foreach(unsigned i, ns.children){
+        const Die& d = dies[i];
+
+        if(d.tag == DW_TAG_namespace){
+          if(prefix == ""){
+            this->warn(d, "nested namespace in a nameless namespace element - skipping");
+          }
+          else{
+            this->namespace_element(d, low_pc, high_pc, prefix);
+          }
+        }
+        else if(is_type_tag(d.tag)){
+          this->type_element(d, prefix_base);
+        }
+        else if(d.tag == DW_TAG_variable){
+          this->variable(d, low_pc, high_pc);
+        }
+        else if(d.tag == DW_TAG_subprogram){
+          this->subprogram(d, low_pc);
+        }
+      }
+    }
+
+    void subprogram(const Die& s, uint64_t cu_low_pc){
+      // Declarations and compiler-generated functions have no source
+      // code to speak of.
+      if(this->attr(s, DW_AT_declaration) or this->attr(s, DW_AT_artificial)){
+        return;
+      }
+
+      uint64_t low_pc, high_pc;
+      this->pc_range(s, low_pc, high_pc);
+      const std::string name = this->name_of(s);
+      if(name == "" or low_pc == 0x0 or high_pc == 0x0){
+        this->warn(s, "all subprogram attributes not specified - skipping");
+        return;
+      }
+
+      Loclist locs;
+      const Value *frame_base = this->attr(s, DW_AT_frame_base);
+      if(frame_base and !frame_base->block){
+        this->loclist(s, frame_base->u, locs);
+      }
+
+      foreach(unsigned i, s.children){
+        const Die& d = dies[i];
+
+        if(d.tag == DW_TAG_lexical_block){
+          this->lexical_block(d);
+        }
+        else if(d.tag == DW_TAG_formal_parameter or d.tag == DW_TAG_variable){
+          this->variable(d, low_pc, high_pc);
+        }
+        else if(is_type_tag(d.tag)){
+          this->type_element(d);
+        }
+      }
+
+      Subprogram *sp = subprograms.add_subprogram();
+      sp->set_name(name);
+      sp->set_low_pc(low_pc);
+      sp->set_high_pc(high_pc);
+
+      Loclist *l = sp->mutable_loclist();
+      l->set_cu_low_pc(cu_low_pc);
+      l->MergeFrom(locs);
+    }
+
+    // Reads a frame base location list out of .debug_loc.  Like
+    // DwarfParser::parse_loclist(), only entry 2 (the "bulk" entry
+    // covering most of the function body) is kept; its pcs are left
+    // relative to the compile unit's low pc, as dwarfdump prints them.
+    void loclist(const Die& s, uint64_t loc_offset, Loclist& locs){
+      if(loc_offset >= sections.loc.size){
+        this->warn(s, "frame base location list offset out of range");
+        return;
+      }
+
+      const uint64_t max_address = address_size == 8 ? std::numeric_limits<uint64_t>::max() : 0xffffffff;
+
+      Cursor c(sections.loc.data + loc_offset, sections.loc.data + sections.loc.size);
+      for(unsigned entry=0; c.good(); ){
+        const uint64_t low_pc = c.fixed(address_size);
+        const uint64_t high_pc = c.fixed(address_size);
+        if(!c.good() or (low_pc == 0 and high_pc == 0)){
+          return;
+        }
+
+        // Base address selection entries carry no expression.
+        if(low_pc == max_address){
+          continue;
+        }
+
+        const uint64_t len = c.fixed(2);
+        const unsigned char *expr_begin = c.skip(len);
+        Cursor expr(expr_begin, c.pos());
+        if(entry++ != 2){
+          continue;
+        }
+
+        const uint64_t op = expr.fixed(1);
+        if(op < DW_OP_breg0 or op > DW_OP_breg31){
+          this->warn(s, "frame base is not a register + offset expression");
+          return;
+        }
+
+        std::stringstream reg;
+        reg << "DW_OP_breg" << (op - DW_OP_breg0);
+
+        Locator *loc = locs.add_locator();
+        loc->set_low_pc(low_pc);
+        loc->set_high_pc(high_pc);
+        loc->set_reg(reg.str());
+        loc->set_offset(static_cast<int32_t>(expr.sleb()));
+        return;
+      }
+    }
+
+    void lexical_block(const Die& b){
+      uint64_t low_pc, high_pc;
+      this->pc_range(b, low_pc, high_pc);
+      if(low_pc == 0x0 or high_pc == 0x0){
+        this->warn(b, "lexical block spec did not include both a low_pc and a high_pc - skipping");
+        return;
+      }
+
+      foreach(unsigned i, b.children){
+        const Die& d = dies[i];
+
+        if(d.tag == DW_TAG_variable){
+          this->variable(d, low_pc, high_pc);
+        }
+        else if(d.tag == DW_TAG_lexical_block){
+          this->lexical_block(d);
+        }
+        else if(is_type_tag(d.tag)){
+          this->type_element(d);
+        }
+      }
+
+      LexicalBlock *l = scopes.add_lexical_block();
+      l->set_low_pc(low_pc);
+      l->set_high_pc(high_pc);
+    }
+
+    void variable(const Die& v, uint64_t low_pc, uint64_t high_pc){
+      const std::string name = this->name_of(v);
+      const uint64_t file_no = this->uint_of(v, DW_AT_decl_file, 0, true);
+      const std::string file = file_no < files.size() ? files[file_no] : "";
+      const uint64_t line_no = this->uint_of(v, DW_AT_decl_line, -1, true);
+      const uint64_t type = this->uint_of(v, DW_AT_type, -1, true);
+
+      // Sometimes a variable is only declared but not defined, in
+      // which case it exists, but not in a knowable place.
+      const Value *location = this->attr(v, DW_AT_location);
+      if(!location){
+        this->warn(v, "variable tag had no location information.");
+        return;
+      }
+      if(!location->block or location->len == 0){
+        this->warn(v, "variable location is a location list - skipping");
+        return;
+      }
+
+      if(name == "" or file == "" or line_no == static_cast<uint64_t>(-1) or type == static_cast<uint64_t>(-1)){
+        this->warn(v, "some variable attributes were not set in the variable element.");
+        return;
+      }
+
+      Cursor expr(location->block, location->block + location->len);
+      const uint64_t op = expr.fixed(1);
+      if(op != DW_OP_fbreg and op != DW_OP_addr){
+        this->warn(v, "unknown location protocol in variable tag - skipping");
+        return;
+      }
+
+      Variable *var = vars.add_var();
+      var->set_id(v.offset);
+      var->set_name(name);
+      var->set_type(type);
+      var->set_file(file);
+      var->set_line(line_no);
+      var->set_low_pc(low_pc);
+      var->set_high_pc(high_pc);
+
+      if(op == DW_OP_fbreg){
+        var->mutable_stack_location()->set_offset(static_cast<int32_t>(expr.sleb()));
+      }
+      else{
+        var->mutable_absolute_location()->set_address(expr.fixed(address_size));
+      }
+    }
+
+    void type_element(const Die& d, const std::string& prefix = ""){
+      switch(d.tag){
+      case DW_TAG_base_type:
+        {
+          const Value *name = this->attr(d, DW_AT_name);
+
+          Type *t = types.add_type();
+          t->set_name(name and name->str ? name->str : "123illegal name");
+          t->set_id(d.offset);
+          t->mutable_base_type()->set_size(this->uint_of(d, DW_AT_byte_size, -1));
+        }
+        break;
+
+      case DW_TAG_class_type:
+      case DW_TAG_structure_type:
+        this->class_type(d, prefix);
+        break;
+
+      case DW_TAG_typedef:
+        this->typedef_type(d, prefix);
+        break;
+
+      case DW_TAG_subroutine_type:
+        this->typedef_type(d, prefix, false);
+        break;
+
+      case DW_TAG_const_type:
+        {
+          Type *t = types.add_type();
+          t->set_name("");
+          t->set_id(d.offset);
+          t->mutable_const_type()->set_ref(this->uint_of(d, DW_AT_type, -1));
+        }
+        break;
+
+      case DW_TAG_pointer_type:
+        {
+          Type *t = types.add_type();
+          t->set_name("");
+          t->set_id(d.offset);
+
+          Type::PointerType *p = t->mutable_pointer_type();
+          p->set_size(this->uint_of(d, DW_AT_byte_size, -1));
+          p->set_ref(this->uint_of(d, DW_AT_type, -1));
+        }
+        break;
+
+      case DW_TAG_reference_type:
+        {
+          Type *t = types.add_type();
+          t->set_name("");
+          t->set_id(d.offset);
+
+          Type::ReferenceType *r = t->mutable_reference_type();
+          r->set_size(this->uint_of(d, DW_AT_byte_size, -1));
+          r->set_ref(this->uint_of(d, DW_AT_type, -1));
+        }
+        break;
+
+      case DW_TAG_array_type:
+        // TODO(choudhury): array types are ignored, as in
+        // DwarfParser::parse_array_type().
+        break;
+      }
+    }
+
+    void class_type(const Die& c, const std::string& prefix){
+      const Value *name_v = this->attr(c, DW_AT_name);
+      const std::string name = name_v and name_v->str ? name_v->str : "";
+
+      // Nested class types are captured, with the enclosing class's
+      // name joined to the prefix.
+      foreach(unsigned i, c.children){
+        const Die& d = dies[i];
+        if(d.tag == DW_TAG_class_type){
+          if(name == ""){
+            this->warn(d, "class tag supplies no name, but has a nested class type - skipping");
+          }
+          else{
+            this->class_type(d, prefix + name + "::");
+          }
+        }
+      }
+
+      Type *t = types.add_type();
+      t->set_name(prefix + name);
+      t->set_id(c.offset);
+      t->mutable_class_type()->set_size(this->uint_of(c, DW_AT_byte_size, -1));
+    }
+
+    void typedef_type(const Die& d, const std::string& prefix, bool name_needed = true){
+      const Value *name_v = this->attr(d, DW_AT_name);
+      const std::string name = name_v and name_v->str ? name_v->str : "";
+      const Value *type = this->attr(d, DW_AT_type);
+
+      if((name_needed and name == "") or !type){
+        this->warn(d, "typedef attributes (name, type) not all specified - continuing");
+        return;
+      }
+
+      Type *t = types.add_type();
+      t->set_name(prefix + (name_needed ? name : "unknown_name"));
+      t->set_id(d.offset);
+      t->mutable_typedef_type()->set_ref(type->u);
+    }
+
+  private:
+    const DwarfReader::Sections& sections;
+
+    // Header fields.
+    const uint64_t offset;
+    uint64_t end, first, abbrev_offset;
+    unsigned version, offset_size, address_size;
+
+    std::vector<Abbrev> abbrevs;
+    std::vector<Die> dies;
+    std::vector<unsigned> roots;
+    boost::unordered_map<uint64_t, unsigned> index_of;
+    std::vector<std::string> files;
+
+    TypeList& types;
+    VariableList& vars;
+    SubprogramList& subprograms;
+    LexicalBlockList& scopes;
+    std::vector<std::string>& warnings;
+  };
+}
+
+DwarfReader::DwarfReader(const std::string& filename)
+  : next(0)
+{
+  try{
+    file.open(filename);
+  }
+  catch(std::exception& e){
+    *this << "could not open file '" << filename << "': " << e.what();
+    return;
+  }
+
+  if(!file.is_open()){
+    *this << "could not open file '" << filename << "'";
+    return;
+  }
+
+  this->load_sections();
+}
+
+bool DwarfReader::load_sections(){
+  const unsigned char *base = reinterpret_cast<const unsigned char *>(file.data());
+  const uint64_t size = file.size();
+
+  if(size < EI_NIDENT or std::memcmp(base, ELFMAG, SELFMAG) != 0){
+    *this << "not an ELF file";
+    return false;
+  }
+  if(base[EI_DATA] != ELFDATA2LSB){
+    *this << "only little-endian ELF files are supported";
+    return false;
+  }
+
+  // Pull the section header table location out of either flavor of
+  // ELF header.
+  const bool elf64 = base[EI_CLASS] == ELFCLASS64;
+  uint64_t shoff, shentsize, shnum, shstrndx;
+  if(elf64){
+    Elf64_Ehdr eh;
+    if(size < sizeof(eh)){
+      *this << "truncated ELF header";
+      return false;
+    }
+    std::memcpy(&eh, base, sizeof(eh));
+    shoff = eh.e_shoff;
+    shentsize = eh.e_shentsize;
+    shnum = eh.e_shnum;
+    shstrndx = eh.e_shstrndx;
+  }
+  else{
+    Elf32_Ehdr eh;
+    if(size < sizeof(eh)){
+      *this << "truncated ELF header";
+      return false;
+    }
+    std::memcpy(&eh, base, sizeof(eh));
+    shoff = eh.e_shoff;
+    shentsize = eh.e_shentsize;
+    shnum = eh.e_shnum;
+    shstrndx = eh.e_shstrndx;
+  }
+
+  if(shnum == 0 or shoff + shnum*shentsize > size or shstrndx >= shnum or
+     shentsize < (elf64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr))){
+    *this << "bad section header table";
+    return false;
+  }
+
+  std::vector<uint64_t> names(shnum), offsets(shnum), sizes(shnum), flags(shnum), types(shnum);
+  for(uint64_t i=0; i<shnum; i++){
+    if(elf64){
+      Elf64_Shdr sh;
+      std::memcpy(&sh, base + shoff + i*shentsize, sizeof(sh));
+      names[i] = sh.sh_name;
+      offsets[i] = sh.sh_offset;
+      sizes[i] = sh.sh_size;
+      flags[i] = sh.sh_flags;
+      types[i] = sh.sh_type;
+    }
+    else{
+      Elf32_Shdr sh;
+      std::memcpy(&sh, base + shoff + i*shentsize, sizeof(sh));
+      names[i] = sh.sh_name;
+      offsets[i] = sh.sh_offset;
+      sizes[i] = sh.sh_size;
+      flags[i] = sh.sh_flags;
+      types[i] = sh.sh_type;
+    }
+  }
+
+  if(offsets[shstrndx] + sizes[shstrndx] > size){
+    *this << "bad section name table";
+    return false;
+  }
+  const char *shstrtab = reinterpret_cast<const char *>(base + offsets[shstrndx]);
+
+  for(uint64_t i=0; i<shnum; i++){
+    if(types[i] == SHT_NOBITS or names[i] >= sizes[shstrndx]){
+      continue;
+    }
+
+    const std::string name(shstrtab + names[i]);
+    Section *s = 0;
+    if(name == ".debug_info"){
+      s = &sections.info;
+    }
+    else if(name == ".debug_abbrev"){
+      s = &sections.abbrev;
+    }
+    else if(name == ".debug_str"){
+      s = &sections.str;
+    }
+    else if(name == ".debug_line"){
+      s = &sections.line;
+    }
+    else if(name == ".debug_loc"){
+      s = &sections.loc;
+    }
+    else if(name == ".debug_ranges"){
+      s = &sections.ranges;
+    }
+    else{
+      continue;
+    }
+
+    if(flags[i] & SHF_COMPRESSED){
+      *this << "section " << name << " is compressed (relink with --compress-debug-sections=none)";
+      return false;
+    }
+    if(offsets[i] + sizes[i] > size){
+      *this << "section " << name << " extends past the end of the file";
+      return false;
+    }
+
+    s->data = base + offsets[i];
+    s->size = sizes[i];
+  }
+
+  if(!sections.info.data or !sections.abbrev.data){
+    *this << "no DWARF debugging information (compile with -g)";
+    return false;
+  }
+
+  return true;
+}
+
+bool DwarfReader::read(unsigned threads){
+  if(this->hasError()){
+    return false;
+  }
+
+  // Find the compilation unit boundaries - only the unit headers are
+  // touched here, so this pass is cheap.
+  uint64_t offset = 0;
+  while(offset < sections.info.size){
+    Cursor c(sections.info.data + offset, sections.info.data + sections.info.size);
+    uint64_t length = c.fixed(4);
+    if(length == 0xffffffff){
+      length = c.fixed(8);
+    }
+    if(!c.good() or length == 0){
+      break;
+    }
+
+    units.push_back(Unit());
+    units.back().offset = offset;
+
+    offset = (c.pos() - sections.info.data) + length;
+  }
+
+  // Decode the units on a pool of threads, each taking the next
+  // undecoded unit until there are none left.
+  next = 0;
+  boost::thread_group workers;
+  for(unsigned i=0; i<(threads > 0 ? threads : 1); i++){
+    workers.create_thread(boost::bind(&DwarfReader::work, this));
+  }
+  workers.join_all();
+
+  // Merge the per-unit results in order, so the output is identical
+  // to that of a serial pass.
+  foreach(Unit& u, units){
+    if(u.error != ""){
+      *this << u.error;
+      return false;
+    }
+
+    types.MergeFrom(u.types);
+    vars.MergeFrom(u.vars);
+    subprograms.MergeFrom(u.subprograms);
+    scopes.MergeFrom(u.scopes);
+    warnings.insert(warnings.end(), u.warnings.begin(), u.warnings.end());
+
+    u = Unit();
+  }
+
+  return true;
+}
+
+void DwarfReader::work(){
+  while(true){
+    size_t i;
+    {
+      boost::lock_guard<boost::mutex> lock(mutex);
+      if(next >= units.size()){
+        return;
+      }
+      i = next++;
+    }
+
+    Unit& u = units[i];
+    UnitDecoder decoder(sections, u.offset, u.types, u.vars, u.subprograms, u.scopes, u.warnings);
+    u.error = decoder.decode();
+  }
+}
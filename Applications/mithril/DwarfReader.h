@@ -0,0 +1,98 @@
+// -*- c++ -*-
+//
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// DwarfReader.h - Reads DWARF debugging information directly out of
+// an ELF binary, producing the same type, variable, subprogram, and
+// lexical block lists as the dwarfdump text parser, without ever
+// running dwarfdump.  Compilation units are decoded in parallel.
+
+#ifndef DWARF_READER_H
+#define DWARF_READER_H
+
+// MTV headers.
+#include <Core/LexicalBlock.pb.h>
+#include <Core/Subprogram.pb.h>
+#include <Core/Type.pb.h>
+#include <Core/Variable.pb.h>
+#include <Core/Util/ErrorMessage.h>
+
+// Boost headers.
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/thread.hpp>
+
+// System headers.
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// NOTE(choudhury): only the subset of DWARF 2-4 that mithril actually
+// uses is understood (no DWARF 5, no split DWARF, no compressed debug
+// sections), and the binary must be a linked executable or shared
+// object, since relocations are not applied.
+class DwarfReader : public MTV::ErrorMessage {
+public:
+  // A view of one ELF section inside the mapped file.
+  struct Section{
+    Section()
+      : data(0),
+        size(0)
+    {}
+
+    const unsigned char *data;
+    uint64_t size;
+  };
+
+  struct Sections{
+    Section info, abbrev, str, line, loc, ranges;
+  };
+
+public:
+  DwarfReader(const std::string& filename);
+
+  // Decodes every compilation unit on the given number of threads.
+  // The results are merged in compilation unit order, so they do not
+  // depend on the number of threads.
+  bool read(unsigned threads);
+
+  const MTV::Mithril::TypeList& get_types() const { return types; }
+  const MTV::Mithril::VariableList& get_vars() const { return vars; }
+  const MTV::Mithril::SubprogramList& get_subprograms() const { return subprograms; }
+  const MTV::Mithril::LexicalBlockList& get_scopes() const { return scopes; }
+
+  // Diagnostics for DWARF elements that were skipped, in compilation
+  // unit order.
+  const std::vector<std::string>& get_warnings() const { return warnings; }
+
+private:
+  struct Unit{
+    uint64_t offset;
+
+    MTV::Mithril::TypeList types;
+    MTV::Mithril::VariableList vars;
+    MTV::Mithril::SubprogramList subprograms;
+    MTV::Mithril::LexicalBlockList scopes;
+
+    std::vector<std::string> warnings;
+    std::string error;
+  };
+
+  bool load_sections();
+  void work();
+
+private:
+  boost::iostreams::mapped_file_source file;
+  Sections sections;
+
+  std::vector<Unit> units;
+  boost::mutex mutex;
+  size_t next;
+
+  MTV::Mithril::TypeList types;
+  MTV::Mithril::VariableList vars;
+  MTV::Mithril::SubprogramList subprograms;
+  MTV::Mithril::LexicalBlockList scopes;
+  std::vector<std::string> warnings;
+};
+
+#endif
@@ -1,15 +1,19 @@
 // Copyright 2011 A.N.M. Imroz Choudhury
 //
-// mithril.cpp - Parses the output of the "dwarfdump" program, placing
+// mithril.cpp - Parses the output of the "dwarfdump" program (or
+// reads the DWARF information straight out of the binary), placing
 // relevant data into a protobuffer for use by aeon and waxlamp (and
 // others).
 
 // MTV headers.
+#include <Applications/mithril/DwarfReader.h>
 #include <Core/LexicalBlock.pb.h>
 #include <Core/Subprogram.pb.h>
 #include <Core/Type.pb.h>
 #include <Core/Variable.pb.h>
+#include <Core/Util/BoostForeach.h>
 #include <Core/Util/Util.h>
+#include <Tools/ReferenceTrace/StackIndex.h>
 using MTV::Mithril::LexicalBlock;
 using MTV::Mithril::LexicalBlockList;
 using MTV::Mithril::Locator;
@@ -30,6 +34,123 @@ using MTV::Mithril::VariableList;
 #include <stack>
 #include <stdint.h>
 
+void print(const TypeList& types, const VariableList& vars, const SubprogramList& subprograms, const LexicalBlockList& scopes){
+  std::cout << "TYPES:" << std::endl;
+  for(int i=0; i<types.type_size(); i++){
+    const Type& t = types.type(i);
+
+    std::cout << std::hex << t.id() << ": " << std::dec;
+
+    if(t.has_base_type()){
+      std::cout << "base type '" << t.name() << "' of size " << t.base_type().size() << std::endl;
+    }
+    else if(t.has_class_type()){
+      std::cout << "class type '" << t.name() << "' of size " << t.class_type().size() << std::endl;
+    }
+    else if(t.has_typedef_type()){
+      std::cout << "typedef type referring to type " << std::hex << t.typedef_type().ref() << std::dec << std::endl;
+    }
+    else if(t.has_const_type()){
+      std::cout << "const type referring to type " << std::hex << t.const_type().ref() << std::dec << std::endl;
+    }
+    else if(t.has_pointer_type()){
+      std::cout << "pointer type of size " << t.pointer_type().size() << ", referring to type " << std::hex << t.pointer_type().ref() << std::dec << std::endl;
+    }
+    else if(t.has_array_type()){
+      std::cout << "array type: not implemented quite yet" << std::endl;
+    }
+  }
+
+  std::cout << "VARIABLES:" << std::endl;
+  for(int i=0; i<vars.var_size(); i++){
+    const Variable& v = vars.var(i);
+
+    std::cout << v.name() << " declared at " << v.file() << ":" << v.line()
+              << " of type id " << std::hex << v.type() << std::dec
+              << " at ";
+
+    if(v.has_stack_location()){
+      std::cout << "stack offset " << v.stack_location().offset() << std::endl;
+    }
+    else if(v.has_absolute_location()){
+      std::cout << "address " << std::hex << v.absolute_location().address() << std::dec << std::endl;
+    }
+  }
+
+  std::cout << "SUBPROGRAMS:" << std::endl;
+  for(int i=0; i<subprograms.subprogram_size(); i++){
+    const Subprogram& s = subprograms.subprogram(i);
+
+    std::cout << "subprogram " << s.name() << " from 0x" << std::hex << s.low_pc() << " to 0x" << s.high_pc() << std::endl;
+
+    std::cout << "loclist:" << std::endl;
+    std::cout << "\t" << "compile unit low pc: 0x" << std::hex << s.loclist().cu_low_pc() << std::endl;
+    for(int j=0; j<s.loclist().locator_size(); j++){
+      const Locator& l = s.loclist().locator(j);
+      std::cout << "\t" << "0x" << std::hex << l.low_pc() << " to 0x" << l.high_pc() << ": register " << l.reg() << " + " << std::dec << l.offset() << std::endl;
+    }
+  }
+
+  std::cout << "LEXICAL SCOPES:" << std::endl;
+  std::cout << std::hex;
+  for(int i=0; i<scopes.lexical_block_size(); i++){
+    const LexicalBlock& l = scopes.lexical_block(i);
+
+    std::cout << "0x" << l.low_pc() << " -> 0x" << l.high_pc() << std::endl;
+  }
+}
+
+bool save(const std::string& filename, const TypeList& types, const VariableList& vars, const SubprogramList& subprograms, const LexicalBlockList& scopes){
+  // Open the file for output, and bail if error.
+  std::ofstream out(filename.c_str());
+  if(!out){
+    return false;
+  }
+
+  // Write out the type specs.
+  {
+    const int size = types.ByteSize();
+    out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    types.SerializeToOstream(&out);
+  }
+
+  // Write out the varaible specs.
+  {
+    const int size = vars.ByteSize();
+    out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    vars.SerializeToOstream(&out);
+  }
+
+  // Write out the subprogram specs.
+  {
+    const int size = subprograms.ByteSize();
+    out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    subprograms.SerializeToOstream(&out);
+  }
+
+  // Write out the lexical block specs.
+  {
+    const int size = scopes.ByteSize();
+    out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    scopes.SerializeToOstream(&out);
+  }
+
+  // Flush the stream, close it, then indicate success.
+  out.flush();
+  out.close();
+
+  return true;
+}
+
+bool save_index(const std::string& filename, const TypeList& types, const VariableList& vars, const SubprogramList& subprograms, const LexicalBlockList& scopes){
+  std::string err;
+  if(!MTV::StackIndex::save(filename, types, vars, subprograms, scopes, err)){
+    std::cerr << "error: " << err << std::endl;
+    return false;
+  }
+  return true;
+}
+
 class LineBuffer{
 public:
   LineBuffer(std::istream& in)
@@ -219,111 +340,15 @@ public:
   }
 
   void print() const {
-    std::cout << "TYPES:" << std::endl;
-    for(int i=0; i<types.type_size(); i++){
-      const Type& t = types.type(i);
-
-      std::cout << std::hex << t.id() << ": " << std::dec;
-
-      if(t.has_base_type()){
-        std::cout << "base type '" << t.name() << "' of size " << t.base_type().size() << std::endl;
-      }
-      else if(t.has_class_type()){
-        std::cout << "class type '" << t.name() << "' of size " << t.class_type().size() << std::endl;
-      }
-      else if(t.has_typedef_type()){
-        std::cout << "typedef type referring to type " << std::hex << t.typedef_type().ref() << std::dec << std::endl;
-      }
-      else if(t.has_const_type()){
-        std::cout << "const type referring to type " << std::hex << t.const_type().ref() << std::dec << std::endl;
-      }
-      else if(t.has_pointer_type()){
-        std::cout << "pointer type of size " << t.pointer_type().size() << ", referring to type " << std::hex << t.pointer_type().ref() << std::dec << std::endl;
-      }
-      else if(t.has_array_type()){
-        std::cout << "array type: not implemented quite yet" << std::endl;
-      }
-    }
-
-    std::cout << "VARIABLES:" << std::endl;
-    for(int i=0; i<vars.var_size(); i++){
-      const Variable& v = vars.var(i);
-
-      std::cout << v.name() << " declared at " << v.file() << ":" << v.line()
-                << " of type id " << std::hex << v.type() << std::dec
-                << " at ";
-
-      if(v.has_stack_location()){
-        std::cout << "stack offset " << v.stack_location().offset() << std::endl;
-      }
-      else if(v.has_absolute_location()){
-        std::cout << "address " << std::hex << v.absolute_location().address() << std::dec << std::endl;
-      }
-    }
-
-    std::cout << "SUBPROGRAMS:" << std::endl;
-    for(int i=0; i<subprograms.subprogram_size(); i++){
-      const Subprogram& s = subprograms.subprogram(i);
-
-      std::cout << "subprogram " << s.name() << " from 0x" << std::hex << s.low_pc() << " to 0x" << s.high_pc() << std::endl;
-
-      std::cout << "loclist:" << std::endl;
-      std::cout << "\t" << "compile unit low pc: 0x" << std::hex << s.loclist().cu_low_pc() << std::endl;
-      for(int j=0; j<s.loclist().locator_size(); j++){
-        const Locator& l = s.loclist().locator(j);
-        std::cout << "\t" << "0x" << std::hex << l.low_pc() << " to 0x" << l.high_pc() << ": register " << l.reg() << " + " << std::dec << l.offset() << std::endl;
-      }
-    }
-
-    std::cout << "LEXICAL SCOPES:" << std::endl;
-    std::cout << std::hex;
-    for(int i=0; i<scopes.lexical_block_size(); i++){
-      const LexicalBlock& l = scopes.lexical_block(i);
-
-      std::cout << "0x" << l.low_pc() << " -> 0x" << l.high_pc() << std::endl;
-    }
+    ::print(types, vars, subprograms, scopes);
   }
 
   bool save(const std::string& filename) const {
-    // Open the file for output, and bail if error.
-    std::ofstream out(filename.c_str());
-    if(!out){
-      return false;
-    }
-
-    // Write out the type specs.
-    {
-      const int size = types.ByteSize();
-      out.write(reinterpret_cast<const char *>(&size), sizeof(size));
-      types.SerializeToOstream(&out);
-    }
-
-    // Write out the varaible specs.
-    {
-      const int size = vars.ByteSize();
-      out.write(reinterpret_cast<const char *>(&size), sizeof(size));
-      vars.SerializeToOstream(&out);
-    }
-
-    // Write out the subprogram specs.
-    {
-      const int size = subprograms.ByteSize();
-      out.write(reinterpret_cast<const char *>(&size), sizeof(size));
-      subprograms.SerializeToOstream(&out);
-    }
-
-    // Write out the lexical block specs.
-    {
-      const int size = scopes.ByteSize();
-      out.write(reinterpret_cast<const char *>(&size), sizeof(size));
-      scopes.SerializeToOstream(&out);
-    }
-
-    // Flush the stream, close it, then indicate success.
-    out.flush();
-    out.close();
+    return ::save(filename, types, vars, subprograms, scopes);
+  }
 
-    return true;
+  bool save_index(const std::string& filename) const {
+    return ::save_index(filename, types, vars, subprograms, scopes);
   }
 
 private:
@@ -1575,7 +1600,8 @@ private:
 };
 
 int main(int argc, char *argv[]){
-  std::string inputfile, outputfile;
+  std::string inputfile, elffile, outputfile, indexfile;
+  unsigned threads;
   bool print;
 
   try{
@@ -1589,6 +1615,22 @@ int main(int argc, char *argv[]){
                                               "filename",
                                               cmd);
 
+    TCLAP::ValueArg<std::string> elffileArg("e",
+                                            "elf-file",
+                                            "Binary to read the DWARF information from directly (instead of a dwarf dump).",
+                                            false,
+                                            "",
+                                            "filename",
+                                            cmd);
+
+    TCLAP::ValueArg<unsigned> threadsArg("j",
+                                         "threads",
+                                         "Number of threads to decode compilation units with (for --elf-file).",
+                                         false,
+                                         boost::thread::hardware_concurrency(),
+                                         "count",
+                                         cmd);
+
     TCLAP::ValueArg<std::string> outputfileArg("o",
                                                "output-file",
                                                "File to write protocol buffer to.",
@@ -1597,6 +1639,14 @@ int main(int argc, char *argv[]){
                                                "filename",
                                                cmd);
 
+    TCLAP::ValueArg<std::string> indexfileArg("x",
+                                              "index-file",
+                                              "File to write a memory-mappable stack index to (for aeon and mtrstackfilter).",
+                                              false,
+                                              "",
+                                              "filename",
+                                              cmd);
+
     TCLAP::SwitchArg printArg("p",
                               "print",
                               "Whether to print the results of parsing",
@@ -1606,7 +1656,10 @@ int main(int argc, char *argv[]){
     cmd.parse(argc, argv);
 
     inputfile = inputfileArg.getValue();
+    elffile = elffileArg.getValue();
+    threads = threadsArg.getValue();
     outputfile = outputfileArg.getValue();
+    indexfile = indexfileArg.getValue();
     print = printArg.getValue();
   }
   catch(TCLAP::ArgException& e){
@@ -1614,6 +1667,46 @@ int main(int argc, char *argv[]){
     exit(1);
   }
 
+  if(elffile != "" and inputfile != ""){
+    std::cerr << "error: specify only one of --input-file and --elf-file." << std::endl;
+    exit(1);
+  }
+
+  if(outputfile == "" and indexfile == ""){
+    std::cerr << "warning: no output file specified." << std::endl;
+  }
+
+  if(elffile != ""){
+    DwarfReader reader(elffile);
+    if(!reader.read(threads)){
+      std::cerr << "error: " << reader.error() << std::endl;
+      exit(1);
+    }
+
+    foreach(const std::string& w, reader.get_warnings()){
+      std::cerr << w << std::endl;
+    }
+
+    if(print){
+      ::print(reader.get_types(), reader.get_vars(), reader.get_subprograms(), reader.get_scopes());
+    }
+
+    if(outputfile != ""){
+      if(!::save(outputfile, reader.get_types(), reader.get_vars(), reader.get_subprograms(), reader.get_scopes())){
+        std::cerr << "error: could not save protocol buffer to file '" << outputfile << "'." << std::endl;
+        exit(1);
+      }
+    }
+
+    if(indexfile != ""){
+      if(!::save_index(indexfile, reader.get_types(), reader.get_vars(), reader.get_subprograms(), reader.get_scopes())){
+        exit(1);
+      }
+    }
+
+    return 0;
+  }
+
   // Open the input file.
   if(inputfile == ""){
     inputfile = "/dev/stdin";
@@ -1624,12 +1717,6 @@ int main(int argc, char *argv[]){
     exit(1);
   }
 
-  // Open the output file.
-  std::ofstream out;
-  if(outputfile == ""){
-    std::cerr << "warning: no output file specified." << std::endl;
-  }
-
   DwarfParser parser(in);
   parser.parse();
 
@@ -1644,5 +1731,11 @@ int main(int argc, char *argv[]){
     }
   }
 
+  if(indexfile != ""){
+    if(!parser.save_index(indexfile)){
+      exit(1);
+    }
+  }
+
   return 0;
 }
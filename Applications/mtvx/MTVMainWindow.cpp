@@ -249,6 +249,12 @@ void MTVMainWindow::openEventTrace(){
   // here, and then probably save the state of everything for
   // restoring later.
   event = DeltaMementoReader::open(file.toStdString(), reftracePanel->getNetwork()->getMemorables());
+  if(!event){
+    QMessageBox::warning(this,
+                         "Could not open file",
+                         "The selected file cannot be opened, or is not an event trace.");
+    return;
+  }
 
   // Modify the message in the status bar.
   //
@@ -410,11 +416,35 @@ void MTVMainWindow::about(){
 }
 
 void MTVMainWindow::last_event(){
-  std::cout << "MTVMainWindow::last_event()" << std::endl;
+  assert(event);
+
+  try{
+    event->previousEvent();
+  }
+  catch(DeltaMementoReader::End){
+    this->statusBar()->showMessage("Beginning of event trace reached.", 2000);
+  }
 }
 
 void MTVMainWindow::rewind(){
-  std::cout << "MTVMainWindow::rewind()" << std::endl;
+  // The button connected to this slot should be deactivated if there
+  // is no event trace loaded.
+  assert(event);
+
+  // Change the icon on the rewind button.
+  rewindButton->setIcon(QIcon(":/icons/pause-button.png"));
+
+  // Save the identity of the button.
+  actionButton = rewindButton;
+
+  // Change the signal on the rewind button.
+  QObject::disconnect(rewindButton, SIGNAL(clicked()), this, SLOT(rewind()));
+  QObject::connect(rewindButton, SIGNAL(clicked()), this, SLOT(pause()));
+
+  // Deactivate the other buttons.
+  deactivateButtons(rewindButton);
+
+  event->startReverse();
 }
 
 void MTVMainWindow::play(){
@@ -497,7 +527,14 @@ void MTVMainWindow::ffwd(){
 }
 
 void MTVMainWindow::next_event(){
-  std::cout << "MTVMainWindow::next_event()" << std::endl;
+  assert(event);
+
+  try{
+    event->nextEvent();
+  }
+  catch(DeltaMementoReader::End){
+    this->statusBar()->showMessage("End of event trace reached.", 2000);
+  }
 }
 
 void MTVMainWindow::setTraceSpeed(int value){
@@ -16,7 +16,7 @@
 #include <Core/Dataflow/LineRecordFilter.h>
 #include <Core/Dataflow/MemoryRecordFilter.h>
 #include <Core/Dataflow/Module.h>
-#include <Core/Dataflow/TraceReader.h>
+#include <Core/Dataflow/QtTraceReader.h>
 #include <Modules/ReferenceTrace/UI/ReferenceTracePanel.h>
 #include <Tools/CacheSimulator/Cache.h>
 using Daly::Cache;
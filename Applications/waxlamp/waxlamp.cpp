@@ -8,11 +8,14 @@
 #include <Core/Variable.pb.h>
 #include <Core/Color/Color.h>
 #include <Core/Color/ColorGenerator.h>
+#include <Core/Dataflow/Instrumentation.h>
 #include <Core/Dataflow/LineCacheMissCounter.h>
 #include <Core/Dataflow/LineVisitCounter.h>
 #include <Core/Dataflow/SetUtilizationCounter.h>
 #include <Core/Dataflow/Printer.h>
-#include <Core/Dataflow/TraceReader.h>
+#include <Core/Dataflow/QtTraceReader.h>
+#include <Core/UI/FrameEncoder.h>
+#include <Core/UI/OffscreenRenderer.h>
 #include <Core/Util/Timing.h>
 #include <Core/Util/Util.h>
 #include <Modules/ReferenceTrace/Networks/WaxlampNetwork.h>
@@ -20,15 +23,19 @@
 // #include <Modules/ReferenceTrace/Networks/WaxlampFifoNetwork.h>
 #include <Modules/ReferenceTrace/UI/WaxlampPanel.h>
 #include <Tools/CacheSimulator/Cache.h>
-#include <Tools/ReferenceTrace/StackInfo.h>
+#include <Tools/ReferenceTrace/StackIndex.h>
 using Daly::Cache;
 using MTV::Clock;
 using MTV::ClockedTraceReader;
 using MTV::Color;
 using MTV::ColorGenerator;
+using MTV::Frame;
+using MTV::FrameEncoder;
+using MTV::Instrumentation;
 using MTV::LineDumper;
 using MTV::LineCacheMissCounter;
 using MTV::LineVisitCounter;
+using MTV::OffscreenRenderer;
 using MTV::Printer;
 using MTV::SetUtilizationCounter;
 using MTV::TickingClock;
@@ -37,7 +44,7 @@ using MTV::WaxlampNetwork;
 using MTV::WaxlampCacheNetwork;
 // using MTV::WaxlampFifoNetwork;
 using MTV::WaxlampPanel;
-using MTV::StackInfo;
+using MTV::StackIndex;
 using MTV::TimedTraceReader;
 using MTV::TraceReader;
 namespace FD = MTV::FrameDump;
@@ -51,6 +58,11 @@ namespace FD = MTV::FrameDump;
 // TCLAP headers.
 #include <tclap/CmdLine.h>
 
+// System headers.
+#include <stack>
+
+MTV_INSTRUMENT_ALLOCATIONS
+
 std::string getFileText(const std::string& filename){
   // Open the file - bail if error.
   std::ifstream in(filename.c_str());
@@ -114,10 +126,16 @@ int main(int argc, char *argv[]){
 
   // Get command line arguments.
   std::string tracefile, registrationfile, cachespec, colorgenspec;
-  bool print, linedumping, framedumping, visitcountdumping, misscountdumping, setutildumping, hitleveldumping, fast, invisible;
+  bool print, linedumping, framedumping, visitcountdumping, misscountdumping, setutildumping, hitleveldumping, fast, invisible, batching;
   std::vector<std::string> dumping;
   bool keyframes;
   std::string outputfile, filetable, mithrilfile;
+  bool headless;
+  std::string frameformat;
+  unsigned encodethreads;
+  std::string instrumentfile;
+  unsigned long instrumentperiod;
+  unsigned sampleinterval;
 
   // Default is not to dump any data.
   linedumping = framedumping = visitcountdumping = misscountdumping = setutildumping = false;
@@ -190,6 +208,12 @@ int main(int argc, char *argv[]){
                                   "Do not show the rendering window",
                                   cmd);
 
+    // Batched rendering.
+    TCLAP::SwitchArg batchingArg("b",
+                                 "batch",
+                                 "Render with batched vertex arrays instead of immediate mode",
+                                 cmd);
+
     // Color generator.
     TCLAP::ValueArg<std::string> colorgenspecArg("g",
                                                  "colorgen",
@@ -205,10 +229,32 @@ int main(int argc, char *argv[]){
                                   "Only dumps keyframes, at the completion of each cache event.",
                                   cmd);
 
+    // Headless rendering.
+    TCLAP::SwitchArg headlessArg("",
+                                 "headless",
+                                 "Render frames offscreen as fast as possible, writing them to the output file",
+                                 cmd);
+
+    TCLAP::ValueArg<std::string> frameformatArg("",
+                                                "frame-format",
+                                                "Headless frame encoding (\"png\" - numbered files using the output file as a prefix, or \"y4m\" - a single raw video stream)",
+                                                false,
+                                                "png",
+                                                "format",
+                                                cmd);
+
+    TCLAP::ValueArg<unsigned> encodethreadsArg("",
+                                               "encode-threads",
+                                               "Number of threads encoding headless frames",
+                                               false,
+                                               4,
+                                               "threads",
+                                               cmd);
+
     // Output file.
     TCLAP::ValueArg<std::string> outputfileArg("o",
                                                "output-file",
-                                               "Output file for protocol buffer.",
+                                               "Output file for protocol buffer (or for frames, with --headless).",
                                                true,
                                                "",
                                                "filename",
@@ -231,6 +277,31 @@ int main(int argc, char *argv[]){
                                                 "filename",
                                                 cmd);
 
+    // Dataflow instrumentation.
+    TCLAP::ValueArg<std::string> instrumentfileArg("",
+                                                   "instrument",
+                                                   "Profile the dataflow network, saving a Chrome trace-event file",
+                                                   false,
+                                                   "",
+                                                   "filename",
+                                                   cmd);
+
+    TCLAP::ValueArg<unsigned long> instrumentperiodArg("",
+                                                       "instrument-period",
+                                                       "Profile the dataflow network, printing stats every this many records",
+                                                       false,
+                                                       0,
+                                                       "records",
+                                                       cmd);
+
+    TCLAP::ValueArg<unsigned> sampleintervalArg("",
+                                                "sample-interval",
+                                                "Time one record in this many when profiling",
+                                                false,
+                                                64,
+                                                "positive number",
+                                                cmd);
+
     // Parse command line.
     cmd.parse(argc, argv);
 
@@ -243,17 +314,28 @@ int main(int argc, char *argv[]){
     // linedumping = linedumpingArg.getValue();
     fast = fastArg.getValue();
     invisible = invisibleArg.getValue();
+    batching = batchingArg.getValue();
     colorgenspec = colorgenspecArg.getValue();
     keyframes = keyframesArg.getValue();
     outputfile = outputfileArg.getValue();
     filetable = filetableArg.getValue();
     mithrilfile = mithrilfileArg.getValue();
+    headless = headlessArg.getValue();
+    frameformat = frameformatArg.getValue();
+    encodethreads = encodethreadsArg.getValue();
+    instrumentfile = instrumentfileArg.getValue();
+    instrumentperiod = instrumentperiodArg.getValue();
+    sampleinterval = sampleintervalArg.getValue();
   }
   catch(TCLAP::ArgException& e){
     std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
     exit(1);
   }
 
+  if(instrumentfile != "" or instrumentperiod > 0){
+    Instrumentation::enable(sampleinterval, instrumentperiod, instrumentfile);
+  }
+
   if(fast){
     motion_duration = 0.1;
     trace_duration = 100;
@@ -300,7 +382,7 @@ int main(int argc, char *argv[]){
   // clock if we're dumping frames, and a "time-travel" clock (one
   // where we can set the time manually) for keyframing.
   Clock::ptr clock;
-  if(framedumping){
+  if(framedumping or headless){
     clock = boost::make_shared<TickingClock>(1.0 / 30.0);
     // clock = boost::make_shared<TickingClock>(0.01);
   }
@@ -365,6 +447,7 @@ int main(int argc, char *argv[]){
   WaxlampPanel::ptr panel(new WaxlampPanel(clock, net));
   panel->setBackgroundColor(Color::white);
   panel->setDumping(framedumping);
+  panel->batching(batching);
 
   // Connect the reader to it.
   trace->addConsumer(panel->memoryRecordEntryPoint());
@@ -445,7 +528,7 @@ int main(int argc, char *argv[]){
   //
   // TODO(choudhury): this function should be abstracted into a header
   // file so it can be called from mtrstackfilter.cpp.
-  boost::unordered_map<uint64_t, MTV::Mithril::Type> type_table;
+  StackIndex stackindex;
   boost::unordered_map<uint64_t, std::vector<MTV::Mithril::Variable> > var_entry, var_exit;
   if(mithrilfile != ""){
     std::ifstream mithril(mithrilfile.c_str());
@@ -462,23 +545,23 @@ int main(int argc, char *argv[]){
     MTV::Mithril::VariableList vars;
     MTV::readProtocolBuffer(mithril, vars);
 
-    // // Read out the subprogram information.
-    // MTV::Mithril::SubprogramList subprogs;
-    // MTV::readProtocolBuffer(mithril, subprogs);
+    // Read out the subprogram information.
+    MTV::Mithril::SubprogramList subprogs;
+    MTV::readProtocolBuffer(mithril, subprogs);
 
-    // // Read out the lexical scope information.
-    // MTV::Mithril::LexicalBlockList scopes;
-    // MTV::readProtocolBuffer(mithril, scopes);
+    // Read out the lexical scope information.
+    MTV::Mithril::LexicalBlockList scopes;
+    MTV::readProtocolBuffer(mithril, scopes);
     
     if(!mithril){
       std::cerr << "error: could not read out data from file '" << mithrilfile << "'" << std::endl;
       exit(1);
     }
 
-    // Make a table of the types.
-    for(int i=0; i<types.type_size(); i++){
-      const MTV::Mithril::Type& t = types.type(i);
-      type_table[t.id()] = t;
+    // Index the messages for their resolved type sizes.
+    if(!stackindex.load(types, vars, subprogs, scopes)){
+      std::cerr << "error: " << stackindex.error() << std::endl;
+      exit(1);
     }
 
     // Create two tables mapping from address to variable - one for
@@ -496,7 +579,51 @@ int main(int argc, char *argv[]){
   }
 
   std::ofstream keyframeout;
-  if(framedumping){
+  if(headless){
+    // Render as fast as the offscreen rasterizer allows: the ticking
+    // clock advances one frame's worth of time per iteration, no
+    // matter how long the frame actually took to produce.
+    FrameEncoder::Format format;
+    if(!FrameEncoder::parseFormat(frameformat, format)){
+      std::cerr << "error: invalid frame format '" << frameformat << "'" << std::endl;
+      exit(1);
+    }
+
+    OffscreenRenderer renderer(panel->width(), panel->height());
+    if(renderer.hasError()){
+      std::cerr << "error: " << renderer.error() << std::endl;
+      exit(1);
+    }
+
+    FrameEncoder encoder(format, outputfile, encodethreads);
+    if(encoder.hasError()){
+      std::cerr << "error: " << encoder.error() << std::endl;
+      exit(1);
+    }
+
+    Frame frame;
+    while(trace->advance()){
+      panel->animationUpdate();
+
+      renderer.render(*panel, frame);
+      if(renderer.hasError()){
+        std::cerr << "error: " << renderer.error() << std::endl;
+        exit(1);
+      }
+      encoder.submit(frame);
+
+      clock->tick();
+    }
+
+    // Wait for the encoders to drain before exiting.
+    encoder.finish();
+    std::cerr << encoder.framesWritten() << " frames written" << std::endl;
+    if(!encoder.good()){
+      std::cerr << "error: " << encoder.framesFailed() << " frames could not be written." << std::endl;
+      exit(1);
+    }
+  }
+  else if(framedumping){
     if(keyframes){
       // Open the output file.
       keyframeout.open(outputfile.c_str());
@@ -667,8 +794,12 @@ int main(int argc, char *argv[]){
                     const std::vector<MTV::Mithril::Variable>& vars = i->second;
                     FD::FrameDump& framedump = net->getCacheGrouper()->getFrameDumpPB();
                     for(unsigned j=0; j<vars.size(); j++){
-                      unsigned num;
-                      const uint32_t type = StackInfo::get_type_size(type_table, vars[j].type(), num);
+                      // NOTE(choudhury): a variable of unknown size
+                      // cannot be laid out as glyphs.
+                      uint32_t type, num;
+                      if(!stackindex.type_size(vars[j].type(), type, num) or type == 0){
+                        continue;
+                      }
 
                       uint64_t base;
                       if(vars[j].has_stack_location()){
@@ -120,7 +120,6 @@ uint64_t BlockStreamReader::next(uint64_t blockAddr, uint64_t point){
   // function.
   //
   // TODO(choudhury): is this necessary?
-  static uint64_t curpoint = 0;
   if(point < curpoint){
     std::cerr << "error: requested point lies in the past." << std::endl;
     abort();
@@ -35,6 +35,10 @@ namespace MTV{
     static const uint64_t never;
 
   public:
+    BlockStreamReader()
+      : curpoint(0)
+    {}
+
     // Open a block stream trace file.
     bool open(const std::string& infile, unsigned numstreams);
 
@@ -59,6 +63,9 @@ namespace MTV{
   private:
     Table stream;
     boost::shared_ptr<LRUIfstreamPool> pool;
+
+    // The last point queried (queries must not go backwards).
+    uint64_t curpoint;
   };
 }
 
@@ -8,9 +8,11 @@
 #include <Core/Dataflow/BlockStream/BlockStreamReader.h>
 #include <Core/Dataflow/BlockStream/LRUStreamPool.h>
 #include <Core/Dataflow/TraceReader.h>
+#include <Core/Util/BlockInterner.h>
 #include <Core/Util/Boost.h>
 #include <Core/BlockStreamHeader.pb.h>
 using MTV::BlockStream::BlockStreamHeader;
+using MTV::BlockInterner;
 using MTV::BlockStreamReader;
 using MTV::LRUOfstreamPool;
 using MTV::TraceReader;
@@ -109,8 +111,21 @@ int main(int argc, char *argv[]){
 
   // Make a pass through the trace file, counting (1) how many unique
   // block addresses show up and (2) how many times each appears in
-  // the trace.
-  boost::unordered_map<uint64_t, uint64_t> appearances;
+  // the trace.  The blocks are interned, so the counts can be kept in
+  // a flat array (indexed in order of first appearance).
+  //
+  // If mtrintern has left a block ID side file next to the trace, made
+  // with the same block size, start from its IDs so that the table is
+  // sized once up front instead of growing during the pass.
+  BlockInterner::ptr blocks = BlockInterner::load(BlockInterner::sidefile(infile));
+  if(blocks and blocks->block_size() == blocksize){
+    std::cerr << "using block IDs from '" << BlockInterner::sidefile(infile) << "'" << std::endl;
+  }
+  else{
+    blocks = boost::make_shared<BlockInterner>(blocksize);
+  }
+
+  std::vector<uint64_t> appearances(blocks->size(), 0);
   try{
     while(true){
       // Read out a record.
@@ -121,20 +136,21 @@ int main(int argc, char *argv[]){
         continue;
       }
 
-      // Compute the block address.
-      const uint64_t blockAddr = rec.addr / blocksize;
+      // Look up the block's ID.
+      const BlockInterner::id_t id = blocks->intern(rec.addr);
+      if(id == appearances.size()){
+        appearances.push_back(0);
+      }
 
       // Increment the count of appearances of this address.
-      appearances[blockAddr]++;
+      appearances[id]++;
     }
   }
   catch(TraceReader::End){}
 
   // Report the counts.
-  for(boost::unordered_map<uint64_t, uint64_t>::const_iterator i = appearances.begin();
-      i != appearances.end();
-      i++){
-    std::cerr << "block " << i->first << " appears " << i->second << " times." << std::endl;
+  for(BlockInterner::id_t i=0; i<blocks->size(); i++){
+    std::cerr << "block " << blocks->block(i) << " appears " << appearances[i] << " times." << std::endl;
   }
 
   // Write out a header to the output file.
@@ -146,16 +162,16 @@ int main(int argc, char *argv[]){
 
   // Add information about each block stream in the trace.
   std::streampos curpos = 0;
-  for(boost::unordered_map<uint64_t, uint64_t>::const_iterator i = appearances.begin(); i != appearances.end(); i++){
+  for(BlockInterner::id_t i=0; i<blocks->size(); i++){
     // Create a block stream message object.
     BlockStreamHeader::BlockStream *bs = hdr.add_blockstream();
 
     // Set the attributes for it.
-    bs->set_block_addr(i->first);
+    bs->set_block_addr(blocks->block(i));
     bs->set_offset(curpos);
 
     // Bump the position counter by the appropriate length.
-    curpos += i->second*sizeof(uint64_t);
+    curpos += appearances[i]*sizeof(uint64_t);
   }
 
   // Write the header out to disk.
@@ -252,6 +268,12 @@ int main(int argc, char *argv[]){
       // Read out a record.
       const MTR::Record& rec = trace->nextRecord();
 
+      // Only memory records have block streams, but the positions
+      // count every record.
+      if(MTR::type(rec) != MTR::Record::MType){
+        continue;
+      }
+
       // Compute its block address.
       const uint64_t blockAddr = rec.addr / blocksize;
 
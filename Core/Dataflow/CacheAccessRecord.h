@@ -17,16 +17,23 @@ namespace MTV{
     CacheAccessRecord(const std::vector<Daly::CacheHitRecord>& hits,
                       const std::vector<Daly::CacheEvictionRecord>& evictions,
                       const std::vector<Daly::CacheEntranceRecord>& entrances,
-                      MTR::addr_t addr)
+                      MTR::addr_t addr,
+                      const std::vector<Daly::CachePrefetchRecord>& prefetches = std::vector<Daly::CachePrefetchRecord>())
       : hits(hits),
         evictions(evictions),
         entrances(entrances),
+        prefetches(prefetches),
         addr(addr)
     {}
 
     std::vector<Daly::CacheHitRecord> hits;
     std::vector<Daly::CacheEvictionRecord> evictions;
     std::vector<Daly::CacheEntranceRecord> entrances;
+
+    // Prefetches issued, used, or evicted unused during the access
+    // (only for caches with prefetchers).
+    std::vector<Daly::CachePrefetchRecord> prefetches;
+
     MTR::addr_t addr;
   };
 }
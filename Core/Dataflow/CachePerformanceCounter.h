@@ -13,6 +13,7 @@
 // MTV headers.
 #include <Core/Dataflow/CacheAccessRecord.h>
 #include <Core/Dataflow/Filter.h>
+#include <Core/Dataflow/WindowedStats.h>
 #include <Core/Util/BoostPointers.h>
 #include <Core/Util/LevelComparator.h>
 #include <Tools/CacheSimulator/Cache.h>
@@ -22,7 +23,6 @@ using Daly::CacheHitRecord;
 using MTV::NewCache;
 
 // System headers.
-#include <numeric>
 #include <ostream>
 
 namespace MTV{
@@ -31,13 +31,10 @@ namespace MTV{
     BoostPointers(HitHistory);
 
   public:
+    // A size of -1 averages over the whole history.
     HitHistory(unsigned size)
       : id(static_id++),
-        infinite(size == static_cast<unsigned>(-1)),
-        history(infinite ? 0 : size, 0.0),
-        p(0),
-        frac(1.0 / size),
-        avg(0.0),
+        window(size),
         L1(false)
     {}
 
@@ -50,71 +47,21 @@ namespace MTV{
     }
 
     void record(float val){
-      if(!infinite){
-        history[p] = val;
-        p = (p + 1) % history.size();
-      }
-      else{
-        // Expand the average.
-        avg *= p;
-
-        // Add in the new value.
-        avg += val;
-
-        // Divide by the new number of items.
-        avg /= ++p;
-      }
+      window.record(val);
     }
 
     float hitRate() const {
-      // for(unsigned i=0; i<history.size(); i++){
-      //   std::cout << history[i] << " ";
-      // }
-      // std::cout << std::endl;
-
-      // std::cout << "p = " << p << std::endl;
-
-      if(!infinite){
-        // TODO(choudhury): interpolate from -4 to 1 for the L2.
-        float avg = std::accumulate(history.begin(), history.end(), 0) * frac;
-
-        // std::cout << "avg (before) = " << avg << std::endl;
+      const float avg = window.mean();
 
-        if(L1){
-          // Map this value, which lies in [-4, 1], to [-1, 1].
-          if(avg < 0.0){
-            avg /= 4.0;
-          }
-        }
-
-        // float avg = 0.0;
-        // for(unsigned i=0; i<history.size(); i++){
-        //   avg += i*history[i];
-        // }
-        // avg /= (history.size() - 1)*(history.size() - 1) / 2.0;
-
-        // std::cout << "avg = " << avg << std::endl;
-
-        // Average the values in the history vector.
-        return avg;
-      }
-      else{
-        return (L1 and avg < 0.0) ? avg / 4.0 : avg;
-      }
+      // For the L1, map the value, which lies in [-4, 1], to [-1, 1].
+      return (L1 and avg < 0.0) ? avg / 4.0 : avg;
     }
 
   private:
     static unsigned static_id;
     unsigned id;
 
-    bool infinite;
-
-    std::vector<float> history;
-    int p;
-
-    const float frac;
-
-    float avg;
+    WindowedMean window;
 
     bool L1;
   };
@@ -193,13 +140,10 @@ namespace MTV{
 
   public:
     CacheSetUtilizationPolicyT(typename CacheType::const_ptr c, unsigned window)
-      : history(c->num_levels()),
-        blocksize(c->block_size())
+      : blocksize(c->block_size())
     {
       for(unsigned i=0; i<c->num_levels(); i++){
-        for(unsigned j=0; j<c->level(i)->associativity(); j++){
-          history[i].push_back(boost::make_shared<HitHistory>(window));
-        }
+        history.push_back(WindowedHistogram(c->level(i)->associativity(), window));
       }
     }
     
@@ -212,17 +156,13 @@ namespace MTV{
           continue;
         }
 
-        // Otherwise, log a 1 in the appropriate set of the level, and a 0
-        // in the other sets.  Leave the other levels alone, as they
-        // weren't really involved with this computation.
-        const unsigned hit_set = (hit->addr / blocksize) % history[hit->L].size();
-        // std::cout << "addr: " << (hit->addr / blocksize) << ", L" << (hit->L+1) << ", set: " << hit_set << std::endl;
-
-        for(unsigned set=0; set<history[hit->L].size(); set++){
-          history[hit->L][set]->record(set == hit_set);
-        }
+        // Otherwise, log a hit in the appropriate set of the level
+        // (which implicitly logs a 0 in the other sets).  Leave the
+        // other levels alone, as they weren't really involved with
+        // this computation.
+        const unsigned hit_set = (hit->addr / blocksize) % history[hit->L].bins();
+        history[hit->L].record(hit_set);
       }
-      // std::cout << "-----" << std::endl;
     }
 
     CacheHitRates rates() const {
@@ -230,8 +170,8 @@ namespace MTV{
 
       // Collect the utilization rates.
       for(unsigned L=0; L<history.size(); L++){
-        for(unsigned set=0; set<history[L].size(); set++){
-          retval.add(history[L][set]->hitRate());
+        for(unsigned set=0; set<history[L].bins(); set++){
+          retval.add(history[L].rate(set));
         }
       }
 
@@ -239,7 +179,7 @@ namespace MTV{
     }
 
   private:
-    std::vector<std::vector<HitHistory::ptr> > history;
+    std::vector<WindowedHistogram> history;
     unsigned blocksize;
   };
 
@@ -377,8 +317,32 @@ namespace MTV{
       // If there was a writeback eviction, increment the appropriate
       // counter.
       foreach(const CacheEvictionRecord& e, rec.evictions){
-        if(e.writeback and e.dirty and e.L > 0){
-          bandwidth[e.L - 1] += blocksize;
+        switch(e.kind){
+        case CacheEvictionRecord::Replacement:
+          if(e.writeback and e.dirty and e.L > 0){
+            bandwidth[e.L - 1] += blocksize;
+          }
+          break;
+
+        case CacheEvictionRecord::BackInvalidation:
+          // A dirty copy travels down to the evicting level; the write
+          // hit past it accounts for the rest of the way.
+          if(e.writeback and e.dirty){
+            for(unsigned i=e.L; i<e.dest; i++){
+              bandwidth[i] += blocksize;
+            }
+          }
+          break;
+
+        case CacheEvictionRecord::Swap:
+          // A victim moving down travels one level; a block moving up
+          // is counted by the access's hit.
+          if(e.dest > e.L){
+            for(unsigned i=e.L; i<e.dest; i++){
+              bandwidth[i] += blocksize;
+            }
+          }
+          break;
         }
       }
     }
@@ -395,18 +359,80 @@ namespace MTV{
   typedef LevelToLevelBandwidthPolicyT<Daly::Cache> LevelToLevelBandwidthPolicy;
   typedef LevelToLevelBandwidthPolicyT<NewCache> NewCacheLevelToLevelBandwidthPolicy;
 
+  template<typename CacheType>
+  class PrefetchBandwidthPolicyT : public PerformanceCounterPolicy {
+  public:
+    BoostPointers(PrefetchBandwidthPolicyT);
+
+  public:
+    // The rates are three groups of one counter per pair of levels:
+    // the total bytes moved (demand plus prefetch), the bytes moved by
+    // prefetches, and the prefetched bytes evicted before any use.
+    PrefetchBandwidthPolicyT(typename CacheType::const_ptr c)
+      : demand(c),
+        blocksize(c->block_size()),
+        prefetched(c->num_levels(), 0.0),
+        wasted(c->num_levels(), 0.0)
+    {}
+
+    void consume(const CacheAccessRecord& rec){
+      demand.consume(rec);
+
+      foreach(const Daly::CachePrefetchRecord& p, rec.prefetches){
+        if(p.event == Daly::CachePrefetchRecord::Issued){
+          // The block crosses every pair of levels between its source
+          // and its destination.
+          for(unsigned i=p.L; i<p.source and i<prefetched.size(); i++){
+            prefetched[i] += blocksize;
+          }
+        }
+        else if(p.event == Daly::CachePrefetchRecord::Polluting and p.L < wasted.size()){
+          wasted[p.L] += blocksize;
+        }
+      }
+    }
+
+    CacheHitRates rates() const {
+      CacheHitRates rates = demand.rates();
+      for(unsigned i=0; i<prefetched.size(); i++){
+        rates[i] += prefetched[i];
+      }
+
+      for(unsigned i=0; i<prefetched.size(); i++){
+        rates.add(prefetched[i]);
+      }
+
+      for(unsigned i=0; i<wasted.size(); i++){
+        rates.add(wasted[i]);
+      }
+
+      return rates;
+    }
+
+  private:
+    LevelToLevelBandwidthPolicyT<CacheType> demand;
+    const float blocksize;
+    std::vector<float> prefetched, wasted;
+  };
+
+  typedef PrefetchBandwidthPolicyT<NewCache> NewCachePrefetchBandwidthPolicy;
+
   template<typename CacheType>
   class CacheMissCountPolicyT : public PerformanceCounterPolicy {
   public:
     BoostPointers(CacheMissCountPolicyT);
 
   public:
-    CacheMissCountPolicyT(typename CacheType::const_ptr c)
+    // Counts the misses (and dirty writebacks) to main memory over the
+    // last "window" accesses - by default, over the whole trace.
+    CacheMissCountPolicyT(typename CacheType::const_ptr c, unsigned window = WindowedMean::Unbounded)
       : hitlevel(c->num_levels()),
-        count(0)
+        misses(window)
     {}
 
     void consume(const CacheAccessRecord& rec){
+      unsigned count = 0;
+
       foreach(const CacheHitRecord& hit, rec.hits){
         if(hit.L == hitlevel){
           count++;
@@ -418,17 +444,20 @@ namespace MTV{
           count++;
         }
       }
+
+      misses.record(count);
     }
+
     CacheHitRates rates() const {
       CacheHitRates rates;
-      rates.add(count);
+      rates.add(misses.sum());
 
       return rates;
     }
 
   private:
     unsigned hitlevel;
-    unsigned count;
+    WindowedMean misses;
   };
 
   typedef CacheMissCountPolicyT<Daly::Cache> CacheMissCountPolicy;
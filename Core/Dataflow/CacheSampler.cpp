@@ -0,0 +1,354 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// CacheSampler.cpp
+
+// MTV headers.
+#include <Core/Dataflow/CacheSampler.h>
+#include <Core/Util/BoostForeach.h>
+using MTV::CacheSampler;
+using MTV::SampledCacheStats;
+
+// Boost headers.
+#include <boost/math/distributions/students_t.hpp>
+
+// System headers.
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdlib.h>
+
+const uint64_t CacheSampler::Unbounded = static_cast<uint64_t>(-1);
+const uint64_t SampledCacheStats::CheckInterval;
+
+CacheSampler::CacheSampler(uint64_t block_size, uint64_t set_groups, unsigned set_ratio, uint64_t period, uint64_t window, uint64_t warmup, unsigned seed)
+  : block_size(block_size),
+    set_groups(set_ratio > 1 ? set_groups : 1),
+    set_ratio(set_ratio),
+    period(period),
+    window(window),
+    warmup(warmup),
+    slot(this->set_groups, -1),
+    sampled_groups(std::max<uint64_t>(this->set_groups / std::max(set_ratio, 1u), 1)),
+    phase(Measure),
+    windows(period > 0 ? 0 : 1),
+    count(0),
+    passed(0)
+{
+  // Choose the sampled set classes at random, so that they do not
+  // line up with strides in the trace.
+  std::vector<unsigned> order(this->set_groups);
+  for(unsigned i=0; i<order.size(); i++){
+    order[i] = i;
+  }
+
+  unsigned short xsubi[3] = {0x330e, static_cast<unsigned short>(seed & 0xffff), static_cast<unsigned short>(seed >> 16)};
+  for(unsigned i=order.size() - 1; i>0; i--){
+    std::swap(order[i], order[nrand48(xsubi) % (i + 1)]);
+  }
+
+  for(unsigned i=0; i<sampled_groups; i++){
+    slot[order[i]] = i;
+  }
+}
+
+void CacheSampler::consume(const MTR::Record& rec){
+  if(period > 0){
+    const uint64_t p = count % period;
+    if(p >= period - window){
+      if(phase != Measure or p == period - window){
+        windows++;
+      }
+
+      phase = Measure;
+    }
+    else if(warmup == Unbounded or p + window + warmup >= period){
+      phase = Warm;
+    }
+    else{
+      phase = Skip;
+    }
+  }
+
+  count++;
+
+  if(phase == Skip or slot[(rec.addr / block_size) % set_groups] < 0){
+    return;
+  }
+
+  passed++;
+  this->produce(rec);
+}
+
+double CacheSampler::sampled_fraction() const {
+  return period == 0 ? static_cast<double>(sampled_groups) / set_groups : 0.0;
+}
+
+void CacheSampler::describe(std::ostream& out) const {
+  out << "sampling:";
+  if(set_groups > 1){
+    out << " " << sampled_groups << " of " << set_groups << " set classes;";
+  }
+  if(period > 0){
+    out << " " << window << "-record windows every " << period << " records";
+    if(warmup == Unbounded){
+      out << " (functional warming)";
+    }
+    else{
+      out << " (" << warmup << " warmup records)";
+    }
+    out << ";";
+  }
+
+  out << " simulated " << passed << " of " << count << " records";
+  if(count > 0){
+    const std::ios_base::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+
+    out << " (" << std::fixed << std::setprecision(2) << 100.0*passed / count << "%)";
+
+    out.flags(flags);
+    out.precision(precision);
+  }
+  out << std::endl;
+}
+
+SampledCacheStats::SampledCacheStats(CacheSampler::const_ptr sampler, unsigned num_levels, unsigned block_size)
+  : sampler(sampler),
+    num_levels(num_levels),
+    blocksize(block_size)
+{}
+
+void SampledCacheStats::consume(const CacheAccessRecord& rec){
+  if(not sampler->measuring() or rec.hits.empty()){
+    return;
+  }
+
+  const unsigned u = sampler->unit(rec.addr);
+  while(units.size() <= u){
+    units.push_back(Unit(num_levels));
+  }
+  Unit& unit = units[u];
+
+  unit.records++;
+
+  // The lowest level that was hit; the levels before it missed (cf.
+  // CacheTemperaturePolicy).
+  unsigned hit = rec.hits[0].L;
+  foreach(const Daly::CacheHitRecord& h, rec.hits){
+    hit = std::min(hit, h.L);
+  }
+
+  for(unsigned L=0; L<hit and L<num_levels; L++){
+    unit.accesses[L]++;
+    unit.misses[L]++;
+    unit.score[L] += (L == 0 ? -4.0 : -1.0);
+  }
+
+  if(hit < num_levels){
+    unit.accesses[hit]++;
+    unit.score[hit] += 1.0;
+  }
+
+  // Traffic between levels (cf. LevelToLevelBandwidthPolicy).
+  foreach(const Daly::CacheHitRecord& h, rec.hits){
+    if(h.op == 'R'){
+      for(unsigned L=0; L<h.L and L<num_levels; L++){
+        unit.bytes[L] += blocksize;
+      }
+    }
+    else if(h.op == 'W' and h.L > 0 and h.L <= num_levels){
+      unit.bytes[h.L - 1] += blocksize;
+    }
+
+    if(h.L == num_levels){
+      unit.memory++;
+    }
+  }
+
+  foreach(const Daly::CacheEvictionRecord& e, rec.evictions){
+    if(e.writeback and e.dirty and e.L > 0 and e.L <= num_levels){
+      unit.bytes[e.L - 1] += blocksize;
+
+      if(e.L == num_levels){
+        unit.memory++;
+      }
+    }
+  }
+}
+
+SampledCacheStats::Estimate SampledCacheStats::ratio(const std::vector<double>& y, const std::vector<double>& x, double confidence) const {
+  Estimate e;
+  e.units = y.size();
+
+  double sy = 0.0, sx = 0.0;
+  for(unsigned i=0; i<y.size(); i++){
+    sy += y[i];
+    sx += x[i];
+  }
+
+  if(sx == 0.0){
+    e.halfwidth = std::numeric_limits<double>::infinity();
+    return e;
+  }
+
+  e.value = sy / sx;
+
+  const unsigned n = y.size();
+  if(n < 2){
+    e.halfwidth = std::numeric_limits<double>::infinity();
+    return e;
+  }
+
+  // Linearized variance of the ratio estimator, with a finite
+  // population correction when the population is known.
+  double ss = 0.0;
+  for(unsigned i=0; i<n; i++){
+    const double d = y[i] - e.value*x[i];
+    ss += d*d;
+  }
+
+  const double xbar = sx / n;
+  const double fpc = 1.0 - sampler->sampled_fraction();
+  const double se = std::sqrt(fpc * ss / (n - 1) / n) / xbar;
+
+  const boost::math::students_t dist(n - 1);
+  const double t = boost::math::quantile(boost::math::complement(dist, (1.0 - confidence) / 2.0));
+
+  e.halfwidth = t*se;
+
+  return e;
+}
+
+SampledCacheStats::Estimate SampledCacheStats::missRate(unsigned L, double confidence) const {
+  const unsigned n = sampler->num_units();
+
+  std::vector<double> y(n, 0.0), x(n, 0.0);
+  for(unsigned i=0; i<units.size() and i<n; i++){
+    y[i] = units[i].misses[L];
+    x[i] = units[i].accesses[L];
+  }
+
+  return this->ratio(y, x, confidence);
+}
+
+SampledCacheStats::Estimate SampledCacheStats::temperature(unsigned L, double confidence) const {
+  const unsigned n = sampler->num_units();
+
+  std::vector<double> y(n, 0.0), x(n, 0.0);
+  for(unsigned i=0; i<units.size() and i<n; i++){
+    y[i] = units[i].score[L];
+    x[i] = units[i].records;
+  }
+
+  Estimate e = this->ratio(y, x, confidence);
+
+  // Map the L1 value from [-4, 1] to [-1, 1], as HitHistory does.
+  if(L == 0 and e.value < 0.0){
+    e.value /= 4.0;
+    e.halfwidth /= 4.0;
+  }
+
+  return e;
+}
+
+SampledCacheStats::Estimate SampledCacheStats::bandwidth(unsigned L, double confidence) const {
+  const unsigned n = sampler->num_units();
+
+  std::vector<double> y(n, 0.0), x(n, 0.0);
+  for(unsigned i=0; i<units.size() and i<n; i++){
+    y[i] = units[i].bytes[L];
+    x[i] = units[i].records;
+  }
+
+  return this->ratio(y, x, confidence);
+}
+
+SampledCacheStats::Estimate SampledCacheStats::memoryTraffic(double confidence) const {
+  const unsigned n = sampler->num_units();
+
+  std::vector<double> y(n, 0.0), x(n, 0.0);
+  for(unsigned i=0; i<units.size() and i<n; i++){
+    y[i] = units[i].memory;
+    x[i] = units[i].records;
+  }
+
+  return this->ratio(y, x, confidence);
+}
+
+bool SampledCacheStats::converged(double target, double confidence, unsigned min_units) const {
+  if(sampler->num_units() < min_units){
+    return false;
+  }
+
+  for(unsigned L=0; L<num_levels; L++){
+    const Estimate e = this->missRate(L, confidence);
+    if(e.halfwidth > target*e.value){
+      return false;
+    }
+  }
+
+  return true;
+}
+
+namespace{
+  void print_estimate(std::ostream& out, const std::string& label, const SampledCacheStats::Estimate& e){
+    out << "  " << label << ": " << e.value;
+    if(e.halfwidth == std::numeric_limits<double>::infinity()){
+      out << " (too few samples for an interval)";
+    }
+    else{
+      out << " +/- " << e.halfwidth;
+    }
+    out << std::endl;
+  }
+}
+
+void SampledCacheStats::report(std::ostream& out, double confidence, const std::string& policy) const {
+  const std::ios_base::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+
+  out << std::setprecision(6);
+  out << "estimates with " << 100.0*confidence << "% confidence intervals (" << sampler->num_units() << " sample units):" << std::endl;
+
+  for(unsigned L=0; L<num_levels; L++){
+    std::stringstream ss;
+    ss << "L" << (L + 1) << " miss rate";
+    print_estimate(out, ss.str(), this->missRate(L, confidence));
+  }
+
+  if(policy == "temperature"){
+    for(unsigned L=0; L<num_levels; L++){
+      std::stringstream ss;
+      ss << "L" << (L + 1) << " temperature";
+      print_estimate(out, ss.str(), this->temperature(L, confidence));
+    }
+  }
+  else if(policy == "bandwidth"){
+    for(unsigned L=0; L<num_levels; L++){
+      std::stringstream ss;
+      ss << "L" << (L + 1) << "-";
+      if(L + 1 < num_levels){
+        ss << "L" << (L + 2);
+      }
+      else{
+        ss << "memory";
+      }
+      ss << " bytes per record";
+      print_estimate(out, ss.str(), this->bandwidth(L, confidence));
+    }
+  }
+  else if(policy == "miss-count"){
+    const Estimate e = this->memoryTraffic(confidence);
+    print_estimate(out, "memory transfers per record", e);
+
+    Estimate total = e;
+    total.value *= sampler->records();
+    total.halfwidth *= sampler->records();
+    print_estimate(out, "memory transfers (total)", total);
+  }
+
+  out.flags(flags);
+  out.precision(precision);
+}
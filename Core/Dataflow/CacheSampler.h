@@ -0,0 +1,184 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// CacheSampler.h - Statistical sampling for cache simulation.  A
+// CacheSampler sits in front of the cache simulators and passes on
+// only a sample of the memory records: those falling in a subset of
+// the cache sets (set sampling), and/or those near periodic
+// measurement windows (time sampling, with a warmup before each
+// window).  SampledCacheStats collects per-level statistics from the
+// measured records and estimates them with confidence intervals.
+
+#ifndef CACHE_SAMPLER_H
+#define CACHE_SAMPLER_H
+
+// MTV headers.
+#include <Core/Dataflow/CacheAccessRecord.h>
+#include <Core/Dataflow/Consumer.h>
+#include <Core/Dataflow/Filter.h>
+#include <Core/Util/BoostPointers.h>
+#include <Tools/ReferenceTrace/mtrtools.h>
+
+// System headers.
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace MTV{
+  class CacheSampler : public Filter<MTR::Record> {
+  public:
+    BoostPointers(CacheSampler);
+
+  public:
+    // Means "warm up on every record" - i.e., functional warming.
+    static const uint64_t Unbounded;
+
+  public:
+    // Set sampling: "set_groups" is the number of classes that block
+    // addresses fall into (by taking them modulo this number); it
+    // must divide the number of sets in every cache level, so that
+    // each class covers whole sets.  One class in "set_ratio" is
+    // simulated.
+    //
+    // Time sampling: every "period" records, "window" records are
+    // measured, after "warmup" records that are simulated but not
+    // measured.  Records before the warmup are skipped.  A zero
+    // period disables time sampling.
+    CacheSampler(uint64_t block_size, uint64_t set_groups, unsigned set_ratio, uint64_t period, uint64_t window, uint64_t warmup, unsigned seed = 0);
+
+    void consume(const MTR::Record& rec);
+
+    // Whether the current record is being measured.
+    bool measuring() const {
+      return phase == Measure;
+    }
+
+    // The sample unit that an address in the current window belongs
+    // to (one unit per set class per measurement window).
+    unsigned unit(MTR::addr_t addr) const {
+      return (windows - 1)*sampled_groups + slot[(addr / block_size) % set_groups];
+    }
+
+    // The number of sample units opened so far.
+    unsigned num_units() const {
+      return windows*sampled_groups;
+    }
+
+    // The fraction of the unit population that was sampled (nonzero
+    // only when the population is known, i.e., for set sampling
+    // alone).
+    double sampled_fraction() const;
+
+    uint64_t records() const {
+      return count;
+    }
+
+    uint64_t simulated() const {
+      return passed;
+    }
+
+    void describe(std::ostream& out) const;
+
+  private:
+    enum Phase{
+      Skip,
+      Warm,
+      Measure
+    };
+
+  private:
+    const uint64_t block_size, set_groups;
+    const unsigned set_ratio;
+    const uint64_t period, window, warmup;
+
+    // Maps each set class to its slot among the sampled classes, or
+    // to -1.
+    std::vector<int> slot;
+    unsigned sampled_groups;
+
+    Phase phase;
+
+    // Measurement windows begun so far.
+    unsigned windows;
+
+    uint64_t count, passed;
+  };
+
+  class SampledCacheStats : public Consumer<CacheAccessRecord> {
+  public:
+    BoostPointers(SampledCacheStats);
+
+  public:
+    struct Estimate{
+      Estimate()
+        : value(0.0),
+          halfwidth(0.0),
+          units(0)
+      {}
+
+      double value, halfwidth;
+      unsigned units;
+    };
+
+  public:
+    SampledCacheStats(CacheSampler::const_ptr sampler, unsigned num_levels, unsigned block_size);
+
+    void consume(const CacheAccessRecord& rec);
+
+    // Local miss rate of a level (misses over accesses reaching it).
+    Estimate missRate(unsigned L, double confidence) const;
+
+    // Mean temperature of a level, as CacheTemperaturePolicy computes
+    // it over an unbounded window.
+    Estimate temperature(unsigned L, double confidence) const;
+
+    // Bytes moved between levels L and L+1 (or memory) per record.
+    Estimate bandwidth(unsigned L, double confidence) const;
+
+    // Misses and dirty writebacks to memory per record.
+    Estimate memoryTraffic(double confidence) const;
+
+    // How often, in records, a caller should test converged().
+    static const uint64_t CheckInterval = 10000;
+
+    // Whether every level's miss rate is known to within the relative
+    // error "target" (with at least "min_units" sample units).  Only
+    // meaningful with time sampling, whose windows span the trace.
+    bool converged(double target, double confidence, unsigned min_units = 30) const;
+
+    // Prints the miss rates, plus the estimates for a
+    // CachePerformanceCounter policy ("temperature", "bandwidth", or
+    // "miss-count") if one is named.
+    void report(std::ostream& out, double confidence, const std::string& policy = "") const;
+
+  private:
+    struct Unit{
+      Unit(unsigned levels)
+        : records(0),
+          accesses(levels, 0),
+          misses(levels, 0),
+          score(levels, 0.0),
+          bytes(levels, 0.0),
+          memory(0)
+      {}
+
+      uint64_t records;
+      std::vector<uint64_t> accesses, misses;
+      std::vector<double> score, bytes;
+      uint64_t memory;
+    };
+
+    // Ratio estimate of sum(y) / sum(x) over the sample units.
+    Estimate ratio(const std::vector<double>& y, const std::vector<double>& x, double confidence) const;
+
+  private:
+    CacheSampler::const_ptr sampler;
+    const unsigned num_levels;
+    const float blocksize;
+
+    std::vector<Unit> units;
+  };
+}
+
+#endif
@@ -57,7 +57,8 @@ namespace MTV{
       // Broadcast the hit info.
       this->Filter2<MTR::Record, CacheAccessRecord, CacheStatusReport>::produce(CacheAccessRecord(c->hitInfo(),
                                                                                                   c->evictionInfo(),
-                                                                                                  c->entranceInfo(), rec.addr));
+                                                                                                  c->entranceInfo(), rec.addr,
+                                                                                                  c->prefetchInfo()));
 
       // Compute the proper cache status color (ranging from blue for a
       // hit in the lowest level up to red for a miss to main memory).
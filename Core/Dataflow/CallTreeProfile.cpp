@@ -0,0 +1,220 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// CallTreeProfile.cpp
+
+// MTV headers.
+#include <Core/Dataflow/CallTreeProfile.h>
+#include <Core/Util/BoostForeach.h>
+using Daly::CacheEvictionRecord;
+using Daly::CacheHitRecord;
+using MTV::CallTreeProfile;
+
+// System headers.
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace{
+  struct MoreOf{
+    MoreOf(const std::vector<uint64_t>& values)
+      : values(values)
+    {}
+
+    bool operator()(uint32_t a, uint32_t b) const {
+      return values[a] > values[b];
+    }
+
+    const std::vector<uint64_t>& values;
+  };
+}
+
+const uint32_t CallTreeProfile::Root;
+
+CallTreeProfile::CallTreeProfile(unsigned num_levels, unsigned blocksize)
+  : num_levels(num_levels),
+    blocksize(blocksize),
+    stride(Hits + num_levels),
+    counts(stride, 0),
+    stack(1, Root)
+{
+  const Node root = {Root, 0};
+  nodes.push_back(root);
+}
+
+void CallTreeProfile::addFunction(const std::string& name, uint64_t low_pc, uint64_t high_pc){
+  functions[low_pc] = std::make_pair(high_pc, name);
+}
+
+uint32_t CallTreeProfile::child(uint32_t node, uint64_t function){
+  const std::pair<uint32_t, uint64_t> key(node, function);
+  boost::unordered_map<std::pair<uint32_t, uint64_t>, uint32_t>::const_iterator i = children.find(key);
+  if(i != children.end()){
+    return i->second;
+  }
+
+  const uint32_t index = nodes.size();
+  const Node n = {node, function};
+  nodes.push_back(n);
+  counts.resize(counts.size() + stride, 0);
+  children[key] = index;
+
+  return index;
+}
+
+void CallTreeProfile::consume(const MTR::Record& rec){
+  if(rec.code == MTR::Record::FunctionEntry){
+    stack.push_back(this->child(stack.back(), rec.addr));
+  }
+  else if(rec.code == MTR::Record::FunctionExit){
+    // NOTE(choudhury): an exit normally matches the top of the stack;
+    // if it doesn't (the trace missed some exits, e.g. because of a
+    // longjmp), unwind to the nearest matching frame.  An exit with no
+    // matching frame is ignored.
+    for(size_t i=stack.size()-1; i>0; i--){
+      if(nodes[stack[i]].function == rec.addr){
+        stack.resize(i);
+        break;
+      }
+    }
+  }
+}
+
+void CallTreeProfile::consume(const CacheAccessRecord& rec){
+  uint64_t *c = &counts[stack.back()*stride];
+
+  c[References]++;
+
+  // Each access counts once, at the lowest level it hit (a store's
+  // write-through records name the levels below it as well).
+  if(rec.hits.size() > 0){
+    unsigned hit = rec.hits[0].L;
+    foreach(const CacheHitRecord& h, rec.hits){
+      hit = std::min(hit, h.L);
+    }
+
+    if(hit < num_levels){
+      c[Hits + hit]++;
+    }
+    else{
+      c[Misses]++;
+    }
+  }
+
+  // Dirty blocks leaving the last level are written to memory.
+  foreach(const CacheEvictionRecord& e, rec.evictions){
+    if(e.writeback and e.dirty and e.L + 1 == num_levels){
+      c[WritebackBytes] += blocksize;
+    }
+  }
+}
+
+bool CallTreeProfile::counter(const std::string& name, unsigned& c) const {
+  if(name == "references"){
+    c = References;
+    return true;
+  }
+  else if(name == "misses"){
+    c = Misses;
+    return true;
+  }
+  else if(name == "writebacks"){
+    c = WritebackBytes;
+    return true;
+  }
+  else if(name.size() > 1 and (name[0] == 'L' or name[0] == 'l')){
+    std::stringstream ss(name.substr(1));
+    unsigned L;
+    if(ss >> L and ss.eof() and L >= 1 and L <= num_levels){
+      c = Hits + L - 1;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+std::string CallTreeProfile::name(uint32_t node) const {
+  if(node == Root){
+    return "[root]";
+  }
+
+  const uint64_t pc = nodes[node].function;
+  std::map<uint64_t, std::pair<uint64_t, std::string> >::const_iterator f = functions.upper_bound(pc);
+  if(f != functions.begin()){
+    --f;
+    if(pc < f->second.first){
+      return f->second.second;
+    }
+  }
+
+  std::stringstream ss;
+  ss << "0x" << std::hex << pc;
+  return ss.str();
+}
+
+std::string CallTreeProfile::path(uint32_t node) const {
+  std::vector<uint32_t> up;
+  for(uint32_t n = node; n != Root; n = nodes[n].parent){
+    up.push_back(n);
+  }
+
+  if(up.size() == 0){
+    return this->name(Root);
+  }
+
+  std::string p;
+  for(std::vector<uint32_t>::const_reverse_iterator i = up.rbegin(); i != up.rend(); ++i){
+    if(p.size() > 0){
+      p += ';';
+    }
+    p += this->name(*i);
+  }
+
+  return p;
+}
+
+std::vector<uint64_t> CallTreeProfile::inclusive(unsigned c) const {
+  std::vector<uint64_t> totals(nodes.size());
+  for(uint32_t n=0; n<nodes.size(); n++){
+    totals[n] = this->exclusive(n, c);
+  }
+
+  // Children come after their parents, so one backward pass sums
+  // every subtree.
+  for(uint32_t n=nodes.size()-1; n>0; n--){
+    totals[nodes[n].parent] += totals[n];
+  }
+
+  return totals;
+}
+
+void CallTreeProfile::writeCollapsed(std::ostream& out, unsigned c) const {
+  for(uint32_t n=0; n<nodes.size(); n++){
+    if(this->exclusive(n, c) > 0){
+      out << this->path(n) << ' ' << this->exclusive(n, c) << std::endl;
+    }
+  }
+}
+
+void CallTreeProfile::report(std::ostream& out, unsigned c, unsigned top) const {
+  const std::vector<uint64_t> totals = this->inclusive(c);
+
+  std::vector<uint32_t> order;
+  for(uint32_t n=0; n<nodes.size(); n++){
+    if(totals[n] > 0){
+      order.push_back(n);
+    }
+  }
+
+  const unsigned k = std::min<size_t>(top, order.size());
+  std::partial_sort(order.begin(), order.begin() + k, order.end(), MoreOf(totals));
+
+  out << std::fixed << std::setprecision(2);
+  out << std::setw(10) << "inclusive" << std::setw(10) << "exclusive" << "  call path" << std::endl;
+  for(unsigned i=0; i<k; i++){
+    const uint32_t n = order[i];
+    out << std::setw(9) << (totals[Root] > 0 ? 100.0 * totals[n] / totals[Root] : 0.0) << '%'
+        << std::setw(9) << (totals[Root] > 0 ? 100.0 * this->exclusive(n, c) / totals[Root] : 0.0) << '%'
+        << "  " << this->path(n) << std::endl;
+  }
+}
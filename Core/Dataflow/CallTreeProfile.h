@@ -0,0 +1,124 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// CallTreeProfile.h - Accepts trace records and cache simulation
+// results, follows the call stack through the FunctionEntry and
+// FunctionExit records, and attributes the references, the hits at
+// each cache level, the misses to memory, and the bytes written back
+// to memory to each call path.
+
+#ifndef CALL_TREE_PROFILE_H
+#define CALL_TREE_PROFILE_H
+
+// MTV headers.
+#include <Core/Dataflow/CacheAccessRecord.h>
+#include <Core/Dataflow/Consumer.h>
+#include <Core/Util/Boost.h>
+#include <Core/Util/BoostPointers.h>
+#include <Tools/ReferenceTrace/mtrtools.h>
+
+// System headers.
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace MTV{
+  class CallTreeProfile : public Consumer<MTR::Record>,
+                          public Consumer<CacheAccessRecord> {
+  public:
+    BoostPointers(CallTreeProfile);
+
+  public:
+    // The counters kept for each call path; the hits at level L are
+    // counter Hits + L.
+    enum Counter{
+      References,
+      Misses,
+      WritebackBytes,
+      Hits
+    };
+
+    // Node 0 is the root: the accesses made outside any function the
+    // trace saw entered.
+    static const uint32_t Root = 0;
+
+  public:
+    CallTreeProfile(unsigned num_levels, unsigned blocksize);
+
+    // Names the function whose code occupies [low_pc, high_pc).
+    // Functions without names are shown by address.
+    void addFunction(const std::string& name, uint64_t low_pc, uint64_t high_pc);
+
+    void consume(const MTR::Record& rec);
+    void consume(const CacheAccessRecord& rec);
+
+    unsigned num_counters() const {
+      return stride;
+    }
+
+    // Parses a counter name ("references", "misses", "writebacks", or
+    // a level such as "L1" for its hits), returning false if the name
+    // is not one of these.
+    bool counter(const std::string& name, unsigned& c) const;
+
+    unsigned num_nodes() const {
+      return nodes.size();
+    }
+
+    uint32_t parent(uint32_t node) const {
+      return nodes[node].parent;
+    }
+
+    std::string name(uint32_t node) const;
+
+    // The semicolon separated function names from the root to a node.
+    std::string path(uint32_t node) const;
+
+    // A node's counts for its own accesses, and for those of its whole
+    // subtree.
+    uint64_t exclusive(uint32_t node, unsigned c) const {
+      return counts[node*stride + c];
+    }
+
+    std::vector<uint64_t> inclusive(unsigned c) const;
+
+    // Writes one line per call path with a nonzero exclusive count, in
+    // the "collapsed stack" format read by flame graph tools.
+    void writeCollapsed(std::ostream& out, unsigned c) const;
+
+    // Prints the "top" call paths with the largest inclusive count.
+    void report(std::ostream& out, unsigned c, unsigned top) const;
+
+  private:
+    // Finds or creates the child of "node" for a call to "function".
+    uint32_t child(uint32_t node, uint64_t function);
+
+  private:
+    struct Node{
+      uint32_t parent;
+      uint64_t function;
+    };
+
+    const unsigned num_levels, blocksize, stride;
+
+    // The call tree is an arena: nodes are never freed, and are
+    // addressed by their index.  A node's counters are the "stride"
+    // entries of "counts" starting at index*stride.  Children always
+    // come after their parents.
+    std::vector<Node> nodes;
+    std::vector<uint64_t> counts;
+    boost::unordered_map<std::pair<uint32_t, uint64_t>, uint32_t> children;
+
+    // The shadow call stack (node indices; the root is always at the
+    // bottom).
+    std::vector<uint32_t> stack;
+
+    // Function names, keyed by low PC, giving the high PC and name.
+    std::map<uint64_t, std::pair<uint64_t, std::string> > functions;
+  };
+}
+
+#endif
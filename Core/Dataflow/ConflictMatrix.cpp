@@ -0,0 +1,145 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// ConflictMatrix.cpp
+
+// MTV headers.
+#include <Core/Dataflow/ConflictMatrix.h>
+#include <Core/Util/BoostForeach.h>
+using Daly::CacheEntranceRecord;
+using Daly::CacheEvictionRecord;
+using MTV::ConflictMatrix;
+
+// System headers.
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+namespace{
+  struct Cell{
+    unsigned level, evictor, victim;
+    uint64_t remisses, evictions;
+  };
+
+  bool more_remisses(const Cell& a, const Cell& b){
+    return a.remisses > b.remisses or (a.remisses == b.remisses and a.evictions > b.evictions);
+  }
+
+  void write32(std::ostream& out, uint32_t x){
+    out.write(reinterpret_cast<const char *>(&x), sizeof(x));
+  }
+}
+
+ConflictMatrix::ConflictMatrix(unsigned num_levels, unsigned blocksize)
+  : num_levels(num_levels),
+    blocksize(blocksize),
+    names(1, "(other)"),
+    pending(num_levels)
+{}
+
+void ConflictMatrix::addRegion(const std::string& name, uint64_t base, uint64_t limit){
+  regions[base] = std::make_pair(limit, static_cast<unsigned>(names.size()));
+  names.push_back(name);
+}
+
+unsigned ConflictMatrix::region(uint64_t addr) const {
+  std::map<uint64_t, std::pair<uint64_t, unsigned> >::const_iterator r = regions.upper_bound(addr);
+  if(r != regions.begin()){
+    --r;
+    if(addr < r->second.first){
+      return r->second.second;
+    }
+  }
+
+  return 0;
+}
+
+void ConflictMatrix::consume(const CacheAccessRecord& rec){
+  const unsigned n = names.size();
+  if(evicted.empty()){
+    evicted.resize(num_levels, std::vector<uint64_t>(n*n, 0));
+    remissed.resize(num_levels, std::vector<uint64_t>(n*n, 0));
+  }
+
+  // A block coming back into a level it was evicted from is a re-miss
+  // charged to the eviction.
+  foreach(const CacheEntranceRecord& e, rec.entrances){
+    if(e.L >= num_levels){
+      continue;
+    }
+
+    boost::unordered_map<uint64_t, uint32_t>::iterator p = pending[e.L].find(e.blockaddr);
+    if(p != pending[e.L].end()){
+      remissed[e.L][p->second]++;
+      pending[e.L].erase(p);
+    }
+  }
+
+  // Every block leaving a level because of this access is charged to
+  // the accessed region.  (Blocks moving up through an exclusive
+  // hierarchy are not leaving because of a conflict.)
+  const unsigned evictor = this->region(rec.addr);
+  foreach(const CacheEvictionRecord& e, rec.evictions){
+    if(e.L >= num_levels or (e.kind == CacheEvictionRecord::Swap and e.dest < e.L)){
+      continue;
+    }
+
+    const uint32_t cell = evictor*n + this->region(e.blockaddr * blocksize);
+    evicted[e.L][cell]++;
+    pending[e.L][e.blockaddr] = cell;
+  }
+}
+
+bool ConflictMatrix::save(const std::string& filename) const {
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  if(!out){
+    return false;
+  }
+
+  out.write(magic(), 8);
+  write32(out, Version);
+  write32(out, num_levels);
+  write32(out, names.size());
+  write32(out, 0);
+
+  foreach(const std::string& name, names){
+    write32(out, name.size());
+    out.write(name.data(), name.size());
+  }
+
+  const std::vector<uint64_t> zeroes(names.size()*names.size(), 0);
+  for(unsigned L=0; L<num_levels; L++){
+    const std::vector<uint64_t>& r = remissed.empty() ? zeroes : remissed[L];
+    const std::vector<uint64_t>& e = evicted.empty() ? zeroes : evicted[L];
+
+    out.write(reinterpret_cast<const char *>(&r[0]), r.size()*sizeof(r[0]));
+    out.write(reinterpret_cast<const char *>(&e[0]), e.size()*sizeof(e[0]));
+  }
+
+  return out.good();
+}
+
+void ConflictMatrix::report(std::ostream& out, unsigned top) const {
+  std::vector<Cell> cells;
+  for(unsigned L=0; L<num_levels and not evicted.empty(); L++){
+    for(unsigned i=0; i<names.size(); i++){
+      for(unsigned j=0; j<names.size(); j++){
+        const Cell c = {L, i, j, this->remisses(L, i, j), this->evictions(L, i, j)};
+        if(c.remisses > 0){
+          cells.push_back(c);
+        }
+      }
+    }
+  }
+
+  const unsigned n = std::min<size_t>(top, cells.size());
+  std::partial_sort(cells.begin(), cells.begin() + n, cells.end(), more_remisses);
+
+  out << std::fixed << std::setprecision(2);
+  out << "top conflicts (re-misses of evicted blocks):" << std::endl;
+  for(unsigned i=0; i<n; i++){
+    const Cell& c = cells[i];
+    out << "  L" << (c.level + 1) << ": " << names[c.evictor] << " evicted " << names[c.victim] << ": "
+        << c.remisses << " re-misses of " << c.evictions << " evictions"
+        << " (" << 100.0 * c.remisses / c.evictions << "%)" << std::endl;
+  }
+}
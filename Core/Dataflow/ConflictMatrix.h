@@ -0,0 +1,98 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// ConflictMatrix.h - Consumes cache access records and attributes
+// evictions to the data structures involved: for each cache level, a
+// matrix counts how often accesses to one address region evicted
+// blocks of another (or the same) region, and how many of those
+// blocks were later missed on again.
+
+#ifndef CONFLICT_MATRIX_H
+#define CONFLICT_MATRIX_H
+
+// MTV headers.
+#include <Core/Dataflow/CacheAccessRecord.h>
+#include <Core/Dataflow/Consumer.h>
+#include <Core/Util/Boost.h>
+#include <Core/Util/BoostPointers.h>
+
+// System headers.
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace MTV{
+  class ConflictMatrix : public Consumer<CacheAccessRecord> {
+  public:
+    BoostPointers(ConflictMatrix);
+
+  public:
+    // The saved file is the magic string, then four 32-bit fields
+    // (version, level count, region count, and zero), then each
+    // region name as a 32-bit length followed by its characters, and
+    // finally, for each level, the re-miss matrix and the eviction
+    // matrix as 64-bit counts in row major order (rows are the
+    // evicting region, columns the evicted one).
+    static const char *magic(){
+      return "MTVXCMAT";
+    }
+
+    static const uint32_t Version = 1;
+
+  public:
+    // Region 0 collects the addresses outside every named region.
+    ConflictMatrix(unsigned num_levels, unsigned blocksize);
+
+    // Names the addresses in [base, limit) (regions should not overlap,
+    // and must all be added before any records are consumed).
+    void addRegion(const std::string& name, uint64_t base, uint64_t limit);
+
+    void consume(const CacheAccessRecord& rec);
+
+    unsigned num_regions() const {
+      return names.size();
+    }
+
+    const std::string& region_name(unsigned i) const {
+      return names[i];
+    }
+
+    // Blocks of region "victim" evicted from a level by accesses to
+    // region "evictor", and how many of them were missed on again.
+    uint64_t evictions(unsigned level, unsigned evictor, unsigned victim) const {
+      return evicted.empty() ? 0 : evicted[level][evictor*names.size() + victim];
+    }
+
+    uint64_t remisses(unsigned level, unsigned evictor, unsigned victim) const {
+      return remissed.empty() ? 0 : remissed[level][evictor*names.size() + victim];
+    }
+
+    bool save(const std::string& filename) const;
+
+    // Prints the "top" pairs with the most re-misses, across levels.
+    void report(std::ostream& out, unsigned top) const;
+
+  private:
+    unsigned region(uint64_t addr) const;
+
+  private:
+    const unsigned num_levels, blocksize;
+
+    std::vector<std::string> names;
+
+    // The named regions, keyed by base address, giving their limit and
+    // index.
+    std::map<uint64_t, std::pair<uint64_t, unsigned> > regions;
+
+    // For each level, the blocks evicted and not yet brought back,
+    // with the matrix cell to charge when they are.
+    std::vector<boost::unordered_map<uint64_t, uint32_t> > pending;
+
+    std::vector<std::vector<uint64_t> > evicted, remissed;
+  };
+}
+
+#endif
@@ -7,6 +7,8 @@
 #include <Marino/DeltaMementoRecorder.h>
 #include <Marino/Memento.pb.h>
 #include <Marino/Memorable.h>
+using MTV::ChunkedDeltaMementoReader;
+using MTV::ChunkedDeltaMementoRecorder;
 using MTV::DeltaMementoReader;
 using MTV::DeltaMementoRecorder;
 using MTV::ImmediateDeltaMementoReader;
@@ -16,8 +18,16 @@ using MTV::Memorable;
 #include <google/protobuf/text_format.h>
 using google::protobuf::TextFormat;
 
+// Boost includes.
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
 // System includes.
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 
 DeltaMementoReader::ptr DeltaMementoReader::open(const std::string& filename, const std::vector<Memorable::ptr>& mems){
   // Open the file.  Bail out (with a null pointer) if it can't be
@@ -39,10 +49,12 @@ DeltaMementoReader::ptr DeltaMementoReader::open(const std::string& filename, co
     break;
 
   case DeltaMementoRecorder::Chunked:
-    // TODO(choudhury): implement ChunkedDeltaMementoReader.
-    //
-    // return DeltaMementoReader::ptr(new ChunkedDeltaMementoReader(filename, mems, in.tellg())));
-    p = DeltaMementoReader::ptr();
+    {
+      ChunkedDeltaMementoReader::ptr c(new ChunkedDeltaMementoReader(filename, mems, in.tellg()));
+      if(c->good()){
+        p = c;
+      }
+    }
     break;
 
   case DeltaMementoRecorder::None:
@@ -55,7 +67,8 @@ DeltaMementoReader::ptr DeltaMementoReader::open(const std::string& filename, co
 
 DeltaMementoReader::DeltaMementoReader(const std::vector<Memorable::ptr>& mems)
   : mems(mems),
-    timer(new QTimer(0))
+    timer(new QTimer(0)),
+    reverse(false)
 {
   // Connect the timer's timeout signal to the class's timeout slot.
   QObject::connect(timer.get(), SIGNAL(timeout()), this, SLOT(timeout()));
@@ -65,7 +78,12 @@ void DeltaMementoReader::timeout(){
   // std::cout << "reading an event!" << std::endl;
 
   try{
-    this->nextEvent();
+    if(reverse){
+      this->previousEvent();
+    }
+    else{
+      this->nextEvent();
+    }
   }
   catch(DeltaMementoReader::End){
     std::cout << "Event trace end reached!!" << std::endl;
@@ -74,6 +92,12 @@ void DeltaMementoReader::timeout(){
 }
 
 void DeltaMementoReader::start(){
+  reverse = false;
+  timer->start();
+}
+
+void DeltaMementoReader::startReverse(){
+  reverse = true;
   timer->start();
 }
 
@@ -122,3 +146,191 @@ void ImmediateDeltaMementoReader::nextEvent(){
   // appropriate object.
   mems[d.id()]->applyDelta(d);
 }
+
+ChunkedDeltaMementoReader::ChunkedDeltaMementoReader(const std::string& filename, const std::vector<Memorable::ptr>& mems, std::streampos start)
+  : DeltaMementoReader(mems),
+    eventtrace(filename.c_str(), std::ios::binary),
+    ok(false),
+    total(0),
+    cursor(0),
+    loaded(-1)
+{
+  if(!eventtrace){
+    return;
+  }
+
+  ok = this->readIndex(start);
+  if(!ok){
+    return;
+  }
+
+  // Compute the number of the first event in each chunk.
+  firsts.reserve(index.size() + 1);
+  for(unsigned i=0; i<index.size(); i++){
+    firsts.push_back(total);
+    total += index[i].header.count;
+  }
+  firsts.push_back(total);
+}
+
+bool ChunkedDeltaMementoReader::readIndex(std::streampos start){
+  typedef ChunkedDeltaMementoRecorder::Footer Footer;
+
+  eventtrace.seekg(0, std::ios::end);
+  const std::streampos end = eventtrace.tellg();
+
+  // Look for the footer; if it is there, it tells where the index
+  // lives.
+  Footer footer;
+  if(end - start >= static_cast<std::streamoff>(sizeof(footer))){
+    eventtrace.seekg(end - static_cast<std::streamoff>(sizeof(footer)));
+    eventtrace.read(reinterpret_cast<char *>(&footer), sizeof(footer));
+
+    if(eventtrace and
+       std::memcmp(footer.magic, ChunkedDeltaMementoRecorder::Magic, sizeof(footer.magic)) == 0 and
+       footer.index_offset + footer.chunks*sizeof(IndexEntry) + sizeof(footer) == static_cast<uint64_t>(end)){
+      index.resize(footer.chunks);
+
+      eventtrace.seekg(footer.index_offset);
+      if(!index.empty()){
+        eventtrace.read(reinterpret_cast<char *>(&index[0]), index.size()*sizeof(IndexEntry));
+      }
+
+      return static_cast<bool>(eventtrace);
+    }
+  }
+
+  // No footer (the recording was cut short) - rebuild the index by
+  // walking the chunk headers.
+  eventtrace.clear();
+  return this->scanChunks(start, end);
+}
+
+bool ChunkedDeltaMementoReader::scanChunks(std::streampos start, std::streampos end){
+  std::streampos pos = start;
+  while(end - pos >= static_cast<std::streamoff>(sizeof(ChunkedDeltaMementoRecorder::ChunkHeader))){
+    IndexEntry entry;
+    entry.offset = pos;
+
+    eventtrace.seekg(pos);
+    eventtrace.read(reinterpret_cast<char *>(&entry.header), sizeof(entry.header));
+
+    // Stop at a partially written chunk (or at whatever was left of
+    // an index that was being written).
+    pos += sizeof(entry.header) + entry.header.bytes;
+    if(!eventtrace or entry.header.count == 0 or pos > end){
+      break;
+    }
+
+    index.push_back(entry);
+  }
+
+  eventtrace.clear();
+  return true;
+}
+
+const DeltaMemento& ChunkedDeltaMementoReader::event(uint64_t i){
+  // Find the chunk containing the event.
+  const int c = std::upper_bound(firsts.begin(), firsts.end(), i) - firsts.begin() - 1;
+
+  if(c != loaded){
+    const IndexEntry& entry = index[c];
+
+    std::string compressed(entry.header.bytes, '\0');
+    eventtrace.seekg(entry.offset + sizeof(entry.header));
+    eventtrace.read(&compressed[0], compressed.size());
+
+    // Inflate the chunk.
+    std::string payload;
+    try{
+      boost::iostreams::filtering_istream z;
+      z.push(boost::iostreams::gzip_decompressor());
+      z.push(boost::iostreams::array_source(compressed.data(), compressed.size()));
+      payload.assign(std::istreambuf_iterator<char>(z), std::istreambuf_iterator<char>());
+    }
+    catch(std::ios_base::failure&){
+      // The chunk is corrupt; treat the file as ending here.
+      loaded = -1;
+      throw DeltaMementoReader::End();
+    }
+
+    // Parse out the size-prefixed mementos.
+    chunk.resize(entry.header.count);
+    size_t p = 0;
+    for(unsigned j=0; j<chunk.size(); j++){
+      int size = 0;
+      if(p + sizeof(size) <= payload.size()){
+        std::memcpy(&size, &payload[p], sizeof(size));
+        p += sizeof(size);
+      }
+
+      if(size < 0 or p + size > payload.size() or !chunk[j].ParseFromArray(payload.data() + p, size)){
+        // The chunk is corrupt; treat the file as ending here.
+        loaded = -1;
+        throw DeltaMementoReader::End();
+      }
+      p += size;
+    }
+
+    loaded = c;
+  }
+
+  return chunk[i - firsts[c]];
+}
+
+void ChunkedDeltaMementoReader::nextEvent(){
+  if(cursor == total){
+    throw DeltaMementoReader::End();
+  }
+
+  const DeltaMemento& d = this->event(cursor);
+  mems[d.id()]->applyDelta(d);
+  ++cursor;
+}
+
+void ChunkedDeltaMementoReader::previousEvent(){
+  if(cursor == 0){
+    throw DeltaMementoReader::End();
+  }
+
+  const DeltaMemento& d = this->event(cursor - 1);
+  mems[d.id()]->unapplyDelta(d);
+  --cursor;
+}
+
+namespace{
+  // Whether a chunk lies entirely before a trace index (the chunks are
+  // in trace order, so this partitions the index).
+  bool ends_before(const ChunkedDeltaMementoRecorder::IndexEntry& entry, uint64_t trace_index){
+    return entry.header.last < trace_index;
+  }
+}
+
+bool ChunkedDeltaMementoReader::seek(uint64_t trace_index){
+  // Use the chunk index to find the first chunk that may contain an
+  // event at or past the target, then search within it.
+  const unsigned c = std::lower_bound(index.begin(), index.end(), trace_index, ends_before) - index.begin();
+
+  // NOTE(choudhury): the file stores deltas, so the events between
+  // here and the target still have to be (un)applied one by one; the
+  // index just saves locating the target by scanning.  Reading any
+  // event can find a corrupt or short chunk, which ends the file.
+  try{
+    uint64_t target = firsts[c];
+    while(target < firsts[std::min<size_t>(c + 1, index.size())] and this->event(target).trace_index() < trace_index){
+      ++target;
+    }
+
+    while(cursor < target){
+      this->nextEvent();
+    }
+    while(cursor > target){
+      this->previousEvent();
+    }
+  }
+  catch(DeltaMementoReader::End){
+    return false;
+  }
+
+  return true;
+}
@@ -4,13 +4,15 @@
 //
 // DeltaMementoReader.h - In the same style as TraceReader, opens a
 // file of delta mementos, reads them one by one, and takes
-// appropriate action.
+// appropriate action.  Chunked files can also be stepped backwards and
+// seeked by trace index.
 
 #ifndef DELTA_MEMENTO_READER_H
 #define DELTA_MEMENTO_READER_H
 
 // MTV headers.
 #include <Core/Util/BoostPointers.h>
+#include <Marino/DeltaMementoRecorder.h>
 #include <Marino/Memorable.h>
 
 // Qt headers.
@@ -20,6 +22,7 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <stdint.h>
 
 namespace MTV{
   class DeltaMementoReader : public QObject {
@@ -36,13 +39,27 @@ namespace MTV{
 
     virtual void nextEvent() = 0;
 
+    // Unapplies the most recently applied event.  Readers that can
+    // only go forward report that there is nothing to go back to.
+    virtual void previousEvent(){
+      throw End();
+    }
+
+    // Applies or unapplies events until exactly those with a trace
+    // index below the given one have been applied.  Returns false if
+    // the reader cannot seek.
+    virtual bool seek(uint64_t trace_index){
+      return false;
+    }
+
   public slots:
     // This slot is engaged to let the object know it should read out
-    // the next event.
+    // the next (or, when playing in reverse, the previous) event.
     void timeout();
 
     // Playback control.
     void start();
+    void startReverse();
     void stop();
     void setInterval(int msec);
 
@@ -51,6 +68,7 @@ namespace MTV{
 
   private:
     boost::shared_ptr<QTimer> timer;
+    bool reverse;
 
   public:
     // Thrown by nextEvent() when there are no more events to read.
@@ -83,6 +101,63 @@ namespace MTV{
   protected:
     std::ifstream eventtrace;
   };
+
+  // Reads the files written by ChunkedDeltaMementoRecorder.  Only the
+  // chunk under the cursor is kept inflated, so stepping in either
+  // direction touches the disk once per chunk.
+  class ChunkedDeltaMementoReader : public DeltaMementoReader {
+    Q_OBJECT;
+
+  public:
+    BoostPointers(ChunkedDeltaMementoReader);
+
+  public:
+    ChunkedDeltaMementoReader(const std::string& filename, const std::vector<Memorable::ptr>& mems, std::streampos start);
+
+    // False if the chunk index could not be read.
+    bool good() const {
+      return ok;
+    }
+
+    void nextEvent();
+    void previousEvent();
+    bool seek(uint64_t trace_index);
+
+    // The number of events in the file, and the number that have been
+    // applied so far.
+    uint64_t size() const {
+      return total;
+    }
+
+    uint64_t position() const {
+      return cursor;
+    }
+
+  private:
+    typedef ChunkedDeltaMementoRecorder::IndexEntry IndexEntry;
+
+    bool readIndex(std::streampos start);
+    bool scanChunks(std::streampos start, std::streampos end);
+
+    // Returns the i-th event in the file, inflating its chunk if
+    // necessary.
+    const DeltaMemento& event(uint64_t i);
+
+  private:
+    std::ifstream eventtrace;
+    bool ok;
+
+    std::vector<IndexEntry> index;
+
+    // The number of the first event in each chunk, plus the total.
+    std::vector<uint64_t> firsts;
+    uint64_t total;
+
+    uint64_t cursor;
+
+    int loaded;
+    std::vector<DeltaMemento> chunk;
+  };
 }
 
 #endif
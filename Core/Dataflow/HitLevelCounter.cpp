@@ -26,8 +26,8 @@ void HitLevelCounter::consume(const CacheAccessRecord& rec){
     }
   }
 
-  if(panel){
-    out << panel->getFrame() << ' ';
+  if(frame){
+    out << frame() << ' ';
   }
   // out << rec.addr << ' ' << L << std::endl;
   out.write(reinterpret_cast<const char *>(&L), sizeof(L));
@@ -12,9 +12,11 @@
 // MTV headers.
 #include <Core/Dataflow/CacheAccessRecord.h>
 #include <Core/Dataflow/Consumer.h>
-#include <Core/UI/WidgetPanel.h>
 #include <Core/Util/BoostPointers.h>
 
+// Boost headers.
+#include <boost/function.hpp>
+
 // Sytem headers.
 #include <fstream>
 #include <string>
@@ -25,8 +27,13 @@ namespace MTV{
     BoostPointers(HitLevelCounter);
 
   public:
-    HitLevelCounter(WidgetPanel::const_ptr panel = WidgetPanel::const_ptr())
-      : panel(panel)
+    // If given, the frame source is queried for an animation frame
+    // number to write alongside each record.
+    typedef boost::function<unsigned long long ()> FrameSource;
+
+  public:
+    HitLevelCounter(FrameSource frame = FrameSource())
+      : frame(frame)
     {}
 
     ~HitLevelCounter();
@@ -37,7 +44,7 @@ namespace MTV{
 
   private:
     std::ofstream out;
-    WidgetPanel::const_ptr panel;
+    FrameSource frame;
   };
 }
 
@@ -0,0 +1,330 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// Instrumentation.cpp
+
+// MTV headers.
+#include <Core/Dataflow/Instrumentation.h>
+using MTV::Instrumentation;
+
+// Boost headers.
+#include <boost/thread.hpp>
+#include <boost/unordered_map.hpp>
+
+// System headers.
+#include <algorithm>
+#include <cxxabi.h>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <sys/time.h>
+#include <vector>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+bool Instrumentation::active = false;
+bool Instrumentation::counting = false;
+uint64_t Instrumentation::allocations = 0;
+unsigned Instrumentation::depth = 0;
+bool Instrumentation::sampling = false;
+uint64_t Instrumentation::child_cycles = 0;
+uint64_t Instrumentation::child_allocations = 0;
+
+namespace{
+  // A timed consume() call.
+  struct Event{
+    const Instrumentation::Node *node;
+    uint64_t start, duration;
+  };
+
+  struct Counter{
+    std::string name;
+    uint64_t time;
+    double value;
+  };
+
+  struct Gauge{
+    Gauge()
+      : last(0.0),
+        max(0.0)
+    {}
+
+    double last, max;
+  };
+
+  // Bounds the memory used for trace events.
+  const size_t MaxEvents = 1 << 20;
+
+  unsigned sample_interval = 64;
+  uint64_t report_period = 0;
+  std::string tracefile;
+
+  uint64_t records = 0;
+
+  // A deque keeps node pointers valid as nodes are added.
+  std::deque<Instrumentation::Node> nodes;
+  boost::unordered_map<const void *, unsigned> node_index;
+  boost::unordered_map<const void *, std::string> names;
+
+  std::vector<Event> events;
+
+  boost::mutex gauge_mutex;
+  std::vector<Counter> counters;
+  std::map<std::string, Gauge> gauges;
+
+  // Reference points for converting cycles to microseconds.
+  uint64_t ref_cycles;
+  struct timeval ref_time;
+
+  double microseconds(const struct timeval& tv){
+    return 1e6*(tv.tv_sec - ref_time.tv_sec) + (tv.tv_usec - ref_time.tv_usec);
+  }
+
+  std::string demangle(const char *name){
+    int status;
+    char *d = abi::__cxa_demangle(name, 0, 0, &status);
+    if(status != 0){
+      return name;
+    }
+
+    const std::string result(d);
+    free(d);
+
+    return result;
+  }
+
+  std::string json_string(const std::string& s){
+    std::stringstream ss;
+    ss << '"';
+    for(unsigned i=0; i<s.length(); i++){
+      if(s[i] == '"' or s[i] == '\\'){
+        ss << '\\';
+      }
+      ss << s[i];
+    }
+    ss << '"';
+
+    return ss.str();
+  }
+}
+
+uint64_t Instrumentation::cycles(){
+#if defined(__i386__) || defined(__x86_64__)
+  return __rdtsc();
+#else
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return 1000000ULL*tv.tv_sec + tv.tv_usec;
+#endif
+}
+
+void Instrumentation::enable(unsigned _sample_interval, uint64_t _report_period, const std::string& _tracefile){
+  sample_interval = std::max(_sample_interval, 1u);
+  report_period = _report_period;
+  tracefile = _tracefile;
+
+  ref_cycles = cycles();
+  gettimeofday(&ref_time, 0);
+
+  if(!active){
+    atexit(&Instrumentation::finish);
+  }
+
+  active = true;
+  counting = true;
+}
+
+void Instrumentation::finish(){
+  active = false;
+
+  report(std::cerr);
+
+  if(tracefile != "" and !writeTrace(tracefile)){
+    std::cerr << "error: could not write trace events to '" << tracefile << "'." << std::endl;
+  }
+}
+
+void Instrumentation::nameNode(const void *node, const std::string& name){
+  names[node] = name;
+
+  // Rename the node if it has already been seen.
+  boost::unordered_map<const void *, unsigned>::const_iterator i = node_index.find(node);
+  if(i != node_index.end()){
+    nodes[i->second].name = name;
+  }
+}
+
+Instrumentation::Node *Instrumentation::node(const void *p, const std::type_info& type){
+  boost::unordered_map<const void *, unsigned>::const_iterator i = node_index.find(p);
+  if(i != node_index.end()){
+    return &nodes[i->second];
+  }
+
+  std::string name;
+  boost::unordered_map<const void *, std::string>::const_iterator n = names.find(p);
+  if(n != names.end()){
+    name = n->second;
+  }
+  else{
+    std::stringstream ss;
+    ss << demangle(type.name()) << " #" << nodes.size();
+    name = ss.str();
+  }
+
+  node_index[p] = nodes.size();
+  nodes.push_back(Node(name));
+
+  return &nodes.back();
+}
+
+Instrumentation::Scope::Scope(){
+  if(depth++ == 0){
+    sampling = (records % sample_interval == 0);
+    records++;
+
+    if(report_period > 0 and records % report_period == 0){
+      report(std::cerr);
+    }
+  }
+}
+
+Instrumentation::Scope::~Scope(){
+  --depth;
+}
+
+bool Instrumentation::Scope::sampled() const {
+  return sampling;
+}
+
+Instrumentation::Timer::Timer(Node *node)
+  : node(node),
+    saved_child_cycles(child_cycles),
+    saved_child_allocations(child_allocations),
+    start_allocations(allocations)
+{
+  child_cycles = 0;
+  child_allocations = 0;
+  start = cycles();
+}
+
+Instrumentation::Timer::~Timer(){
+  const uint64_t duration = cycles() - start;
+  const uint64_t allocs = allocations - start_allocations;
+
+  node->samples++;
+  node->cycles += duration;
+  node->self_cycles += duration - std::min(duration, child_cycles);
+  node->allocations += allocs - std::min(allocs, child_allocations);
+
+  child_cycles = saved_child_cycles + duration;
+  child_allocations = saved_child_allocations + allocs;
+
+  if(tracefile != "" and events.size() < MaxEvents){
+    Event e;
+    e.node = node;
+    e.start = start;
+    e.duration = duration;
+    events.push_back(e);
+  }
+}
+
+void Instrumentation::gauge(const std::string& name, double value){
+  if(!active){
+    return;
+  }
+
+  boost::lock_guard<boost::mutex> lock(gauge_mutex);
+
+  Gauge& g = gauges[name];
+  g.last = value;
+  g.max = std::max(g.max, value);
+
+  if(tracefile != "" and counters.size() < MaxEvents){
+    Counter c;
+    c.name = name;
+    c.time = cycles();
+    c.value = value;
+    counters.push_back(c);
+  }
+}
+
+void Instrumentation::report(std::ostream& out){
+  const std::ios_base::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+
+  out << std::endl
+      << "dataflow stats after " << records << " records:" << std::endl
+      << std::left << std::setw(40) << "node"
+      << std::right << std::setw(12) << "in"
+      << std::setw(12) << "out"
+      << std::setw(14) << "cycles/rec"
+      << std::setw(14) << "self/rec"
+      << std::setw(12) << "allocs/rec" << std::endl;
+
+  out << std::fixed << std::setprecision(1);
+  for(unsigned i=0; i<nodes.size(); i++){
+    const Node& n = nodes[i];
+    const double samples = n.samples > 0 ? n.samples : 1;
+
+    out << std::left << std::setw(40) << n.name.substr(0, 39)
+        << std::right << std::setw(12) << n.in
+        << std::setw(12) << n.out
+        << std::setw(14) << n.cycles / samples
+        << std::setw(14) << n.self_cycles / samples
+        << std::setprecision(2) << std::setw(12) << n.allocations / samples
+        << std::setprecision(1) << std::endl;
+  }
+
+  boost::lock_guard<boost::mutex> lock(gauge_mutex);
+  for(std::map<std::string, Gauge>::const_iterator i = gauges.begin(); i != gauges.end(); i++){
+    out << std::left << std::setw(40) << i->first.substr(0, 39)
+        << std::right << " last " << i->second.last << ", max " << i->second.max << std::endl;
+  }
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+bool Instrumentation::writeTrace(const std::string& filename){
+  std::ofstream out(filename.c_str());
+  if(!out){
+    return false;
+  }
+
+  // Convert cycles to microseconds using the time elapsed since
+  // enable().
+  struct timeval now;
+  gettimeofday(&now, 0);
+  const double elapsed = microseconds(now);
+  const double per_us = elapsed > 0.0 ? (cycles() - ref_cycles) / elapsed : 1.0;
+
+  out << std::fixed << std::setprecision(3);
+  out << "{\"traceEvents\": [" << std::endl
+      << "  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"mtvx dataflow\"}}";
+
+  for(unsigned i=0; i<events.size(); i++){
+    const Event& e = events[i];
+    out << "," << std::endl
+        << "  {\"name\": " << json_string(e.node->name)
+        << ", \"ph\": \"X\", \"pid\": 1, \"tid\": 1"
+        << ", \"ts\": " << (e.start - ref_cycles) / per_us
+        << ", \"dur\": " << e.duration / per_us << "}";
+  }
+
+  boost::lock_guard<boost::mutex> lock(gauge_mutex);
+  for(unsigned i=0; i<counters.size(); i++){
+    const Counter& c = counters[i];
+    out << "," << std::endl
+        << "  {\"name\": " << json_string(c.name)
+        << ", \"ph\": \"C\", \"pid\": 1"
+        << ", \"ts\": " << (c.time - ref_cycles) / per_us
+        << ", \"args\": {\"value\": " << c.value << "}}";
+  }
+
+  out << std::endl << "]}" << std::endl;
+
+  return true;
+}
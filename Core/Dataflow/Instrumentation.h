@@ -0,0 +1,165 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// Instrumentation.h - Opt-in profiling for dataflow networks.  When
+// enabled, every Producer::broadcast() counts records into and out of
+// each node, and on a sample of the records times each consume() call
+// and counts its allocations.  The results are printed as a periodic
+// table and saved as a Chrome trace-event file (load it in
+// chrome://tracing).  When disabled, a broadcast costs one extra test
+// of a flag.
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+// System headers.
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <typeinfo>
+#include <stdint.h>
+
+namespace MTV{
+  // NOTE(choudhury): dataflow networks run on a single thread, so the
+  // per-node bookkeeping is unsynchronized; only gauge() may be called
+  // from other threads.
+  class Instrumentation{
+  public:
+    struct Node{
+      Node(const std::string& name)
+        : name(name),
+          in(0),
+          out(0),
+          samples(0),
+          cycles(0),
+          self_cycles(0),
+          allocations(0)
+      {}
+
+      std::string name;
+
+      // Records consumed and produced.
+      uint64_t in, out;
+
+      // For the sampled consume() calls: how many there were, the time
+      // spent in them (including, and excluding, downstream nodes),
+      // and the allocations made by the node itself.
+      uint64_t samples, cycles, self_cycles, allocations;
+    };
+
+    // Times one consume() call, attributing time spent in nested
+    // (downstream) calls to those nodes rather than this one.
+    class Timer{
+    public:
+      Timer(Node *node);
+      ~Timer();
+
+    private:
+      Node *node;
+      uint64_t start, saved_child_cycles, saved_child_allocations, start_allocations;
+    };
+
+    // Marks one broadcast; whether a record is sampled is decided once,
+    // at the outermost broadcast, so that a sampled record is timed
+    // through the whole network.
+    class Scope{
+    public:
+      Scope();
+      ~Scope();
+
+      bool sampled() const;
+    };
+
+  public:
+    // Tested by every broadcast.
+    static bool active;
+
+    // Starts collecting.  One record in every "sample_interval" is
+    // timed; every "report_period" records (if nonzero) the stats
+    // table is printed to stderr; and if "tracefile" is given, the
+    // trace events are written to it at exit.
+    static void enable(unsigned sample_interval = 64, uint64_t report_period = 0, const std::string& tracefile = "");
+
+    // Names a node (any object taking part in a network).  Unnamed
+    // nodes are named after their type.
+    template<typename T>
+    static void name(const T& node, const std::string& name){
+      nameNode(dynamic_cast<const void *>(&*node), name);
+    }
+
+    static void nameNode(const void *node, const std::string& name);
+
+    // Looks up the record for a node, creating it if necessary.
+    static Node *node(const void *p, const std::type_info& type);
+
+    // Records the current value of a named quantity, such as a queue
+    // depth.
+    static void gauge(const std::string& name, double value);
+
+    // Counts allocations made through MTV_INSTRUMENT_ALLOCATIONS
+    // without enabling the rest of the profiling (enable() turns
+    // counting on as well).
+    static void countAllocations(){
+      counting = true;
+    }
+
+    static uint64_t allocationCount(){
+      return allocations;
+    }
+
+    static void countAllocation(){
+      if(counting){
+        __sync_fetch_and_add(&allocations, 1);
+      }
+    }
+
+    // Prints the stats table.
+    static void report(std::ostream& out);
+
+    // Writes out the Chrome trace-event file.
+    static bool writeTrace(const std::string& filename);
+
+    static uint64_t cycles();
+
+  private:
+    static void finish();
+
+  private:
+    static bool counting;
+    static uint64_t allocations;
+
+    // Broadcast nesting depth, and whether the current outermost
+    // record is being sampled.
+    static unsigned depth;
+    static bool sampling;
+
+    // Time and allocations of the nested, timed calls under the
+    // innermost running Timer.
+    static uint64_t child_cycles, child_allocations;
+  };
+}
+
+// Placing this macro at file scope in one source file of a program
+// lets Instrumentation count allocations.
+#define MTV_INSTRUMENT_ALLOCATIONS                                      \
+  void *operator new(size_t size){                                      \
+    MTV::Instrumentation::countAllocation();                            \
+    void *p = malloc(size > 0 ? size : 1);                              \
+    if(!p){                                                             \
+      throw std::bad_alloc();                                           \
+    }                                                                   \
+    return p;                                                           \
+  }                                                                     \
+  void *operator new[](size_t size){                                    \
+    return operator new(size);                                          \
+  }                                                                     \
+  void operator delete(void *p) throw() {                               \
+    free(p);                                                            \
+  }                                                                     \
+  void operator delete[](void *p) throw() {                             \
+    free(p);                                                            \
+  }
+
+#endif
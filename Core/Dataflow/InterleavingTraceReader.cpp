@@ -0,0 +1,116 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// InterleavingTraceReader.cpp
+
+// MTV headers.
+#include <Core/Dataflow/InterleavingTraceReader.h>
+using MTV::InterleavingTraceReader;
+using MTV::TraceReader;
+
+// System headers.
+#include <algorithm>
+
+InterleavingTraceReader::InterleavingTraceReader(Schedule schedule, unsigned quantum)
+  : sched(schedule),
+    quantum(std::max(quantum, 1u)),
+    current(-1),
+    budget(0),
+    last(0)
+{}
+
+bool InterleavingTraceReader::open(const std::vector<std::string>& filenames){
+  threads.clear();
+  for(unsigned i=0; i<filenames.size(); i++){
+    Thread t;
+    t.reader = boost::make_shared<TraceReader>();
+    t.done = false;
+    t.time = 0;
+
+    if(!t.reader->open(filenames[i])){
+      threads.clear();
+      return false;
+    }
+
+    threads.push_back(t);
+  }
+
+  // Start with thread 0 under either schedule.
+  current = -1;
+  last = threads.size() - 1;
+
+  return !threads.empty();
+}
+
+bool InterleavingTraceReader::schedule(){
+  current = -1;
+
+  if(sched == Quantum){
+    // Round robin, starting after the last thread to run.
+    for(unsigned k=1; k<=threads.size(); k++){
+      const unsigned i = (last + k) % threads.size();
+      if(!threads[i].done){
+        current = i;
+        break;
+      }
+    }
+
+    budget = quantum;
+  }
+  else{
+    // Earliest current time wins.
+    for(unsigned i=0; i<threads.size(); i++){
+      if(!threads[i].done and (current == -1 or threads[i].time < threads[current].time)){
+        current = i;
+      }
+    }
+  }
+
+  if(current != -1){
+    last = current;
+  }
+
+  return current != -1;
+}
+
+const MTR::ThreadRecord& InterleavingTraceReader::nextRecord(){
+  while(true){
+    if(current == -1 and !this->schedule()){
+      throw InterleavingTraceReader::End();
+    }
+
+    Thread& t = threads[current];
+
+    MTR::Record rec;
+    try{
+      rec = t.reader->nextRecord();
+    }
+    catch(TraceReader::End){
+      t.done = true;
+      current = -1;
+      continue;
+    }
+
+    // Timestamps only steer the schedule.
+    if(rec.code == MTR::Record::Timestamp){
+      t.time = rec.addr;
+      if(sched == Timestamp){
+        current = -1;
+      }
+      continue;
+    }
+
+    out.record = rec;
+    out.thread = current;
+
+    // Under the quantum schedule, only memory records count against
+    // the thread's time slice.
+    if(sched == Quantum and MTR::type(rec) == MTR::Record::MType and --budget == 0){
+      current = -1;
+    }
+
+    break;
+  }
+
+  this->produce(out);
+  return out;
+}
@@ -0,0 +1,90 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// InterleavingTraceReader.h - Merges several per-thread reference
+// traces into a single, deterministically ordered stream of records
+// tagged with their thread ids.
+
+#ifndef INTERLEAVING_TRACE_READER_H
+#define INTERLEAVING_TRACE_READER_H
+
+// MTV headers.
+#include <Core/Dataflow/Producer.h>
+#include <Core/Dataflow/TraceReader.h>
+#include <Core/Util/BoostPointers.h>
+#include <Tools/ReferenceTrace/mtrtools.h>
+
+// System headers.
+#include <string>
+#include <vector>
+
+namespace MTV{
+  class InterleavingTraceReader : public Producer<MTR::ThreadRecord> {
+  public:
+    BoostPointers(InterleavingTraceReader);
+
+  public:
+    enum Schedule{
+      // Round robin: each thread in turn issues "quantum" memory
+      // records.
+      Quantum,
+
+      // Whichever thread has the earliest current time (as set by the
+      // last Timestamp record it issued) runs until its next
+      // Timestamp record.  Ties go to the lowest thread id.
+      Timestamp
+    };
+
+  public:
+    InterleavingTraceReader(Schedule schedule = Quantum, unsigned quantum = 1);
+
+    // Opens one trace per thread; thread ids are assigned in order.
+    bool open(const std::vector<std::string>& filenames);
+
+    unsigned num_threads() const {
+      return threads.size();
+    }
+
+    // Reads out the next record from whichever thread is scheduled and
+    // then produce()s it.  Timestamp records are consumed here and not
+    // passed on.
+    const MTR::ThreadRecord& nextRecord();
+
+    // From the Producer interface.
+    void produce(const MTR::ThreadRecord& rec){
+      this->broadcast(rec);
+    }
+
+  private:
+    struct Thread{
+      TraceReader::ptr reader;
+      bool done;
+      uint64_t time;
+    };
+
+    // Picks the next thread to run, or returns false when every
+    // thread is finished.
+    bool schedule();
+
+  private:
+    const Schedule sched;
+    const unsigned quantum;
+
+    std::vector<Thread> threads;
+
+    // The running thread (or -1 when a new one must be scheduled),
+    // and how many memory records it may still issue in its quantum.
+    int current;
+    unsigned budget;
+    unsigned last;
+
+    MTR::ThreadRecord out;
+
+  public:
+    // Thrown by nextRecord() when every trace has been read out.
+    class End {};
+  };
+}
+
+#endif
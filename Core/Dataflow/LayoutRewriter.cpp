@@ -0,0 +1,123 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// LayoutRewriter.cpp
+
+// MTV headers.
+#include <Core/Dataflow/LayoutRewriter.h>
+using MTV::IdentityLayout;
+using MTV::Layout;
+using MTV::LayoutRewriter;
+using MTV::MortonLayout;
+using MTV::PadLayout;
+using MTV::SoALayout;
+using MTV::TileLayout;
+using MTV::TransposeLayout;
+
+// System headers.
+#include <sstream>
+
+namespace{
+  // Reads a whole unsigned number from a string.
+  bool parse_number(const std::string& s, uint64_t& value){
+    std::stringstream ss(s);
+    ss >> value;
+    return not ss.fail() and ss.eof();
+  }
+}
+
+Layout::ptr Layout::create(const std::string& desc, uint64_t rows, uint64_t cols, uint64_t type, std::string& error){
+  if(rows == 0 or cols == 0 or type == 0){
+    error = "error: cannot change the layout of an empty region.";
+    return Layout::ptr();
+  }
+
+  const std::string::size_type eq = desc.find('=');
+  const std::string name = desc.substr(0, eq);
+  const std::string arg = (eq == std::string::npos) ? "" : desc.substr(eq + 1);
+
+  if(name == "identity" and eq == std::string::npos){
+    return boost::make_shared<IdentityLayout>(rows, cols, type);
+  }
+  else if(name == "transpose" and eq == std::string::npos){
+    return boost::make_shared<TransposeLayout>(rows, cols, type);
+  }
+  else if(name == "morton" and eq == std::string::npos){
+    return boost::make_shared<MortonLayout>(rows, cols, type);
+  }
+  else if(name == "pad"){
+    uint64_t pad;
+    if(not parse_number(arg, pad)){
+      error = "error: pad layout requires a byte count (e.g. \"pad=64\").";
+      return Layout::ptr();
+    }
+
+    return boost::make_shared<PadLayout>(rows, cols, type, pad);
+  }
+  else if(name == "tile"){
+    const std::string::size_type x = arg.find('x');
+    uint64_t tile_rows, tile_cols;
+    if(x == std::string::npos or
+       not parse_number(arg.substr(0, x), tile_rows) or
+       not parse_number(arg.substr(x + 1), tile_cols) or
+       tile_rows == 0 or tile_cols == 0){
+      error = "error: tile layout requires positive tile dimensions (e.g. \"tile=8x8\").";
+      return Layout::ptr();
+    }
+
+    return boost::make_shared<TileLayout>(rows, cols, type, tile_rows, tile_cols);
+  }
+  else if(name == "soa"){
+    uint64_t size;
+    if(not parse_number(arg, size) or size == 0 or size % type != 0){
+      std::stringstream ss;
+      ss << "error: soa layout requires a structure size that is a positive multiple of the element size (" << type << ").";
+      error = ss.str();
+      return Layout::ptr();
+    }
+
+    return boost::make_shared<SoALayout>(rows, cols, type, size);
+  }
+
+  std::stringstream ss;
+  ss << "error: unknown layout '" << desc << "' (must be one of 'identity', 'transpose', 'pad=N', 'tile=RxC', 'morton', or 'soa=N').";
+  error = ss.str();
+  return Layout::ptr();
+}
+
+uint64_t MortonLayout::interleave(uint64_t row, uint64_t col){
+  uint64_t index = 0;
+  for(unsigned b=0; b<32; b++){
+    index |= ((col >> b) & 1) << (2*b);
+    index |= ((row >> b) & 1) << (2*b + 1);
+  }
+
+  return index;
+}
+
+void LayoutRewriter::addRegion(uint64_t base, uint64_t size, Layout::ptr layout){
+  Region r;
+  r.limit = base + size;
+  r.layout = layout;
+
+  regions[base] = r;
+}
+
+void LayoutRewriter::consume(const MTR::Record& rec){
+  if(MTR::type(rec) != MTR::Record::MType){
+    this->produce(rec);
+    return;
+  }
+
+  std::map<uint64_t, Region>::const_iterator r = regions.upper_bound(rec.addr);
+  if(r != regions.begin()){
+    --r;
+    if(rec.addr < r->second.limit){
+      MTR::Record moved(rec);
+      moved.addr = r->first + r->second.layout->offset(rec.addr - r->first);
+      this->produce(moved);
+      return;
+    }
+  }
+
+  this->produce(rec);
+}
@@ -0,0 +1,216 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// LayoutRewriter.h - A filter that rewrites the addresses falling in
+// registered regions as though the regions' data were laid out
+// differently (transposed, padded, tiled, in Morton order, or split
+// from an array of structures into a structure of arrays).
+
+#ifndef LAYOUT_REWRITER_H
+#define LAYOUT_REWRITER_H
+
+// MTV headers.
+#include <Core/Dataflow/Filter.h>
+#include <Core/Util/BoostPointers.h>
+#include <Tools/ReferenceTrace/mtrtools.h>
+
+// System headers.
+#include <map>
+#include <string>
+#include <stdint.h>
+
+namespace MTV{
+  // A layout describes where each byte of a region of rows x cols
+  // elements, each "type" bytes long and originally stored in row
+  // major order, lives in the new arrangement.
+  class Layout{
+  public:
+    BoostPointers(Layout);
+
+  public:
+    // Parses a layout description: "identity", "transpose", "pad=N"
+    // (N bytes after each row), "tile=RxC" (R x C element tiles),
+    // "morton", or "soa=N" (an array of N byte structures split into
+    // one array per "type" byte field).  Returns a null pointer and
+    // fills in "error" if the description is malformed.
+    static Layout::ptr create(const std::string& desc, uint64_t rows, uint64_t cols, uint64_t type, std::string& error);
+
+  public:
+    Layout(uint64_t rows, uint64_t cols, uint64_t type)
+      : rows(rows),
+        cols(cols),
+        type(type)
+    {}
+
+    virtual ~Layout() {}
+
+    // Maps a byte offset into the original region to its offset in
+    // the new layout.  Offsets past the last whole element are left
+    // alone.
+    uint64_t offset(uint64_t original) const {
+      const uint64_t element = original / type;
+      if(element >= rows*cols){
+        return original;
+      }
+
+      return this->element_offset(element / cols, element % cols) + original % type;
+    }
+
+    // The number of bytes the region occupies in the new layout.
+    virtual uint64_t footprint() const {
+      return rows*cols*type;
+    }
+
+  protected:
+    // The byte offset of the element at (row, col) in the new layout.
+    virtual uint64_t element_offset(uint64_t row, uint64_t col) const = 0;
+
+  protected:
+    const uint64_t rows, cols, type;
+  };
+
+  class IdentityLayout : public Layout {
+  public:
+    IdentityLayout(uint64_t rows, uint64_t cols, uint64_t type)
+      : Layout(rows, cols, type)
+    {}
+
+  protected:
+    uint64_t element_offset(uint64_t row, uint64_t col) const {
+      return (row*cols + col)*type;
+    }
+  };
+
+  // Column major order.
+  class TransposeLayout : public Layout {
+  public:
+    TransposeLayout(uint64_t rows, uint64_t cols, uint64_t type)
+      : Layout(rows, cols, type)
+    {}
+
+  protected:
+    uint64_t element_offset(uint64_t row, uint64_t col) const {
+      return (col*rows + row)*type;
+    }
+  };
+
+  // Row major order, with "pad" unused bytes after each row.
+  class PadLayout : public Layout {
+  public:
+    PadLayout(uint64_t rows, uint64_t cols, uint64_t type, uint64_t pad)
+      : Layout(rows, cols, type),
+        pitch(cols*type + pad)
+    {}
+
+    uint64_t footprint() const {
+      return rows*pitch;
+    }
+
+  protected:
+    uint64_t element_offset(uint64_t row, uint64_t col) const {
+      return row*pitch + col*type;
+    }
+
+  private:
+    const uint64_t pitch;
+  };
+
+  // Row major order of tile_rows x tile_cols tiles, each stored in row
+  // major order.  Partial tiles at the edges are padded out to full
+  // tiles.
+  class TileLayout : public Layout {
+  public:
+    TileLayout(uint64_t rows, uint64_t cols, uint64_t type, uint64_t tile_rows, uint64_t tile_cols)
+      : Layout(rows, cols, type),
+        tile_rows(tile_rows),
+        tile_cols(tile_cols),
+        tiles_across((cols + tile_cols - 1) / tile_cols),
+        tiles_down((rows + tile_rows - 1) / tile_rows)
+    {}
+
+    uint64_t footprint() const {
+      return tiles_down*tiles_across*tile_rows*tile_cols*type;
+    }
+
+  protected:
+    uint64_t element_offset(uint64_t row, uint64_t col) const {
+      const uint64_t tile = (row / tile_rows)*tiles_across + col / tile_cols;
+      return (tile*tile_rows*tile_cols + (row % tile_rows)*tile_cols + col % tile_cols)*type;
+    }
+
+  private:
+    const uint64_t tile_rows, tile_cols, tiles_across, tiles_down;
+  };
+
+  // Z-order: the element index interleaves the bits of the column
+  // (even bits) and row (odd bits).  Regions that are not square
+  // powers of two leave holes.
+  class MortonLayout : public Layout {
+  public:
+    MortonLayout(uint64_t rows, uint64_t cols, uint64_t type)
+      : Layout(rows, cols, type)
+    {}
+
+    uint64_t footprint() const {
+      return (MortonLayout::interleave(rows - 1, cols - 1) + 1)*type;
+    }
+
+  protected:
+    uint64_t element_offset(uint64_t row, uint64_t col) const {
+      return MortonLayout::interleave(row, col)*type;
+    }
+
+  private:
+    static uint64_t interleave(uint64_t row, uint64_t col);
+  };
+
+  // The region is an array of "size" byte structures whose fields are
+  // each "type" bytes; the new layout stores each field in an array of
+  // its own.  A trailing partial structure is left alone.
+  class SoALayout : public Layout {
+  public:
+    SoALayout(uint64_t rows, uint64_t cols, uint64_t type, uint64_t size)
+      : Layout(rows, cols, type),
+        size(size),
+        count(rows*cols*type / size)
+    {}
+
+  protected:
+    uint64_t element_offset(uint64_t row, uint64_t col) const {
+      const uint64_t byte = (row*cols + col)*type;
+      if(byte / size >= count){
+        return byte;
+      }
+
+      return (byte % size)*count + (byte / size)*type;
+    }
+
+  private:
+    const uint64_t size, count;
+  };
+
+  class LayoutRewriter : public Filter<MTR::Record> {
+  public:
+    BoostPointers(LayoutRewriter);
+
+  public:
+    // Rewrites the addresses in [base, base + size) with the layout
+    // (regions should not overlap).  The region keeps its base
+    // address.
+    void addRegion(uint64_t base, uint64_t size, Layout::ptr layout);
+
+    void consume(const MTR::Record& rec);
+
+  private:
+    struct Region{
+      uint64_t limit;
+      Layout::ptr layout;
+    };
+
+    // Regions, keyed by base address.
+    std::map<uint64_t, Region> regions;
+  };
+}
+
+#endif
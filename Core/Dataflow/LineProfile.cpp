@@ -0,0 +1,195 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// LineProfile.cpp
+
+// MTV headers.
+#include <Core/Dataflow/LineProfile.h>
+#include <Core/Util/Boost.h>
+#include <Core/Util/BoostForeach.h>
+using Daly::CacheEvictionRecord;
+using Daly::CacheHitRecord;
+using MTV::LineProfile;
+
+// System headers.
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace{
+  void write32(std::ostream& out, uint32_t x){
+    out.write(reinterpret_cast<const char *>(&x), sizeof(x));
+  }
+
+  bool read32(std::istream& in, uint32_t& x){
+    in.read(reinterpret_cast<char *>(&x), sizeof(x));
+    return in.good();
+  }
+
+  bool active(const uint64_t *c, unsigned n){
+    for(unsigned i=0; i<n; i++){
+      if(c[i] > 0){
+        return true;
+      }
+    }
+
+    return false;
+  }
+}
+
+LineProfile::ptr LineProfile::load(const std::string& filename, std::string& error){
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  if(!in){
+    error = "error: could not open file '" + filename + "' for reading.";
+    return LineProfile::ptr();
+  }
+
+  char m[8];
+  uint32_t version, levels, count, zero;
+  if(not in.read(m, sizeof(m)) or std::memcmp(m, magic(), sizeof(m)) != 0){
+    error = "error: file '" + filename + "' is not a line profile.";
+    return LineProfile::ptr();
+  }
+
+  if(not read32(in, version) or not read32(in, levels) or not read32(in, count) or not read32(in, zero)){
+    error = "error: line profile '" + filename + "' is truncated.";
+    return LineProfile::ptr();
+  }
+
+  if(version != Version){
+    std::stringstream ss;
+    ss << "error: line profile '" << filename << "' has version " << version << " (expected " << Version << ").";
+    error = ss.str();
+    return LineProfile::ptr();
+  }
+
+  LineProfile::ptr profile = boost::make_shared<LineProfile>(levels);
+  for(uint32_t i=0; i<count; i++){
+    uint32_t file, line;
+    if(not read32(in, file) or not read32(in, line)){
+      error = "error: line profile '" + filename + "' is truncated.";
+      return LineProfile::ptr();
+    }
+
+    uint64_t *c = &profile->unattributed[0];
+    if(file != NoFile){
+      profile->grow(file, line);
+      c = &profile->files[file][line*profile->stride];
+    }
+
+    if(not in.read(reinterpret_cast<char *>(c), profile->stride*sizeof(c[0]))){
+      error = "error: line profile '" + filename + "' is truncated.";
+      return LineProfile::ptr();
+    }
+  }
+
+  return profile;
+}
+
+LineProfile::LineProfile(unsigned num_levels)
+  : levels(num_levels),
+    stride(Misses + num_levels),
+    unattributed(stride, 0),
+    curfile(NoFile),
+    curline(0),
+    snapperiod(0),
+    references(0)
+{}
+
+void LineProfile::grow(uint32_t file, uint32_t line){
+  if(file >= files.size()){
+    files.resize(file + 1);
+  }
+
+  std::vector<uint64_t>& f = files[file];
+  const size_t need = (static_cast<size_t>(line) + 1)*stride;
+  if(f.size() < need){
+    f.resize(need, 0);
+  }
+}
+
+void LineProfile::consume(const MTR::Record& rec){
+  if(MTR::type(rec) != MTR::Record::LType){
+    return;
+  }
+
+  this->grow(rec.file, rec.line);
+  curfile = rec.file;
+  curline = rec.line;
+}
+
+void LineProfile::consume(const CacheAccessRecord& rec){
+  uint64_t *c = this->current();
+
+  c[References]++;
+
+  // The access missed in every level above the lowest one it hit (a
+  // store's write-through records would otherwise count as misses
+  // too).
+  if(rec.hits.size() > 0){
+    unsigned hit = rec.hits[0].L;
+    foreach(const CacheHitRecord& h, rec.hits){
+      hit = std::min(hit, h.L);
+    }
+
+    for(unsigned L=0; L<hit and L<levels; L++){
+      c[Misses + L]++;
+    }
+  }
+
+  // Count the blocks this access pushed out of a level (not those
+  // moving up through an exclusive hierarchy).
+  foreach(const CacheEvictionRecord& e, rec.evictions){
+    if(e.kind == CacheEvictionRecord::Swap and e.dest < e.L){
+      continue;
+    }
+
+    c[Evictions]++;
+    if(e.writeback and e.dirty){
+      c[Writebacks]++;
+    }
+  }
+
+  if(snapperiod > 0 and ++references % snapperiod == 0){
+    this->save(snapfile);
+  }
+}
+
+bool LineProfile::save(const std::string& filename) const {
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  if(!out){
+    return false;
+  }
+
+  uint32_t count = active(&unattributed[0], stride) ? 1 : 0;
+  for(uint32_t f=0; f<files.size(); f++){
+    for(uint32_t l=0; l<this->num_lines(f); l++){
+      count += active(this->counters(f, l), stride) ? 1 : 0;
+    }
+  }
+
+  out.write(magic(), 8);
+  write32(out, Version);
+  write32(out, levels);
+  write32(out, count);
+  write32(out, 0);
+
+  if(active(&unattributed[0], stride)){
+    write32(out, NoFile);
+    write32(out, 0);
+    out.write(reinterpret_cast<const char *>(&unattributed[0]), stride*sizeof(uint64_t));
+  }
+
+  for(uint32_t f=0; f<files.size(); f++){
+    for(uint32_t l=0; l<this->num_lines(f); l++){
+      const uint64_t *c = this->counters(f, l);
+      if(active(c, stride)){
+        write32(out, f);
+        write32(out, l);
+        out.write(reinterpret_cast<const char *>(c), stride*sizeof(uint64_t));
+      }
+    }
+  }
+
+  return out.good();
+}
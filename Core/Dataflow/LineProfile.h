@@ -0,0 +1,123 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// LineProfile.h - Accepts trace records and cache simulation results,
+// and accumulates, for each source line, the references made, the
+// misses at each cache level, and the evictions and writebacks
+// caused.  The counts live in flat arrays indexed by file number (as
+// assigned by the trace's file table) and line number, and are
+// written out as a single compact profile.
+
+#ifndef LINE_PROFILE_H
+#define LINE_PROFILE_H
+
+// MTV headers.
+#include <Core/Dataflow/CacheAccessRecord.h>
+#include <Core/Dataflow/Consumer.h>
+#include <Core/Util/BoostPointers.h>
+#include <Tools/ReferenceTrace/mtrtools.h>
+
+// System headers.
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace MTV{
+  class LineProfile : public Consumer<MTR::Record>,
+                      public Consumer<CacheAccessRecord> {
+  public:
+    BoostPointers(LineProfile);
+
+  public:
+    // The counters kept for each line; the misses at level L are
+    // counter Misses + L.
+    enum Counter{
+      References,
+      Evictions,
+      Writebacks,
+      Misses
+    };
+
+    // The file number of the accesses made before the first line
+    // record.
+    static const uint32_t NoFile = 0xffffffff;
+
+    // The saved file is the magic string, then four 32-bit fields
+    // (version, level count, line count, and zero), then, for each
+    // line with any activity, its 32-bit file and line numbers
+    // followed by its counters as 64-bit values.
+    static const char *magic(){
+      return "MTVXLPRF";
+    }
+
+    static const uint32_t Version = 1;
+
+    // Reads a saved profile, returning a null pointer and filling in
+    // "error" on failure.
+    static LineProfile::ptr load(const std::string& filename, std::string& error);
+
+  public:
+    LineProfile(unsigned num_levels);
+
+    // Rewrites the profile to "filename" after every "period" memory
+    // references, so a long run can be inspected while it is going.
+    void setSnapshot(const std::string& filename, uint64_t period){
+      snapfile = filename;
+      snapperiod = period;
+    }
+
+    void consume(const MTR::Record& rec);
+    void consume(const CacheAccessRecord& rec);
+
+    bool save(const std::string& filename) const;
+
+    unsigned num_levels() const {
+      return levels;
+    }
+
+    unsigned num_counters() const {
+      return stride;
+    }
+
+    unsigned num_files() const {
+      return files.size();
+    }
+
+    unsigned num_lines(uint32_t file) const {
+      return file < files.size() ? files[file].size() / stride : 0;
+    }
+
+    // The counters for a line (a null pointer for lines never seen).
+    // File NoFile, line 0 holds the unattributed accesses.
+    const uint64_t *counters(uint32_t file, uint32_t line) const {
+      if(file == NoFile){
+        return line == 0 ? &unattributed[0] : 0;
+      }
+
+      return line < this->num_lines(file) ? &files[file][line*stride] : 0;
+    }
+
+  private:
+    uint64_t *current(){
+      return curfile == NoFile ? &unattributed[0] : &files[curfile][curline*stride];
+    }
+
+    // Makes room for a line's counters.
+    void grow(uint32_t file, uint32_t line);
+
+  private:
+    const unsigned levels, stride;
+
+    // One array of counters per file, "stride" counters per line.
+    std::vector<std::vector<uint64_t> > files;
+    std::vector<uint64_t> unattributed;
+
+    uint32_t curfile, curline;
+
+    std::string snapfile;
+    uint64_t snapperiod, references;
+  };
+}
+
+#endif
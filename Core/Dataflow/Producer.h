@@ -13,6 +13,7 @@
 
 // MTV headers.
 #include <Core/Dataflow/Consumer.h>
+#include <Core/Dataflow/Instrumentation.h>
 #include <Core/Util/BoostForeach.h>
 #include <Core/Util/BoostPointers.h>
 
@@ -79,12 +80,37 @@ namespace MTV{
       // in the produce() method to actually push the data out after
       // any processing that may be required.
 
+      if(Instrumentation::active){
+        this->instrumentedBroadcast(out);
+        return;
+      }
+
       foreach(typename Consumer<Out>::ptr c, consumers){
         c->print();
         c->consume(out);
       }
     }
 
+  private:
+    void instrumentedBroadcast(const Out& out){
+      Instrumentation::node(dynamic_cast<const void *>(this), typeid(*this))->out++;
+
+      Instrumentation::Scope scope;
+      foreach(typename Consumer<Out>::ptr c, consumers){
+        Instrumentation::Node *node = Instrumentation::node(dynamic_cast<const void *>(c.get()), typeid(*c));
+        node->in++;
+
+        c->print();
+        if(scope.sampled()){
+          Instrumentation::Timer timer(node);
+          c->consume(out);
+        }
+        else{
+          c->consume(out);
+        }
+      }
+    }
+
   protected:
     // std::vector<typename Consumer<Out>::ptr> consumers;
     std::list<typename Consumer<Out>::ptr> consumers;
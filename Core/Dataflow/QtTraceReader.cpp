@@ -0,0 +1,116 @@
+// Copyright 2010 A.N.M. Imroz Choudhury, all rights reserved
+//
+// QtTraceReader.cpp
+
+// MTV includes.
+#include <Core/Dataflow/QtTraceReader.h>
+using MTV::Clock;
+using MTV::ClockedTraceReader;
+using MTV::QtTraceReader;
+using MTV::TimedTraceReader;
+using MTV::TraceReader;
+
+// Boost includes.
+#include <boost/bind.hpp>
+
+// System includes.
+#include <iostream>
+
+QtTraceReader::QtTraceReader(const size_t bufsize)
+  : TraceReader(bufsize)
+{
+  // Forward the trace position to the Qt signal.
+  this->setProgressCallback(boost::bind(&QtTraceReader::reportProgress, this, _1));
+}
+
+TimedTraceReader::TimedTraceReader(const size_t bufsize)
+  : QtTraceReader(bufsize),
+    timer(new QTimer(0))
+{
+  // Have the reader produce a new record whenever the timer times
+  // out.
+  QObject::connect(timer.get(), SIGNAL(timeout()), this, SLOT(timeout()));
+}
+
+void TimedTraceReader::timeout(){
+  try{
+    // Produce records until a memory record appears.
+    //
+    // TODO(choudhury): this behavior ought to be controllable.
+    while(MTR::type(this->nextRecord()) != MTR::Record::MType){
+      // Empty while loop.
+    }
+  }
+  catch(TraceReader::End){
+    std::cout << "Trace end reached!!" << std::endl;
+    timer->stop();
+    exit(0);
+  }
+}
+
+void TimedTraceReader::start(){
+  timer->start();
+}
+
+void TimedTraceReader::stop(){
+  timer->stop();
+}
+
+void TimedTraceReader::setInterval(int msec){
+  timer->setInterval(msec);
+}
+
+ClockedTraceReader::ClockedTraceReader(Clock::ptr clock, const size_t bufsize)
+  : QtTraceReader(bufsize),
+    timer(new QTimer(0)),
+    clock(clock),
+    interval(0.0),
+    last(0.0)
+{
+  // Have the reader produce a new record whenever the timer times
+  // out.
+  QObject::connect(timer.get(), SIGNAL(timeout()), this, SLOT(timeout()));
+
+  // Check the clock as often as possible.
+  timer->setInterval(1);
+}
+
+bool ClockedTraceReader::advance(){
+  if(clock->noww() - last > interval){
+    try{
+      // Produce records until a memory record appears.
+      //
+      // TODO(choudhury): this behavior ought to be controllable.
+      while(MTR::type(this->nextRecord()) != MTR::Record::MType){
+        // Empty while loop.
+      }
+    }
+    catch(TraceReader::End){
+      return false;
+    }
+
+    last = clock->noww();
+  }
+
+  return true;
+}
+
+void ClockedTraceReader::timeout(){
+  if(!this->advance()){
+    std::cout << "Trace end reached!!" << std::endl;
+    timer->stop();
+    exit(0);
+  }
+}
+
+void ClockedTraceReader::start(){
+  timer->start();
+}
+
+void ClockedTraceReader::stop(){
+  timer->stop();
+}
+
+void ClockedTraceReader::setInterval(int msec){
+  interval = 0.001*msec;
+}
@@ -0,0 +1,93 @@
+// -*- c++ -*-
+//
+// Copyright 2010 A.N.M. Imroz Choudhury, all rights reserved
+//
+// QtTraceReader.h - Thin Qt adapters over TraceReader: a QObject that
+// reports the trace position as a signal, and timer-driven readers
+// for the GUI applications.
+
+#ifndef QT_TRACE_READER_H
+#define QT_TRACE_READER_H
+
+// MTV headers.
+#include <Core/Dataflow/TraceReader.h>
+#include <Core/Util/BoostPointers.h>
+#include <Core/Util/Timing.h>
+
+// Qt headers.
+#include <QtCore>
+
+namespace MTV{
+  class QtTraceReader : public QObject,
+                        public TraceReader {
+    Q_OBJECT;
+
+  public:
+    BoostPointers(QtTraceReader);
+
+  public:
+    QtTraceReader(const size_t bufsize = TraceReader::default_bufsize);
+
+  signals:
+    void onTraceRecord(uint64_t);
+
+  private:
+    void reportProgress(uint64_t pos){
+      emit onTraceRecord(pos);
+    }
+  };
+
+  class TimedTraceReader : public QtTraceReader {
+    Q_OBJECT;
+
+  public:
+    BoostPointers(TimedTraceReader);
+
+  public:
+    TimedTraceReader(const size_t bufsize = TraceReader::default_bufsize);
+
+  public slots:
+    // This slot can be engaged to let the object know it should
+    // produce a new record.
+    void timeout();
+
+    // Playback control.
+    void start();
+    void stop();
+    void setInterval(int msec);
+
+  private:
+    boost::shared_ptr<QTimer> timer;
+  };
+
+  class ClockedTraceReader : public QtTraceReader {
+    Q_OBJECT;
+
+  public:
+    BoostPointers(ClockedTraceReader);
+
+  public:
+    ClockedTraceReader(Clock::ptr clock, const size_t bufsize = TraceReader::default_bufsize);
+
+    // Consults the clock and produces records if the interval has
+    // elapsed, just as timeout() does, but returns false at the end
+    // of the trace instead of exiting.  This lets a caller drive the
+    // reader from its own loop (e.g. when rendering headlessly).
+    bool advance();
+
+  public slots:
+    void timeout();
+
+    void start();
+    void stop();
+    void setInterval(int msec);
+
+  private:
+    boost::shared_ptr<QTimer> timer;
+    Clock::ptr clock;
+    float interval;
+    float last;
+  };
+}
+
+#endif
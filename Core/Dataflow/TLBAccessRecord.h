@@ -0,0 +1,35 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// TLBAccessRecord.h - A record of where the translation for an
+// accessed address was found.
+
+#ifndef TLB_ACCESS_RECORD_H
+#define TLB_ACCESS_RECORD_H
+
+// MTV includes.
+#include <Tools/NewCacheSimulator/TLB.h>
+#include <Tools/ReferenceTrace/mtrtools.h>
+
+namespace MTV{
+  struct TLBAccessRecord{
+    TLBAccessRecord(MTR::addr_t addr, unsigned level, unsigned walk_refs, TLB::PageSize page)
+      : addr(addr),
+        level(level),
+        walk_refs(walk_refs),
+        page(page)
+    {}
+
+    MTR::addr_t addr;
+
+    // The TLB level holding the translation (the number of TLB levels
+    // for a page walk), and the memory references the walk made.
+    unsigned level;
+    unsigned walk_refs;
+
+    TLB::PageSize page;
+  };
+}
+
+#endif
@@ -0,0 +1,22 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// TLBLevelCounter.cpp
+
+// MTV headers.
+#include <Core/Dataflow/TLBLevelCounter.h>
+using MTV::TLBLevelCounter;
+
+TLBLevelCounter::~TLBLevelCounter(){
+  out.flush();
+  out.close();
+}
+
+bool TLBLevelCounter::open(const std::string& filename){
+  out.open(filename.c_str());
+  return out.good();
+}
+
+void TLBLevelCounter::consume(const TLBAccessRecord& rec){
+  // Same format as HitLevelCounter: one binary level per reference.
+  out.write(reinterpret_cast<const char *>(&rec.level), sizeof(rec.level));
+}
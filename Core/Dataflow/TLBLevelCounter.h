@@ -0,0 +1,37 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// TLBLevelCounter.h - Consumes TLB access records and writes out the
+// TLB level in which each reference's translation was found.
+
+#ifndef TLB_LEVEL_COUNTER_H
+#define TLB_LEVEL_COUNTER_H
+
+// MTV headers.
+#include <Core/Dataflow/Consumer.h>
+#include <Core/Dataflow/TLBAccessRecord.h>
+#include <Core/Util/BoostPointers.h>
+
+// System headers.
+#include <fstream>
+#include <string>
+
+namespace MTV{
+  class TLBLevelCounter : public Consumer<TLBAccessRecord> {
+  public:
+    BoostPointers(TLBLevelCounter);
+
+  public:
+    ~TLBLevelCounter();
+
+    bool open(const std::string& filename);
+
+    void consume(const TLBAccessRecord& rec);
+
+  private:
+    std::ofstream out;
+  };
+}
+
+#endif
@@ -0,0 +1,51 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// TLBSimulator.h - A filter that runs the addresses of memory records
+// through a TLB model, producing a record of each translation.  It
+// sits alongside a CacheSimulator, consuming the same records.
+
+#ifndef TLB_SIMULATOR_H
+#define TLB_SIMULATOR_H
+
+// MTV includes.
+#include <Core/Dataflow/Filter.h>
+#include <Core/Dataflow/TLBAccessRecord.h>
+#include <Core/Util/BoostPointers.h>
+#include <Tools/NewCacheSimulator/TLB.h>
+#include <Tools/ReferenceTrace/mtrtools.h>
+
+namespace MTV{
+  class TLBSimulator : public Filter<MTR::Record, TLBAccessRecord> {
+  public:
+    BoostPointers(TLBSimulator);
+
+  public:
+    TLBSimulator(TLB::ptr tlb)
+      : tlb(tlb)
+    {}
+
+    TLB::const_ptr getTLB() const { return tlb; }
+
+    // Consumer interface.
+    void consume(const MTR::Record& rec){
+      switch(rec.code){
+      case MTR::Record::Read:
+      case MTR::Record::Write:
+        break;
+
+      default:
+        return;
+      }
+
+      const unsigned L = tlb->access(rec.addr);
+      this->produce(TLBAccessRecord(rec.addr, L, tlb->last_walk_refs(), tlb->last_page_size()));
+    }
+
+  private:
+    TLB::ptr tlb;
+  };
+}
+
+#endif
@@ -0,0 +1,302 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// TraceIndex.cpp
+
+// MTV headers.
+#include <Core/Dataflow/TraceIndex.h>
+#include <Core/Dataflow/TraceReader.h>
+#include <Core/Util/BoostForeach.h>
+using MTV::TraceIndex;
+using MTV::TraceReader;
+
+// System headers.
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+const uint32_t TraceIndex::Version;
+const uint64_t TraceIndex::CheckpointInterval;
+const uint64_t TraceIndex::NoPosition;
+
+namespace{
+  template<typename T>
+  void put(std::ostream& out, const T& x){
+    out.write(reinterpret_cast<const char *>(&x), sizeof(x));
+  }
+
+  template<typename T>
+  bool get(std::istream& in, T& x){
+    in.read(reinterpret_cast<char *>(&x), sizeof(x));
+    return in.good();
+  }
+}
+
+TraceIndex::TraceIndex(){
+  this->clear();
+}
+
+void TraceIndex::clear(){
+  trace_size = trace_mtime = 0;
+  records = 0;
+  std::fill(counts, counts + NumCodes, 0);
+  low = ~static_cast<MTR::addr_t>(0);
+  high = 0;
+  first_line = last_line = NoPosition;
+  funcs.clear();
+  lines.clear();
+}
+
+bool TraceIndex::stamp(const std::string& filename, uint64_t& size, uint64_t& mtime){
+  struct stat st;
+  if(stat(filename.c_str(), &st) != 0){
+    return false;
+  }
+
+  size = st.st_size;
+  mtime = st.st_mtime;
+  return true;
+}
+
+void TraceIndex::add(const MTR::Record& rec){
+  const uint64_t pos = records++;
+
+  if(static_cast<unsigned>(rec.code) < NumCodes){
+    counts[rec.code]++;
+  }
+
+  switch(rec.code){
+  case MTR::Record::Read:
+  case MTR::Record::Write:
+    low = std::min(low, rec.addr);
+    high = std::max(high, rec.addr);
+    break;
+
+  case MTR::Record::LineNumber:
+    {
+      if(first_line == NoPosition){
+        first_line = pos;
+      }
+      last_line = pos;
+
+      std::map<std::pair<uint32_t, uint32_t>, Line>::iterator i = lines.find(std::make_pair(rec.file, rec.line));
+      if(i == lines.end()){
+        const Line l = {pos, 0};
+        i = lines.insert(std::make_pair(std::make_pair(rec.file, rec.line), l)).first;
+      }
+      i->second.visits++;
+    }
+    break;
+
+  case MTR::Record::FunctionEntry:
+    {
+      Function& f = funcs[rec.addr];
+      if(f.entries % CheckpointInterval == 0){
+        f.checkpoints.push_back(pos);
+      }
+      f.entries++;
+    }
+    break;
+
+  case MTR::Record::FunctionExit:
+    funcs[rec.addr].exits++;
+    break;
+
+  default:
+    break;
+  }
+}
+
+bool TraceIndex::build(const std::string& tracefile){
+  this->clear();
+
+  if(!stamp(tracefile, trace_size, trace_mtime)){
+    *this << "could not open trace file '" << tracefile << "'";
+    return false;
+  }
+
+  TraceReader reader(256*1024);
+  if(!reader.open(tracefile)){
+    *this << "could not open trace file '" << tracefile << "'";
+    return false;
+  }
+
+  try{
+    while(true){
+      this->add(reader.nextRecord());
+    }
+  }
+  catch(TraceReader::End){}
+
+  return true;
+}
+
+bool TraceIndex::save(const std::string& filename) const {
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  if(!out){
+    return false;
+  }
+
+  out.write(magic(), 8);
+  put(out, Version);
+  put(out, static_cast<uint32_t>(CheckpointInterval));
+  put(out, trace_size);
+  put(out, trace_mtime);
+  put(out, records);
+  for(unsigned i=0; i<NumCodes; i++){
+    put(out, counts[i]);
+  }
+  put(out, low);
+  put(out, high);
+  put(out, first_line);
+  put(out, last_line);
+
+  put(out, static_cast<uint64_t>(funcs.size()));
+  for(std::map<uint64_t, Function>::const_iterator i = funcs.begin(); i != funcs.end(); ++i){
+    put(out, i->first);
+    put(out, i->second.entries);
+    put(out, i->second.exits);
+    put(out, static_cast<uint64_t>(i->second.checkpoints.size()));
+    foreach(uint64_t pos, i->second.checkpoints){
+      put(out, pos);
+    }
+  }
+
+  put(out, static_cast<uint64_t>(lines.size()));
+  for(std::map<std::pair<uint32_t, uint32_t>, Line>::const_iterator i = lines.begin(); i != lines.end(); ++i){
+    put(out, i->first.first);
+    put(out, i->first.second);
+    put(out, i->second.first);
+    put(out, i->second.visits);
+  }
+
+  return out.good();
+}
+
+bool TraceIndex::read(std::istream& in){
+  this->clear();
+
+  char m[8];
+  uint32_t version, interval;
+  in.read(m, sizeof(m));
+  if(!in or std::memcmp(m, magic(), sizeof(m)) != 0){
+    return false;
+  }
+
+  if(!get(in, version) or !get(in, interval) or version != Version or interval != CheckpointInterval){
+    return false;
+  }
+
+  bool ok = get(in, trace_size) and get(in, trace_mtime) and get(in, records);
+  for(unsigned i=0; i<NumCodes; i++){
+    ok = ok and get(in, counts[i]);
+  }
+  ok = ok and get(in, low) and get(in, high) and get(in, first_line) and get(in, last_line);
+
+  uint64_t n = 0;
+  ok = ok and get(in, n);
+  for(uint64_t i=0; ok and i<n; i++){
+    uint64_t addr, num;
+    ok = get(in, addr);
+
+    Function& f = funcs[addr];
+    ok = ok and get(in, f.entries) and get(in, f.exits) and get(in, num);
+    for(uint64_t j=0; ok and j<num; j++){
+      uint64_t pos;
+      ok = get(in, pos);
+      f.checkpoints.push_back(pos);
+    }
+  }
+
+  ok = ok and get(in, n);
+  for(uint64_t i=0; ok and i<n; i++){
+    uint32_t file, line;
+    Line l;
+    ok = get(in, file) and get(in, line) and get(in, l.first) and get(in, l.visits);
+    if(ok){
+      lines[std::make_pair(file, line)] = l;
+    }
+  }
+
+  if(!ok){
+    this->clear();
+  }
+
+  return ok;
+}
+
+bool TraceIndex::load(const std::string& filename){
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  if(!in){
+    *this << "could not open index file '" << filename << "'";
+    return false;
+  }
+
+  if(!this->read(in)){
+    *this << "file '" << filename << "' is not a trace index, or is truncated";
+    return false;
+  }
+
+  return true;
+}
+
+bool TraceIndex::open(const std::string& tracefile){
+  uint64_t size, mtime;
+  if(!stamp(tracefile, size, mtime)){
+    *this << "could not open trace file '" << tracefile << "'";
+    return false;
+  }
+
+  // Use the sidecar if it was made from this version of the trace.
+  const std::string indexfile = sidecar(tracefile);
+  std::ifstream in(indexfile.c_str(), std::ios::binary);
+  if(in and this->read(in) and trace_size == size and trace_mtime == mtime){
+    return true;
+  }
+
+  if(!this->build(tracefile)){
+    return false;
+  }
+
+  // NOTE(choudhury): failing to write the sidecar (e.g. because the
+  // trace lives in a read-only directory) only costs the next run a
+  // rebuild.
+  this->save(indexfile);
+  return true;
+}
+
+uint64_t TraceIndex::invocations(uint64_t function) const {
+  std::map<uint64_t, Function>::const_iterator i = funcs.find(function);
+  return i != funcs.end() ? i->second.entries : 0;
+}
+
+bool TraceIndex::function_checkpoint(uint64_t function, uint64_t n, uint64_t& pos, uint64_t& entry) const {
+  std::map<uint64_t, Function>::const_iterator i = funcs.find(function);
+  if(i == funcs.end() or n >= i->second.entries){
+    return false;
+  }
+
+  const uint64_t c = n / CheckpointInterval;
+  pos = i->second.checkpoints[c];
+  entry = c*CheckpointInterval;
+  return true;
+}
+
+uint64_t TraceIndex::first_visit(uint32_t file, uint32_t line) const {
+  std::map<std::pair<uint32_t, uint32_t>, Line>::const_iterator i = lines.find(std::make_pair(file, line));
+  return i != lines.end() ? i->second.first : NoPosition;
+}
+
+uint64_t TraceIndex::visits(uint32_t file, uint32_t line) const {
+  std::map<std::pair<uint32_t, uint32_t>, Line>::const_iterator i = lines.find(std::make_pair(file, line));
+  return i != lines.end() ? i->second.visits : 0;
+}
+
+std::vector<uint64_t> TraceIndex::functions() const {
+  std::vector<uint64_t> f;
+  for(std::map<uint64_t, Function>::const_iterator i = funcs.begin(); i != funcs.end(); ++i){
+    f.push_back(i->first);
+  }
+
+  return f;
+}
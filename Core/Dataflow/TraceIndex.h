@@ -0,0 +1,151 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// TraceIndex.h - A summary of a reference trace, built in one pass
+// and kept in a sidecar file next to the trace: the record count, the
+// count of each record code, the bounds of the memory addresses, and
+// where functions are entered and source lines are first visited, so
+// that a TraceReader can seek straight to them.
+
+#ifndef TRACE_INDEX_H
+#define TRACE_INDEX_H
+
+// MTV headers.
+#include <Core/Util/BoostPointers.h>
+#include <Core/Util/ErrorMessage.h>
+#include <Tools/ReferenceTrace/mtrtools.h>
+
+// System headers.
+#include <istream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace MTV{
+  class TraceIndex : public ErrorMessage {
+  public:
+    BoostPointers(TraceIndex);
+
+  public:
+    static const char *magic(){
+      return "MTVXTIDX";
+    }
+
+    static const uint32_t Version = 1;
+
+    // Every "CheckpointInterval"-th entry to each function has its
+    // position recorded; the entries between checkpoints are found by
+    // scanning forward from the one before.
+    static const uint64_t CheckpointInterval = 64;
+
+    // Returned for positions of records that never occur.
+    static const uint64_t NoPosition = ~static_cast<uint64_t>(0);
+
+    // The conventional name of a trace's index file.
+    static std::string sidecar(const std::string& tracefile){
+      return tracefile + ".idx";
+    }
+
+  public:
+    TraceIndex();
+
+    // Reads the whole trace and indexes it.
+    bool build(const std::string& tracefile);
+
+    bool load(const std::string& filename);
+    bool save(const std::string& filename) const;
+
+    // Loads the trace's sidecar index if there is one and it is up to
+    // date, and otherwise builds the index and (if possible) saves it
+    // as the sidecar.
+    bool open(const std::string& tracefile);
+
+    // Queries.
+    uint64_t num_records() const {
+      return records;
+    }
+
+    uint64_t count(MTR::Record::Code code) const {
+      return static_cast<unsigned>(code) < NumCodes ? counts[code] : 0;
+    }
+
+    // The lowest and highest addresses of the memory records (low >
+    // high if there are none).
+    MTR::addr_t low_address() const {
+      return low;
+    }
+
+    MTR::addr_t high_address() const {
+      return high;
+    }
+
+    // The positions of the first and last LineNumber records.
+    uint64_t first_line_record() const {
+      return first_line;
+    }
+
+    uint64_t last_line_record() const {
+      return last_line;
+    }
+
+    // The number of times a function was entered.
+    uint64_t invocations(uint64_t function) const;
+
+    // Finds the latest checkpoint at or before the nth (counting from
+    // 0) entry to a function: its position in the trace, and which
+    // entry it is.  Returns false if the function was entered n times
+    // or fewer.
+    bool function_checkpoint(uint64_t function, uint64_t n, uint64_t& pos, uint64_t& entry) const;
+
+    // The position of the first visit to a source line, and the number
+    // of visits (NoPosition and zero if the line never occurs).
+    uint64_t first_visit(uint32_t file, uint32_t line) const;
+    uint64_t visits(uint32_t file, uint32_t line) const;
+
+    // The functions entered in the trace, by address.
+    std::vector<uint64_t> functions() const;
+
+  private:
+    void clear();
+    void add(const MTR::Record& rec);
+
+    // Reads an index without reporting errors.
+    bool read(std::istream& in);
+
+    // The size and modification time of a file, to tell whether an
+    // index is stale.
+    static bool stamp(const std::string& filename, uint64_t& size, uint64_t& mtime);
+
+  private:
+    enum { NumCodes = MTR::Record::Timestamp + 1 };
+
+    struct Function{
+      Function()
+        : entries(0),
+          exits(0)
+      {}
+
+      uint64_t entries, exits;
+      std::vector<uint64_t> checkpoints;
+    };
+
+    struct Line{
+      uint64_t first, visits;
+    };
+
+    uint64_t trace_size, trace_mtime;
+
+    uint64_t records;
+    uint64_t counts[NumCodes];
+    MTR::addr_t low, high;
+    uint64_t first_line, last_line;
+
+    std::map<uint64_t, Function> funcs;
+    std::map<std::pair<uint32_t, uint32_t>, Line> lines;
+  };
+}
+
+#endif
@@ -0,0 +1,142 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// TraceReadAhead.cpp
+
+// MTV headers.
+#include <Core/Dataflow/TraceReadAhead.h>
+using MTV::TraceReadAhead;
+
+// Boost headers.
+#include <boost/bind.hpp>
+
+// System headers.
+#include <fcntl.h>
+#include <unistd.h>
+
+TraceReadAhead::TraceReadAhead(std::streambuf *source, unsigned depth, size_t chunksize, const std::string& rawfile, std::streamoff offset)
+  : source(source),
+    chunksize(chunksize),
+    ring(depth + 1),
+    head(0),
+    tail(0),
+    filled(0),
+    holding(false),
+    finished(false),
+    stopping(false),
+    fd(-1),
+    position(offset),
+    advised(offset)
+{
+  for(unsigned i=0; i<ring.size(); i++){
+    ring[i].data.resize(chunksize);
+    ring[i].size = 0;
+  }
+
+  if(rawfile != ""){
+    fd = ::open(rawfile.c_str(), O_RDONLY);
+  }
+
+  thread = boost::thread(boost::bind(&TraceReadAhead::run, this));
+}
+
+TraceReadAhead::~TraceReadAhead(){
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    stopping = true;
+    space.notify_all();
+  }
+  thread.join();
+
+  if(fd >= 0){
+    ::close(fd);
+  }
+}
+
+void TraceReadAhead::advise(std::streamoff end){
+#ifdef POSIX_FADV_WILLNEED
+  if(fd >= 0 and end > advised){
+    posix_fadvise(fd, advised, end - advised, POSIX_FADV_WILLNEED);
+    advised = end;
+  }
+#endif
+}
+
+void TraceReadAhead::run(){
+  while(true){
+    unsigned slot;
+    {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      while(filled == ring.size() and !stopping){
+        space.wait(lock);
+      }
+
+      if(stopping){
+        return;
+      }
+
+      slot = tail;
+    }
+
+    // Keep the kernel a full ring ahead of the chunk being read.
+    this->advise(position + static_cast<std::streamoff>(ring.size()*chunksize));
+
+    // NOTE(choudhury): the slot at "tail" belongs to this thread until
+    // it is published, so it is filled without holding the lock.  A
+    // decompression error ends the trace, just as it would when
+    // reading the stream directly.
+    std::streamsize n = 0;
+    try{
+      n = source->sgetn(&ring[slot].data[0], chunksize);
+    }
+    catch(...){}
+    position += n;
+
+    boost::lock_guard<boost::mutex> lock(mutex);
+    if(n > 0){
+      ring[slot].size = n;
+      tail = (tail + 1) % ring.size();
+      filled++;
+    }
+
+    // A short read means the source is exhausted.
+    if(n < static_cast<std::streamsize>(chunksize)){
+      finished = true;
+    }
+
+    available.notify_one();
+    if(finished){
+      return;
+    }
+  }
+}
+
+TraceReadAhead::int_type TraceReadAhead::underflow(){
+  if(gptr() < egptr()){
+    return traits_type::to_int_type(*gptr());
+  }
+
+  boost::unique_lock<boost::mutex> lock(mutex);
+
+  // Give the chunk just read back to the thread.
+  if(holding){
+    head = (head + 1) % ring.size();
+    filled--;
+    holding = false;
+    space.notify_one();
+  }
+
+  while(filled == 0 and !finished){
+    available.wait(lock);
+  }
+
+  if(filled == 0){
+    setg(0, 0, 0);
+    return traits_type::eof();
+  }
+
+  char *data = &ring[head].data[0];
+  setg(data, data, data + ring[head].size);
+  holding = true;
+
+  return traits_type::to_int_type(*gptr());
+}
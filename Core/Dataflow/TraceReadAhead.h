@@ -0,0 +1,83 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// TraceReadAhead.h - A stream buffer that reads (and, for gzipped
+// traces, decompresses) a trace on a background thread, keeping a
+// ring of large chunks filled ahead of the reader so that decoding
+// overlaps with whatever consumes the records.
+
+#ifndef TRACE_READ_AHEAD_H
+#define TRACE_READ_AHEAD_H
+
+// MTV headers.
+#include <Core/Util/BoostPointers.h>
+
+// Boost headers.
+#include <boost/thread.hpp>
+
+// System headers.
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace MTV{
+  class TraceReadAhead : public std::streambuf {
+  public:
+    BoostPointers(TraceReadAhead);
+
+  public:
+    // Starts reading "source" in chunks of "chunksize" bytes, keeping
+    // up to "depth" chunks ready beyond the one being read.  If
+    // "rawfile" names the (uncompressed) file behind "source", and
+    // "offset" is where in it reading starts, the kernel is also asked
+    // to prefetch the file ahead of the ring.
+    TraceReadAhead(std::streambuf *source, unsigned depth, size_t chunksize, const std::string& rawfile = "", std::streamoff offset = 0);
+
+    // Stops the background thread.  Anything still in the ring is
+    // dropped.
+    ~TraceReadAhead();
+
+  protected:
+    // From the std::streambuf interface: hands the next filled chunk
+    // to the reader.
+    int_type underflow();
+
+  private:
+    // The background thread.
+    void run();
+
+    // Asks the kernel to prefetch the raw file up to "end".
+    void advise(std::streamoff end);
+
+  private:
+    struct Chunk{
+      std::vector<char> data;
+      std::streamsize size;
+    };
+
+    std::streambuf *source;
+    const size_t chunksize;
+
+    // The ring: the reader consumes from "head" (and keeps that chunk
+    // while its get area points into it), the thread fills at "tail",
+    // and "filled" counts the chunks in between, including the one
+    // being read.
+    std::vector<Chunk> ring;
+    unsigned head, tail, filled;
+    bool holding, finished, stopping;
+
+    boost::mutex mutex;
+    boost::condition_variable space, available;
+
+    // For prefetching raw files: a descriptor of the file, where the
+    // thread is reading in it, and how far the kernel has been asked to
+    // read ahead.
+    int fd;
+    std::streamoff position, advised;
+
+    boost::thread thread;
+  };
+}
+
+#endif
@@ -3,36 +3,45 @@
 // TraceReader.cpp
 
 // MTV includes.
+#include <Core/Dataflow/TraceIndex.h>
+#include <Core/Dataflow/TraceReadAhead.h>
 #include <Core/Dataflow/TraceReader.h>
-using MTV::Clock;
-using MTV::ClockedTraceReader;
-using MTV::TimedTraceReader;
+using MTV::TraceIndex;
+using MTV::TraceReadAhead;
 using MTV::TraceReader;
 using MTV::TraceWriter;
 
 // System includes.
+#include <algorithm>
 #include <iostream>
 
 TraceReader::TraceReader(const size_t bufsize)
-  : in(&inbuf),
+  : inbuf(boost::make_shared<filtering_istreambuf>()),
+    in(inbuf.get()),
+    readAheadDepth(0),
+    readAheadChunk(default_readahead_chunk),
+    dataStart(0),
     buffer(bufsize),
     bufsize(bufsize),
     next(0),
     curbufsize(0),
     globalPos(0),
+    progressInterval(100),
     signalBase(0),
     signalLimit(0)
 {}
 
 bool TraceReader::open(const std::string& filename){
+  // Reset the filtering streambuf object (stopping any read-ahead
+  // before the file changes under it).
+  this->resetInput();
+
   // Open the file.
   file.open(filename.c_str());
   if(!file){
     return false;
   }
-
-  // Reset the filtering streambuf object.
-  inbuf.reset();
+  this->filename = filename;
 
   // Read the magic bytes.  If they are not present, assume the file
   // is pre-magic and contains a raw encoding.
@@ -45,8 +54,9 @@ bool TraceReader::open(const std::string& filename){
     file.read(reinterpret_cast<char *>(&code), sizeof(code));
 
     encoding = static_cast<TraceWriter::Encoding>(code);
+    dataStart = file.tellg();
     if(encoding == TraceWriter::Gzip){
-      inbuf.push(gzip_decompressor());
+      inbuf->push(gzip_decompressor());
     }
   }
   else{
@@ -55,23 +65,111 @@ bool TraceReader::open(const std::string& filename){
 
     // The encoding is Raw.
     encoding = TraceWriter::Raw;
+    dataStart = 0;
   }
 
-  inbuf.push(file);
+  inbuf->push(file);
+  this->startReadAhead();
 
   // return static_cast<bool>(in);
   return true;
 }
 
-void TraceReader::seek(const size_t recID){
-  // TODO(choudhury): more robust behavior.
+bool TraceReader::seek(const uint64_t recID){
+  // Rebuild the input chain from the right place in the file.
+  this->resetInput();
+  file.clear();
+
   if(encoding == TraceWriter::Raw){
-    // Seek to the right place in the file.
-    file.seekg(recID*sizeof(MTR::Record));
+    file.seekg(dataStart + static_cast<std::streamoff>(recID*sizeof(MTR::Record)));
+    inbuf->push(file);
+  }
+  else{
+    file.seekg(dataStart);
+    inbuf->push(gzip_decompressor());
+    inbuf->push(file);
+
+    // A compressed stream can only be read forward.
+    uint64_t remaining = recID;
+    while(remaining > 0){
+      const uint64_t chunk = std::min<uint64_t>(remaining, bufsize);
+      in.read(reinterpret_cast<char *>(&buffer[0]), chunk*sizeof(MTR::Record));
+
+      const uint64_t got = in.gcount() / sizeof(MTR::Record);
+      if(got == 0){
+        break;
+      }
+      remaining -= got;
+    }
+  }
+
+  this->startReadAhead();
+
+  // Save the new global position.
+  globalPos = recID;
+
+  return this->peek() != 0 or recID == 0;
+}
+
+bool TraceReader::seekFunction(const TraceIndex& index, uint64_t function, uint64_t n){
+  uint64_t pos, entry;
+  if(!index.function_checkpoint(function, n, pos, entry) or !this->seek(pos)){
+    return false;
+  }
+
+  // Scan forward from the checkpoint (which is itself an entry) to
+  // the requested entry.
+  for(const MTR::Record *rec = this->peek(); rec; rec = this->peek()){
+    if(rec->code == MTR::Record::FunctionEntry and rec->addr == function and entry++ == n){
+      return true;
+    }
 
-    // Save the new global position.
-    globalPos = recID;
+    this->skip();
+  }
+
+  return false;
+}
+
+bool TraceReader::seekLine(const TraceIndex& index, uint32_t file, uint32_t line){
+  const uint64_t pos = index.first_visit(file, line);
+  return pos != TraceIndex::NoPosition and this->seek(pos);
+}
+
+void TraceReader::resetInput(){
+  readahead.reset();
+  inbuf = boost::make_shared<filtering_istreambuf>();
+  in.rdbuf(inbuf.get());
+  next = curbufsize = 0;
+}
+
+void TraceReader::startReadAhead(){
+  if(readAheadDepth == 0){
+    return;
+  }
+
+  // For raw traces the position in the file is known, so the kernel
+  // can be asked to prefetch it too.
+  const bool raw = (encoding == TraceWriter::Raw);
+  readahead = boost::make_shared<TraceReadAhead>(inbuf.get(),
+                                                 readAheadDepth,
+                                                 readAheadChunk*sizeof(MTR::Record),
+                                                 raw ? filename : std::string(),
+                                                 raw ? static_cast<std::streamoff>(file.tellg()) : 0);
+  in.rdbuf(readahead.get());
+}
+
+const MTR::Record *TraceReader::peek(){
+  if(next == curbufsize){
+    in.read(reinterpret_cast<char *>(&buffer[0]), bufsize*sizeof(MTR::Record));
+
+    next = 0;
+    curbufsize = in.gcount() / sizeof(MTR::Record);
+    if(curbufsize == 0){
+      return 0;
+    }
   }
+
+  return &buffer[next];
 }
 
 void TraceReader::setSignalRange(MTR::addr_t base, MTR::addr_t limit){
@@ -104,9 +202,9 @@ const MTR::Record& TraceReader::nextRecord(){
     }
   }
 
-  // Broadcast the global position of the trace.
-  if(globalPos % 100 == 0){
-    emit onTraceRecord(globalPos);
+  // Report the global position of the trace.
+  if(progress and globalPos % progressInterval == 0){
+    progress(globalPos);
   }
   ++globalPos;
 
@@ -133,85 +231,3 @@ const MTR::Record& TraceReader::nextRecord(){
 void TraceReader::produce(const MTR::Record& rec){
   this->broadcast(rec);
 }
-
-TimedTraceReader::TimedTraceReader(const size_t bufsize)
-  : TraceReader(bufsize),
-    timer(new QTimer(0))
-{
-  // Have the reader produce a new record whenever the timer times
-  // out.
-  QObject::connect(timer.get(), SIGNAL(timeout()), this, SLOT(timeout()));
-}
-
-void TimedTraceReader::timeout(){
-  try{
-    // Produce records until a memory record appears.
-    //
-    // TODO(choudhury): this behavior ought to be controllable.
-    while(MTR::type(this->nextRecord()) != MTR::Record::MType){
-      // Empty while loop.
-    }
-  }
-  catch(TraceReader::End){
-    std::cout << "Trace end reached!!" << std::endl;
-    timer->stop();
-    exit(0);
-  }
-}
-
-void TimedTraceReader::start(){
-  timer->start();
-}
-
-void TimedTraceReader::stop(){
-  timer->stop();
-}
-
-void TimedTraceReader::setInterval(int msec){
-  timer->setInterval(msec);
-}
-
-ClockedTraceReader::ClockedTraceReader(Clock::ptr clock, const size_t bufsize)
-  : TraceReader(bufsize),
-    timer(new QTimer(0)),
-    clock(clock)
-{
-  // Have the reader produce a new record whenever the timer times
-  // out.
-  QObject::connect(timer.get(), SIGNAL(timeout()), this, SLOT(timeout()));
-
-  // Check the clock as often as possible.
-  timer->setInterval(1);
-}
-
-void ClockedTraceReader::timeout(){
-  if(clock->noww() - last > interval){
-    try{
-      // Produce records until a memory record appears.
-      //
-      // TODO(choudhury): this behavior ought to be controllable.
-      while(MTR::type(this->nextRecord()) != MTR::Record::MType){
-        // Empty while loop.
-      }
-    }
-    catch(TraceReader::End){
-      std::cout << "Trace end reached!!" << std::endl;
-      timer->stop();
-      exit(0);
-    }
-
-    last = clock->noww();
-  }
-}
-
-void ClockedTraceReader::start(){
-  timer->start();
-}
-
-void ClockedTraceReader::stop(){
-  timer->stop();
-}
-
-void ClockedTraceReader::setInterval(int msec){
-  interval = 0.001*msec;
-}
@@ -3,7 +3,9 @@
 // Copyright 2010 A.N.M. Imroz Choudhury, all rights reserved
 //
 // TraceReader.h - Defines a data producer that reads a trace from
-// disk and sends trace records downstream.
+// disk and sends trace records downstream.  This class has no Qt
+// dependency; see QtTraceReader.h for the timer-driven versions used
+// by the GUI applications.
 
 #ifndef TRACE_READER_H
 #define TRACE_READER_H
@@ -13,11 +15,10 @@
 #include <Core/Dataflow/SignalRecordFilter.h>
 #include <Core/Dataflow/TraceWriter.h>
 #include <Core/Util/Boost.h>
-#include <Core/Util/Timing.h>
 #include <Tools/ReferenceTrace/mtrtools.h>
 
-// Qt headers.
-#include <QtCore>
+// Boost headers.
+#include <boost/function.hpp>
 
 // System headers.
 #include <iostream>
@@ -25,27 +26,59 @@
 #include <vector>
 
 namespace MTV{
-  class TraceReader : public QObject,
-                      public Producer<MTR::Record> {
-    Q_OBJECT;
+  class TraceIndex;
+  class TraceReadAhead;
 
+  class TraceReader : public Producer<MTR::Record> {
   public:
     BoostPointers(TraceReader);
 
   public:
     static const size_t default_bufsize = 10*1024;
 
+    // The default size (in records) of the read-ahead chunks.
+    static const size_t default_readahead_chunk = 64*1024;
+
+    // Called with the global trace position of every "every"-th
+    // record read.
+    typedef boost::function<void (uint64_t)> ProgressCallback;
+
   public:
     TraceReader(const size_t bufsize = default_bufsize);
     // ~TraceReader() {
     //   std::cerr << "TraceReader() destructor!" << std::endl;
     // }
 
+    // Reads (and decompresses) the trace on a background thread,
+    // keeping "depth" chunks of "chunk" records ready ahead of the
+    // reader (a depth of zero reads synchronously, the default).  Takes
+    // effect at the next open() or seek().
+    void setReadAhead(unsigned depth, size_t chunk = default_readahead_chunk){
+      readAheadDepth = depth;
+      readAheadChunk = chunk > 0 ? chunk : 1;
+    }
+
     bool open(const std::string& filename);
-    void seek(const size_t recID);
+
+    // Positions the reader so that the next record read is the one at
+    // index "recID".  Raw traces seek directly; gzipped traces are
+    // decompressed from the start up to that point.  Returns false if
+    // the trace is shorter than that.
+    bool seek(const uint64_t recID);
+
+    // Positions the reader at the nth (counting from 0) entry to a
+    // function, or the first visit to a source line, as found in the
+    // trace's index.  Returns false if there is no such record.
+    bool seekFunction(const TraceIndex& index, uint64_t function, uint64_t n);
+    bool seekLine(const TraceIndex& index, uint32_t file, uint32_t line);
 
     void setSignalRange(MTR::addr_t base, MTR::addr_t limit);
 
+    void setProgressCallback(ProgressCallback callback, uint64_t every = 100){
+      progress = callback;
+      progressInterval = every > 0 ? every : 1;
+    }
+
     SignalRecordFilter::ptr getSignalFilter() { return sfilter; }
 
     TraceWriter::Encoding getEncoding() const { return encoding; }
@@ -94,16 +127,45 @@ namespace MTV{
     // From the Producer interface.
     void produce(const MTR::Record& rec);
 
-  signals:
-    void onTraceRecord(uint64_t);
+  private:
+    // Starts a new, empty input chain and drops whatever was buffered.
+    void resetInput();
+
+    // Puts the read-ahead thread (if requested) in front of the input
+    // chain.
+    void startReadAhead();
+
+    // Returns the next record without reading it out (or 0 at the end
+    // of the trace); skip() then passes over it without producing it.
+    const MTR::Record *peek();
+
+    void skip(){
+      ++next;
+      ++globalPos;
+    }
 
   protected:
     std::ifstream file;
+
+    // NOTE(choudhury): a filtering_istreambuf that has been read from
+    // keeps stale data in its get area after reset(), so each (re)start
+    // of the input uses a fresh one.
+    boost::shared_ptr<filtering_istreambuf> inbuf;
     std::istream in;
-    filtering_istreambuf inbuf;
+
+    // When reading ahead, "in" reads from this instead of "inbuf" (and
+    // nothing else may touch "inbuf" or "file").
+    boost::shared_ptr<TraceReadAhead> readahead;
+    unsigned readAheadDepth;
+    size_t readAheadChunk;
+    std::string filename;
 
     TraceWriter::Encoding encoding;
 
+    // Where the records begin in the file (past any magic phrase and
+    // encoding).
+    std::streamoff dataStart;
+
     std::vector<MTR::Record> buffer;
     const size_t bufsize;
 
@@ -120,6 +182,9 @@ namespace MTV{
     // used to tell a GUI where the trace is.
     uint64_t globalPos;
 
+    ProgressCallback progress;
+    uint64_t progressInterval;
+
     // These are used to detect signal references; those records
     // follow a separate path out of the trace reader.
     MTR::addr_t signalBase, signalLimit;
@@ -132,52 +197,6 @@ namespace MTV{
     // Thrown by nextRecord() when there are no more items to read.
     class End {};
   };
-
-  class TimedTraceReader : public TraceReader {
-    Q_OBJECT;
-
-  public:
-    BoostPointers(TimedTraceReader);
-
-  public:
-    TimedTraceReader(const size_t bufsize = TraceReader::default_bufsize);
-
-  public slots:
-    // This slot can be engaged to let the object know it should
-    // produce a new record.
-    void timeout();
-
-    // Playback control.
-    void start();
-    void stop();
-    void setInterval(int msec);
-
-  private:
-    boost::shared_ptr<QTimer> timer;
-  };
-
-  class ClockedTraceReader : public TraceReader {
-    Q_OBJECT;
-
-  public:
-    BoostPointers(ClockedTraceReader);
-
-  public:
-    ClockedTraceReader(Clock::ptr clock, const size_t bufsize = TraceReader::default_bufsize);
-
-  public slots:
-    void timeout();
-
-    void start();
-    void stop();
-    void setInterval(int msec);
-
-  private:
-    boost::shared_ptr<QTimer> timer;
-    Clock::ptr clock;
-    float interval;
-    float last;
-  };
 }
 
 #endif
@@ -0,0 +1,12 @@
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// WindowedStats.cpp
+
+// MTV headers.
+#include <Core/Dataflow/WindowedStats.h>
+using MTV::WindowedHistogram;
+using MTV::WindowedMean;
+
+const unsigned WindowedMean::Unbounded;
+const unsigned WindowedHistogram::Unbounded;
+const unsigned WindowedHistogram::NoBin = static_cast<unsigned>(-1);
@@ -0,0 +1,148 @@
+// -*- c++ -*-
+//
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// WindowedStats.h - Sliding-window statistics with O(1) updates and
+// queries, for the performance counter policies.
+
+#ifndef WINDOWED_STATS_H
+#define WINDOWED_STATS_H
+
+// MTV headers.
+#include <Core/Util/BoostPointers.h>
+
+// System headers.
+#include <vector>
+
+namespace MTV{
+  // The mean of the last "window" recorded values (the window starts
+  // out full of zeros), or of every value recorded when the window is
+  // Unbounded.  A running sum is kept, so both recording and querying
+  // are constant time.
+  class WindowedMean{
+  public:
+    BoostPointers(WindowedMean);
+
+  public:
+    static const unsigned Unbounded = static_cast<unsigned>(-1);
+
+  public:
+    WindowedMean(unsigned window)
+      : unbounded(window == Unbounded),
+        history(unbounded ? 0 : window, 0.0f),
+        p(0),
+        total(0.0),
+        n(0)
+    {}
+
+    void record(float val){
+      ++n;
+
+      if(unbounded){
+        total += val;
+        return;
+      }
+
+      total += val - history[p];
+      history[p] = val;
+
+      // Recompute the sum exactly once per pass through the window,
+      // so floating point error cannot build up (this keeps the cost
+      // amortized constant).
+      if(++p == history.size()){
+        p = 0;
+
+        total = 0.0;
+        for(unsigned i=0; i<history.size(); i++){
+          total += history[i];
+        }
+      }
+    }
+
+    double sum() const {
+      return total;
+    }
+
+    double mean() const {
+      if(unbounded){
+        return n > 0 ? total / n : 0.0;
+      }
+      return history.size() > 0 ? total / history.size() : 0.0;
+    }
+
+    unsigned long long count() const {
+      return n;
+    }
+
+  private:
+    bool unbounded;
+    std::vector<float> history;
+    unsigned p;
+    double total;
+    unsigned long long n;
+  };
+
+  // Tracks, for each of a number of bins, the fraction of the last
+  // "window" ticks that landed in it (or of all ticks, when the window
+  // is Unbounded).  Every tick lands in exactly one bin, so only that
+  // bin and the one whose tick falls out of the window change: the
+  // other bins' counts are implicitly unchanged, and their rates
+  // follow from the shared tick count.
+  class WindowedHistogram{
+  public:
+    BoostPointers(WindowedHistogram);
+
+  public:
+    static const unsigned Unbounded = WindowedMean::Unbounded;
+
+  public:
+    WindowedHistogram(unsigned bins, unsigned window)
+      : unbounded(window == Unbounded),
+        ring(unbounded ? 0 : window, NoBin),
+        p(0),
+        counts(bins, 0),
+        ticks(0)
+    {}
+
+    void record(unsigned bin){
+      ++ticks;
+      ++counts[bin];
+
+      if(!unbounded and ring.size() > 0){
+        if(ring[p] != NoBin){
+          --counts[ring[p]];
+        }
+        ring[p] = bin;
+        p = (p + 1) % ring.size();
+      }
+    }
+
+    unsigned bins() const {
+      return counts.size();
+    }
+
+    unsigned long long count(unsigned bin) const {
+      return counts[bin];
+    }
+
+    // As with WindowedMean, a bounded window is treated as starting
+    // out full of ticks that hit no bin.
+    double rate(unsigned bin) const {
+      if(unbounded){
+        return ticks > 0 ? static_cast<double>(counts[bin]) / ticks : 0.0;
+      }
+      return ring.size() > 0 ? static_cast<double>(counts[bin]) / ring.size() : 0.0;
+    }
+
+  private:
+    static const unsigned NoBin;
+
+    bool unbounded;
+    std::vector<unsigned> ring;
+    unsigned p;
+    std::vector<unsigned long long> counts;
+    unsigned long long ticks;
+  };
+}
+
+#endif
@@ -38,7 +38,7 @@ void AlphaGlyph::SetSize( int resX, int resY ){
 }
 
 
-void AlphaGlyph::Draw( float x, float y, float scale ){
+void AlphaGlyph::Bind(){
 	if(tid == 0xffffffff){
 		glGenTextures(1,&tid); 
 	}
@@ -47,19 +47,21 @@ void AlphaGlyph::Draw( float x, float y, float scale ){
 
 		Rebuild();
 
-		glEnable(GL_TEXTURE_2D); 
-			glBindTexture(GL_TEXTURE_2D,tid);
-			glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP);
-			glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP);
-			glTexImage2D(GL_TEXTURE_2D,0,GL_ALPHA,w,h,0,GL_ALPHA,GL_FLOAT,alpha);
-			//glTexImage2D(GL_TEXTURE_2D,0,GL_LUMINANCE,w,h,0,GL_LUMINANCE,GL_FLOAT,alpha);
-		glDisable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D,tid);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP);
+		glTexImage2D(GL_TEXTURE_2D,0,GL_ALPHA,w,h,0,GL_ALPHA,GL_FLOAT,alpha);
+		//glTexImage2D(GL_TEXTURE_2D,0,GL_LUMINANCE,w,h,0,GL_LUMINANCE,GL_FLOAT,alpha);
 	}
 
+	glBindTexture(GL_TEXTURE_2D,tid);
+}
+
+void AlphaGlyph::Draw( float x, float y, float scale ){
 	glEnable(GL_TEXTURE_2D); 
-		glBindTexture(GL_TEXTURE_2D,tid);
+		Bind();
 		glBegin(GL_QUADS);
 			glTexCoord2f(0,0); glVertex3f(-scale + x,-scale + y,0);
 			glTexCoord2f(1,0); glVertex3f( scale + x,-scale + y,0);
@@ -30,6 +30,10 @@ public:
 
 	virtual void SetSize( int resX, int resY );
 
+	// Builds the texture on first use, and binds it to
+	// GL_TEXTURE_2D.
+	void Bind();
+
 	virtual void EnableBlending();
 	virtual void Draw( float x, float y, float scale );
 	virtual void DisableBlending();
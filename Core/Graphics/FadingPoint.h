@@ -72,6 +72,10 @@ namespace MTV{
       glyph.DisableBlending();
     };
 
+    void batch(RenderBatch& b) const {
+      b.sprite(glyph, location.x, location.y, size, color);
+    }
+
   private:
     static GaussianAlphaGlyph glyph;
 
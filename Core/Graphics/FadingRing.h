@@ -61,6 +61,10 @@ namespace MTV{
       glyph.DisableBlending();
     };
 
+    void batch(RenderBatch& b) const {
+      b.sprite(glyph, location.x, location.y, size, color);
+    }
+
   private:
     static SineAlphaGlyph glyph;
 
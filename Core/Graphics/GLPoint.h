@@ -62,6 +62,10 @@ namespace MTV{
       glEnd();
     };
 
+    void batch(RenderBatch& b) const {
+      b.point(location, color, size);
+    }
+
   private:
     Color color;
     int size;
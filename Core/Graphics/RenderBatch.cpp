@@ -0,0 +1,140 @@
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// RenderBatch.cpp
+
+// MTV headers.
+#include <Core/Graphics/RenderBatch.h>
+using MTV::Color;
+using MTV::Point;
+using MTV::RenderBatch;
+
+RenderBatch::RenderBatch()
+  : calls(0),
+    submitted(0)
+{}
+
+RenderBatch::Run& RenderBatch::run(GLenum mode, GLfloat pointSize, AlphaGlyph *glyph){
+  if(!runs.empty()){
+    Run& last = runs.back();
+    if(last.mode == mode and last.pointSize == pointSize and last.glyph == glyph){
+      return last;
+    }
+  }
+
+  Run r;
+  r.mode = mode;
+  r.pointSize = pointSize;
+  r.glyph = glyph;
+  r.first = static_cast<GLint>(vertices.size());
+  r.count = 0;
+  runs.push_back(r);
+
+  return runs.back();
+}
+
+void RenderBatch::vertex(float x, float y, float s, float t, const Color& c){
+  Vertex v;
+  v.x = x;
+  v.y = y;
+  v.s = s;
+  v.t = t;
+  v.r = c.r;
+  v.g = c.g;
+  v.b = c.b;
+  v.a = c.a;
+  vertices.push_back(v);
+}
+
+void RenderBatch::quad(const Point& a, const Point& b, const Color& color){
+  this->run(GL_QUADS, 0.0, 0).count += 4;
+
+  this->vertex(a.x, a.y, 0.0, 0.0, color);
+  this->vertex(a.x, b.y, 0.0, 0.0, color);
+  this->vertex(b.x, b.y, 0.0, 0.0, color);
+  this->vertex(b.x, a.y, 0.0, 0.0, color);
+}
+
+void RenderBatch::outline(const Point& a, const Point& b, const Color& color){
+  // NOTE(choudhury): a GL_LINE_LOOP can't be merged with its
+  // neighbors, so the loop is broken up into four separate segments.
+  this->run(GL_LINES, 0.0, 0).count += 8;
+
+  this->vertex(a.x, a.y, 0.0, 0.0, color);
+  this->vertex(a.x, b.y, 0.0, 0.0, color);
+
+  this->vertex(a.x, b.y, 0.0, 0.0, color);
+  this->vertex(b.x, b.y, 0.0, 0.0, color);
+
+  this->vertex(b.x, b.y, 0.0, 0.0, color);
+  this->vertex(b.x, a.y, 0.0, 0.0, color);
+
+  this->vertex(b.x, a.y, 0.0, 0.0, color);
+  this->vertex(a.x, a.y, 0.0, 0.0, color);
+}
+
+void RenderBatch::point(const Point& p, const Color& color, float size){
+  this->run(GL_POINTS, size, 0).count += 1;
+  this->vertex(p.x, p.y, 0.0, 0.0, color);
+}
+
+void RenderBatch::sprite(AlphaGlyph& glyph, float x, float y, float scale, const Color& color){
+  this->run(GL_QUADS, 0.0, &glyph).count += 4;
+
+  this->vertex(-scale + x, -scale + y, 0.0, 0.0, color);
+  this->vertex( scale + x, -scale + y, 1.0, 0.0, color);
+  this->vertex( scale + x,  scale + y, 1.0, 1.0, color);
+  this->vertex(-scale + x,  scale + y, 0.0, 1.0, color);
+}
+
+void RenderBatch::flush(){
+  if(runs.empty()){
+    return;
+  }
+
+  // NOTE(choudhury): client-side vertex arrays are part of GL 1.1, so
+  // this path works on any context the immediate-mode path does
+  // (including software rasterizers such as llvmpipe), while cutting
+  // the per-vertex call overhead down to a few calls per run.
+  glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+  const Vertex *base = &vertices[0];
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(2, GL_FLOAT, sizeof(Vertex), &base->x);
+  glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), &base->s);
+  glColorPointer(4, GL_FLOAT, sizeof(Vertex), &base->r);
+
+  for(std::vector<Run>::const_iterator r = runs.begin(); r != runs.end(); r++){
+    if(r->mode == GL_POINTS){
+      glPointSize(r->pointSize);
+    }
+
+    if(r->glyph){
+      // Match the state changes AlphaGlyph::Draw() and its callers
+      // perform, so that the batched frame looks identical.
+      r->glyph->EnableBlending();
+      glEnable(GL_TEXTURE_2D);
+      r->glyph->Bind();
+      glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+      glDrawArrays(r->mode, r->first, r->count);
+
+      glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+      glDisable(GL_TEXTURE_2D);
+      r->glyph->DisableBlending();
+    }
+    else{
+      glDrawArrays(r->mode, r->first, r->count);
+    }
+
+    ++calls;
+  }
+
+  glPopClientAttrib();
+
+  submitted += vertices.size();
+
+  // Keep the storage around for the next frame.
+  vertices.clear();
+  runs.clear();
+}
@@ -0,0 +1,88 @@
+// -*- c++ -*-
+//
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// RenderBatch.h - Collects the quads, points, and glyph sprites that
+// widgets would otherwise draw in immediate mode into a single vertex
+// array, and submits them with a handful of glDrawArrays() calls.
+
+#ifndef RENDER_BATCH_H
+#define RENDER_BATCH_H
+
+// MTV headers.
+#include <Core/Color/Color.h>
+#include <Core/Geometry/Point.h>
+#include <Core/Graphics/AlphaGlyph.h>
+
+// System headers.
+#include <vector>
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+namespace MTV{
+  class RenderBatch {
+  public:
+    RenderBatch();
+
+    // Axis-aligned filled quad with corners a and b.
+    void quad(const Point& a, const Point& b, const Color& color);
+
+    // Outline of the axis-aligned rectangle with corners a and b.
+    void outline(const Point& a, const Point& b, const Color& color);
+
+    // Single GL point of the given pixel size.
+    void point(const Point& p, const Color& color, float size);
+
+    // A textured quad of half-width scale, centered on (x, y), using
+    // the glyph's alpha texture modulated by color.  This is the
+    // batched equivalent of AlphaGlyph::Draw().
+    void sprite(AlphaGlyph& glyph, float x, float y, float scale, const Color& color);
+
+    // Submits everything collected so far, in the order it was
+    // collected, and empties the batch.  Widgets that must draw
+    // something in immediate mode call this first so that painter's
+    // order is preserved.
+    void flush();
+
+    // Statistics, accumulated across flushes until reset.
+    unsigned long drawCalls() const { return calls; }
+    unsigned long vertexCount() const { return submitted; }
+
+    void resetStats(){
+      calls = submitted = 0;
+    }
+
+  private:
+    struct Vertex {
+      GLfloat x, y;
+      GLfloat s, t;
+      GLfloat r, g, b, a;
+    };
+
+    // A maximal sequence of vertices sharing the same GL state.
+    struct Run {
+      GLenum mode;
+      GLfloat pointSize;
+      AlphaGlyph *glyph;
+      GLint first;
+      GLsizei count;
+    };
+
+    // Returns the run that the next vertices should be appended to,
+    // starting a new one if the state differs from the current run.
+    Run& run(GLenum mode, GLfloat pointSize, AlphaGlyph *glyph);
+
+    void vertex(float x, float y, float s, float t, const Color& c);
+
+  private:
+    std::vector<Vertex> vertices;
+    std::vector<Run> runs;
+
+    unsigned long calls, submitted;
+  };
+}
+
+#endif
@@ -29,6 +29,10 @@ namespace MTV{
       this->drawChildren();
     }
 
+    void batch(RenderBatch& b) const {
+      this->batchChildren(b);
+    }
+
     float width() const { return insertion_offset; }
     float height() const { return max_widget_height; }
 
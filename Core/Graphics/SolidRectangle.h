@@ -67,6 +67,15 @@ namespace MTV{
       }
     }
 
+    void batch(RenderBatch& b) const {
+      const Point corner = location + diagonal;
+
+      b.quad(location, corner, color);
+      if(outline){
+        b.outline(location, corner, Color::black);
+      }
+    }
+
     void setColor(const Color& c){
       std::cout << "SolidRectangle::setColor!" << std::endl;
       color = c;
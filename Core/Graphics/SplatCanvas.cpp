@@ -0,0 +1,104 @@
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// SplatCanvas.cpp
+
+// MTV headers.
+#include <Core/Graphics/SplatCanvas.h>
+using MTV::Color;
+using MTV::SplatCanvas;
+
+// System headers.
+#include <algorithm>
+#include <cmath>
+
+SplatCanvas::SplatCanvas(int width, int height, int glyphResolution, float glyphSigma)
+  : width(width),
+    height(height),
+    shape(static_cast<float>(glyphResolution*glyphResolution) / (8.0f*glyphSigma*glyphSigma)),
+    r(width*height),
+    g(width*height),
+    b(width*height),
+    wx(width)
+{}
+
+void SplatCanvas::clear(const Color& c){
+  std::fill(r.begin(), r.end(), c.r);
+  std::fill(g.begin(), g.end(), c.g);
+  std::fill(b.begin(), b.end(), c.b);
+}
+
+void SplatCanvas::fade(const Color& c, float decay){
+  const float keep = 1.0f - decay;
+  const float cr = decay*c.r, cg = decay*c.g, cb = decay*c.b;
+
+  float * const R = &r[0];
+  float * const G = &g[0];
+  float * const B = &b[0];
+  const int n = width*height;
+  for(int i=0; i<n; i++){
+    R[i] = keep*R[i] + cr;
+    G[i] = keep*G[i] + cg;
+    B[i] = keep*B[i] + cb;
+  }
+}
+
+void SplatCanvas::splat(float x, float y, float scale, const Color& c){
+  if(scale <= 0.0f or c.a <= 0.0f){
+    return;
+  }
+
+  // Pixel bounds of the glyph quad, clipped to the canvas.  Pixel
+  // (i, j) is sampled at its center, (i + 0.5, j + 0.5).
+  const int x0 = std::max(0, static_cast<int>(std::ceil(x - scale - 0.5f)));
+  const int x1 = std::min(width - 1, static_cast<int>(std::floor(x + scale - 0.5f)));
+  const int y0 = std::max(0, static_cast<int>(std::ceil(y - scale - 0.5f)));
+  const int y1 = std::min(height - 1, static_cast<int>(std::floor(y + scale - 0.5f)));
+  if(x0 > x1 or y0 > y1){
+    return;
+  }
+
+  // The Gaussian is separable, so the per-pixel weight is the product
+  // of a column weight and a row weight, and only 2N exponentials are
+  // needed for an NxN glyph.
+  const float k = shape / (scale*scale);
+  for(int i=x0; i<=x1; i++){
+    const float dx = (i + 0.5f) - x;
+    wx[i] = c.a * std::exp(-k*dx*dx);
+  }
+
+  for(int j=y0; j<=y1; j++){
+    const float dy = (j + 0.5f) - y;
+    const float wy = std::exp(-k*dy*dy);
+
+    float * const R = &r[j*width];
+    float * const G = &g[j*width];
+    float * const B = &b[j*width];
+    const float * const W = &wx[0];
+    for(int i=x0; i<=x1; i++){
+      const float a = wy*W[i];
+      R[i] += a*(c.r - R[i]);
+      G[i] += a*(c.g - G[i]);
+      B[i] += a*(c.b - B[i]);
+    }
+  }
+}
+
+static unsigned char toByte(float v){
+  return static_cast<unsigned char>(std::max(0.0f, std::min(255.0f, 255.0f*v + 0.5f)));
+}
+
+void SplatCanvas::toRGBA(std::vector<unsigned char>& rgba) const {
+  rgba.resize(4*width*height);
+
+  // The canvas stores its bottom row first, as GL does.
+  for(int j=0; j<height; j++){
+    const int src = (height - 1 - j)*width;
+    unsigned char *dst = &rgba[4*j*width];
+    for(int i=0; i<width; i++){
+      dst[4*i + 0] = toByte(r[src + i]);
+      dst[4*i + 1] = toByte(g[src + i]);
+      dst[4*i + 2] = toByte(b[src + i]);
+      dst[4*i + 3] = 255;
+    }
+  }
+}
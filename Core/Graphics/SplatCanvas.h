@@ -0,0 +1,65 @@
+// -*- c++ -*-
+//
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// SplatCanvas.h - A software (CPU) raster target that composites
+// Gaussian glyphs the same way FadingPoint/GaussianAlphaGlyph does in
+// GL, and reproduces the MotionBlur washout between frames.  It needs
+// no GL context, so any number of canvases can be drawn in parallel.
+
+#ifndef SPLAT_CANVAS_H
+#define SPLAT_CANVAS_H
+
+// MTV headers.
+#include <Core/Color/Color.h>
+#include <Core/Util/BoostPointers.h>
+
+// System headers.
+#include <vector>
+
+namespace MTV{
+  class SplatCanvas {
+  public:
+    BoostPointers(SplatCanvas);
+
+  public:
+    // The glyph shape defaults to that of FadingPoint's
+    // GaussianAlphaGlyph(32, 32, 2.0).
+    SplatCanvas(int width, int height, int glyphResolution = 32, float glyphSigma = 2.0);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    void clear(const Color& c);
+
+    // Equivalent to MotionBlur::Draw(): blends the previous contents
+    // toward the color c by the given decay rate.
+    void fade(const Color& c, float decay);
+
+    // Composites a Gaussian glyph of half-width scale, centered at
+    // (x, y) (lower-left origin, as in the widget panels), with
+    // GL_SRC_ALPHA/GL_ONE_MINUS_SRC_ALPHA blending.
+    void splat(float x, float y, float scale, const Color& c);
+
+    // Writes the canvas as 8-bit RGBA, top row first.
+    void toRGBA(std::vector<unsigned char>& rgba) const;
+
+  private:
+    int width, height;
+
+    // res^2 / (8 sigma^2): scales squared pixel distance (divided by
+    // the squared glyph scale) into the Gaussian's exponent.
+    float shape;
+
+    // NOTE(choudhury): the channels are stored as separate planes
+    // (rather than interleaved) so that the inner splatting loop
+    // walks three unit-stride float arrays, which the compiler
+    // vectorizes.
+    std::vector<float> r, g, b;
+
+    // Scratch space for the separable glyph weights.
+    std::vector<float> wx;
+  };
+}
+
+#endif
@@ -54,3 +54,13 @@ void StripedQuad::draw() const {
   }
   glEnd();
 }
+
+void StripedQuad::batch(RenderBatch& b) const {
+  const float width = stripes.size()*stripeWidth + (stripes.size() - 1)*spacing;
+
+  b.quad(location, location + Vector(width, height), Color(0.0, 0.0, 0.0, 0.4));
+  for(unsigned i=0; i<stripes.size(); i++){
+    Point start = location + Vector(i*(stripeWidth + spacing), 0.0);
+    b.quad(start, start + Vector(stripeWidth, height), stripes[i]);
+  }
+}
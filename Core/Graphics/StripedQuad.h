@@ -35,6 +35,7 @@ namespace MTV{
 
     bool contains(const Point& p);
     void draw() const;
+    void batch(RenderBatch& b) const;
 
   private:
     // The "blank" (i.e. "off" color).
@@ -36,6 +36,10 @@ namespace MTV{
       this->drawChildren();
     }
 
+    void batch(RenderBatch& b) const {
+      this->batchChildren(b);
+    }
+
   private:
     SolidRectangle::ptr tick;
     TextWidget::ptr label;
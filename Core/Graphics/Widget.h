@@ -15,6 +15,7 @@
 #include <Core/Color/Color.h>
 #include <Core/Dataflow/UpdateNotifier.h>
 #include <Core/Geometry/Point.h>
+#include <Core/Graphics/RenderBatch.h>
 #include <Core/Util/BoostPointers.h>
 
 // System headers.
@@ -57,6 +58,21 @@ namespace MTV{
       }
     }
 
+    // Adds this widget's geometry to a render batch instead of
+    // drawing it directly.  The default flushes the batch and falls
+    // back on draw(), so widgets that don't implement batching still
+    // appear in the right order.
+    virtual void batch(RenderBatch& b) const {
+      b.flush();
+      this->draw();
+    }
+
+    void batchChildren(RenderBatch& b) const {
+      foreach(Widget::ptr child, children){
+        child->batch(b);
+      }
+    }
+
     bool childrenContain(const Point& p){
       // Convenience function: returns true if ANY child widget
       // contains the point p.
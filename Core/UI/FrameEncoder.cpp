@@ -0,0 +1,286 @@
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// FrameEncoder.cpp
+
+// MTV headers.
+#include <Core/Dataflow/Instrumentation.h>
+#include <Core/UI/FrameEncoder.h>
+using MTV::Frame;
+using MTV::FrameEncoder;
+using MTV::Instrumentation;
+
+// Boost headers.
+#include <boost/bind.hpp>
+
+// Qt headers.
+#include <QImage>
+
+// System headers.
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+static unsigned char toByte(float v){
+  return static_cast<unsigned char>(std::max(0.0f, std::min(255.0f, v + 0.5f)));
+}
+
+bool FrameEncoder::parseFormat(const std::string& name, Format& format){
+  if(name == "png"){
+    format = PNG;
+  }
+  else if(name == "y4m"){
+    format = Y4M;
+  }
+  else{
+    return false;
+  }
+
+  return true;
+}
+
+FrameEncoder::FrameEncoder(Format format, const std::string& output, unsigned threads, unsigned fps)
+  : format(format),
+    output(output),
+    fps(fps),
+    capacity(2*(threads > 0 ? threads : 1)),
+    done(false),
+    seq(0),
+    out(0),
+    next(0),
+    header(false),
+    written(0),
+    failed(0)
+{
+  if(format == Y4M){
+    if(output == "-"){
+      out = &std::cout;
+    }
+    else{
+      file.open(output.c_str(), std::ios::binary);
+      if(!file){
+        *this << "could not open file '" << output << "' for output";
+        return;
+      }
+      out = &file;
+    }
+  }
+
+  for(unsigned i=0; i<(threads > 0 ? threads : 1); i++){
+    workers.create_thread(boost::bind(&FrameEncoder::work, this));
+  }
+}
+
+FrameEncoder::~FrameEncoder(){
+  this->finish();
+}
+
+void FrameEncoder::submit(Frame& frame){
+  boost::unique_lock<boost::mutex> lock(mutex);
+  while(queue.size() >= capacity){
+    space.wait(lock);
+  }
+
+  queue.push_back(Job());
+  Job& job = queue.back();
+  job.seq = seq++;
+  job.frame.width = frame.width;
+  job.frame.height = frame.height;
+  job.frame.rgba.swap(frame.rgba);
+
+  if(Instrumentation::active){
+    Instrumentation::gauge("frame encoder queue", queue.size());
+  }
+
+  available.notify_one();
+}
+
+void FrameEncoder::finish(){
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    if(done){
+      return;
+    }
+    done = true;
+  }
+
+  available.notify_all();
+  workers.join_all();
+
+  if(out){
+    out->flush();
+
+    // Whichever frames were still buffered are lost, though which ones
+    // is unknown; make sure good() reports it.
+    boost::lock_guard<boost::mutex> lock(outmutex);
+    if(!*out and failed == 0){
+      std::cerr << "error: could not finish writing '" << output << "'" << std::endl;
+      failed = 1;
+    }
+  }
+}
+
+unsigned long long FrameEncoder::framesWritten() const {
+  boost::lock_guard<boost::mutex> lock(outmutex);
+  return written;
+}
+
+unsigned long long FrameEncoder::framesFailed() const {
+  boost::lock_guard<boost::mutex> lock(outmutex);
+  return failed;
+}
+
+void FrameEncoder::work(){
+  while(true){
+    Job job;
+    {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      while(queue.empty() and !done){
+        available.wait(lock);
+      }
+
+      // Only quit once the queue has drained.
+      if(queue.empty()){
+        return;
+      }
+
+      job.seq = queue.front().seq;
+      job.frame.width = queue.front().frame.width;
+      job.frame.height = queue.front().frame.height;
+      job.frame.rgba.swap(queue.front().frame.rgba);
+      queue.pop_front();
+    }
+    space.notify_one();
+
+    switch(format){
+    case PNG:
+      this->encodePNG(job);
+      break;
+
+    case Y4M:
+      this->encodeY4M(job);
+      break;
+    }
+  }
+}
+
+bool FrameEncoder::writePNG(const Frame& f, const std::string& filename){
+  // Drop the alpha channel - the framebuffer alpha is not meaningful
+  // as image transparency.
+  std::vector<unsigned char> rgb(3*f.width*f.height);
+  for(int i=0; i<f.width*f.height; i++){
+    rgb[3*i + 0] = f.rgba[4*i + 0];
+    rgb[3*i + 1] = f.rgba[4*i + 1];
+    rgb[3*i + 2] = f.rgba[4*i + 2];
+  }
+
+  // NOTE(choudhury): QImage is reentrant, so each thread can safely
+  // encode its own image.
+  QImage image(&rgb[0], f.width, f.height, 3*f.width, QImage::Format_RGB888);
+  return image.save(QString(filename.c_str()), "PNG");
+}
+
+void FrameEncoder::encodePNG(const Job& job){
+  std::stringstream filename;
+  filename << output << std::setw(6) << std::setfill('0') << job.seq << ".png";
+
+  const bool ok = FrameEncoder::writePNG(job.frame, filename.str());
+  if(!ok){
+    std::cerr << "error: could not write frame '" << filename.str() << "'" << std::endl;
+  }
+
+  boost::lock_guard<boost::mutex> lock(outmutex);
+  if(ok){
+    ++written;
+  }
+  else{
+    ++failed;
+  }
+}
+
+void FrameEncoder::encodeY4M(const Job& job){
+  std::vector<unsigned char> yuv;
+  FrameEncoder::toI420(job.frame, yuv);
+
+  // NOTE(choudhury): jobs leave the queue in order, so the frame that
+  // is next in line is always held by a worker that does not wait
+  // here.  While the others wait, they stop taking jobs, and submit()
+  // blocks once the queue fills.
+  boost::unique_lock<boost::mutex> lock(outmutex);
+  while(job.seq >= next + capacity){
+    inorder.wait(lock);
+  }
+
+  if(!header){
+    // NOTE(choudhury): the chroma planes are subsampled by two in each
+    // direction, so odd dimensions are rounded up for them in
+    // toI420(); the header carries the true size.
+    *out << "YUV4MPEG2 W" << job.frame.width << " H" << job.frame.height << " F" << fps << ":1 Ip A1:1 C420jpeg\n";
+    header = true;
+  }
+
+  pending[job.seq].swap(yuv);
+
+  // Write out every frame that is now next in line.
+  std::map<unsigned long long, std::vector<unsigned char> >::iterator i;
+  while((i = pending.find(next)) != pending.end()){
+    *out << "FRAME\n";
+    out->write(reinterpret_cast<const char *>(&i->second[0]), i->second.size());
+
+    // NOTE(choudhury): once the stream has failed, every later frame
+    // fails with it, but they still have to be drained in order.
+    if(*out){
+      ++written;
+    }
+    else{
+      if(failed == 0){
+        std::cerr << "error: could not write frame " << next << " to '" << output << "'" << std::endl;
+      }
+      ++failed;
+    }
+
+    pending.erase(i);
+    ++next;
+  }
+
+  inorder.notify_all();
+}
+
+void FrameEncoder::toI420(const Frame& frame, std::vector<unsigned char>& yuv){
+  const int w = frame.width, h = frame.height;
+  const int cw = (w + 1) / 2, ch = (h + 1) / 2;
+
+  yuv.resize(w*h + 2*cw*ch);
+  unsigned char *Y = &yuv[0];
+  unsigned char *U = Y + w*h;
+  unsigned char *V = U + cw*ch;
+
+  // Luma at full resolution.
+  for(int i=0; i<w*h; i++){
+    const unsigned char *p = &frame.rgba[4*i];
+    Y[i] = toByte(0.299f*p[0] + 0.587f*p[1] + 0.114f*p[2]);
+  }
+
+  // Chroma from the average of each 2x2 block (clamped at the edges).
+  for(int cy=0; cy<ch; cy++){
+    for(int cx=0; cx<cw; cx++){
+      float r = 0.0, g = 0.0, b = 0.0;
+      for(int dy=0; dy<2; dy++){
+        for(int dx=0; dx<2; dx++){
+          const int x = std::min(2*cx + dx, w - 1);
+          const int y = std::min(2*cy + dy, h - 1);
+          const unsigned char *p = &frame.rgba[4*(y*w + x)];
+          r += p[0];
+          g += p[1];
+          b += p[2];
+        }
+      }
+      r *= 0.25f;
+      g *= 0.25f;
+      b *= 0.25f;
+
+      U[cy*cw + cx] = toByte(128.0f - 0.168736f*r - 0.331264f*g + 0.5f*b);
+      V[cy*cw + cx] = toByte(128.0f + 0.5f*r - 0.418688f*g - 0.081312f*b);
+    }
+  }
+}
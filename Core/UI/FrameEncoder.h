@@ -0,0 +1,125 @@
+// -*- c++ -*-
+//
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// FrameEncoder.h - Encodes rendered frames to disk on a pool of
+// worker threads, either as a numbered sequence of PNG files or as a
+// single raw YUV4MPEG2 (Y4M) stream.
+
+#ifndef FRAME_ENCODER_H
+#define FRAME_ENCODER_H
+
+// MTV headers.
+#include <Core/Util/BoostPointers.h>
+#include <Core/Util/ErrorMessage.h>
+
+// Boost headers.
+#include <boost/thread.hpp>
+
+// System headers.
+#include <deque>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace MTV{
+  // An RGBA image, stored top row first.
+  struct Frame {
+    Frame()
+      : width(0),
+        height(0)
+    {}
+
+    int width, height;
+    std::vector<unsigned char> rgba;
+  };
+
+  class FrameEncoder : public ErrorMessage {
+  public:
+    BoostPointers(FrameEncoder);
+
+  public:
+    enum Format{
+      PNG,
+      Y4M
+    };
+
+    // Recognizes "png" and "y4m".
+    static bool parseFormat(const std::string& name, Format& format);
+
+    // Writes a single frame as a PNG file (safe to call from any
+    // thread).
+    static bool writePNG(const Frame& frame, const std::string& filename);
+
+  public:
+    // For PNG, output is a filename prefix (frames are written to
+    // <output>000000.png, <output>000001.png, ...).  For Y4M, output
+    // is the stream's filename, or "-" for standard output.
+    FrameEncoder(Format format, const std::string& output, unsigned threads, unsigned fps = 30);
+    ~FrameEncoder();
+
+    // Queues a frame for encoding.  The pixel data is taken from the
+    // frame (leaving it empty) rather than copied.  Blocks if the
+    // workers have fallen too far behind, so that memory use stays
+    // bounded.
+    void submit(Frame& frame);
+
+    // Waits for all queued frames to be written.
+    void finish();
+
+    // The number of frames written out, and the number that could not
+    // be; good() is false once any frame has failed.
+    unsigned long long framesWritten() const;
+    unsigned long long framesFailed() const;
+
+    bool good() const {
+      return this->framesFailed() == 0;
+    }
+
+  private:
+    struct Job {
+      unsigned long long seq;
+      Frame frame;
+    };
+
+    void work();
+
+    void encodePNG(const Job& job);
+    void encodeY4M(const Job& job);
+
+    // Converts an RGBA frame to planar 4:2:0 YCbCr (JPEG/full range).
+    static void toI420(const Frame& frame, std::vector<unsigned char>& yuv);
+
+  private:
+    const Format format;
+    const std::string output;
+    const unsigned fps;
+
+    boost::mutex mutex;
+    boost::condition_variable available, space;
+    std::deque<Job> queue;
+    size_t capacity;
+    bool done;
+    unsigned long long seq;
+
+    boost::thread_group workers;
+
+    // Y4M frames must go out in order, so converted frames wait here
+    // until all of their predecessors have been written.  A worker
+    // whose frame is too far ahead of the next one waits on "inorder"
+    // instead, so that no more than "capacity" frames are ever held
+    // here.
+    mutable boost::mutex outmutex;
+    boost::condition_variable inorder;
+    std::ofstream file;
+    std::ostream *out;
+    std::map<unsigned long long, std::vector<unsigned char> > pending;
+    unsigned long long next;
+    bool header;
+
+    unsigned long long written, failed;
+  };
+}
+
+#endif
@@ -0,0 +1,65 @@
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// OffscreenRenderer.cpp
+
+// MTV headers.
+#include <Core/UI/OffscreenRenderer.h>
+using MTV::Frame;
+using MTV::OffscreenRenderer;
+using MTV::WidgetPanel;
+
+// System headers.
+#include <cstring>
+
+OffscreenRenderer::OffscreenRenderer(int width, int height)
+  : width(width),
+    height(height),
+    pixels(4*width*height),
+    setup(0)
+{
+#ifdef MTVX_HAVE_OSMESA
+  // An RGBA context with no depth, stencil, or accumulation buffers -
+  // the widgets only ever draw flat 2D geometry.
+  context = OSMesaCreateContextExt(OSMESA_RGBA, 0, 0, 0, 0);
+  if(!context){
+    *this << "could not create OSMesa context";
+  }
+#else
+  *this << "offscreen rendering is unavailable (mtvx was built without OSMesa)";
+#endif
+}
+
+OffscreenRenderer::~OffscreenRenderer(){
+#ifdef MTVX_HAVE_OSMESA
+  if(context){
+    OSMesaDestroyContext(context);
+  }
+#endif
+}
+
+void OffscreenRenderer::render(WidgetPanel& panel, Frame& frame){
+#ifdef MTVX_HAVE_OSMESA
+  if(!OSMesaMakeCurrent(context, &pixels[0], GL_UNSIGNED_BYTE, width, height)){
+    *this << "could not make OSMesa context current";
+    return;
+  }
+
+  if(setup != &panel){
+    panel.setupOffscreen(width, height);
+    setup = &panel;
+  }
+
+  panel.renderOffscreen();
+  glFinish();
+
+  // OSMesa stores the bottom row first; flip it so the frame is in
+  // the usual image order.
+  const size_t stride = 4*width;
+  frame.width = width;
+  frame.height = height;
+  frame.rgba.resize(stride*height);
+  for(int i=0; i<height; i++){
+    memcpy(&frame.rgba[i*stride], &pixels[(height - 1 - i)*stride], stride);
+  }
+#endif
+}
@@ -0,0 +1,53 @@
+// -*- c++ -*-
+//
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// OffscreenRenderer.h - Renders a WidgetPanel into a software GL
+// buffer (via OSMesa), so that frames can be produced on machines
+// with no display, and without waiting on the panel's animation
+// timer.
+
+#ifndef OFFSCREEN_RENDERER_H
+#define OFFSCREEN_RENDERER_H
+
+// MTV headers.
+#include <Core/UI/FrameEncoder.h>
+#include <Core/UI/WidgetPanel.h>
+#include <Core/Util/BoostPointers.h>
+#include <Core/Util/ErrorMessage.h>
+
+// System headers.
+#include <vector>
+#ifdef MTVX_HAVE_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+namespace MTV{
+  class OffscreenRenderer : public ErrorMessage {
+  public:
+    BoostPointers(OffscreenRenderer);
+
+  public:
+    OffscreenRenderer(int width, int height);
+    ~OffscreenRenderer();
+
+    // Draws one frame of the panel and copies the result into frame
+    // (top row first, RGBA).  The first call switches the panel into
+    // offscreen mode and sets up its projection.
+    void render(WidgetPanel& panel, Frame& frame);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+  private:
+    int width, height;
+    std::vector<unsigned char> pixels;
+    WidgetPanel *setup;
+
+#ifdef MTVX_HAVE_OSMESA
+    OSMesaContext context;
+#endif
+  };
+}
+
+#endif
@@ -70,6 +70,9 @@ void WidgetAnimationPanel::animationUpdate(){
     }
   }
 
-  // Issue a request to re-draw.
-  updateGL();
+  // Issue a request to re-draw (an offscreen panel is drawn
+  // explicitly by its renderer instead).
+  if(!this->isOffscreen()){
+    updateGL();
+  }
 }
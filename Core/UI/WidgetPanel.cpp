@@ -23,7 +23,9 @@ WidgetPanel::WidgetPanel()
   : QGLWidget(QGLFormat(QGL::DoubleBuffer | QGL::AlphaChannel)),
     textColor(Color::white),
     doMotionBlur(false),
+    doBatching(false),
     dumping(false),
+    offscreen(false),
     frame(0)
 {
   blur.SetDecay(0.2);
@@ -60,6 +62,13 @@ void WidgetPanel::useColorProfile(const ColorProfile& profile){
 }
 
 void WidgetPanel::text(int x, int y, const std::string& message, const QFont& font){
+  // NOTE(choudhury): renderText() draws through the QGLWidget's own
+  // context, which is not the one current during offscreen
+  // rendering, so text is skipped there.
+  if(offscreen){
+    return;
+  }
+
   textColor.glSet();
   this->renderText(x, y, QString(message.c_str()), font);
 }
@@ -171,8 +180,16 @@ void WidgetPanel::paintGL(){
 
   // Draw the widgets.  Later widgets in the widgets list are drawn on
   // top of earlier widgets.
-  foreach(Widget::ptr w, widgets){
-    w->draw();
+  if(doBatching){
+    foreach(Widget::ptr w, widgets){
+      w->batch(renderBatch);
+    }
+    renderBatch.flush();
+  }
+  else{
+    foreach(Widget::ptr w, widgets){
+      w->draw();
+    }
   }
 
   if(doMotionBlur){
@@ -18,6 +18,7 @@
 #include <Core/Color/Color.h>
 #include <Core/Color/ColorProfile.h>
 #include <Core/Graphics/MotionBlur.h>
+#include <Core/Graphics/RenderBatch.h>
 #include <Core/Graphics/Widget.h>
 #include <Core/Util/BoostPointers.h>
 
@@ -48,6 +49,17 @@ namespace MTV{
       doMotionBlur = on;
     }
 
+    // When batching is on, widgets deposit their geometry into a
+    // RenderBatch that is submitted with a few vertex array draw
+    // calls per frame, rather than drawing in immediate mode.
+    void batching(bool on){
+      doBatching = on;
+    }
+
+    const RenderBatch& getRenderBatch() const {
+      return renderBatch;
+    }
+
     // Framebuffer grab.
     //
     // NOTE(choudhury): for some reason, QGLWidget::grabFrameBuffer()
@@ -69,6 +81,24 @@ namespace MTV{
       return frame;
     }
 
+    // Offscreen rendering.  These run the same GL code as the Qt
+    // callbacks do, but against whatever GL context the caller has
+    // made current, without the panel ever being shown (see
+    // OffscreenRenderer).
+    void setupOffscreen(int width, int height){
+      offscreen = true;
+      this->initializeGL();
+      this->resizeGL(width, height);
+    }
+
+    void renderOffscreen(){
+      this->paintGL();
+    }
+
+    bool isOffscreen() const {
+      return offscreen;
+    }
+
   protected:
     // Returns the first widget in the widgets list that contains the
     // point p, or else a null pointer if there is no widget there.
@@ -108,7 +138,11 @@ namespace MTV{
     bool doMotionBlur;
     MotionBlur blur;
 
+    bool doBatching;
+    RenderBatch renderBatch;
+
     bool dumping;
+    bool offscreen;
 
     unsigned long long frame;
 
@@ -0,0 +1,121 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// BlockInterner.cpp
+
+// MTV headers.
+#include <Core/Util/BlockInterner.h>
+using MTV::BlockInterner;
+
+// System headers.
+#include <fstream>
+
+const BlockInterner::id_t BlockInterner::None;
+const std::string BlockInterner::extension = ".blockids";
+const std::string BlockInterner::magicphrase = "mtv block ids";
+
+namespace{
+  const size_t MinCapacity = 1024;
+}
+
+BlockInterner::BlockInterner(unsigned blocksize)
+  : blocksize(blocksize)
+{
+  this->rehash(MinCapacity);
+}
+
+void BlockInterner::reserve(id_t n){
+  size_t capacity = table.size();
+  while(capacity < 2*static_cast<size_t>(n)){
+    capacity *= 2;
+  }
+
+  if(capacity > table.size()){
+    this->rehash(capacity);
+  }
+
+  blocks.reserve(n);
+}
+
+void BlockInterner::clear(){
+  blocks.clear();
+  this->rehash(MinCapacity);
+}
+
+void BlockInterner::rehash(size_t capacity){
+  Slot empty;
+  empty.block = 0;
+  empty.id = None;
+
+  table.assign(capacity, empty);
+
+  shift = 64;
+  for(size_t c = capacity; c > 1; c >>= 1){
+    shift--;
+  }
+
+  // IDs do not change, only the slots they occupy.
+  for(id_t i=0; i<blocks.size(); i++){
+    Slot *s = this->probe(blocks[i]);
+    s->block = blocks[i];
+    s->id = i;
+  }
+}
+
+bool BlockInterner::save(const std::string& filename) const {
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  if(!out){
+    return false;
+  }
+
+  // Header: magic phrase, block size, and number of blocks; then the
+  // block numbers in ID order.
+  const uint32_t bs = blocksize;
+  const uint64_t count = blocks.size();
+
+  out.write(magicphrase.c_str(), magicphrase.length());
+  out.write(reinterpret_cast<const char *>(&bs), sizeof(bs));
+  out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+  if(count > 0){
+    out.write(reinterpret_cast<const char *>(&blocks[0]), count*sizeof(blocks[0]));
+  }
+
+  return static_cast<bool>(out);
+}
+
+BlockInterner::ptr BlockInterner::load(const std::string& filename){
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  if(!in){
+    return BlockInterner::ptr();
+  }
+
+  std::string magic(magicphrase.length(), '\0');
+  uint32_t bs;
+  uint64_t count;
+
+  in.read(&magic[0], magic.length());
+  in.read(reinterpret_cast<char *>(&bs), sizeof(bs));
+  in.read(reinterpret_cast<char *>(&count), sizeof(count));
+  if(!in or magic != magicphrase or bs == 0 or count >= None){
+    return BlockInterner::ptr();
+  }
+
+  BlockInterner::ptr interner(new BlockInterner(bs));
+  interner->reserve(count);
+
+  std::vector<uint64_t> blocks(count);
+  if(count > 0){
+    in.read(reinterpret_cast<char *>(&blocks[0]), count*sizeof(blocks[0]));
+    if(!in){
+      return BlockInterner::ptr();
+    }
+  }
+
+  for(uint64_t i=0; i<count; i++){
+    if(interner->intern_block(blocks[i]) != i){
+      // Duplicate entry - the file is corrupt.
+      return BlockInterner::ptr();
+    }
+  }
+
+  return interner;
+}
@@ -0,0 +1,136 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// BlockInterner.h - Maps the distinct block addresses in a trace to
+// dense 32-bit IDs, in order of first appearance, so that per-block
+// data can live in flat arrays instead of hash tables keyed by
+// address.  The mapping can be saved as a side file next to the
+// trace (see mtrintern) and loaded back later (see mtr2blockstream).
+
+#ifndef BLOCK_INTERNER_H
+#define BLOCK_INTERNER_H
+
+// MTV headers.
+#include <Core/Util/BoostPointers.h>
+#include <Tools/ReferenceTrace/mtrtools.h>
+
+// System headers.
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace MTV{
+  class BlockInterner{
+  public:
+    BoostPointers(BlockInterner);
+
+  public:
+    typedef uint32_t id_t;
+
+    // Returned by find() for blocks that have not been interned.
+    static const id_t None = 0xffffffff;
+
+    // The side file extension, and its magic phrase.
+    static const std::string extension;
+    static const std::string magicphrase;
+
+  public:
+    // With a block size of 1, whole addresses are interned.
+    BlockInterner(unsigned blocksize = 1);
+
+    unsigned block_size() const {
+      return blocksize;
+    }
+
+    // The number of distinct blocks interned so far; the IDs are 0
+    // through size() - 1.
+    id_t size() const {
+      return blocks.size();
+    }
+
+    // Returns the ID of the block containing "addr", assigning it the
+    // next ID if it is new.
+    id_t intern(MTR::addr_t addr){
+      return this->intern_block(addr / blocksize);
+    }
+
+    id_t intern_block(uint64_t block){
+      Slot *s = this->probe(block);
+      if(s->id == None){
+        if(2*(blocks.size() + 1) > table.size()){
+          this->grow();
+          s = this->probe(block);
+        }
+
+        s->block = block;
+        s->id = blocks.size();
+        blocks.push_back(block);
+      }
+
+      return s->id;
+    }
+
+    // Returns the ID of the block containing "addr", or None.
+    id_t find(MTR::addr_t addr) const {
+      return this->find_block(addr / blocksize);
+    }
+
+    id_t find_block(uint64_t block) const {
+      return const_cast<BlockInterner *>(this)->probe(block)->id;
+    }
+
+    // The block number (address / block size) with a given ID.
+    uint64_t block(id_t id) const {
+      return blocks[id];
+    }
+
+    void reserve(id_t n);
+
+    void clear();
+
+    // Saves the mapping to, or loads it from, a side file.
+    bool save(const std::string& filename) const;
+    static ptr load(const std::string& filename);
+
+    // The conventional side file name for a trace.
+    static std::string sidefile(const std::string& tracefile){
+      return tracefile + extension;
+    }
+
+  private:
+    struct Slot{
+      uint64_t block;
+      id_t id;
+    };
+
+    // Finds the slot holding "block", or the empty slot where it
+    // would go (open addressing with linear probing).
+    Slot *probe(uint64_t block){
+      const size_t mask = table.size() - 1;
+      for(size_t i = (block * 0x9e3779b97f4a7c15ULL) >> shift; ; i = (i + 1) & mask){
+        if(table[i].id == None or table[i].block == block){
+          return &table[i];
+        }
+      }
+    }
+
+    void rehash(size_t capacity);
+
+    void grow(){
+      this->rehash(2*table.size());
+    }
+
+  private:
+    unsigned blocksize;
+
+    // The table size is a power of two, kept at most half full; the
+    // hash takes the top bits of a multiplicative hash.
+    std::vector<Slot> table;
+    unsigned shift;
+
+    std::vector<uint64_t> blocks;
+  };
+}
+
+#endif
@@ -4,14 +4,22 @@
 
 // MTV includes.
 #include <Marino/DeltaMementoRecorder.h>
+using MTV::ChunkedDeltaMementoRecorder;
 using MTV::DeltaMementoRecorder;
 using MTV::ImmediateDeltaMementoRecorder;
 
+// Boost includes.
+#include <boost/bind.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
 // // Protobuf includes.
 // #include <google/protobuf/text_format.h>
 // using google::protobuf::TextFormat;
 
 // System includes.
+#include <algorithm>
 #include <iostream>
 #include <string>
 
@@ -37,7 +45,10 @@ ImmediateDeltaMementoRecorder::~ImmediateDeltaMementoRecorder(){
   out.close();
 }
 
-void ImmediateDeltaMementoRecorder::consume(const DeltaMemento& delta){
+void ImmediateDeltaMementoRecorder::consume(const DeltaMemento& _delta){
+  DeltaMemento scratch;
+  const DeltaMemento& delta = this->stamp(_delta, scratch);
+
   // Write the message size out to disk.
   const int size = delta.ByteSize();
   out.write(reinterpret_cast<const char *>(&size), sizeof(size));
@@ -45,3 +56,145 @@ void ImmediateDeltaMementoRecorder::consume(const DeltaMemento& delta){
   // Serialize the message itself.
   delta.SerializeToOstream(&out);
 }
+
+// The number of chunks allowed to wait for the writer thread before
+// consume() blocks.
+static const unsigned MaxPendingChunks = 4;
+
+const char ChunkedDeltaMementoRecorder::Magic[8] = {'M', 'T', 'V', 'X', 'D', 'M', 'C', 'I'};
+
+ChunkedDeltaMementoRecorder::ChunkedDeltaMementoRecorder(const std::string& filename, unsigned chunksize)
+  : out(filename.c_str(), std::ios::binary),
+    chunksize(std::max(chunksize, 1u)),
+    done(false),
+    failed(!out)
+{
+  current.header.count = 0;
+
+  if(failed){
+    return;
+  }
+
+  // Write out the type code.
+  const DeltaMementoRecorder::FileType code = DeltaMementoRecorder::Chunked;
+  out.write(reinterpret_cast<const char *>(&code), sizeof(DeltaMementoRecorder::Chunked));
+
+  worker = boost::thread(boost::bind(&ChunkedDeltaMementoRecorder::work, this));
+}
+
+ChunkedDeltaMementoRecorder::~ChunkedDeltaMementoRecorder(){
+  if(!worker.joinable()){
+    return;
+  }
+
+  // Send out the last partial chunk, then wait for the writer to
+  // drain the queue.
+  if(current.header.count > 0){
+    this->flush();
+  }
+
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    done = true;
+  }
+  ready.notify_one();
+  worker.join();
+
+  // Write the index and the footer that locates it.
+  Footer footer;
+  footer.index_offset = out.tellp();
+  footer.chunks = index.size();
+  std::copy(Magic, Magic + sizeof(Magic), footer.magic);
+
+  if(!index.empty()){
+    out.write(reinterpret_cast<const char *>(&index[0]), index.size()*sizeof(IndexEntry));
+  }
+  out.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+
+  out.close();
+}
+
+ChunkedDeltaMementoRecorder::operator bool() const {
+  boost::mutex::scoped_lock lock(mutex);
+  return !failed;
+}
+
+void ChunkedDeltaMementoRecorder::consume(const DeltaMemento& _delta){
+  DeltaMemento scratch;
+  const DeltaMemento& delta = this->stamp(_delta, scratch);
+
+  // Append the size-prefixed message to the current chunk.
+  const int size = delta.ByteSize();
+  current.payload.append(reinterpret_cast<const char *>(&size), sizeof(size));
+  delta.AppendToString(&current.payload);
+
+  if(current.header.count == 0){
+    current.header.first = delta.trace_index();
+  }
+  current.header.last = delta.trace_index();
+
+  if(++current.header.count == chunksize){
+    this->flush();
+  }
+}
+
+void ChunkedDeltaMementoRecorder::flush(){
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    while(pending.size() >= MaxPendingChunks){
+      space.wait(lock);
+    }
+
+    pending.push_back(Chunk());
+    pending.back().payload.swap(current.payload);
+    pending.back().header = current.header;
+  }
+  ready.notify_one();
+
+  current.header.count = 0;
+}
+
+void ChunkedDeltaMementoRecorder::work(){
+  while(true){
+    Chunk chunk;
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      while(pending.empty() and !done){
+        ready.wait(lock);
+      }
+
+      if(pending.empty()){
+        return;
+      }
+
+      chunk.payload.swap(pending.front().payload);
+      chunk.header = pending.front().header;
+      pending.pop_front();
+    }
+    space.notify_one();
+
+    // Compress the chunk (the filtering stream flushes everything out
+    // to the string when it goes out of scope).
+    std::string compressed;
+    {
+      boost::iostreams::filtering_ostream z;
+      z.push(boost::iostreams::gzip_compressor());
+      z.push(boost::iostreams::back_inserter(compressed));
+      z.write(chunk.payload.data(), chunk.payload.size());
+    }
+
+    IndexEntry entry;
+    entry.offset = out.tellp();
+    entry.header = chunk.header;
+    entry.header.bytes = compressed.size();
+    index.push_back(entry);
+
+    out.write(reinterpret_cast<const char *>(&entry.header), sizeof(entry.header));
+    out.write(compressed.data(), compressed.size());
+
+    if(!out){
+      boost::mutex::scoped_lock lock(mutex);
+      failed = true;
+    }
+  }
+}
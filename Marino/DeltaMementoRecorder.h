@@ -3,7 +3,8 @@
 // Copyright 2010 A.N.M. Imroz Choudhury, all rights reserved
 //
 // DeltaMementoRecorder.h - An object that consumes DeltaMemento
-// objects and serializes them to disk.
+// objects and serializes them to disk, either one at a time
+// (Immediate) or in compressed, indexed chunks (Chunked).
 
 #ifndef DELTA_MEMENTO_RECORDER_H
 #define DELTA_MEMENTO_RECORDER_H
@@ -14,8 +15,15 @@
 #include <Marino/Memento.pb.h>
 using MTV::Marino::DeltaMemento;
 
+// Boost includes.
+#include <boost/thread.hpp>
+
 // System includes.
+#include <deque>
 #include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
 
 namespace MTV{
   class DeltaMementoRecorder : public Consumer<DeltaMemento> {
@@ -31,13 +39,40 @@ namespace MTV{
     };
 
   public:
+    DeltaMementoRecorder()
+      : traceIndex(0)
+    {}
+
     virtual ~DeltaMementoRecorder() {};
 
+    // Mementos that arrive without a trace index are stamped with this
+    // one before being written (the producers generally don't know
+    // where in the trace they are, but the driver does).
+    void setTraceIndex(uint64_t index){
+      traceIndex = index;
+    }
+
     // TODO(choudhury): see if it's worthwhile to implement this:
     // http://www.artima.com/cppsource/safebool.html
     virtual operator bool() const = 0;
 
     virtual void consume(const DeltaMemento& delta) = 0;
+
+  protected:
+    // Returns the delta itself if it carries a trace index, and
+    // otherwise a stamped copy of it placed in "scratch".
+    const DeltaMemento& stamp(const DeltaMemento& delta, DeltaMemento& scratch) const {
+      if(delta.has_trace_index()){
+        return delta;
+      }
+
+      scratch = delta;
+      scratch.set_trace_index(traceIndex);
+      return scratch;
+    }
+
+  protected:
+    uint64_t traceIndex;
   };
 
   class ImmediateDeltaMementoRecorder : public DeltaMementoRecorder {
@@ -57,6 +92,90 @@ namespace MTV{
   protected:
     std::ofstream out;
   };
+
+  // Collects mementos into chunks of a fixed number of messages, each
+  // of which is gzipped and written out by a background thread.  The
+  // file looks like:
+  //
+  //   type code | chunk | chunk | ... | index | footer
+  //
+  // where each chunk is a ChunkHeader followed by the compressed
+  // bytes (which, once inflated, have the same size-prefixed layout as
+  // an Immediate file), the index is one IndexEntry per chunk, and the
+  // footer locates the index.  A file missing its index (because the
+  // recorder never finished) can still be read by walking the chunk
+  // headers.
+  class ChunkedDeltaMementoRecorder : public DeltaMementoRecorder {
+  public:
+    BoostPointers(ChunkedDeltaMementoRecorder);
+
+  public:
+    struct ChunkHeader{
+      uint32_t bytes;
+      uint32_t count;
+
+      // Trace indices of the first and last memento in the chunk.
+      uint64_t first, last;
+    };
+
+    struct IndexEntry{
+      uint64_t offset;
+      ChunkHeader header;
+    };
+
+    struct Footer{
+      uint64_t index_offset;
+      uint64_t chunks;
+      char magic[8];
+    };
+
+    static const char Magic[8];
+
+  public:
+    ChunkedDeltaMementoRecorder(const std::string& filename, unsigned chunksize = 4096);
+
+    // Flushes the last partial chunk and writes out the index.
+    ~ChunkedDeltaMementoRecorder();
+
+    // False once the file could not be opened or the writer thread has
+    // failed to write to it.
+    operator bool() const;
+
+    void consume(const DeltaMemento& delta);
+
+  private:
+    struct Chunk{
+      std::string payload;
+      ChunkHeader header;
+    };
+
+    // Hands the current chunk off to the writer thread, blocking if
+    // too many chunks are already waiting.
+    void flush();
+
+    // The writer thread's main loop.
+    void work();
+
+  private:
+    std::ofstream out;
+    const unsigned chunksize;
+
+    Chunk current;
+
+    std::deque<Chunk> pending;
+    bool done;
+
+    // Published by the writer thread, which owns "out" until it has
+    // been joined.
+    bool failed;
+
+    mutable boost::mutex mutex;
+    boost::condition_variable ready, space;
+    boost::thread worker;
+
+    // Only touched by the writer thread until it has been joined.
+    std::vector<IndexEntry> index;
+  };
 }
 
 #endif
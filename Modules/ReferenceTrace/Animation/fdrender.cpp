@@ -0,0 +1,490 @@
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// fdrender.cpp - Rasterizes the frames of a framedump file to PNG
+// images, entirely on the CPU, with several threads each rendering a
+// contiguous range of frames.
+
+// MTV headers.
+#include <Core/FrameDump.pb.h>
+#include <Core/Color/Color.h>
+#include <Core/Color/ColorGenerator.h>
+#include <Core/Graphics/SplatCanvas.h>
+#include <Core/UI/FrameEncoder.h>
+#include <Modules/ReferenceTrace/Animation/CacheGrouper.h>
+using MTV::CacheGrouper;
+using MTV::Color;
+using MTV::ColorGenerator;
+using MTV::Frame;
+using MTV::FrameEncoder;
+using MTV::SplatCanvas;
+namespace FD = MTV::FrameDump;
+
+// Boost headers.
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread.hpp>
+#include <boost/unordered_map.hpp>
+
+// TCLAP headers.
+#include <tclap/CmdLine.h>
+
+// System headers.
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Rendering parameters shared (read-only) by all the threads.
+struct RenderSpec{
+  std::string input, output;
+  std::vector<std::streamoff> offsets;
+
+  int width, height;
+  unsigned subframes;
+  float decay;
+  float glyphSize;
+  Color background;
+  std::string colorgenspec;
+};
+
+// Reads out the framedump at the given index.
+bool readFrame(std::ifstream& in, const RenderSpec& spec, unsigned k, FD::FrameDump& frame){
+  in.clear();
+  in.seekg(spec.offsets[k]);
+
+  int size;
+  in.read(reinterpret_cast<char *>(&size), sizeof(size));
+  if(!in or size < 0){
+    return false;
+  }
+
+  std::string buf(size, '\0');
+  in.read(&buf[0], size);
+  if(!in){
+    return false;
+  }
+
+  return frame.ParseFromString(buf);
+}
+
+// The fraction of a pulse's full strength at time t (in [0, 1]), for
+// a pulse peaking at the given apex.
+float pulse(float t, float apex){
+  if(t < apex){
+    return apex > 0.0f ? t / apex : 1.0f;
+  }
+  return apex < 1.0f ? (1.0f - t) / (1.0f - apex) : 1.0f;
+}
+
+Color paletteColor(ColorGenerator& colorgen, unsigned index){
+  switch(index){
+  case FD::FrameDump::Activity::CacheMissColor:
+  case FD::FrameDump::Activity::WriteBackDirtyColor:
+    return Color::red;
+
+  case FD::FrameDump::Activity::WriteBackCleanColor:
+    return Color(0.8, 0.8, 0.8);
+
+  case FD::FrameDump::Activity::BlankColor:
+    return Color(0.0, 0.0, 0.0, 0.0);
+
+  default:
+    return colorgen.color(index);
+  }
+}
+
+ColorGenerator::ptr makeColorGenerator(const std::string& spec){
+  if(spec == "q9s1m1"){
+    return boost::make_shared<MTV::ColorbrewerQualitative9_Set1_Mod1>();
+  }
+  else if(spec == "q9s1m2"){
+    return boost::make_shared<MTV::ColorbrewerQualitative9_Set1_Mod2>();
+  }
+
+  return ColorGenerator::ptr();
+}
+
+typedef std::pair<uint64_t, unsigned> GlyphKey;
+
+// Draws the glyphs of keyframe "cur" at fraction t of the way to
+// keyframe "next" (whose glyph positions are indexed by "where").
+void drawFrame(SplatCanvas& canvas,
+               ColorGenerator& colorgen,
+               const RenderSpec& spec,
+               const FD::FrameDump& cur,
+               const FD::FrameDump *next,
+               const boost::unordered_map<GlyphKey, int>& where,
+               float t){
+  // Collect the activities affecting each glyph during this interval.
+  boost::unordered_map<GlyphKey, const FD::FrameDump::Activity *> colorPulse, sizePulse, colorChange, birth, death;
+  for(int i=0; i<cur.activity_size(); i++){
+    const FD::FrameDump::Activity& a = cur.activity(i);
+    const GlyphKey key(a.id(), a.ghost());
+
+    switch(a.type()){
+    case FD::FrameDump::Activity::ColorPulseActivity:
+      colorPulse[key] = &a;
+      break;
+
+    case FD::FrameDump::Activity::SizePulseActivity:
+      sizePulse[key] = &a;
+      break;
+
+    case FD::FrameDump::Activity::ColorChangeActivity:
+      colorChange[key] = &a;
+      break;
+
+    case FD::FrameDump::Activity::BirthActivity:
+      birth[key] = &a;
+      break;
+
+    case FD::FrameDump::Activity::DeathActivity:
+      death[key] = &a;
+      break;
+
+    case FD::FrameDump::Activity::PolarInterpolationActivity:
+    case FD::FrameDump::Activity::LinearInterpolationActivity:
+      // NOTE(choudhury): all motion is interpolated linearly.
+      break;
+    }
+  }
+
+  for(int i=0; i<cur.glyph_size(); i++){
+    const FD::FrameDump::Glyph& g = cur.glyph(i);
+    const GlyphKey key(g.id(), g.ghost());
+
+    // Position.
+    float x = g.x(), y = g.y();
+    if(next){
+      boost::unordered_map<GlyphKey, int>::const_iterator n = where.find(key);
+      if(n != where.end()){
+        const FD::FrameDump::Glyph& h = next->glyph(n->second);
+        x += t*(h.x() - x);
+        y += t*(h.y() - y);
+      }
+    }
+
+    // Color.  Ghosts are drawn faded, as CacheGrouper does.
+    Color c = paletteColor(colorgen, g.color());
+    if(g.ghost() > 0){
+      c.a = 0.2;
+    }
+
+    boost::unordered_map<GlyphKey, const FD::FrameDump::Activity *>::const_iterator a;
+    if((a = colorChange.find(key)) != colorChange.end()){
+      const Color target = paletteColor(colorgen, a->second->color_change().color());
+      c = Color(c.r + t*(target.r - c.r), c.g + t*(target.g - c.g), c.b + t*(target.b - c.b), c.a + t*(target.a - c.a));
+    }
+
+    if((a = colorPulse.find(key)) != colorPulse.end()){
+      const FD::FrameDump::Activity::ColorPulse& cp = a->second->color_pulse();
+      const Color target = paletteColor(colorgen, cp.color());
+      const float w = pulse(t, cp.apex());
+      c = Color(c.r + w*(target.r - c.r), c.g + w*(target.g - c.g), c.b + w*(target.b - c.b), c.a);
+    }
+
+    if(birth.find(key) != birth.end()){
+      c.a *= t;
+    }
+    else if(death.find(key) != death.end()){
+      c.a *= 1.0f - t;
+    }
+
+    // Size.
+    float size = spec.glyphSize;
+    if((a = sizePulse.find(key)) != sizePulse.end()){
+      const FD::FrameDump::Activity::SizePulse& sp = a->second->size_pulse();
+      size += pulse(t, sp.apex())*(sp.size() - size);
+    }
+
+    canvas.splat(x, y, size, c);
+  }
+}
+
+// Renders output frames [first, last), returning false if any of
+// them could not be rendered.
+bool renderRange(const RenderSpec *spec, unsigned first, unsigned last){
+  std::ifstream in(spec->input.c_str(), std::ios::binary);
+  if(!in){
+    std::cerr << "error: could not open file '" << spec->input << "' for reading." << std::endl;
+    return false;
+  }
+
+  ColorGenerator::ptr colorgen = makeColorGenerator(spec->colorgenspec);
+  SplatCanvas canvas(spec->width, spec->height);
+  canvas.clear(spec->background);
+
+  // With motion blur on, each frame depends on the ones before it.
+  // The dependence decays geometrically, so rendering enough frames
+  // before the start of the range (until the oldest one contributes
+  // less than half a gray level) makes the result match a
+  // single-threaded render.
+  unsigned start = first;
+  if(spec->decay > 0.0f and spec->decay < 1.0f){
+    const unsigned warmup = static_cast<unsigned>(std::ceil(std::log(1.0f/512.0f) / std::log(1.0f - spec->decay)));
+    start = first > warmup ? first - warmup : 0;
+  }
+
+  const unsigned numKeyframes = spec->offsets.size();
+  FD::FrameDump cur, next;
+  boost::unordered_map<GlyphKey, int> where;
+  unsigned loaded = numKeyframes;
+
+  Frame frame;
+  for(unsigned f=start; f<last; f++){
+    const unsigned k = f / spec->subframes;
+    const float t = static_cast<float>(f % spec->subframes) / spec->subframes;
+
+    // Load the bracketing keyframes, if they have changed.
+    if(k != loaded){
+      if(k == loaded + 1){
+        cur.Swap(&next);
+      }
+      else if(!readFrame(in, *spec, k, cur)){
+        std::cerr << "error: could not read frame " << k << std::endl;
+        return false;
+      }
+
+      where.clear();
+      if(k + 1 < numKeyframes){
+        if(!readFrame(in, *spec, k + 1, next)){
+          std::cerr << "error: could not read frame " << (k + 1) << std::endl;
+          return false;
+        }
+
+        for(int i=0; i<next.glyph_size(); i++){
+          where[GlyphKey(next.glyph(i).id(), next.glyph(i).ghost())] = i;
+        }
+      }
+
+      loaded = k;
+    }
+
+    if(spec->decay > 0.0f){
+      canvas.fade(spec->background, spec->decay);
+    }
+    else{
+      canvas.clear(spec->background);
+    }
+
+    drawFrame(canvas, *colorgen, *spec, cur, k + 1 < numKeyframes ? &next : 0, where, t);
+
+    if(f >= first){
+      frame.width = spec->width;
+      frame.height = spec->height;
+      canvas.toRGBA(frame.rgba);
+
+      std::stringstream filename;
+      filename << spec->output << std::setw(6) << std::setfill('0') << f << ".png";
+      if(!FrameEncoder::writePNG(frame, filename.str())){
+        std::cerr << "error: could not write frame '" << filename.str() << "'" << std::endl;
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+// Thread entry point: records whether the range rendered.
+void renderWorker(const RenderSpec *spec, unsigned first, unsigned last, char *ok){
+  *ok = renderRange(spec, first, last);
+}
+
+int main(int argc, char *argv[]){
+  RenderSpec spec;
+  unsigned first, last, threads;
+
+  try{
+    TCLAP::CmdLine cmd("Render the frames of a framedump file to images.");
+
+    TCLAP::UnlabeledValueArg<std::string> inputArg("framedump",
+                                                   "Framedump file to render.",
+                                                   true,
+                                                   "",
+                                                   "filename",
+                                                   cmd);
+
+    TCLAP::ValueArg<std::string> outputArg("o",
+                                           "output-prefix",
+                                           "Prefix for the output PNG files.",
+                                           false,
+                                           "frame",
+                                           "prefix",
+                                           cmd);
+
+    TCLAP::ValueArg<unsigned> firstArg("",
+                                       "first",
+                                       "First output frame to render.",
+                                       false,
+                                       0,
+                                       "frame",
+                                       cmd);
+
+    TCLAP::ValueArg<unsigned> lastArg("",
+                                      "last",
+                                      "One past the last output frame to render (default: all).",
+                                      false,
+                                      0,
+                                      "frame",
+                                      cmd);
+
+    TCLAP::ValueArg<unsigned> threadsArg("j",
+                                         "threads",
+                                         "Number of rendering threads (default: number of cores).",
+                                         false,
+                                         0,
+                                         "threads",
+                                         cmd);
+
+    TCLAP::ValueArg<unsigned> subframesArg("s",
+                                           "subframes",
+                                           "Number of frames to interpolate from each keyframe to the next.",
+                                           false,
+                                           1,
+                                           "count",
+                                           cmd);
+
+    TCLAP::ValueArg<float> decayArg("b",
+                                    "blur-decay",
+                                    "Motion blur decay rate (0 disables motion blur).",
+                                    false,
+                                    0.2,
+                                    "rate",
+                                    cmd);
+
+    TCLAP::ValueArg<int> widthArg("",
+                                  "width",
+                                  "Image width.",
+                                  false,
+                                  1280,
+                                  "pixels",
+                                  cmd);
+
+    TCLAP::ValueArg<int> heightArg("",
+                                   "height",
+                                   "Image height.",
+                                   false,
+                                   720,
+                                   "pixels",
+                                   cmd);
+
+    TCLAP::ValueArg<std::string> colorgenspecArg("g",
+                                                 "colorgen",
+                                                 "Color generator selector",
+                                                 false,
+                                                 "q9s1m1",
+                                                 "name",
+                                                 cmd);
+
+    cmd.parse(argc, argv);
+
+    spec.input = inputArg.getValue();
+    spec.output = outputArg.getValue();
+    first = firstArg.getValue();
+    last = lastArg.getValue();
+    threads = threadsArg.getValue();
+    spec.subframes = subframesArg.getValue();
+    spec.decay = decayArg.getValue();
+    spec.width = widthArg.getValue();
+    spec.height = heightArg.getValue();
+    spec.colorgenspec = colorgenspecArg.getValue();
+  }
+  catch(TCLAP::ArgException& e){
+    std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+    exit(1);
+  }
+
+  if(spec.subframes == 0){
+    std::cerr << "error: subframes must be at least 1" << std::endl;
+    exit(1);
+  }
+
+  if(!makeColorGenerator(spec.colorgenspec)){
+    std::cerr << "error: invalid color generator '" << spec.colorgenspec << "'" << std::endl;
+    exit(1);
+  }
+
+  spec.glyphSize = CacheGrouper::widgetSize;
+  spec.background = Color::white;
+
+  // Index the file: skip the header, and record the offset of each
+  // frame.
+  std::ifstream in(spec.input.c_str(), std::ios::binary);
+  if(!in){
+    std::cerr << "error: could not open file '" << spec.input << "' for reading." << std::endl;
+    exit(1);
+  }
+
+  // Each message is prefixed with its size; seeking past the end of
+  // the file does not fail, so the sizes are checked against its
+  // length instead.
+  in.seekg(0, std::ios::end);
+  const std::streamoff length = in.tellg();
+  in.seekg(0, std::ios::beg);
+
+  int size;
+  in.read(reinterpret_cast<char *>(&size), sizeof(size));
+  if(!in or size < 0 or static_cast<std::streamoff>(sizeof(size)) + size > length){
+    std::cerr << "error: could not read the header of '" << spec.input << "'." << std::endl;
+    exit(1);
+  }
+  in.seekg(size, std::ios::cur);
+
+  while(true){
+    const std::streamoff offset = in.tellg();
+    if(offset == length){
+      break;
+    }
+
+    in.read(reinterpret_cast<char *>(&size), sizeof(size));
+    if(!in or size < 0 or offset + static_cast<std::streamoff>(sizeof(size)) + size > length){
+      std::cerr << "error: frame " << spec.offsets.size() << " of '" << spec.input << "' is truncated." << std::endl;
+      exit(1);
+    }
+
+    spec.offsets.push_back(offset);
+    in.seekg(size, std::ios::cur);
+  }
+  in.close();
+
+  const unsigned total = spec.offsets.size() * spec.subframes;
+  if(last == 0 or last > total){
+    last = total;
+  }
+  if(first >= last){
+    std::cerr << "error: empty frame range [" << first << ", " << last << ")" << std::endl;
+    exit(1);
+  }
+
+  if(threads == 0){
+    threads = std::max(1u, boost::thread::hardware_concurrency());
+  }
+
+  // Divide the frames into contiguous ranges, one per thread.  Each
+  // thread reports its success in its own slot (so that none of them
+  // share a byte, as they would with a vector<bool>).
+  const unsigned count = last - first;
+  std::vector<char> ok(threads, 1);
+  boost::thread_group workers;
+  for(unsigned i=0; i<threads; i++){
+    const unsigned a = first + (count * i) / threads;
+    const unsigned b = first + (count * (i + 1)) / threads;
+    if(a < b){
+      workers.create_thread(boost::bind(&renderWorker, &spec, a, b, &ok[i]));
+    }
+  }
+  workers.join_all();
+
+  if(std::find(ok.begin(), ok.end(), 0) != ok.end()){
+    std::cerr << "error: some frames could not be rendered." << std::endl;
+    exit(1);
+  }
+
+  std::cout << count << " frames rendered." << std::endl;
+  return 0;
+}
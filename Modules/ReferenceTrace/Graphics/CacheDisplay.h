@@ -35,6 +35,10 @@ namespace MTV{
       this->drawChildren();
     }
 
+    void batch(RenderBatch& b) const {
+      this->batchChildren(b);
+    }
+
     void setShellColor(const Color& c){
       glyph->setShellColor(c);
     }
@@ -99,6 +103,10 @@ namespace MTV{
       return this->drawChildren();
     }
 
+    void batch(RenderBatch& b) const {
+      this->batchChildren(b);
+    }
+
     void setShellColor(unsigned L, const Color& c){
       levels[L]->setShellColor(c);
     }
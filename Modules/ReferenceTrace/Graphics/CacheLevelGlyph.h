@@ -39,6 +39,10 @@ namespace MTV{
       this->drawChildren();
     }
 
+    void batch(RenderBatch& b) const {
+      this->batchChildren(b);
+    }
+
     void setShellColor(const Color& c){
       backplate->setColor(c);
     }
@@ -73,6 +73,10 @@ namespace MTV{
       this->drawChildren();
     }
 
+    void batch(RenderBatch& b) const {
+      this->batchChildren(b);
+    }
+
     void setShellColor(CacheLevel::ptr which, const Color& c){
       CacheLevelGlyph::ptr glyph = this->getGlyph(which);
       glyph->setShellColor(c);
@@ -9,6 +9,7 @@ using MTV::CacheTemperatureDisplay;
 using MTV::FadingPoint;
 using MTV::FadingRing;
 using MTV::Point;
+using MTV::RenderBatch;
 using MTV::SolidRectangle;
 using MTV::Widget;
 
@@ -45,3 +46,7 @@ bool CacheTemperatureDisplay::contains(const Point& p){
 void CacheTemperatureDisplay::draw() const {
   this->drawChildren();
 }
+
+void CacheTemperatureDisplay::batch(RenderBatch& b) const {
+  this->batchChildren(b);
+}
@@ -48,6 +48,7 @@ namespace MTV{
     // From the Widget interface.
     bool contains(const Point& p);
     void draw() const;
+    void batch(RenderBatch& b) const;
 
   private:
     FadingPoint::ptr center;
@@ -7,6 +7,7 @@
 #include <Modules/ReferenceTrace/Graphics/RegionDisplay.h>
 using MTV::Color;
 using MTV::RegionDisplay;
+using MTV::RenderBatch;
 using MTV::SolidRectangle;
 using MTV::StripedQuad;
 using MTV::Tick;
@@ -114,3 +115,7 @@ bool RegionDisplay::contains(const Point& p){
 void RegionDisplay::draw() const {
   this->drawChildren();
 }
+
+void RegionDisplay::batch(RenderBatch& b) const {
+  this->batchChildren(b);
+}
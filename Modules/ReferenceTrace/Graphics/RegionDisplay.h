@@ -43,6 +43,7 @@ namespace MTV{
     // From the Widget interface.
     bool contains(const Point& p);
     void draw() const;
+    void batch(RenderBatch& b) const;
 
   private:
     Color shell;
@@ -14,6 +14,7 @@
 #include <Core/Dataflow/CacheAccessRecord.h>
 #include <Core/Dataflow/CacheStatusReport.h>
 #include <Core/Dataflow/Consumer.h>
+#include <Core/Dataflow/Instrumentation.h>
 #include <Core/Dataflow/LineRecordFilter.h>
 #include <Core/Dataflow/MemoryRecordFilter.h>
 #include <Core/Dataflow/Repeater.h>
@@ -53,6 +54,12 @@ namespace MTV{
       // Connect the catchall cache event render director to the
       // address-stop filter.
       catchall->Producer<CacheAccessRecord>::addConsumer(catchallCacheEventRenderDirector);
+
+      Instrumentation::name(MRecordRepeater, "trace repeater");
+      Instrumentation::name(cacheStatusRepeater, "cache status repeater");
+      Instrumentation::name(cacheAccessRepeater, "cache access repeater");
+      Instrumentation::name(catchall, "catchall");
+      Instrumentation::name(catchallCacheEventRenderDirector, "catchall event director");
     }
 
     Repeater<MTR::Record>::ptr getTraceRepeater() { return MRecordRepeater; }
@@ -137,6 +144,12 @@ namespace MTV{
       regionRenderers.push_back(renderer);
       cacheEventRenderDirectors.push_back(eventDirector);
 
+      Instrumentation::name(rangePass, truetitle + " range pass");
+      Instrumentation::name(director, truetitle + " record director");
+      Instrumentation::name(statusDirector, truetitle + " status director");
+      Instrumentation::name(eventDirector, truetitle + " event director");
+      Instrumentation::name(renderer, truetitle + " renderer");
+
       // Return the renderer pointer, as it will be useful to display
       // classes.
       return renderer;
@@ -145,6 +158,7 @@ namespace MTV{
     CacheRenderer::ptr renderCache(Cache::const_ptr cache){
       // Create a new cache renderer.
       cacheRenderer = CacheRenderer::ptr(new CacheRenderer(cache, 100));
+      Instrumentation::name(cacheRenderer, "cache renderer");
 
       // Connect all the cache event render directors to the new renderer.
       foreach(CacheEventRenderDirector::ptr d, cacheEventRenderDirectors){
@@ -3,6 +3,7 @@
 // WaxlampCacheNetwork.cpp
 
 // MTV headers.
+#include <Core/Dataflow/Instrumentation.h>
 #include <Core/Dataflow/Printer.h>
 #include <Core/Geometry/ParameterAffineRemapper.h>
 #include <Core/Geometry/RandomAnnulus.h>
@@ -20,6 +21,7 @@ using MTV::ColorbrewerQualitative9_Set1;
 using MTV::ColorbrewerQualitative11_Paired;
 using MTV::FadingPoint;
 using MTV::GLPoint;
+using MTV::Instrumentation;
 using MTV::LineCacheMissCounter;
 using MTV::LineRecordFilter;
 using MTV::LineVisitCounter;
@@ -31,6 +33,9 @@ using MTV::RandomDisc;
 using MTV::WaxlampCacheNetwork;
 using MTV::Widget;
 
+// System headers.
+#include <sstream>
+
 WaxlampCacheNetwork::WaxlampCacheNetwork(Cache::ptr c, bool animating, float duration, Clock::ptr clock, ColorGenerator::ptr colorgen)
   : mfilter(boost::make_shared<MemoryRecordFilter>()),
     lfilter(boost::make_shared<LineRecordFilter>()),
@@ -87,6 +92,16 @@ WaxlampCacheNetwork::WaxlampCacheNetwork(Cache::ptr c, bool animating, float dur
 
   // Attach the counter to the temperature renderer.
   perf->addConsumer(temperature);
+
+  // Label the nodes for the dataflow stats (the optional counters are
+  // labeled by type).
+  Instrumentation::name(MRecordRepeater, "trace repeater");
+  Instrumentation::name(mfilter, "memory record filter");
+  Instrumentation::name(lfilter, "line record filter");
+  Instrumentation::name(simulator, "cache simulator");
+  Instrumentation::name(perf, "performance counter");
+  Instrumentation::name(temperature, "temperature renderer");
+  Instrumentation::name(cacheGrouper, "cache grouper");
 }
 
 std::vector<Widget::ptr> WaxlampCacheNetwork::addRegion(MTR::addr_t base, MTR::size_t size, MTR::size_t type){
@@ -114,6 +129,10 @@ std::vector<Widget::ptr> WaxlampCacheNetwork::addRegion(MTR::addr_t base, MTR::s
   simulator->Producer<CacheAccessRecord>::addConsumer(pass);
   pass->Producer<CacheAccessRecord>::addConsumer(cacheGrouper);
 
+  std::stringstream name;
+  name << "range pass 0x" << std::hex << base;
+  Instrumentation::name(pass, name.str());
+
   std::cout << "adding range pass:" << std::endl;
   // pass->print();
 
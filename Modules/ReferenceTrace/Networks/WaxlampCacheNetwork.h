@@ -27,6 +27,9 @@
 #include <Modules/ReferenceTrace/Renderers/CacheTemperatureRenderer.h>
 #include <Tools/CacheSimulator/Cache.h>
 
+// Boost headers.
+#include <boost/bind.hpp>
+
 // System headers.
 #include <fstream>
 #include <iostream>
@@ -139,7 +142,13 @@ namespace MTV{
     }
 
     void hitLevelCounter(WidgetPanel::ptr panel, const std::string& filename){
-      hitlevelcounter = boost::make_shared<HitLevelCounter>(panel);
+      // Tag each record with the panel's current animation frame.
+      HitLevelCounter::FrameSource frame;
+      if(panel){
+        frame = boost::bind(&WidgetPanel::getFrame, panel);
+      }
+
+      hitlevelcounter = boost::make_shared<HitLevelCounter>(frame);
       hitlevelcounter->open(filename);
 
       simulator->Producer<CacheAccessRecord>::addConsumer(hitlevelcounter);
@@ -8,7 +8,7 @@
 #include <Core/Dataflow/AddressRangeFilter.h>
 #include <Core/Dataflow/MemoryRecordFilter.h>
 #include <Core/Dataflow/Printer.h>
-#include <Core/Dataflow/TraceReader.h>
+#include <Core/Dataflow/QtTraceReader.h>
 #include <Core/UI/WidgetPanel.h>
 #include <Modules/ReferenceTrace/Dataflow/RecordRenderDirector.h>
 #include <Modules/ReferenceTrace/Renderers/RegionRenderer.h>
@@ -0,0 +1,844 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// mtvx-bench.cpp - Measures the throughput of each stage of the trace
+// processing pipeline (trace I/O, the two cache simulators, block
+// streams, and the performance counters) on a standard workload, and
+// writes the results to a JSON file for tracking across versions.
+
+// TCLAP headers.
+#include <tclap/CmdLine.h>
+
+// MTV headers.
+#include <Core/Dataflow/BlockStream/BlockStreamReader.h>
+#include <Core/Dataflow/CacheAccessRecord.h>
+#include <Core/Dataflow/CachePerformanceCounter.h>
+#include <Core/Dataflow/Instrumentation.h>
+#include <Core/Dataflow/TraceReader.h>
+#include <Core/Dataflow/TraceWriter.h>
+#include <Core/Util/Timing.h>
+#include <Tools/CacheSimulator/Cache.h>
+#include <Tools/NewCacheSimulator/NewCache.h>
+#include <Tools/ReferenceTrace/mtrtools.h>
+using MTV::BlockStreamReader;
+using MTV::CacheAccessRecord;
+using MTV::CacheLevel;
+using MTV::Instrumentation;
+using MTV::NewCache;
+using MTV::PerformanceCounterPolicy;
+using MTV::TraceReader;
+using MTV::TraceWriter;
+using MTV::WallClock;
+
+// Boost headers.
+#include <boost/filesystem.hpp>
+
+// System headers.
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Every allocation in the process is counted, so that each stage can
+// report its allocations per record.
+MTV_INSTRUMENT_ALLOCATIONS
+
+namespace{
+  // Accumulates wall time and allocations over one or more timed
+  // spans.
+  class Stopwatch{
+  public:
+    Stopwatch()
+      : seconds(0.0),
+        allocs(0),
+        allocs_start(0)
+    {}
+
+    void start(){
+      clock = WallClock();
+      allocs_start = Instrumentation::allocationCount();
+    }
+
+    void stop(){
+      seconds += clock.noww();
+      allocs += Instrumentation::allocationCount() - allocs_start;
+    }
+
+  public:
+    double seconds;
+    unsigned long long allocs;
+
+  private:
+    WallClock clock;
+    unsigned long long allocs_start;
+  };
+
+  struct Result{
+    std::string stage;
+    uint64_t records;
+    uint64_t bytes;
+    double seconds;
+
+    // Negative when the stage runs out of process.
+    long long allocations;
+
+    // Demand misses at each cache level per demand access reaching
+    // that level, for stages that simulate a NewCache (empty
+    // otherwise).
+    std::vector<double> miss_rates;
+  };
+
+  struct Options{
+    std::string workload, tracefile, scratch, mtr2blockstream;
+    uint64_t records, working_set;
+    unsigned blocksize, seed, streams;
+    std::vector<std::string> stages;
+  };
+
+  // A stage runs if no stages were requested, or if its name starts
+  // with one of the requested names (so "new-cache" selects every
+  // NewCache stage).
+  bool selected(const Options& opts, const std::string& stage){
+    if(opts.stages.empty()){
+      return true;
+    }
+
+    for(unsigned i=0; i<opts.stages.size(); i++){
+      if(stage.compare(0, opts.stages[i].size(), opts.stages[i]) == 0){
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  // Whether any stage in the named group will run.
+  bool group_selected(const Options& opts, const std::string& group){
+    if(opts.stages.empty()){
+      return true;
+    }
+
+    for(unsigned i=0; i<opts.stages.size(); i++){
+      const std::string& s = opts.stages[i];
+      if(s.compare(0, group.size(), group) == 0 or group.compare(0, s.size(), s) == 0){
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  Result make_result(const std::string& stage, uint64_t records, const Stopwatch& sw){
+    Result r;
+    r.stage = stage;
+    r.records = records;
+    r.bytes = records * sizeof(MTR::Record);
+    r.seconds = sw.seconds;
+    r.allocations = sw.allocs;
+
+    return r;
+  }
+
+  // Generates "n" memory records (three loads to each store) over a
+  // working set of "ws" bytes.
+  bool generate(const Options& opts, std::vector<MTR::Record>& trace){
+    srand48(opts.seed);
+
+    const uint64_t ws = opts.working_set;
+    const uint64_t stride = 4 * opts.blocksize;
+    const uint64_t base = 0x10000000;
+
+    trace.resize(opts.records);
+    for(uint64_t i=0; i<opts.records; i++){
+      uint64_t offset;
+      if(opts.workload == "sequential"){
+        offset = (8*i) % ws;
+      }
+      else if(opts.workload == "strided"){
+        // Walk the working set in strides, shifting over by one word
+        // after each pass.
+        const uint64_t per_pass = ws / stride;
+        offset = ((i % per_pass)*stride + 8*(i / per_pass)) % ws;
+      }
+      else if(opts.workload == "random"){
+        offset = static_cast<uint64_t>(drand48() * (ws / 8)) * 8;
+      }
+      else{
+        return false;
+      }
+
+      trace[i].addr = base + offset;
+      trace[i].code = (i % 4 == 3) ? MTR::Record::Write : MTR::Record::Read;
+    }
+
+    return true;
+  }
+
+  bool load(const std::string& filename, std::vector<MTR::Record>& trace){
+    TraceReader reader;
+    if(!reader.open(filename)){
+      return false;
+    }
+
+    try{
+      while(true){
+        trace.push_back(reader.nextRecord());
+      }
+    }
+    catch(TraceReader::End){}
+
+    return true;
+  }
+
+  Result write_trace(const std::string& stage, const std::vector<MTR::Record>& trace, const std::string& filename, TraceWriter::Encoding encoding){
+    Stopwatch sw;
+    sw.start();
+    {
+      TraceWriter writer(encoding);
+      if(!writer.open(filename)){
+        std::cerr << "error: could not open file '" << filename << "' for writing." << std::endl;
+        exit(1);
+      }
+
+      for(size_t i=0; i<trace.size(); i++){
+        writer.consume(trace[i]);
+      }
+    }
+    sw.stop();
+
+    return make_result(stage, trace.size(), sw);
+  }
+
+  Result read_trace(const std::string& stage, const std::string& filename){
+    Stopwatch sw;
+    uint64_t n = 0;
+
+    sw.start();
+    TraceReader reader;
+    if(!reader.open(filename)){
+      std::cerr << "error: could not open file '" << filename << "' for reading." << std::endl;
+      exit(1);
+    }
+
+    try{
+      while(true){
+        reader.nextRecord();
+        n++;
+      }
+    }
+    catch(TraceReader::End){}
+    sw.stop();
+
+    return make_result(stage, n, sw);
+  }
+
+  // The standard hierarchy for the cache stages: a 32K, 8-way L1 and a
+  // 256K, 8-way L2, both write-back.
+  const unsigned L1Size = 32*1024;
+  const unsigned L2Size = 256*1024;
+  const unsigned Associativity = 8;
+
+  Daly::Cache::ptr daly_cache(const Options& opts, Daly::EvictionBlockSelector::ptr policy){
+    Daly::Cache::ptr c = boost::make_shared<Daly::Cache>(opts.blocksize, Daly::WriteAllocate, policy, boost::make_shared<Daly::ModtimeTable>());
+    c->addCacheLevel(L1Size, Associativity, Daly::WriteBack);
+    c->addCacheLevel(L2Size, Associativity, Daly::WriteBack);
+
+    return c;
+  }
+
+  NewCache::ptr new_cache(const Options& opts, CacheLevel::ReplacementPolicy policy, TraceReader::ptr reader, BlockStreamReader::ptr bsreader){
+    NewCache::ptr c = NewCache::create(opts.blocksize, NewCache::WriteAllocate);
+    c->set_trace_reader(reader);
+    c->set_blockstream_reader(bsreader);
+
+    const unsigned L1Blocks = L1Size / opts.blocksize;
+    const unsigned L2Blocks = L2Size / opts.blocksize;
+    c->add_level(L1Blocks, L1Blocks / Associativity, CacheLevel::WriteBack, policy);
+    c->add_level(L2Blocks, L2Blocks / Associativity, CacheLevel::WriteBack, policy);
+
+    return c;
+  }
+
+  template<typename CacheType>
+  void access(CacheType& c, const MTR::Record& rec){
+    if(rec.code == MTR::Record::Read){
+      c->load(rec.addr);
+    }
+    else if(rec.code == MTR::Record::Write){
+      c->store(rec.addr);
+    }
+  }
+
+  Result run_daly(const std::string& stage, const Options& opts, const std::vector<MTR::Record>& trace, Daly::EvictionBlockSelector::ptr policy){
+    srand48(opts.seed);
+
+    Stopwatch sw;
+    sw.start();
+    Daly::Cache::ptr c = daly_cache(opts, policy);
+    for(size_t i=0; i<trace.size(); i++){
+      access(c, trace[i]);
+    }
+    sw.stop();
+
+    return make_result(stage, trace.size(), sw);
+  }
+
+  // Replays the trace through a fresh cache, outside any timed
+  // region, and returns the demand miss rate of the first two levels,
+  // each out of the demand accesses that reach that level.
+  std::vector<double> miss_rates(const Options& opts, const std::vector<MTR::Record>& trace, CacheLevel::ReplacementPolicy policy){
+    srand48(opts.seed);
+
+    // A demand miss at a level brings the accessed block into it
+    // (write-backs bring in other blocks).
+    std::vector<uint64_t> misses(2, 0);
+    uint64_t accesses = 0;
+
+    NewCache::ptr c = new_cache(opts, policy, TraceReader::ptr(), BlockStreamReader::ptr());
+    for(size_t i=0; i<trace.size(); i++){
+      if(trace[i].code != MTR::Record::Read and trace[i].code != MTR::Record::Write){
+        continue;
+      }
+
+      access(c, trace[i]);
+      accesses++;
+
+      const uint64_t block_addr = trace[i].addr / opts.blocksize;
+      const std::vector<Daly::CacheEntranceRecord>& entrances = c->entranceInfo();
+      for(size_t j=0; j<entrances.size(); j++){
+        if(entrances[j].blockaddr == block_addr and entrances[j].L < misses.size()){
+          misses[entrances[j].L]++;
+        }
+      }
+    }
+
+    // The accesses that reach each level are the misses in the one
+    // above it.
+    std::vector<double> rates;
+    for(unsigned L=0; L<misses.size(); L++){
+      const uint64_t reaching = (L == 0 ? accesses : misses[L-1]);
+      rates.push_back(reaching > 0 ? static_cast<double>(misses[L]) / reaching : 0.0);
+    }
+
+    return rates;
+  }
+
+  Result run_new(const std::string& stage, const Options& opts, const std::vector<MTR::Record>& trace, CacheLevel::ReplacementPolicy policy){
+    srand48(opts.seed);
+
+    Stopwatch sw;
+    sw.start();
+    NewCache::ptr c = new_cache(opts, policy, TraceReader::ptr(), BlockStreamReader::ptr());
+    for(size_t i=0; i<trace.size(); i++){
+      access(c, trace[i]);
+    }
+    sw.stop();
+
+    Result r = make_result(stage, trace.size(), sw);
+    r.miss_rates = miss_rates(opts, trace, policy);
+
+    return r;
+  }
+
+  // OPT and PES look ahead through the block stream from the trace
+  // reader's current position, so these stages are driven by a
+  // reader over the raw trace file (whose cost is included).
+  Result run_new_lookahead(const std::string& stage, const Options& opts, const std::string& tracefile, const std::string& bsfile, CacheLevel::ReplacementPolicy policy){
+    Stopwatch sw;
+    uint64_t n = 0;
+
+    sw.start();
+    TraceReader::ptr reader = boost::make_shared<TraceReader>();
+    BlockStreamReader::ptr bsreader = boost::make_shared<BlockStreamReader>();
+    if(!reader->open(tracefile) or !bsreader->open(bsfile, opts.streams)){
+      std::cerr << "error: could not open trace for stage " << stage << "." << std::endl;
+      exit(1);
+    }
+
+    NewCache::ptr c = new_cache(opts, policy, reader, bsreader);
+    try{
+      while(true){
+        access(c, reader->nextRecord());
+        n++;
+      }
+    }
+    catch(TraceReader::End){}
+    sw.stop();
+
+    return make_result(stage, n, sw);
+  }
+
+  Result run_mtr2blockstream(const Options& opts, const std::string& tracefile, const std::string& bsfile, uint64_t records, bool& ok){
+    std::stringstream cmd;
+    cmd << "'" << opts.mtr2blockstream << "'"
+        << " -i '" << tracefile << "'"
+        << " -o '" << bsfile << "'"
+        << " -b " << opts.blocksize
+        << " -n " << opts.streams
+        << " >/dev/null 2>&1";
+
+    Stopwatch sw;
+    sw.start();
+    ok = (system(cmd.str().c_str()) == 0);
+    sw.stop();
+
+    Result r = make_result("mtr2blockstream", records, sw);
+    r.allocations = -1;
+
+    return r;
+  }
+
+  Result read_blockstream(const Options& opts, const std::vector<MTR::Record>& trace, const std::string& bsfile){
+    Stopwatch sw;
+    sw.start();
+    BlockStreamReader bsreader;
+    if(!bsreader.open(bsfile, opts.streams)){
+      std::cerr << "error: could not open block stream file '" << bsfile << "'." << std::endl;
+      exit(1);
+    }
+
+    // Ask for each block's next appearance at every point it is used,
+    // as the OPT policy would.  The block stream holds only memory
+    // records, but counts every record, and while record i is being
+    // simulated the trace reader's point is already i + 1.
+    for(size_t i=0; i<trace.size(); i++){
+      if(MTR::type(trace[i]) != MTR::Record::MType){
+        continue;
+      }
+
+      bsreader.next(trace[i].addr / opts.blocksize, i + 1);
+    }
+    sw.stop();
+
+    return make_result("blockstream-read", trace.size(), sw);
+  }
+
+  // The counters are timed over pre-simulated chunks of access
+  // records, so that only the counter itself is measured.
+  void run_counters(const Options& opts, const std::vector<MTR::Record>& trace, std::vector<Result>& results){
+    const char *names[] = {
+      "counter-set-utilization",
+      "counter-temperature",
+      "counter-bandwidth",
+      "counter-miss-count"
+    };
+    const unsigned num_counters = sizeof(names) / sizeof(names[0]);
+    const unsigned window = 1000;
+    const size_t chunk = 64*1024;
+
+    Daly::Cache::ptr c = daly_cache(opts, boost::make_shared<Daly::LRU>());
+
+    std::vector<PerformanceCounterPolicy::ptr> counters;
+    counters.push_back(boost::make_shared<MTV::CacheSetUtilizationPolicy>(c, window));
+    counters.push_back(boost::make_shared<MTV::CacheTemperaturePolicy>(c, window));
+    counters.push_back(boost::make_shared<MTV::LevelToLevelBandwidthPolicy>(c));
+    counters.push_back(boost::make_shared<MTV::CacheMissCountPolicy>(c, window));
+
+    std::vector<Stopwatch> sw(num_counters);
+    uint64_t n = 0;
+
+    std::vector<CacheAccessRecord> records;
+    for(size_t start=0; start<trace.size(); start += chunk){
+      records.clear();
+
+      const size_t end = std::min(start + chunk, trace.size());
+      for(size_t i=start; i<end; i++){
+        if(MTR::type(trace[i]) != MTR::Record::MType){
+          continue;
+        }
+
+        access(c, trace[i]);
+        records.push_back(CacheAccessRecord(c->hitInfo(), c->evictionInfo(), c->entranceInfo(), trace[i].addr));
+      }
+
+      for(unsigned k=0; k<num_counters; k++){
+        sw[k].start();
+        for(size_t i=0; i<records.size(); i++){
+          counters[k]->consume(records[i]);
+        }
+        sw[k].stop();
+      }
+
+      n += records.size();
+    }
+
+    for(unsigned k=0; k<num_counters; k++){
+      if(selected(opts, names[k])){
+        results.push_back(make_result(names[k], n, sw[k]));
+      }
+    }
+  }
+
+  std::string json_string(const std::string& s){
+    std::stringstream ss;
+    ss << '"';
+    for(unsigned i=0; i<s.length(); i++){
+      switch(s[i]){
+      case '"':
+        ss << "\\\"";
+        break;
+
+      case '\\':
+        ss << "\\\\";
+        break;
+
+      default:
+        ss << s[i];
+        break;
+      }
+    }
+    ss << '"';
+
+    return ss.str();
+  }
+
+  void write_json(std::ostream& out, const Options& opts, uint64_t records, const std::vector<Result>& results){
+    out << std::setprecision(6);
+
+    out << "{" << std::endl
+        << "  \"benchmark\": \"mtvx-bench\"," << std::endl
+        << "  \"workload\": " << json_string(opts.tracefile != "" ? opts.tracefile : opts.workload) << "," << std::endl
+        << "  \"records\": " << records << "," << std::endl
+        << "  \"record_size\": " << sizeof(MTR::Record) << "," << std::endl
+        << "  \"working_set\": " << opts.working_set << "," << std::endl
+        << "  \"block_size\": " << opts.blocksize << "," << std::endl
+        << "  \"seed\": " << opts.seed << "," << std::endl
+        << "  \"stages\": [" << std::endl;
+
+    for(unsigned i=0; i<results.size(); i++){
+      const Result& r = results[i];
+      const double secs = r.seconds > 0.0 ? r.seconds : 1e-9;
+
+      out << "    {"
+          << "\"stage\": " << json_string(r.stage) << ", "
+          << "\"records\": " << r.records << ", "
+          << "\"seconds\": " << r.seconds << ", "
+          << "\"records_per_second\": " << (r.records / secs) << ", "
+          << "\"bytes_per_second\": " << (r.bytes / secs) << ", ";
+
+      if(r.allocations < 0){
+        out << "\"allocations\": null, \"allocations_per_record\": null";
+      }
+      else{
+        out << "\"allocations\": " << r.allocations << ", "
+            << "\"allocations_per_record\": " << (r.records > 0 ? static_cast<double>(r.allocations) / r.records : 0.0);
+      }
+
+      if(not r.miss_rates.empty()){
+        out << ", \"miss_rates\": [";
+        for(unsigned L=0; L<r.miss_rates.size(); L++){
+          out << (L > 0 ? ", " : "") << r.miss_rates[L];
+        }
+        out << "]";
+      }
+
+      out << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+
+    out << "  ]" << std::endl
+        << "}" << std::endl;
+  }
+
+  void print(std::ostream& out, const std::vector<Result>& results){
+    out << std::left << std::setw(28) << "stage"
+        << std::right << std::setw(14) << "records/s"
+        << std::setw(14) << "MB/s"
+        << std::setw(14) << "allocs/rec"
+        << std::setw(10) << "L1 miss"
+        << std::setw(10) << "L2 miss" << std::endl;
+
+    for(unsigned i=0; i<results.size(); i++){
+      const Result& r = results[i];
+      const double secs = r.seconds > 0.0 ? r.seconds : 1e-9;
+
+      out << std::left << std::setw(28) << r.stage
+          << std::right << std::fixed << std::setprecision(0) << std::setw(14) << (r.records / secs)
+          << std::setprecision(2) << std::setw(14) << (r.bytes / secs / (1024*1024));
+
+      if(r.allocations < 0){
+        out << std::setw(14) << "-";
+      }
+      else{
+        out << std::setw(14) << (r.records > 0 ? static_cast<double>(r.allocations) / r.records : 0.0);
+      }
+
+      for(unsigned L=0; L<2; L++){
+        if(L < r.miss_rates.size()){
+          out << std::setprecision(4) << std::setw(10) << r.miss_rates[L];
+        }
+        else{
+          out << std::setw(10) << "-";
+        }
+      }
+
+      out << std::endl;
+    }
+  }
+}
+
+int main(int argc, char *argv[]){
+  Options opts;
+  std::string outfile;
+
+  try{
+    TCLAP::CmdLine cmd("Measure the throughput of the trace processing pipeline");
+
+    TCLAP::ValueArg<std::string> workloadArg("w",
+                                             "workload",
+                                             "synthetic workload: 'sequential', 'strided', or 'random'",
+                                             false,
+                                             "random",
+                                             "name",
+                                             cmd);
+
+    TCLAP::ValueArg<std::string> tracefileArg("t",
+                                              "trace",
+                                              "use this reference trace instead of a synthetic workload",
+                                              false,
+                                              "",
+                                              "filename",
+                                              cmd);
+
+    TCLAP::ValueArg<uint64_t> recordsArg("n",
+                                         "records",
+                                         "number of records in the synthetic workload",
+                                         false,
+                                         1000000,
+                                         "count",
+                                         cmd);
+
+    TCLAP::ValueArg<uint64_t> workingSetArg("k",
+                                            "working-set",
+                                            "working set of the synthetic workload (bytes)",
+                                            false,
+                                            4*1024*1024,
+                                            "bytes",
+                                            cmd);
+
+    TCLAP::ValueArg<unsigned> blocksizeArg("b",
+                                           "block-size",
+                                           "cache block size (bytes)",
+                                           false,
+                                           64,
+                                           "bytes",
+                                           cmd);
+
+    TCLAP::ValueArg<unsigned> seedArg("r",
+                                      "seed",
+                                      "random seed",
+                                      false,
+                                      1,
+                                      "seed",
+                                      cmd);
+
+    TCLAP::ValueArg<unsigned> streamsArg("f",
+                                         "file-streams",
+                                         "file streams for block stream writing and reading",
+                                         false,
+                                         256,
+                                         "count",
+                                         cmd);
+
+    TCLAP::ValueArg<std::string> scratchArg("d",
+                                            "scratch",
+                                            "directory for intermediate files",
+                                            false,
+                                            ".",
+                                            "directory",
+                                            cmd);
+
+    TCLAP::ValueArg<std::string> mtr2blockstreamArg("m",
+                                                    "mtr2blockstream",
+                                                    "path to the mtr2blockstream program (default: alongside this one)",
+                                                    false,
+                                                    "",
+                                                    "filename",
+                                                    cmd);
+
+    TCLAP::MultiArg<std::string> stagesArg("s",
+                                           "stage",
+                                           "run only stages whose names begin with this (may be repeated)",
+                                           false,
+                                           "name",
+                                           cmd);
+
+    TCLAP::ValueArg<std::string> outfileArg("o",
+                                            "output",
+                                            "JSON results file",
+                                            false,
+                                            "mtvx-bench.json",
+                                            "filename",
+                                            cmd);
+
+    cmd.parse(argc, argv);
+
+    opts.workload = workloadArg.getValue();
+    opts.tracefile = tracefileArg.getValue();
+    opts.records = recordsArg.getValue();
+    opts.working_set = workingSetArg.getValue();
+    opts.blocksize = blocksizeArg.getValue();
+    opts.seed = seedArg.getValue();
+    opts.streams = streamsArg.getValue();
+    opts.scratch = scratchArg.getValue();
+    opts.mtr2blockstream = mtr2blockstreamArg.getValue();
+    opts.stages = stagesArg.getValue();
+    outfile = outfileArg.getValue();
+  }
+  catch(TCLAP::ArgException& e){
+    std::cerr << "error: " << e.error() << " for argument " << e.argId() << std::endl;
+    exit(1);
+  }
+
+  Instrumentation::countAllocations();
+
+  if(opts.blocksize == 0 or opts.working_set < 4*opts.blocksize){
+    std::cerr << "error: the working set must hold at least four blocks." << std::endl;
+    exit(1);
+  }
+
+  if(opts.mtr2blockstream == ""){
+    opts.mtr2blockstream = (boost::filesystem::path(argv[0]).parent_path() / "mtr2blockstream").string();
+  }
+
+  // Set up the workload.
+  std::vector<MTR::Record> trace;
+  if(opts.tracefile != ""){
+    if(!load(opts.tracefile, trace)){
+      std::cerr << "error: could not open file '" << opts.tracefile << "' for reading." << std::endl;
+      exit(1);
+    }
+  }
+  else if(!generate(opts, trace)){
+    std::cerr << "error: unknown workload '" << opts.workload << "'." << std::endl;
+    exit(1);
+  }
+
+  const std::string rawfile = (boost::filesystem::path(opts.scratch) / "mtvx-bench-raw.mtr").string();
+  const std::string gzipfile = (boost::filesystem::path(opts.scratch) / "mtvx-bench-gzip.mtr").string();
+  const std::string bsfile = (boost::filesystem::path(opts.scratch) / "mtvx-bench.bs").string();
+
+  std::vector<Result> results;
+
+  // Trace I/O.  The trace files are always written, since later
+  // stages read them.
+  Result r = write_trace("trace-write-raw", trace, rawfile, TraceWriter::Raw);
+  if(selected(opts, r.stage)){
+    results.push_back(r);
+  }
+
+  r = write_trace("trace-write-gzip", trace, gzipfile, TraceWriter::Gzip);
+  if(selected(opts, r.stage)){
+    results.push_back(r);
+  }
+
+  if(selected(opts, "trace-read-raw")){
+    results.push_back(read_trace("trace-read-raw", rawfile));
+  }
+
+  if(selected(opts, "trace-read-gzip")){
+    results.push_back(read_trace("trace-read-gzip", gzipfile));
+  }
+
+  // The original cache simulator.
+  if(selected(opts, "daly-cache-random")){
+    results.push_back(run_daly("daly-cache-random", opts, trace, boost::make_shared<Daly::RANDOM>()));
+  }
+
+  if(selected(opts, "daly-cache-lru")){
+    results.push_back(run_daly("daly-cache-lru", opts, trace, boost::make_shared<Daly::LRU>()));
+  }
+
+  if(selected(opts, "daly-cache-mru")){
+    results.push_back(run_daly("daly-cache-mru", opts, trace, boost::make_shared<Daly::MRU>()));
+  }
+
+  // The new cache simulator.
+  if(selected(opts, "new-cache-lru")){
+    results.push_back(run_new("new-cache-lru", opts, trace, CacheLevel::LRU));
+  }
+
+  if(selected(opts, "new-cache-mru")){
+    results.push_back(run_new("new-cache-mru", opts, trace, CacheLevel::MRU));
+  }
+
+  if(selected(opts, "new-cache-random")){
+    results.push_back(run_new("new-cache-random", opts, trace, CacheLevel::Random));
+  }
+
+  // The compact replacement policies, to compare against the
+  // list-based LRU above.
+  if(selected(opts, "new-cache-tree-plru")){
+    results.push_back(run_new("new-cache-tree-plru", opts, trace, CacheLevel::TreePLRU));
+  }
+
+  if(selected(opts, "new-cache-bit-plru")){
+    results.push_back(run_new("new-cache-bit-plru", opts, trace, CacheLevel::BitPLRU));
+  }
+
+  if(selected(opts, "new-cache-srrip")){
+    results.push_back(run_new("new-cache-srrip", opts, trace, CacheLevel::SRRIP));
+  }
+
+  if(selected(opts, "new-cache-brrip")){
+    results.push_back(run_new("new-cache-brrip", opts, trace, CacheLevel::BRRIP));
+  }
+
+  if(selected(opts, "new-cache-drrip")){
+    results.push_back(run_new("new-cache-drrip", opts, trace, CacheLevel::DRRIP));
+  }
+
+  if(selected(opts, "new-cache-ship")){
+    results.push_back(run_new("new-cache-ship", opts, trace, CacheLevel::SHiP));
+  }
+
+  // Block streams, and the policies that need them.
+  const bool need_bs = selected(opts, "mtr2blockstream") or selected(opts, "blockstream-read") or selected(opts, "new-cache-opt") or selected(opts, "new-cache-pes");
+  if(need_bs){
+    bool ok;
+    r = run_mtr2blockstream(opts, rawfile, bsfile, trace.size(), ok);
+    if(!ok){
+      std::cerr << "warning: could not run '" << opts.mtr2blockstream << "'; skipping the block stream stages." << std::endl;
+    }
+    else{
+      if(selected(opts, r.stage)){
+        results.push_back(r);
+      }
+
+      if(selected(opts, "blockstream-read")){
+        results.push_back(read_blockstream(opts, trace, bsfile));
+      }
+
+      if(selected(opts, "new-cache-opt")){
+        results.push_back(run_new_lookahead("new-cache-opt", opts, rawfile, bsfile, CacheLevel::OPT));
+      }
+
+      if(selected(opts, "new-cache-pes")){
+        results.push_back(run_new_lookahead("new-cache-pes", opts, rawfile, bsfile, CacheLevel::PES));
+      }
+    }
+  }
+
+  // Performance counters.
+  if(group_selected(opts, "counter")){
+    run_counters(opts, trace, results);
+  }
+
+  // Clean up the intermediate files.
+  remove(rawfile.c_str());
+  remove(gzipfile.c_str());
+  remove(bsfile.c_str());
+
+  print(std::cout, results);
+
+  std::ofstream out(outfile.c_str());
+  if(!out){
+    std::cerr << "error: could not open file '" << outfile << "' for writing." << std::endl;
+    exit(1);
+  }
+  write_json(out, opts, trace.size(), results);
+
+  return 0;
+}
@@ -119,18 +119,28 @@ void Cache::load(MTR::addr_t addr){
     modtime->update(blockAddr);
   }
 
-  // For each level in which the block was not found, place it there.
-  //
-  // NOTE(choudhury): allocate() may call evict(), which will record
-  // any evictions.
-  //
-  // TODO(choudhury): we need to allocate the block in these cache
-  // levels, but do we need to record a hit?  These should count as
-  // *misses* in those levels.
-  for(unsigned int L=0; L<found.L; L++){
-    unsigned newblock = this->allocate(L, blockAddr);
-    // _hitInfo.push_back(CacheHitRecord(addr, L, newblock, 'R', levels[L]));
-    _entranceInfo.push_back(CacheEntranceRecord(addr, L, newblock));
+  if(_inclusionPolicy == Exclusive){
+    // A block lives in only one level, so a hit below the first level
+    // (or a miss) moves the block into the first level alone.
+    if(found.L > 0){
+      unsigned newblock = this->moveBlock(found.L, 0, blockAddr);
+      _entranceInfo.push_back(CacheEntranceRecord(addr, 0, newblock));
+    }
+  }
+  else{
+    // For each level in which the block was not found, place it there.
+    //
+    // NOTE(choudhury): allocate() may call evict(), which will record
+    // any evictions.
+    //
+    // TODO(choudhury): we need to allocate the block in these cache
+    // levels, but do we need to record a hit?  These should count as
+    // *misses* in those levels.
+    for(unsigned int L=0; L<found.L; L++){
+      unsigned newblock = this->allocate(L, blockAddr);
+      // _hitInfo.push_back(CacheHitRecord(addr, L, newblock, 'R', levels[L]));
+      _entranceInfo.push_back(CacheEntranceRecord(addr, L, newblock));
+    }
   }
 
   // Record the hit in the appropriate level of cache (a read miss is
@@ -255,6 +265,30 @@ void Cache::writeAtLevel(unsigned L, MTR::addr_t addr){
   // Compute the block address of addr.
   MTR::addr_t blockAddr = addr / _blocksize;
 
+  if(_inclusionPolicy == Exclusive and L < levels.size()){
+    // The block moves into level L from wherever it is, and the write
+    // stops there.  A write-through level writes through to memory,
+    // since the levels below it do not hold the block.
+    CacheHitRecord found = this->find(blockAddr);
+    if(found.L == L){
+      hit_cell = found.cell;
+      modtime->update(blockAddr);
+    }
+    else{
+      hit_cell = this->moveBlock(found.L, L, blockAddr);
+      _entranceInfo.push_back(CacheEntranceRecord(addr, L, hit_cell));
+    }
+
+    levels[L]->blocks[hit_cell].dirty = true;
+    this->_hitInfo.push_back(CacheHitRecord(addr, L, hit_cell, 'W'));
+
+    if(levels[L]->_writePolicy == WriteThrough){
+      this->_hitInfo.push_back(CacheHitRecord(addr, levels.size(), 0, 'W'));
+    }
+
+    return;
+  }
+
   // Repeat the actions in the loop until they have been performed for
   // a write-back level.
   for(unsigned level=L; level<levels.size(); level++){
@@ -285,6 +319,12 @@ void Cache::writeAtLevel(unsigned L, MTR::addr_t addr){
       c->blocks[hit_cell].dirty = true;
       _entranceInfo.push_back(CacheEntranceRecord(addr, L, hit_cell));
 
+      // The write stops at a write-back level, so an inclusive
+      // hierarchy must bring the block into the levels below.
+      if(_inclusionPolicy == Inclusive and c->_writePolicy == WriteBack){
+        this->fillBelow(level, blockAddr);
+      }
+
       //std::cout << "Block not found in level " << level << ", allocating at cell " << hit_cell << std::endl;
 
       // This block takes care of a special case- if the slowest cache
@@ -407,6 +447,16 @@ BlockRecord& Cache::evict(unsigned L, unsigned setIndex){
   std::vector<BlockRecord>::iterator victim = pair.first;
   const bool writeback = pair.second;
 
+  // In an exclusive hierarchy, the victim moves down a level, dirty or
+  // not; only the last level's victims leave the cache.
+  if(_inclusionPolicy == Exclusive and L+1 < levels.size()){
+    const MTR::addr_t victimAddr = victim->addr;
+    const unsigned cell = this->moveBlock(L, L+1, victimAddr);
+    _entranceInfo.push_back(CacheEntranceRecord(victimAddr*_blocksize, L+1, cell));
+
+    return *victim;
+  }
+
   // std::cout << "evicting block at " << (LRU_block->addr * _blocksize) << " (modtime " << oldest << ")" << std::endl;
 
   // If the block is dirty and the cache is write-back, its contents
@@ -416,7 +466,7 @@ BlockRecord& Cache::evict(unsigned L, unsigned setIndex){
   // higher than the evicting level.
   const bool do_writeback = victim->dirty and writeback;
   if(do_writeback){
-    writeAtLevel(L+1, victim->addr);
+    writeAtLevel(L+1, victim->addr*_blocksize);
   }
 
   // Unmap the block.  This really doesn't have any effect on the
@@ -427,10 +477,72 @@ BlockRecord& Cache::evict(unsigned L, unsigned setIndex){
 
   _evictionInfo.push_back(CacheEvictionRecord(L, victim->addr, writeback, victim->dirty));
 
+  // An inclusive hierarchy cannot keep the block above this level.
+  if(_inclusionPolicy == Inclusive and L > 0){
+    this->backInvalidate(L, victim->addr);
+  }
+
   // Return the block reference
   return *victim;
 }
 
+void Cache::backInvalidate(unsigned L, MTR::addr_t blockAddr){
+  bool dirty = false;
+  for(unsigned U=0; U<L; U++){
+    try{
+      BlockRecord& blk = levels[U]->block(levels[U]->find(blockAddr));
+      const bool writeback = levels[U]->_writePolicy == WriteBack;
+
+      blk.mapped = false;
+      dirty = dirty or (blk.dirty and writeback);
+
+      _evictionInfo.push_back(CacheEvictionRecord(U, blockAddr, writeback, blk.dirty, CacheEvictionRecord::BackInvalidation, L));
+    }
+    catch(CacheLevel::BlockNotFound){}
+  }
+
+  // A dirty copy above is newer than the evicted one, so it is written
+  // past the evicting level.
+  if(dirty){
+    writeAtLevel(L+1, blockAddr*_blocksize);
+  }
+}
+
+void Cache::fillBelow(unsigned L, MTR::addr_t blockAddr){
+  for(unsigned M=L+1; M<levels.size(); M++){
+    try{
+      levels[M]->find(blockAddr);
+
+      // Inclusion guarantees the levels below this one have it too.
+      return;
+    }
+    catch(CacheLevel::BlockNotFound){}
+
+    const unsigned cell = this->allocate(M, blockAddr);
+    _entranceInfo.push_back(CacheEntranceRecord(blockAddr*_blocksize, M, cell));
+  }
+}
+
+unsigned Cache::moveBlock(unsigned from, unsigned to, MTR::addr_t blockAddr){
+  // Take the block out of its current level (unless it comes from
+  // memory), freeing its cell before the new level makes room for it.
+  bool dirty = false;
+  if(from < levels.size()){
+    BlockRecord& blk = levels[from]->block(levels[from]->find(blockAddr));
+    const bool writeback = levels[from]->_writePolicy == WriteBack;
+
+    dirty = blk.dirty and writeback;
+    blk.mapped = false;
+
+    _evictionInfo.push_back(CacheEvictionRecord(from, blockAddr, writeback, blk.dirty, CacheEvictionRecord::Swap, to));
+  }
+
+  const unsigned cell = this->allocate(to, blockAddr);
+  levels[to]->blocks[cell].dirty = dirty;
+
+  return cell;
+}
+
 std::pair<std::vector<BlockRecord>::iterator, bool> ApproxOPT::select_eviction_block(Cache *c, unsigned L, unsigned setIndex){
   const uint64_t point = reader->getTracePoint();
   log << "point is " << point << std::endl;
@@ -14,6 +14,7 @@
 // MTV includes.
 #include <Core/Dataflow/BlockStream/BlockStreamReader.h>
 #include <Core/Dataflow/TraceReader.h>
+#include <Core/Util/BlockInterner.h>
 #include <Core/Util/Boost.h>
 #include <Core/Util/BoostPointers.h>
 #include <Tools/ReferenceTrace/mtrtools.h>
@@ -60,6 +61,13 @@ namespace Daly {
   /// \brief Enumerates the write miss policies a cache may choose to use.
   typedef enum {WriteAllocate, NoWriteAllocate} WriteMissPolicy;
 
+  /// \brief Enumerates the inclusion policies a cache hierarchy may
+  /// use: non-inclusive non-exclusive (fill every level above the
+  /// hit, evict independently), inclusive (evicting a block from a
+  /// level invalidates it in the levels above), and exclusive (a
+  /// block lives in one level at a time; victims move down a level).
+  typedef enum {NonInclusive, Inclusive, Exclusive} InclusionPolicy;
+
   /// \struct BlockRecord
   ///
   /// \brief Describes the state of a cache block, including the
@@ -96,18 +104,26 @@ namespace Daly {
 
   public:
     void update(MTR::addr_t addr){
-      _modtime[addr] = stamp.nextTick();
+      const MTV::BlockInterner::id_t id = ids.intern_block(addr);
+      if(id == _modtime.size()){
+        _modtime.push_back(0);
+      }
+
+      _modtime[id] = stamp.nextTick();
     }
 
     unsigned long long modtime(MTR::addr_t addr) const {
-      boost::unordered_map<MTR::addr_t, unsigned long long>::const_iterator i = _modtime.find(addr);
-      assert(i != _modtime.end());
+      const MTV::BlockInterner::id_t id = ids.find_block(addr);
+      assert(id != MTV::BlockInterner::None);
 
-      return i->second;
+      return _modtime[id];
     }
 
   private:
-    boost::unordered_map<MTR::addr_t, unsigned long long> _modtime;
+    // Block addresses are interned, so the modtimes can be stored in a
+    // flat array.
+    MTV::BlockInterner ids;
+    std::vector<unsigned long long> _modtime;
     Timestamp stamp;
   };
 
@@ -256,22 +272,38 @@ namespace Daly {
   };
 
   struct CacheEvictionRecord{
+    /// \brief Why the block left level L: replaced by another block;
+    /// invalidated because level \e dest evicted it (inclusive
+    /// hierarchies); or moved to level \e dest (exclusive
+    /// hierarchies - a victim moving down, or a hit moving up).
+    enum Kind{
+      Replacement,
+      BackInvalidation,
+      Swap
+    };
+
     CacheEvictionRecord()
-      : L(0), blockaddr(0), writeback(false)
+      : L(0), blockaddr(0), writeback(false), kind(Replacement), dest(0)
     {}
 
-    CacheEvictionRecord(unsigned L, MTR::addr_t blockaddr, bool writeback, bool dirty)
+    CacheEvictionRecord(unsigned L, MTR::addr_t blockaddr, bool writeback, bool dirty, Kind kind = Replacement, unsigned dest = 0)
       : L(L),
         blockaddr(blockaddr),
         writeback(writeback),
-        dirty(dirty)
+        dirty(dirty),
+        kind(kind),
+        dest(dest)
     {}
 
     unsigned L;
     MTR::addr_t blockaddr;
     bool writeback, dirty;
+    Kind kind;
+    unsigned dest;
 
     friend std::ostream& operator<<(std::ostream& out, const CacheEvictionRecord& r){
+      static const char *kinds[] = {"replacement", "back-invalidation", "swap"};
+
       // Save format flags.
       const std::ios_base::fmtflags flags = out.flags();
 
@@ -280,7 +312,13 @@ namespace Daly {
           << "L = " << std::dec << r.L << ", "
           << "blockaddr = 0x" << std::hex << r.blockaddr << ", "
           << "writeback = " << (r.writeback ? "true" : "false") << ", "
-          << "dirty = " << (r.dirty ? "true" : "false") << ")";
+          << "dirty = " << (r.dirty ? "true" : "false");
+
+      if(r.kind != Replacement){
+        out << ", kind = " << kinds[r.kind] << ", dest = " << std::dec << r.dest;
+      }
+
+      out << ")";
 
       // Restore format flags.
       out.flags(flags);
@@ -323,6 +361,54 @@ namespace Daly {
     }
   };
 
+  /// \brief Describes a prefetch into level L: its issue (with the
+  /// level, or memory, that supplied the block), its first demand use
+  /// (in time, or too late to hide the fetch), or its eviction before
+  /// any use.
+  struct CachePrefetchRecord{
+    enum Event{
+      Issued,
+      Useful,
+      Late,
+      Polluting
+    };
+
+    CachePrefetchRecord()
+      : L(0), blockaddr(0), source(0), event(Issued)
+    {}
+
+    CachePrefetchRecord(unsigned L, MTR::addr_t blockaddr, unsigned source, Event event)
+      : L(L),
+        blockaddr(blockaddr),
+        source(source),
+        event(event)
+    {}
+
+    unsigned L;
+    MTR::addr_t blockaddr;
+    unsigned source;
+    Event event;
+
+    friend std::ostream& operator<<(std::ostream& out, const CachePrefetchRecord& r){
+      static const char *names[] = {"issued", "useful", "late", "polluting"};
+
+      // Save format flags.
+      const std::ios_base::fmtflags flags = out.flags();
+
+      // Output to stream.
+      out << "CachePrefetchRecord("
+          << "L = " << std::dec << r.L << ", "
+          << "blockaddr = 0x" << std::hex << r.blockaddr << ", "
+          << "source = " << std::dec << r.source << ", "
+          << "event = " << names[r.event] << ")";
+
+      // Restore format flags.
+      out.flags(flags);
+
+      return out;
+    }
+  };
+
   /// \class Cache
   ///
   /// \brief A class that builds on top of CacheLevel instances in
@@ -352,6 +438,7 @@ namespace Daly {
     Cache(unsigned _blocksize, WriteMissPolicy _writeMissPolicy, boost::shared_ptr<EvictionBlockSelector> _evictionPolicy, ModtimeTable::ptr modtime) :
       _blocksize(_blocksize),
       _writeMissPolicy(_writeMissPolicy),
+      _inclusionPolicy(NonInclusive),
       _evictionPolicy(_evictionPolicy),
       modtime(modtime)
     {}
@@ -365,6 +452,12 @@ namespace Daly {
     /// \brief Returns the write miss policy used by this cache.
     WriteMissPolicy writeMissPolicy() const { return _writeMissPolicy; }
 
+    /// \brief Returns the inclusion policy of the hierarchy.
+    InclusionPolicy inclusionPolicy() const { return _inclusionPolicy; }
+
+    /// \brief Sets the inclusion policy (before any accesses).
+    void setInclusionPolicy(InclusionPolicy policy){ _inclusionPolicy = policy; }
+
     boost::shared_ptr<EvictionBlockSelector> evictionPolicy() { return _evictionPolicy; }
 
     // virtual BlockRecord& select_eviction_block(unsigned L, unsigned setIndex) const = 0;
@@ -394,6 +487,9 @@ namespace Daly {
 
     const std::vector<CacheEntranceRecord>& entranceInfo() const { return _entranceInfo; }
 
+    /// \brief Always empty - this cache does not prefetch.
+    const std::vector<CachePrefetchRecord>& prefetchInfo() const { return _prefetchInfo; }
+
     void infoReport() const;
 
     /// \brief Add a cache level given a size, associativity, and a
@@ -451,9 +547,24 @@ namespace Daly {
     /// allocate().  Returns the block index of the evicted block.
     BlockRecord& evict(unsigned L, unsigned setIndex);
 
+    /// \brief Invalidates a block evicted from level \e L in the
+    /// levels above it, writing back any dirty copies (inclusive
+    /// hierarchies).
+    void backInvalidate(unsigned L, MTR::addr_t blockAddr);
+
+    /// \brief Places a block written into level \e L in the levels
+    /// below it that lack it (inclusive hierarchies).
+    void fillBelow(unsigned L, MTR::addr_t blockAddr);
+
+    /// \brief Moves a block from level \e from (or from memory) into
+    /// level \e to, carrying its dirty flag (exclusive hierarchies).
+    /// Returns the cell index of the block in level \e to.
+    unsigned moveBlock(unsigned from, unsigned to, MTR::addr_t blockAddr);
+
   private:
     unsigned _blocksize;
     WriteMissPolicy _writeMissPolicy;
+    InclusionPolicy _inclusionPolicy;
     boost::shared_ptr<EvictionBlockSelector> _evictionPolicy;
 
     std::vector<CacheLevel::ptr> levels;
@@ -461,6 +572,7 @@ namespace Daly {
     std::vector<CacheHitRecord> _hitInfo;
     std::vector<CacheEvictionRecord> _evictionInfo;
     std::vector<CacheEntranceRecord> _entranceInfo;
+    std::vector<CachePrefetchRecord> _prefetchInfo;
 
     // Timestamp stamp;
     // boost::unordered_map<MTR::addr_t, unsigned long long> modTime;
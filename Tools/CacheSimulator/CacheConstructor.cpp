@@ -69,6 +69,24 @@ CacheConstructor::CacheConstructor(const std::string& filename, const std::map<s
     return;
   }
 
+  // ...the inclusion policy (optional)...
+  text = root->Attribute("inclusion_policy");
+  if(!text or std::string(text) == "NonInclusive"){
+    this->inclusionPolicy = Daly::NonInclusive;
+  }
+  else if(std::string(text) == "Inclusive"){
+    this->inclusionPolicy = Daly::Inclusive;
+  }
+  else if(std::string(text) == "Exclusive"){
+    this->inclusionPolicy = Daly::Exclusive;
+  }
+  else{
+    std::stringstream ss;
+    ss << "error: inclusion_policy attribute of Cache element must be one of 'NonInclusive', 'Inclusive', or 'Exclusive'.";
+    error_message = ss.str();
+    return;
+  }
+
   // ...and block replacement policy.
   text = root->Attribute("replacement_policy");
   if(!text){
@@ -207,6 +225,7 @@ Cache::ptr CacheConstructor::constructCacheHelper(TraceReader::ptr reader, Modti
   }
 
   Cache::ptr p(new Cache(this->blocksize, this->writeMissPolicy, e, modtime));
+  p->setInclusionPolicy(this->inclusionPolicy);
   for(unsigned i=0; i<levels.size(); i++){
     if(levels[i].useLevelPointer()){
       p->addCacheLevel(levels[i].level);
@@ -67,6 +67,7 @@ namespace Daly{
   private:
     unsigned blocksize;
     Daly::WriteMissPolicy writeMissPolicy;
+    Daly::InclusionPolicy inclusionPolicy;
     std::vector<CacheLevelConstructor> levels;
     std::string evictionPolicy;
 
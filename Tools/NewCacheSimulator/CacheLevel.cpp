@@ -64,6 +64,14 @@ Eviction DirectMappedCacheLevel::allocate(uint64_t block_addr, boost::shared_ptr
     lookup[index]->addr = block_addr;
     lookup[index]->dirty = false;
   }
+  else if(lookup[index]->addr == static_cast<uint64_t>(-1)){
+    // The target block was invalidated, so it can be reused without
+    // an eviction.
+    e.cell = lookup[index]->cell;
+
+    lookup[index]->addr = block_addr;
+    lookup[index]->dirty = false;
+  }
   else{
     // If the target block is mapped, whatever is there needs to be
     // evicted before the block is allocated.
@@ -120,6 +128,17 @@ Eviction OrderedCacheSet::allocate(uint64_t block_addr, boost::shared_ptr<NewCac
     // Set the cell number on the eviction report.
     e.cell = new_cell;
   }
+  else if(not invalid.empty()){
+    // Reuse an invalidated block without evicting anything, touching
+    // it so that it becomes the last touched block.
+    CacheLevel::iterator reuse = invalid.back();
+    invalid.pop_back();
+
+    repl->peek(blocks, reuse);
+    lookup[block_addr] = reuse;
+
+    e.cell = reuse->cell;
+  }
   else{
     // Fill in the appropriate eviction information.
     e.eviction = true;
@@ -201,6 +220,15 @@ Eviction RandomReplacementCacheSet::allocate(uint64_t block_addr, boost::shared_
     new_i->addr = block_addr;
     new_i->dirty = false;
   }
+  else if(not invalid.empty()){
+    // Reuse an invalidated block without evicting anything.
+    CacheLevel::iterator reuse = invalid.back();
+    invalid.pop_back();
+
+    lookup[block_addr] = reuse;
+    reuse->addr = block_addr;
+    reuse->dirty = false;
+  }
   else{
     // Select a block (at random) to evict, then replace the lookup
     // info with the info for that block.
@@ -262,6 +290,15 @@ Eviction BeladyAlgorithmCacheSet::allocate(uint64_t block_addr, boost::shared_pt
     lookup[block_addr]->addr = block_addr;
     lookup[block_addr]->dirty = false;
   }
+  else if(not invalid.empty()){
+    // Reuse an invalidated block without evicting anything.
+    CacheLevel::iterator reuse = invalid.back();
+    invalid.pop_back();
+
+    lookup[block_addr] = reuse;
+    reuse->addr = block_addr;
+    reuse->dirty = false;
+  }
   else{
     // Evict the chosen block.
     //
@@ -11,6 +11,7 @@
 #include <Core/Dataflow/BlockStream/BlockStreamReader.h>
 #include <Core/Dataflow/TraceReader.h>
 #include <Core/Util/BoostPointers.h>
+#include <Tools/NewCacheSimulator/Prefetcher.h>
 
 // Boost headers.
 #include <boost/unordered_map.hpp>
@@ -67,7 +68,16 @@ namespace MTV{
       MRU,
       OPT,
       PES,
-      Random
+      Random,
+
+      // Policies with a few bits of state per way (see
+      // CompactReplacement.h).
+      TreePLRU,
+      BitPLRU,
+      SRRIP,
+      BRRIP,
+      DRRIP,
+      SHiP
     };
 
   public:
@@ -85,6 +95,21 @@ namespace MTV{
       return write_pol;
     }
 
+    // The hardware prefetcher for this level, if any.
+    Prefetcher::ptr prefetcher() const {
+      return pf;
+    }
+
+    void set_prefetcher(Prefetcher::ptr p){
+      pf = p;
+    }
+
+    // The number of sets that block addresses are mapped into (by
+    // taking the address modulo this number).
+    virtual uint64_t num_sets() const {
+      return 1;
+    }
+
     virtual bool has_block(uint64_t block_addr){
       return (this->find(block_addr) != blocks.end());
     }
@@ -99,6 +124,24 @@ namespace MTV{
 
     virtual void write_back(boost::shared_ptr<NewCache> cache, unsigned L, uint64_t block_addr);
 
+    // Coherence actions (see MulticoreCache).  invalidate() drops the
+    // block from the level, leaving its cell free for the next
+    // allocation; clean() clears the block's dirty flag.  Both return
+    // whether the block was dirty (false if it was absent).
+    virtual bool invalidate(uint64_t block_addr) = 0;
+
+    virtual bool clean(uint64_t block_addr){
+      if(not this->has_block(block_addr)){
+        return false;
+      }
+
+      iterator i = this->find(block_addr);
+      const bool dirty = i->dirty;
+      i->dirty = false;
+
+      return dirty;
+    }
+
     // This function can, e.g., set up the level's data structures to
     // make eviction easier, etc.
     virtual void read(uint64_t block_addr) = 0;
@@ -106,6 +149,20 @@ namespace MTV{
     // This function should be used like read() 
     virtual void write(uint64_t block_addr) = 0;
 
+    // The read (or write) that completes a demand miss, right after
+    // allocate().  Levels whose policies tell insertions apart from
+    // reuse treat it as part of the insertion rather than as a hit; a
+    // block brought in without a demand access (e.g. a prefetch) gets
+    // no fill() at all.
+    virtual void fill(uint64_t block_addr, bool write){
+      if(write){
+        this->write(block_addr);
+      }
+      else{
+        this->read(block_addr);
+      }
+    }
+
     virtual void print(std::ostream& out, const std::string& prefix = "") const {
       for(std::list<CacheBlock>::const_iterator i = blocks.begin(); i != blocks.end(); i++){
         out << prefix << "(" << std::dec << i->cell << ", 0x" << std::hex << i->addr << ", " << (i->dirty ? "dirty" : "clean") << ")" << std::endl;
@@ -113,15 +170,35 @@ namespace MTV{
       out << std::dec;
     }
 
+  protected:
+    // Marks an entry empty, and remembers it for reuse by allocate().
+    bool release(iterator i){
+      const bool dirty = i->dirty;
+      i->addr = static_cast<uint64_t>(-1);
+      i->dirty = false;
+      invalid.push_back(i);
+
+      return dirty;
+    }
+
   protected:
     std::list<CacheBlock> blocks;
     const WritePolicy write_pol;
+
+    Prefetcher::ptr pf;
+
+    // Entries emptied by invalidate().
+    std::vector<iterator> invalid;
   };
 
   class DirectMappedCacheLevel : public CacheLevel {
   public:
     DirectMappedCacheLevel(unsigned level, WritePolicy write_policy, unsigned _num_blocks);
 
+    uint64_t num_sets() const {
+      return num_blocks;
+    }
+
     CacheLevel::iterator find(uint64_t block_addr){
       // Direct mapping means there is precisely one position this block
       // can go - if the block is in that position, then return an
@@ -139,6 +216,21 @@ namespace MTV{
 
     Eviction allocate(uint64_t block_addr, boost::shared_ptr<NewCache> cache, unsigned level);
 
+    bool invalidate(uint64_t block_addr){
+      CacheLevel::iterator i = this->find(block_addr);
+      if(i == blocks.end()){
+        return false;
+      }
+
+      // NOTE(choudhury): the mapping decides where a block goes, so
+      // the entry is simply left empty in place.
+      const bool dirty = i->dirty;
+      i->addr = static_cast<uint64_t>(-1);
+      i->dirty = false;
+
+      return dirty;
+    }
+
     void read(uint64_t block_addr){
       // Check that the block is actually present.
       //
@@ -298,6 +390,18 @@ namespace MTV{
 
     Eviction allocate(uint64_t block_addr, boost::shared_ptr<NewCache> cache, unsigned level);
 
+    bool invalidate(uint64_t block_addr){
+      boost::unordered_map<uint64_t, CacheLevel::iterator>::iterator i = lookup.find(block_addr);
+      if(i == lookup.end()){
+        return false;
+      }
+
+      CacheLevel::iterator b = i->second;
+      lookup.erase(i);
+
+      return this->release(b);
+    }
+
     void read(uint64_t block_addr){
       // Make sure the block is actually present.
       //
@@ -364,6 +468,18 @@ namespace MTV{
 
     Eviction allocate(uint64_t block_addr, boost::shared_ptr<NewCache> cache, unsigned level);
 
+    bool invalidate(uint64_t block_addr){
+      boost::unordered_map<uint64_t, CacheLevel::iterator>::iterator i = lookup.find(block_addr);
+      if(i == lookup.end()){
+        return false;
+      }
+
+      CacheLevel::iterator b = i->second;
+      lookup.erase(i);
+
+      return this->release(b);
+    }
+
     void read(uint64_t block_addr){
       // Check to make sure requested block is present.
       //
@@ -421,6 +537,18 @@ namespace MTV{
 
     Eviction allocate(uint64_t block_addr, boost::shared_ptr<NewCache> cache, unsigned level);
 
+    bool invalidate(uint64_t block_addr){
+      boost::unordered_map<uint64_t, CacheLevel::iterator>::iterator i = lookup.find(block_addr);
+      if(i == lookup.end()){
+        return false;
+      }
+
+      CacheLevel::iterator b = i->second;
+      lookup.erase(i);
+
+      return this->release(b);
+    }
+
     void read(uint64_t block_addr){
       // Ensure that the block is present.
       if(not present(find(block_addr))){
@@ -512,8 +640,9 @@ namespace MTV{
         // Get the next trace point at which the block is used.
         const uint64_t next = bsreader->next(i->addr, point);
 
-        // Compare to the current furthest reuse.
-        if(next < nearest_reuse){
+        // Compare to the current nearest reuse (blocks that never
+        // reappear still need a victim among them).
+        if(not found or next < nearest_reuse){
           found = true;
           nearest_reuse = next;
           victim_block = i->addr;
@@ -536,6 +665,10 @@ namespace MTV{
   public:
     SetAssociativeCacheLevel(const std::vector<CacheLevel::ptr>& init_sets);
 
+    uint64_t num_sets() const {
+      return sets.size();
+    }
+
     bool has_block(uint64_t block_addr){
       const uint64_t set_index = block_addr % sets.size();
 
@@ -569,6 +702,18 @@ namespace MTV{
       return sets[set_index]->allocate(block_addr, cache, level);
     }
 
+    bool invalidate(uint64_t block_addr){
+      const uint64_t set_index = block_addr % sets.size();
+
+      return sets[set_index]->invalidate(block_addr);
+    }
+
+    bool clean(uint64_t block_addr){
+      const uint64_t set_index = block_addr % sets.size();
+
+      return sets[set_index]->clean(block_addr);
+    }
+
     void read(uint64_t block_addr){
       const uint64_t set_index = block_addr % sets.size();
 
@@ -581,6 +726,12 @@ namespace MTV{
       sets[set_index]->write(block_addr);
     }
 
+    void fill(uint64_t block_addr, bool write){
+      const uint64_t set_index = block_addr % sets.size();
+
+      sets[set_index]->fill(block_addr, write);
+    }
+
     void print(std::ostream& out, const std::string& prefix = "") const {
       for(unsigned i=0; i<sets.size(); i++){
         out << prefix << "Set " << i << ":" << std::endl;
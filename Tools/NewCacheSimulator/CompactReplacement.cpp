@@ -0,0 +1,232 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// CompactReplacement.cpp
+
+// MTV headers.
+#include <Tools/NewCacheSimulator/CompactReplacement.h>
+#include <Tools/NewCacheSimulator/NewCache.h>
+using MTV::BitPLRUReplacement;
+using MTV::BRRIPReplacement;
+using MTV::CacheLevel;
+using MTV::CompactCacheSet;
+using MTV::CompactReplacement;
+using MTV::DRRIPReplacement;
+using MTV::Eviction;
+using MTV::RRIPReplacement;
+using MTV::SHiPReplacement;
+using MTV::SRRIPReplacement;
+using MTV::TreePLRUReplacement;
+
+// Boost headers.
+#include <boost/make_shared.hpp>
+
+const uint8_t RRIPReplacement::MaxRRPV;
+const unsigned BRRIPReplacement::Throttle;
+const unsigned DRRIPReplacement::Constituency;
+const unsigned DRRIPReplacement::PSELMax;
+const unsigned SHiPReplacement::SignatureBits;
+const uint8_t SHiPReplacement::CounterMax;
+
+CompactReplacement::ptr CompactReplacement::create(CacheLevel::ReplacementPolicy policy, unsigned ways, unsigned region_blocks){
+  switch(policy){
+  case CacheLevel::TreePLRU:
+    return boost::make_shared<TreePLRUReplacement>(ways);
+
+  case CacheLevel::BitPLRU:
+    return boost::make_shared<BitPLRUReplacement>(ways);
+
+  case CacheLevel::SRRIP:
+    return boost::make_shared<SRRIPReplacement>(ways);
+
+  case CacheLevel::BRRIP:
+    return boost::make_shared<BRRIPReplacement>(ways);
+
+  case CacheLevel::DRRIP:
+    return boost::make_shared<DRRIPReplacement>(ways);
+
+  case CacheLevel::SHiP:
+    return boost::make_shared<SHiPReplacement>(ways, region_blocks);
+
+  default:
+    return CompactReplacement::ptr();
+  }
+}
+
+void TreePLRUReplacement::touch(uint8_t *state, unsigned way){
+  // Walk from the root to the way's leaf.  The node bits are stored
+  // heap-style (the children of node n are 2n+1 and 2n+2); a set bit
+  // means the victim lies in the right subtree.
+  unsigned node = 0;
+  for(unsigned half = ways >> 1; half > 0; half >>= 1){
+    const bool right = (way & half) != 0;
+    set_bit(state, node, not right);
+    node = 2*node + (right ? 2 : 1);
+  }
+}
+
+unsigned TreePLRUReplacement::victim(uint8_t *state, unsigned set){
+  unsigned node = 0, way = 0;
+  for(unsigned half = ways >> 1; half > 0; half >>= 1){
+    const bool right = get_bit(state, node);
+    if(right){
+      way |= half;
+    }
+    node = 2*node + (right ? 2 : 1);
+  }
+
+  return way;
+}
+
+void BitPLRUReplacement::touch(uint8_t *state, unsigned way){
+  set_bit(state, way, true);
+
+  for(unsigned w=0; w<ways; w++){
+    if(not get_bit(state, w)){
+      return;
+    }
+  }
+
+  // Every bit is set: start a new epoch with only this way marked.
+  for(unsigned w=0; w<ways; w++){
+    set_bit(state, w, w == way);
+  }
+}
+
+unsigned BitPLRUReplacement::victim(uint8_t *state, unsigned set){
+  for(unsigned w=0; w<ways; w++){
+    if(not get_bit(state, w)){
+      return w;
+    }
+  }
+
+  // NOTE(choudhury): touch() never leaves every bit set, so this is
+  // unreachable.
+  return 0;
+}
+
+unsigned RRIPReplacement::victim(uint8_t *state, unsigned set){
+  // Aging until some block reaches the distant RRPV is the same as
+  // aging every block by the distance from the oldest one to it.
+  uint8_t oldest = 0;
+  unsigned victim = 0;
+  for(unsigned w=0; w<ways; w++){
+    if(state[w] > oldest){
+      oldest = state[w];
+      victim = w;
+
+      if(oldest == MaxRRPV){
+        return victim;
+      }
+    }
+  }
+
+  const uint8_t age = MaxRRPV - oldest;
+  for(unsigned w=0; w<ways; w++){
+    state[w] += age;
+  }
+
+  return victim;
+}
+
+uint8_t DRRIPReplacement::insertion(unsigned set, uint64_t block_addr){
+  // Every fill is a miss, so the leader sets train the selector here.
+  switch(set % Constituency){
+  case 0:
+    if(psel < PSELMax){
+      psel++;
+    }
+    return MaxRRPV - 1;
+
+  case 1:
+    if(psel > 0){
+      psel--;
+    }
+    return this->bimodal();
+
+  default:
+    return psel > PSELMax / 2 ? this->bimodal() : MaxRRPV - 1;
+  }
+}
+
+void SHiPReplacement::hit(uint8_t *state, unsigned set, unsigned way){
+  state[way] = 0;
+  state[ways + way] = 1;
+
+  uint8_t& counter = shct[this->stored_signature(state, way)];
+  if(counter < CounterMax){
+    counter++;
+  }
+}
+
+void SHiPReplacement::fill(uint8_t *state, unsigned set, unsigned way, uint64_t block_addr){
+  const unsigned sig = this->signature(block_addr);
+
+  state[way] = this->insertion(set, block_addr);
+  state[ways + way] = 0;
+  state[2*ways + way] = sig & 0xff;
+  state[3*ways + way] = sig >> 8;
+}
+
+void SHiPReplacement::evict(uint8_t *state, unsigned set, unsigned way){
+  // A block evicted without being reused counts against its
+  // signature.
+  if(state[ways + way] == 0){
+    uint8_t& counter = shct[this->stored_signature(state, way)];
+    if(counter > 0){
+      counter--;
+    }
+  }
+}
+
+Eviction CompactCacheSet::allocate(uint64_t block_addr, boost::shared_ptr<NewCache> cache, unsigned level){
+  if(this->way(block_addr) >= 0){
+    throw AllocateExisting();
+  }
+
+  Eviction e(this->write_policy() == WriteBack, -1);
+
+  unsigned w;
+  if(tags.size() < num_blocks){
+    // The set is not yet full - use the next way.
+    w = tags.size();
+    blocks.push_back(CacheBlock(start_cell + w));
+
+    CacheLevel::iterator i = blocks.end();
+    --i;
+    tags.push_back(block_addr);
+    entries.push_back(i);
+  }
+  else{
+    if(num_invalid > 0){
+      // Reuse an invalidated way without evicting anything.
+      for(w=0; tags[w] != static_cast<uint64_t>(-1); w++);
+      num_invalid--;
+    }
+    else{
+      // Ask the policy for a victim, and evict it.
+      w = repl->victim(&state[0], set_index);
+      repl->evict(&state[0], set_index, w);
+
+      CacheLevel::iterator victim = entries[w];
+      e.eviction = true;
+      e.dirty = victim->dirty;
+      e.block_addr = victim->addr;
+
+      // If the victim is dirty, perform a write back.
+      if(victim->dirty){
+        this->write_back(cache, level + 1, victim->addr);
+      }
+    }
+
+    tags[w] = block_addr;
+  }
+
+  entries[w]->addr = block_addr;
+  entries[w]->dirty = false;
+  e.cell = entries[w]->cell;
+
+  repl->fill(&state[0], set_index, w, block_addr);
+  last_way = w;
+
+  return e;
+}
@@ -0,0 +1,404 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// CompactReplacement.h - Replacement policies that keep each set's
+// state in a few bits per way, as hardware does, instead of in an
+// ordered block list: tree and bit pseudo-LRU, the RRIP family
+// (static, bimodal, and set-dueling dynamic), and SHiP.
+
+#ifndef COMPACT_REPLACEMENT_H
+#define COMPACT_REPLACEMENT_H
+
+// MTV headers.
+#include <Core/Util/BoostPointers.h>
+#include <Tools/NewCacheSimulator/CacheLevel.h>
+
+// System headers.
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+
+namespace MTV{
+  // A policy object is shared by all the sets of a level, so that
+  // level-wide state (the DRRIP selector, the SHiP signature table)
+  // lives in one place; each set owns its per-way state bytes, whose
+  // layout the policy decides.
+  class CompactReplacement{
+  public:
+    BoostPointers(CompactReplacement);
+
+  public:
+    // Returns a policy object for the compact policies, or a null
+    // pointer for the others.  SHiP groups blocks into regions of
+    // "region_blocks" blocks to form its signatures.
+    static CompactReplacement::ptr create(CacheLevel::ReplacementPolicy policy, unsigned ways, unsigned region_blocks);
+
+  public:
+    CompactReplacement(unsigned ways)
+      : ways(ways)
+    {}
+
+    virtual ~CompactReplacement(){}
+
+    // The number of state bytes each set needs (which may be 0, e.g.
+    // for a one-way tree; sets still keep at least one byte, so that
+    // the state pointer is always valid).
+    virtual unsigned state_size() const = 0;
+
+    // A demand access to a block already in "way".
+    virtual void hit(uint8_t *state, unsigned set, unsigned way) = 0;
+
+    // "block_addr" has just been placed in "way" after a miss.
+    virtual void fill(uint8_t *state, unsigned set, unsigned way, uint64_t block_addr) = 0;
+
+    // Chooses the way to evict from a full set (and may update the
+    // state while doing so).
+    virtual unsigned victim(uint8_t *state, unsigned set) = 0;
+
+    // The block in "way" is about to be evicted.
+    virtual void evict(uint8_t *state, unsigned set, unsigned way) {}
+
+  protected:
+    static bool get_bit(const uint8_t *state, unsigned i){
+      return (state[i >> 3] >> (i & 7)) & 1;
+    }
+
+    static void set_bit(uint8_t *state, unsigned i, bool value){
+      if(value){
+        state[i >> 3] |= (1 << (i & 7));
+      }
+      else{
+        state[i >> 3] &= ~(1 << (i & 7));
+      }
+    }
+
+  protected:
+    const unsigned ways;
+  };
+
+  // Tree pseudo-LRU: ways - 1 bits arranged as a binary tree over the
+  // ways, each pointing toward the half that holds the victim.  An
+  // access flips the bits on its path to point away from it.  The
+  // associativity must be a power of two.
+  class TreePLRUReplacement : public CompactReplacement {
+  public:
+    TreePLRUReplacement(unsigned ways)
+      : CompactReplacement(ways)
+    {}
+
+    unsigned state_size() const {
+      return (ways - 1 + 7) / 8;
+    }
+
+    void hit(uint8_t *state, unsigned set, unsigned way){
+      this->touch(state, way);
+    }
+
+    void fill(uint8_t *state, unsigned set, unsigned way, uint64_t block_addr){
+      this->touch(state, way);
+    }
+
+    unsigned victim(uint8_t *state, unsigned set);
+
+  private:
+    void touch(uint8_t *state, unsigned way);
+  };
+
+  // Bit pseudo-LRU (also called MRU bits): one bit per way, set on
+  // access; when the last clear bit would be set, all the others are
+  // cleared instead.  The victim is the lowest way with a clear bit.
+  class BitPLRUReplacement : public CompactReplacement {
+  public:
+    BitPLRUReplacement(unsigned ways)
+      : CompactReplacement(ways)
+    {}
+
+    unsigned state_size() const {
+      return (ways + 7) / 8;
+    }
+
+    void hit(uint8_t *state, unsigned set, unsigned way){
+      this->touch(state, way);
+    }
+
+    void fill(uint8_t *state, unsigned set, unsigned way, uint64_t block_addr){
+      this->touch(state, way);
+    }
+
+    unsigned victim(uint8_t *state, unsigned set);
+
+  private:
+    void touch(uint8_t *state, unsigned way);
+  };
+
+  // Re-reference interval prediction with 2-bit re-reference
+  // prediction values (RRPVs), one byte per way.  Hits predict a near
+  // re-reference (RRPV 0); the victim is a block predicted distant
+  // (RRPV 3), aging the whole set until one exists.  Subclasses
+  // choose the RRPV a new block is inserted with.
+  class RRIPReplacement : public CompactReplacement {
+  public:
+    static const uint8_t MaxRRPV = 3;
+
+  public:
+    RRIPReplacement(unsigned ways)
+      : CompactReplacement(ways)
+    {}
+
+    unsigned state_size() const {
+      return ways;
+    }
+
+    void hit(uint8_t *state, unsigned set, unsigned way){
+      state[way] = 0;
+    }
+
+    void fill(uint8_t *state, unsigned set, unsigned way, uint64_t block_addr){
+      state[way] = this->insertion(set, block_addr);
+    }
+
+    unsigned victim(uint8_t *state, unsigned set);
+
+  protected:
+    virtual uint8_t insertion(unsigned set, uint64_t block_addr) = 0;
+  };
+
+  // Static RRIP: new blocks are predicted a long re-reference
+  // interval, so that scans do not flush blocks that have been
+  // reused.
+  class SRRIPReplacement : public RRIPReplacement {
+  public:
+    SRRIPReplacement(unsigned ways)
+      : RRIPReplacement(ways)
+    {}
+
+  protected:
+    uint8_t insertion(unsigned set, uint64_t block_addr){
+      return MaxRRPV - 1;
+    }
+  };
+
+  // Bimodal RRIP: new blocks are mostly predicted distant, and only
+  // occasionally long, which preserves part of a working set larger
+  // than the cache.
+  //
+  // NOTE(choudhury): the occasional long insertion comes from a
+  // counter rather than a random draw, so that runs are repeatable.
+  class BRRIPReplacement : public RRIPReplacement {
+  public:
+    // One insertion in this many is long rather than distant.
+    static const unsigned Throttle = 32;
+
+  public:
+    BRRIPReplacement(unsigned ways)
+      : RRIPReplacement(ways),
+        fills(0)
+    {}
+
+  protected:
+    uint8_t insertion(unsigned set, uint64_t block_addr){
+      return this->bimodal();
+    }
+
+    uint8_t bimodal(){
+      return (++fills % Throttle == 0) ? MaxRRPV - 1 : MaxRRPV;
+    }
+
+  private:
+    unsigned fills;
+  };
+
+  // Dynamic RRIP: set dueling between SRRIP and BRRIP.  In each group
+  // of 32 sets, one always uses SRRIP and one always uses BRRIP; a
+  // saturating selector counts which of those leader sets misses
+  // more, and the remaining sets follow the winner.
+  class DRRIPReplacement : public BRRIPReplacement {
+  public:
+    static const unsigned Constituency = 32;
+    static const unsigned PSELMax = 1023;
+
+  public:
+    DRRIPReplacement(unsigned ways)
+      : BRRIPReplacement(ways),
+        psel((PSELMax + 1) / 2)
+    {}
+
+  protected:
+    uint8_t insertion(unsigned set, uint64_t block_addr);
+
+  private:
+    unsigned psel;
+  };
+
+  // Signature-based hit prediction (SHiP) on top of SRRIP: a table of
+  // 3-bit counters, indexed by a signature of the block, learns
+  // whether blocks with that signature tend to be reused before they
+  // are evicted; blocks whose signature never sees reuse are inserted
+  // distant.
+  //
+  // NOTE(choudhury): the traces carry no instruction addresses, so
+  // the signature is a hash of the block's memory region (the
+  // SHiP-Mem variant).
+  //
+  // The state for each way is its RRPV, a reuse bit, and a 16-bit
+  // signature, stored in that order as four planes of "ways" bytes.
+  class SHiPReplacement : public RRIPReplacement {
+  public:
+    static const unsigned SignatureBits = 14;
+    static const uint8_t CounterMax = 7;
+
+  public:
+    SHiPReplacement(unsigned ways, unsigned region_blocks)
+      : RRIPReplacement(ways),
+        region_blocks(region_blocks > 0 ? region_blocks : 1),
+        shct(1 << SignatureBits, 1)
+    {}
+
+    unsigned state_size() const {
+      return 4*ways;
+    }
+
+    void hit(uint8_t *state, unsigned set, unsigned way);
+
+    void fill(uint8_t *state, unsigned set, unsigned way, uint64_t block_addr);
+
+    void evict(uint8_t *state, unsigned set, unsigned way);
+
+  protected:
+    uint8_t insertion(unsigned set, uint64_t block_addr){
+      return shct[this->signature(block_addr)] == 0 ? MaxRRPV : MaxRRPV - 1;
+    }
+
+  private:
+    unsigned signature(uint64_t block_addr) const {
+      return static_cast<unsigned>(((block_addr / region_blocks) * 0x9e3779b97f4a7c15ULL) >> (64 - SignatureBits));
+    }
+
+    unsigned stored_signature(const uint8_t *state, unsigned way) const {
+      return state[2*ways + way] | (state[3*ways + way] << 8);
+    }
+
+  private:
+    const unsigned region_blocks;
+
+    // The signature history counter table.
+    std::vector<uint8_t> shct;
+  };
+
+  // A cache set driven by a CompactReplacement policy.  The tags are
+  // scanned linearly, and the per-way block entries never move within
+  // the block list.
+  class CompactCacheSet : public CacheLevel {
+  public:
+    BoostPointers(CompactCacheSet);
+
+  public:
+    CompactCacheSet(WritePolicy write_policy, CompactReplacement::ptr repl, unsigned num_blocks, unsigned start_cell, unsigned set_index)
+      : CacheLevel(write_policy),
+        num_blocks(num_blocks),
+        start_cell(start_cell),
+        set_index(set_index),
+        repl(repl),
+        state(std::max(repl->state_size(), 1u), 0),
+        last_way(0),
+        num_invalid(0)
+    {
+      tags.reserve(num_blocks);
+      entries.reserve(num_blocks);
+    }
+
+    CacheLevel::iterator find(uint64_t block_addr){
+      const int w = this->way(block_addr);
+      return w < 0 ? blocks.end() : entries[w];
+    }
+
+    Eviction allocate(uint64_t block_addr, boost::shared_ptr<NewCache> cache, unsigned level);
+
+    bool invalidate(uint64_t block_addr){
+      const int w = this->way(block_addr);
+      if(w < 0){
+        return false;
+      }
+
+      // NOTE(choudhury): the policy state for the way is left alone;
+      // allocate() fills empty ways before consulting the policy.
+      const bool dirty = entries[w]->dirty;
+      tags[w] = static_cast<uint64_t>(-1);
+      entries[w]->addr = static_cast<uint64_t>(-1);
+      entries[w]->dirty = false;
+      num_invalid++;
+
+      return dirty;
+    }
+
+    void read(uint64_t block_addr){
+      const int w = this->way(block_addr);
+      if(w < 0){
+        throw IllegalBlockAccess();
+      }
+
+      repl->hit(&state[0], set_index, w);
+    }
+
+    void write(uint64_t block_addr){
+      const int w = this->way(block_addr);
+      if(w < 0){
+        throw IllegalBlockAccess();
+      }
+
+      repl->hit(&state[0], set_index, w);
+      entries[w]->dirty = true;
+    }
+
+    // NOTE(choudhury): allocate() has already told the policy about
+    // the insertion, so the access that completes the miss must not
+    // count as a hit, or every insertion would look like a reuse.
+    void fill(uint64_t block_addr, bool write){
+      const int w = this->way(block_addr);
+      if(w < 0){
+        throw IllegalBlockAccess();
+      }
+
+      if(write){
+        entries[w]->dirty = true;
+      }
+    }
+
+  private:
+    int way(uint64_t block_addr){
+      // Lookups come in runs for the same block (has_block(), then
+      // read() or find()), so check the last way found first.
+      if(last_way < tags.size() and tags[last_way] == block_addr){
+        return last_way;
+      }
+
+      for(unsigned w=0; w<tags.size(); w++){
+        if(tags[w] == block_addr){
+          last_way = w;
+          return w;
+        }
+      }
+
+      return -1;
+    }
+
+  private:
+    const unsigned num_blocks;
+    const unsigned start_cell;
+    const unsigned set_index;
+
+    CompactReplacement::ptr repl;
+    std::vector<uint8_t> state;
+
+    // The block address held in each way, and its block entry.
+    std::vector<uint64_t> tags;
+    std::vector<CacheLevel::iterator> entries;
+
+    unsigned last_way;
+
+    unsigned num_invalid;
+  };
+}
+
+#endif
@@ -0,0 +1,260 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// MissStream.cpp
+
+// MTV headers.
+#include <Core/Util/BoostForeach.h>
+#include <Tools/NewCacheSimulator/MissStream.h>
+#include <Tools/NewCacheSimulator/NewCache.h>
+using MTV::CacheAccessRecord;
+using MTV::MissRequest;
+using MTV::MissStreamReader;
+using MTV::MissStreamReplayer;
+using MTV::MissStreamWriter;
+using MTV::NewCache;
+
+// System headers.
+#include <algorithm>
+#include <cstring>
+
+const uint32_t MissStreamWriter::Version;
+
+namespace{
+  template<typename T>
+  void put(std::ostream& out, const T& x){
+    out.write(reinterpret_cast<const char *>(&x), sizeof(x));
+  }
+
+  template<typename T>
+  bool get(std::istream& in, T& x){
+    in.read(reinterpret_cast<char *>(&x), sizeof(x));
+    return in.good();
+  }
+}
+
+bool MissStreamWriter::open(const std::string& filename, const NewCache& cache){
+  if(split_level == 0 or split_level >= cache.num_levels()){
+    *this << "cannot record the requests leaving level " << split_level << " of a " << cache.num_levels() << "-level cache";
+    return false;
+  }
+
+  // NOTE(choudhury): an inclusive cache's lower levels reach back into
+  // the upper ones, an exclusive cache moves victims between them, and
+  // prefetchers act on every level at once, so in none of these cases
+  // do the upper levels depend only on the accesses.
+  if(cache.inclusion_policy() != NewCache::NonInclusive){
+    *this << "only non-inclusive caches can be recorded";
+    return false;
+  }
+
+  for(unsigned L=0; L<cache.num_levels(); L++){
+    if(cache.level(L)->prefetcher()){
+      *this << "caches with prefetchers cannot be recorded";
+      return false;
+    }
+  }
+
+  file.open(filename.c_str(), std::ios::binary);
+  if(!file){
+    *this << "could not open file '" << filename << "' for writing";
+    return false;
+  }
+
+  // The header describes the upper levels, so that a replay can check
+  // that it simulates the same ones.
+  file.write(magic(), 8);
+  put(file, Version);
+  put(file, static_cast<uint32_t>(cache.block_size()));
+  put(file, static_cast<uint32_t>(split_level));
+  for(unsigned L=0; L<split_level; L++){
+    put(file, cache.level(L)->num_sets());
+    put(file, static_cast<uint32_t>(cache.level(L)->write_policy()));
+  }
+
+  outbuf.push(gzip_compressor());
+  outbuf.push(file);
+
+  return static_cast<bool>(file);
+}
+
+bool MissStreamWriter::close(){
+  if(outbuf.empty()){
+    return false;
+  }
+
+  // The end record carries the number of accesses in place of an
+  // access index.
+  out.put('E');
+  put(out, accesses);
+  put(out, position);
+  put(out, static_cast<uint64_t>(0));
+
+  const bool ok = out.good();
+  outbuf.reset();
+  file.close();
+
+  return ok and file.good();
+}
+
+void MissStreamWriter::write_record(char type, uint64_t addr){
+  out.put(type);
+  put(out, accesses - 1);
+  put(out, position);
+  put(out, addr);
+}
+
+void MissStreamWriter::request(MissRequest::Type type, uint64_t addr){
+  this->write_record(type, addr);
+  requested = true;
+}
+
+void MissStreamWriter::finish(const std::vector<Daly::CacheHitRecord>& hits){
+  if(requested){
+    return;
+  }
+
+  // Only accesses supplied by an upper level other than the first need
+  // to be recorded; the rest are first level hits.
+  unsigned level = 0;
+  foreach(const Daly::CacheHitRecord& h, hits){
+    level = std::max(level, static_cast<unsigned>(h.L));
+  }
+
+  if(level > 0){
+    this->write_record(MissRequest::Hit, level);
+  }
+}
+
+bool MissStreamReader::open(const std::string& filename, const NewCache& cache){
+  file.open(filename.c_str(), std::ios::binary);
+  if(!file){
+    *this << "could not open miss stream '" << filename << "'";
+    return false;
+  }
+
+  char m[8];
+  uint32_t version, blocksize, split;
+  file.read(m, sizeof(m));
+  if(!file or std::memcmp(m, MissStreamWriter::magic(), sizeof(m)) != 0){
+    *this << "'" << filename << "' is not a miss stream";
+    return false;
+  }
+
+  if(!get(file, version) or version != MissStreamWriter::Version){
+    *this << "miss stream '" << filename << "' has an unsupported version";
+    return false;
+  }
+
+  if(!get(file, blocksize) or !get(file, split)){
+    *this << "miss stream '" << filename << "' is truncated";
+    return false;
+  }
+
+  if(split == 0 or split >= cache.num_levels()){
+    *this << "miss stream '" << filename << "' leaves level " << split << ", but the cache has " << cache.num_levels() << " levels";
+    return false;
+  }
+
+  if(blocksize != cache.block_size()){
+    *this << "miss stream '" << filename << "' was recorded with " << blocksize << "-byte blocks, but the cache has " << cache.block_size() << "-byte blocks";
+    return false;
+  }
+
+  for(unsigned L=0; L<split; L++){
+    uint64_t num_sets;
+    uint32_t write_policy;
+    if(!get(file, num_sets) or !get(file, write_policy)){
+      *this << "miss stream '" << filename << "' is truncated";
+      return false;
+    }
+
+    if(num_sets != cache.level(L)->num_sets() or write_policy != static_cast<uint32_t>(cache.level(L)->write_policy())){
+      *this << "level " << (L+1) << " of the cache differs from the one miss stream '" << filename << "' was recorded with";
+      return false;
+    }
+  }
+
+  if(cache.inclusion_policy() != NewCache::NonInclusive){
+    *this << "miss streams can only be replayed through non-inclusive caches";
+    return false;
+  }
+
+  split_level = split;
+
+  inbuf.push(gzip_decompressor());
+  inbuf.push(file);
+
+  return true;
+}
+
+bool MissStreamReader::next(MissRequest& r){
+  if(done){
+    return false;
+  }
+
+  char type;
+  if(!in.get(type) or !get(in, r.access) or !get(in, r.position) or !get(in, r.addr)){
+    *this << "miss stream is truncated";
+    done = true;
+    return false;
+  }
+
+  if(type == 'E'){
+    accesses = r.access;
+    done = true;
+    return false;
+  }
+
+  r.type = type;
+  return true;
+}
+
+void MissStreamReplayer::absorbed(unsigned L){
+  hits.clear();
+  hits.push_back(Daly::CacheHitRecord(0, L, 0, 'R'));
+
+  this->produce(CacheAccessRecord(hits, no_evictions, no_entrances, 0));
+}
+
+bool MissStreamReplayer::step(){
+  if(not have_pending){
+    have_pending = stream->next(pending);
+  }
+
+  if(not have_pending and access >= stream->num_accesses()){
+    return false;
+  }
+
+  if(not have_pending or pending.access != access){
+    // The access never left the first level.
+    this->absorbed(0);
+  }
+  else if(pending.type == MissRequest::Hit){
+    this->absorbed(pending.addr);
+    have_pending = false;
+  }
+  else{
+    // Send each of the access's requests to the lower levels, reporting
+    // the address of the read (if there is one) as the address
+    // accessed.
+    MTR::addr_t addr = 0;
+    bool read = false;
+
+    cache->begin_replay();
+    while(have_pending and pending.access == access){
+      cache->replay(pending, stream->split());
+
+      if(not read and pending.type == MissRequest::Read){
+        addr = pending.addr;
+        read = true;
+      }
+
+      have_pending = stream->next(pending);
+    }
+
+    this->produce(CacheAccessRecord(cache->hitInfo(), cache->evictionInfo(), cache->entranceInfo(), addr));
+  }
+
+  access++;
+  return true;
+}
@@ -0,0 +1,191 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// MissStream.h - Records the requests that leave the upper levels of
+// a NewCache (the read misses, write-throughs, and write-backs they
+// send to the level below), and replays them through a cache with the
+// same upper levels, so that a sweep over the lower levels'
+// configurations simulates the upper levels only once.
+
+#ifndef MISS_STREAM_H
+#define MISS_STREAM_H
+
+// MTV headers.
+#include <Core/Dataflow/CacheAccessRecord.h>
+#include <Core/Dataflow/Producer.h>
+#include <Core/Util/Boost.h>
+#include <Core/Util/BoostPointers.h>
+#include <Core/Util/ErrorMessage.h>
+
+// System headers.
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace MTV{
+  class NewCache;
+
+  struct MissRequest{
+    // Reads and writes are requests sent to the level below the upper
+    // levels.  A Hit marks an access that the upper levels absorbed
+    // below their first level (its "addr" holds the level of the hit).
+    enum Type{
+      Read = 'R',
+      Write = 'W',
+      Hit = 'H'
+    };
+
+    // The index of the cache access (counting from 0) that made the
+    // request, and the trace position of its record.
+    uint64_t access, position;
+
+    uint64_t addr;
+    char type;
+  };
+
+  class MissStreamWriter : public ErrorMessage {
+  public:
+    BoostPointers(MissStreamWriter);
+
+  public:
+    static const char *magic(){
+      return "MTVXMISS";
+    }
+
+    static const uint32_t Version = 1;
+
+  public:
+    // Records the requests leaving the first "split" levels.
+    MissStreamWriter(unsigned split)
+      : split_level(split),
+        accesses(0),
+        position(0),
+        requested(false),
+        out(&outbuf)
+    {}
+
+    ~MissStreamWriter(){
+      this->close();
+    }
+
+    // Writes the header, describing the cache's upper levels.  Only
+    // non-inclusive caches without prefetchers can be recorded.
+    bool open(const std::string& filename, const NewCache& cache);
+
+    // Finishes the stream, recording the number of accesses made.
+    bool close();
+
+    unsigned split() const {
+      return split_level;
+    }
+
+    // Called by the cache at the start of each access, for each
+    // request it sends below the split, and with the access's hits once
+    // it is complete.
+    void access(uint64_t pos){
+      accesses++;
+      position = pos;
+      requested = false;
+    }
+
+    void request(MissRequest::Type type, uint64_t addr);
+
+    void finish(const std::vector<Daly::CacheHitRecord>& hits);
+
+  private:
+    void write_record(char type, uint64_t addr);
+
+  private:
+    const unsigned split_level;
+    uint64_t accesses, position;
+    bool requested;
+
+    std::ofstream file;
+    filtering_ostreambuf outbuf;
+    std::ostream out;
+  };
+
+  class MissStreamReader : public ErrorMessage {
+  public:
+    BoostPointers(MissStreamReader);
+
+  public:
+    MissStreamReader()
+      : split_level(0),
+        accesses(0),
+        done(false),
+        in(&inbuf)
+    {}
+
+    // Reads the header, checking that the cache's upper levels match
+    // the ones the stream was recorded from.
+    bool open(const std::string& filename, const NewCache& cache);
+
+    unsigned split() const {
+      return split_level;
+    }
+
+    // Reads the next request, returning false at the end of the stream
+    // (or if it is truncated, which also sets an error).
+    bool next(MissRequest& r);
+
+    // The number of accesses made by the recorded cache (known once
+    // next() has reached the end).
+    uint64_t num_accesses() const {
+      return accesses;
+    }
+
+  private:
+    unsigned split_level;
+    uint64_t accesses;
+    bool done;
+
+    std::ifstream file;
+    filtering_istreambuf inbuf;
+    std::istream in;
+  };
+
+  // Drives a cache's lower levels from a miss stream, producing one
+  // access record per access made by the recorded cache.  The records
+  // hold the lower levels' results; an access the upper levels
+  // absorbed is reported as a single hit in the level that supplied
+  // it.
+  class MissStreamReplayer : public Producer<CacheAccessRecord> {
+  public:
+    BoostPointers(MissStreamReplayer);
+
+  public:
+    MissStreamReplayer(boost::shared_ptr<NewCache> cache, MissStreamReader::ptr stream)
+      : cache(cache),
+        stream(stream),
+        access(0),
+        have_pending(false)
+    {}
+
+    // Replays the next access, returning false when there are no more.
+    bool step();
+
+    void produce(const CacheAccessRecord& rec){
+      this->broadcast(rec);
+    }
+
+  private:
+    void absorbed(unsigned L);
+
+  private:
+    boost::shared_ptr<NewCache> cache;
+    MissStreamReader::ptr stream;
+
+    uint64_t access;
+    MissRequest pending;
+    bool have_pending;
+
+    std::vector<Daly::CacheHitRecord> hits;
+    const std::vector<Daly::CacheEvictionRecord> no_evictions;
+    const std::vector<Daly::CacheEntranceRecord> no_entrances;
+  };
+}
+
+#endif
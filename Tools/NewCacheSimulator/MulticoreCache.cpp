@@ -0,0 +1,293 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// MulticoreCache.cpp
+
+// MTV headers.
+#include <Tools/NewCacheSimulator/MulticoreCache.h>
+using MTV::CacheLevel;
+using MTV::MulticoreCache;
+using MTV::NewCache;
+
+// System headers.
+#include <algorithm>
+#include <iomanip>
+
+const unsigned MulticoreCache::WordSize = 8;
+
+namespace{
+  bool more_false_sharing(const std::pair<uint64_t, uint64_t>& a, const std::pair<uint64_t, uint64_t>& b){
+    return a.second > b.second or (a.second == b.second and a.first < b.first);
+  }
+
+  double percent(uint64_t part, uint64_t whole){
+    return whole > 0 ? 100.0 * part / whole : 0.0;
+  }
+}
+
+void MulticoreCache::Stats::print(std::ostream& out, const std::string& indent) const {
+  out << indent << "accesses: " << accesses << std::endl
+      << indent << "memory misses: " << memory_misses << " (" << percent(memory_misses, accesses) << "%)" << std::endl
+      << indent << "coherence misses: " << coherence_misses << " (" << percent(coherence_misses, accesses) << "%)" << std::endl
+      << indent << "  true sharing: " << true_sharing << std::endl
+      << indent << "  false sharing: " << false_sharing << std::endl
+      << indent << "invalidations: " << invalidations << std::endl
+      << indent << "interventions: " << interventions << std::endl
+      << indent << "upgrades: " << upgrades << std::endl;
+}
+
+MulticoreCache::MulticoreCache(NewCacheSet::ptr cacheset)
+  : caches(cacheset->getCaches()),
+    depth(caches.size(), 0)
+{
+  // A core's private levels are the leading levels that appear in no
+  // other core's cache.
+  for(unsigned i=0; i<caches.size(); i++){
+    for(unsigned L=0; L<caches[i]->num_levels(); L++){
+      bool shared = false;
+      for(unsigned j=0; j<caches.size() and not shared; j++){
+        if(j == i){
+          continue;
+        }
+
+        for(unsigned M=0; M<caches[j]->num_levels(); M++){
+          if(caches[j]->level(M) == caches[i]->level(L)){
+            shared = true;
+            break;
+          }
+        }
+      }
+
+      if(shared){
+        break;
+      }
+
+      depth[i]++;
+    }
+  }
+}
+
+void MulticoreCache::addRegion(const std::string& name, uint64_t base, uint64_t limit){
+  Region r;
+  r.name = name;
+  r.limit = limit;
+
+  regions[base] = r;
+}
+
+void MulticoreCache::load(unsigned core, uint64_t addr){
+  this->access(core, addr, false);
+}
+
+void MulticoreCache::store(unsigned core, uint64_t addr){
+  this->access(core, addr, true);
+}
+
+void MulticoreCache::access(unsigned core, uint64_t addr, bool write){
+  const unsigned cores = caches.size();
+  NewCache::ptr cache = caches[core];
+
+  const uint64_t block_addr = addr / cache->block_size();
+  const uint64_t word = 1ULL << (((addr % cache->block_size()) / WordSize) % 64);
+
+  boost::unordered_map<uint64_t, Line>::iterator entry = directory.find(block_addr);
+  if(entry == directory.end()){
+    entry = directory.insert(std::make_pair(block_addr, Line(cores))).first;
+  }
+  Line& line = entry->second;
+
+  Stats s;
+  s.accesses = 1;
+
+  // Check whether the block is anywhere in this core's cache.
+  bool present = false;
+  for(unsigned L=0; L<cache->num_levels() and not present; L++){
+    present = cache->level(L)->has_block(block_addr);
+  }
+  if(not present){
+    s.memory_misses = 1;
+  }
+
+  const State before = line.state[core];
+  if(before == Invalid){
+    // A miss in the private levels - if another core's store took the
+    // block away, it is a coherence miss, and it is true sharing if
+    // this access touches a word written since then.
+    if(line.invalidated[core]){
+      s.coherence_misses = 1;
+      if(line.remote[core] & word){
+        s.true_sharing = 1;
+      }
+      else{
+        s.false_sharing = 1;
+        line.false_sharing++;
+      }
+    }
+
+    line.invalidated[core] = false;
+    line.remote[core] = 0;
+
+    // Other copies are demoted to Shared, and a Modified copy is
+    // written back first.
+    bool shared = false;
+    for(unsigned d=0; d<cores; d++){
+      if(d == core or line.state[d] == Invalid){
+        continue;
+      }
+
+      if(line.state[d] == Modified){
+        this->intervene(d, block_addr);
+        s.interventions++;
+      }
+
+      line.state[d] = Shared;
+      shared = true;
+    }
+
+    line.state[core] = shared ? Shared : Exclusive;
+  }
+
+  if(write){
+    if(before == Shared){
+      s.upgrades = 1;
+    }
+
+    // Take the block away from every other core, and note the written
+    // word for each core that has lost its copy.
+    for(unsigned d=0; d<cores; d++){
+      if(d == core){
+        continue;
+      }
+
+      if(line.state[d] != Invalid){
+        this->invalidate(d, block_addr);
+        s.invalidations++;
+
+        line.state[d] = Invalid;
+        line.invalidated[d] = true;
+        line.remote[d] = 0;
+      }
+
+      if(line.invalidated[d]){
+        line.remote[d] |= word;
+      }
+    }
+
+    line.state[core] = Modified;
+    cache->store(addr);
+  }
+  else{
+    cache->load(addr);
+  }
+
+  this->retire(core);
+
+  total += s;
+
+  std::map<uint64_t, Region>::iterator r = regions.upper_bound(addr);
+  if(r != regions.begin()){
+    --r;
+    if(addr < r->second.limit){
+      r->second.stats += s;
+    }
+  }
+}
+
+void MulticoreCache::intervene(unsigned core, uint64_t block_addr){
+  NewCache::ptr cache = caches[core];
+
+  // The write backs add to the eviction records left over from the
+  // core's own last access, which were retired then; only the new
+  // ones need retiring now.
+  const size_t first = cache->evictions().size();
+
+  // Push dirty data down one level at a time, so a copy written back
+  // into a lower private level is itself written back on the next
+  // step.
+  for(unsigned L=0; L<depth[core]; L++){
+    CacheLevel::ptr level = cache->level(L);
+    if(level->write_policy() == CacheLevel::WriteBack and level->clean(block_addr)){
+      level->write_back(cache, L + 1, block_addr);
+    }
+  }
+
+  this->retire(core, first);
+}
+
+void MulticoreCache::invalidate(unsigned core, uint64_t block_addr){
+  NewCache::ptr cache = caches[core];
+
+  bool dirty = false;
+  for(unsigned L=0; L<depth[core]; L++){
+    if(cache->level(L)->invalidate(block_addr) and cache->level(L)->write_policy() == CacheLevel::WriteBack){
+      dirty = true;
+    }
+  }
+
+  // The owner's data goes to the first shared level (or memory) before
+  // the writer's store lands on top of it.
+  if(dirty){
+    cache->level(depth[core] - 1)->write_back(cache, depth[core], block_addr);
+  }
+}
+
+void MulticoreCache::retire(unsigned core, size_t first){
+  const std::vector<Daly::CacheEvictionRecord>& evictions = caches[core]->evictions();
+  for(size_t i=first; i<evictions.size(); i++){
+    const Daly::CacheEvictionRecord& e = evictions[i];
+    if(e.L >= depth[core] or this->in_private(core, e.blockaddr)){
+      continue;
+    }
+
+    boost::unordered_map<uint64_t, Line>::iterator entry = directory.find(e.blockaddr);
+    if(entry != directory.end()){
+      entry->second.state[core] = Invalid;
+    }
+  }
+}
+
+bool MulticoreCache::in_private(unsigned core, uint64_t block_addr) const {
+  for(unsigned L=0; L<depth[core]; L++){
+    if(caches[core]->level(L)->has_block(block_addr)){
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void MulticoreCache::report(std::ostream& out, unsigned hotspots) const {
+  out << std::fixed << std::setprecision(2);
+
+  out << "cores: " << caches.size() << std::endl;
+  for(unsigned i=0; i<caches.size(); i++){
+    out << "  core " << i << ": " << depth[i] << " private level" << (depth[i] == 1 ? "" : "s") << std::endl;
+  }
+
+  out << "total:" << std::endl;
+  total.print(out, "  ");
+
+  for(std::map<uint64_t, Region>::const_iterator i = regions.begin(); i != regions.end(); i++){
+    out << "region " << i->second.name << " [0x" << std::hex << i->first << ", 0x" << i->second.limit << std::dec << "):" << std::endl;
+    i->second.stats.print(out, "  ");
+  }
+
+  if(hotspots == 0){
+    return;
+  }
+
+  std::vector<std::pair<uint64_t, uint64_t> > blocks;
+  for(boost::unordered_map<uint64_t, Line>::const_iterator i = directory.begin(); i != directory.end(); i++){
+    if(i->second.false_sharing > 0){
+      blocks.push_back(std::make_pair(i->first, i->second.false_sharing));
+    }
+  }
+
+  const unsigned n = std::min<size_t>(hotspots, blocks.size());
+  std::partial_sort(blocks.begin(), blocks.begin() + n, blocks.end(), more_false_sharing);
+
+  out << "false sharing hotspots:" << std::endl;
+  for(unsigned i=0; i<n; i++){
+    const uint64_t addr = blocks[i].first * caches[0]->block_size();
+    out << "  0x" << std::hex << addr << std::dec << ": " << blocks[i].second << std::endl;
+  }
+}
@@ -0,0 +1,167 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// MulticoreCache.h - Drives a cache set as a multicore memory system,
+// one cache per core, keeping the cores' private levels coherent with
+// a MESI directory and classifying coherence misses as true or false
+// sharing.
+
+#ifndef MULTICORE_CACHE_H
+#define MULTICORE_CACHE_H
+
+// MTV headers.
+#include <Core/Util/BoostPointers.h>
+#include <Tools/NewCacheSimulator/NewCacheSet.h>
+
+// Boost headers.
+#include <boost/unordered_map.hpp>
+
+// System headers.
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace MTV{
+  class MulticoreCache{
+  public:
+    BoostPointers(MulticoreCache);
+
+  public:
+    enum State{
+      Invalid,
+      Shared,
+      Exclusive,
+      Modified
+    };
+
+    struct Stats{
+      Stats()
+        : accesses(0),
+          memory_misses(0),
+          coherence_misses(0),
+          true_sharing(0),
+          false_sharing(0),
+          invalidations(0),
+          interventions(0),
+          upgrades(0)
+      {}
+
+      Stats& operator+=(const Stats& other){
+        accesses += other.accesses;
+        memory_misses += other.memory_misses;
+        coherence_misses += other.coherence_misses;
+        true_sharing += other.true_sharing;
+        false_sharing += other.false_sharing;
+        invalidations += other.invalidations;
+        interventions += other.interventions;
+        upgrades += other.upgrades;
+
+        return *this;
+      }
+
+      void print(std::ostream& out, const std::string& indent) const;
+
+      // Memory misses are accesses that found the block in no level of
+      // the core's cache; coherence misses are misses in the core's
+      // private levels to a block that was taken away by another
+      // core's store.
+      uint64_t accesses;
+      uint64_t memory_misses;
+      uint64_t coherence_misses;
+      uint64_t true_sharing;
+      uint64_t false_sharing;
+
+      // Private copies destroyed by stores, dirty private copies
+      // written back for other cores' accesses, and stores to Shared
+      // blocks.
+      uint64_t invalidations;
+      uint64_t interventions;
+      uint64_t upgrades;
+    };
+
+    // Sharing is tracked at the granularity of 8-byte words.
+    static const unsigned WordSize;
+
+  public:
+    // Core i runs on the i'th cache of the set.  The levels of a cache
+    // above its first shared level are that core's private levels.
+    MulticoreCache(NewCacheSet::ptr caches);
+
+    unsigned num_cores() const {
+      return caches.size();
+    }
+
+    // Attributes statistics for accesses in [base, limit) to the named
+    // region (regions should not overlap).
+    void addRegion(const std::string& name, uint64_t base, uint64_t limit);
+
+    void load(unsigned core, uint64_t addr);
+    void store(unsigned core, uint64_t addr);
+
+    const Stats& stats() const {
+      return total;
+    }
+
+    // Prints the overall and per-region statistics, followed by the
+    // "hotspots" blocks with the most false sharing misses.
+    void report(std::ostream& out, unsigned hotspots) const;
+
+  private:
+    // The directory entry for one block.
+    struct Line{
+      Line(unsigned cores)
+        : state(cores, Invalid),
+          invalidated(cores, false),
+          remote(cores, 0),
+          false_sharing(0)
+      {}
+
+      std::vector<State> state;
+
+      // Whether each core's last copy was invalidated by another core,
+      // and which words were written by other cores since then.
+      std::vector<bool> invalidated;
+      std::vector<uint64_t> remote;
+
+      uint64_t false_sharing;
+    };
+
+    struct Region{
+      std::string name;
+      uint64_t limit;
+      Stats stats;
+    };
+
+    void access(unsigned core, uint64_t addr, bool write);
+
+    // Writes back any dirty private copy the core holds.
+    void intervene(unsigned core, uint64_t block_addr);
+
+    // Destroys the core's private copies.
+    void invalidate(unsigned core, uint64_t block_addr);
+
+    // Moves blocks evicted from the core's private levels to Invalid,
+    // starting from the given eviction record.
+    void retire(unsigned core, size_t first = 0);
+
+    bool in_private(unsigned core, uint64_t block_addr) const;
+
+  private:
+    std::vector<NewCache::ptr> caches;
+
+    // The number of private levels for each core.
+    std::vector<unsigned> depth;
+
+    boost::unordered_map<uint64_t, Line> directory;
+
+    // Regions, keyed by base address.
+    std::map<uint64_t, Region> regions;
+
+    Stats total;
+  };
+}
+
+#endif
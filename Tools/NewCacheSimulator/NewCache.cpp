@@ -2,11 +2,20 @@
 //
 // NewCache.cpp
 
+#include <Core/Util/BoostForeach.h>
+#include <Tools/NewCacheSimulator/CompactReplacement.h>
 #include <Tools/NewCacheSimulator/NewCache.h>
 #include <Tools/NewCacheSimulator/NewCacheConstructor.h>
 using MTV::CacheLevel;
+using MTV::CompactCacheSet;
+using MTV::CompactReplacement;
+using MTV::MissRequest;
 using MTV::NewCache;
 using MTV::NewCacheConstructor;
+using MTV::Prefetcher;
+
+// System headers.
+#include <algorithm>
 
 NewCache::ptr NewCache::newFromSpec(const std::string& specfile, TraceReader::ptr trace, BlockStreamReader::ptr bsreader, std::string& error){
   NewCacheConstructor c(specfile);
@@ -119,6 +128,31 @@ CacheLevel::ptr NewCache::add_level(unsigned num_blocks, unsigned num_sets, Cach
         level = boost::make_shared<SetAssociativeCacheLevel>(sets);
       }
       break;
+
+    case CacheLevel::TreePLRU:
+    case CacheLevel::BitPLRU:
+    case CacheLevel::SRRIP:
+    case CacheLevel::BRRIP:
+    case CacheLevel::DRRIP:
+    case CacheLevel::SHiP:
+      {
+        if(repl_policy == CacheLevel::TreePLRU and (num_blocks_per_set & (num_blocks_per_set - 1)) != 0){
+          throw IllegalAssociativity();
+        }
+
+        // One policy object serves every set in the level.  SHiP
+        // signatures come from 16K regions.
+        const unsigned region_blocks = std::max(16384 / blocksize, 1u);
+        CompactReplacement::ptr repl = CompactReplacement::create(repl_policy, num_blocks_per_set, region_blocks);
+
+        std::vector<CacheLevel::ptr> sets(num_sets);
+        for(unsigned i=0; i<num_sets; i++){
+          sets[i] = boost::make_shared<CompactCacheSet>(write_policy, repl, num_blocks_per_set, i*num_blocks_per_set, i);
+        }
+
+        level = boost::make_shared<SetAssociativeCacheLevel>(sets);
+      }
+      break;
     }
 
     // Place the level into the cache's level set.
@@ -128,7 +162,7 @@ CacheLevel::ptr NewCache::add_level(unsigned num_blocks, unsigned num_sets, Cach
   return levels.back();
 }
 
-void NewCache::load(const uint64_t addr){
+void NewCache::clear_info(){
   // Empty the hit information vectors.
 #ifdef USE_STRING_INFO
   hit_info_string.clear();
@@ -139,10 +173,41 @@ void NewCache::load(const uint64_t addr){
   hit_info.clear();
   eviction_info.clear();
   entrance_info.clear();
+  prefetch_info.clear();
+}
+
+void NewCache::load(const uint64_t addr){
+  this->clear_info();
+
+  if(miss_stream){
+    miss_stream->access(trace ? trace->getTracePoint() - 1 : 0);
+  }
 
   // Compute the block address.
   const uint64_t block_addr = addr / blocksize;
 
+  const bool prefetching = this->prefetching();
+  const unsigned demand = prefetching ? this->demand_level(block_addr) : 0;
+
+  if(inclusion == Exclusive){
+    this->load_exclusive(addr);
+  }
+  else{
+    this->read_at_level(0, addr);
+  }
+
+  if(prefetching){
+    this->prefetch(block_addr, demand);
+  }
+
+  if(miss_stream){
+    miss_stream->finish(hit_info);
+  }
+}
+
+void NewCache::read_at_level(const unsigned level, const uint64_t addr){
+  const uint64_t block_addr = addr / blocksize;
+
   // Search for the block in each level of cache until it's found.
   // When it's not found in a given level, allocate the block there
   // and possibly take a write-back action.
@@ -150,7 +215,12 @@ void NewCache::load(const uint64_t addr){
   // TODO(choudhury): throughout the process, record information
   // about the results of each operation.
   bool in_cache = false;
-  for(unsigned L=0; L<levels.size(); L++){
+  for(unsigned L=level; L<levels.size(); L++){
+    // Record the request if it leaves the levels being recorded.
+    if(miss_stream and L == miss_stream->split()){
+      miss_stream->request(MissRequest::Read, addr);
+    }
+
     // CacheLevel::iterator i = levels[L]->find(block_addr);      
     // if(levels[L]->present(i)){
     if(levels[L]->has_block(block_addr)){
@@ -208,7 +278,7 @@ void NewCache::load(const uint64_t addr){
         eviction_info_string.push_back(ss.str());
 #endif
 
-        eviction_info.push_back(Daly::CacheEvictionRecord(L, e.block_addr, levels[L]->write_policy() == CacheLevel::WriteBack, e.dirty));
+        this->evicted(L, e);
       }
 
       // Finally, read from the newly allocated block.
@@ -216,7 +286,7 @@ void NewCache::load(const uint64_t addr){
       // NOTE(choudhury): don't record a hit here - the block may be
       // found in a higher level, so the hit will be recorded AFTER
       // the search loop concludes.
-      levels[L]->read(block_addr);
+      levels[L]->fill(block_addr, false);
     }
   }
 
@@ -238,11 +308,20 @@ void NewCache::load(const uint64_t addr){
 void NewCache::write_at_level(const unsigned level, const uint64_t addr){
   const uint64_t block_addr = addr / blocksize;
 
+  if(inclusion == Exclusive and level < levels.size()){
+    this->write_exclusive(level, addr);
+    return;
+  }
+
   // Go up through the levels of cache, looking for the block to
   // write to - stop when a write back cache level is found.
   unsigned L;
   CacheLevel::iterator i;
   for(L=level; L<levels.size(); L++){
+    if(miss_stream and L == miss_stream->split()){
+      miss_stream->request(MissRequest::Write, addr);
+    }
+
     // i = levels[L]->find(block_addr);
     // if(levels[L]->present(i)){
     if(levels[L]->has_block(block_addr)){
@@ -284,12 +363,12 @@ void NewCache::write_at_level(const unsigned level, const uint64_t addr){
           eviction_info_string.push_back(ss.str());
 #endif
 
-          eviction_info.push_back(Daly::CacheEvictionRecord(L, e.block_addr, levels[L]->write_policy() == CacheLevel::WriteBack, e.dirty));
+          this->evicted(L, e);
         }
 
         // Perform the write to the block.
         i = levels[L]->find(block_addr);
-        levels[L]->write(block_addr);
+        levels[L]->fill(block_addr, true);
       }
       else{
         // We don't have an implementation for "write no allocate"
@@ -329,17 +408,308 @@ void NewCache::write_at_level(const unsigned level, const uint64_t addr){
 }
 
 void NewCache::store(const uint64_t addr){
-  // Empty the hit information vectors.
-#ifdef USE_STRING_INFO
-  hit_info_string.clear();
-  eviction_info_string.clear();
-  entrance_info_string.clear();
-#endif
+  this->clear_info();
 
-  hit_info.clear();
-  eviction_info.clear();
-  entrance_info.clear();
+  if(miss_stream){
+    miss_stream->access(trace ? trace->getTracePoint() - 1 : 0);
+  }
+
+  const uint64_t block_addr = addr / blocksize;
+
+  const bool prefetching = this->prefetching();
+  const unsigned demand = prefetching ? this->demand_level(block_addr) : 0;
 
   // Initiate a write at the fastest cache level.
   this->write_at_level(0, addr);
+
+  if(prefetching){
+    this->prefetch(block_addr, demand);
+  }
+
+  if(miss_stream){
+    miss_stream->finish(hit_info);
+  }
+}
+
+void NewCache::replay(const MissRequest& r, const unsigned split){
+  switch(r.type){
+  case MissRequest::Read:
+    this->read_at_level(split, r.addr);
+    break;
+
+  case MissRequest::Write:
+    this->write_at_level(split, r.addr);
+    break;
+
+  default:
+    break;
+  }
+}
+
+bool NewCache::prefetching(){
+  accesses++;
+
+  bool any = false;
+  for(unsigned L=0; L<levels.size(); L++){
+    any = any or levels[L]->prefetcher();
+  }
+
+  if(any and prefetch_state.size() < levels.size()){
+    prefetch_state.resize(levels.size());
+  }
+
+  return any;
+}
+
+unsigned NewCache::demand_level(const uint64_t block_addr){
+  unsigned L;
+  for(L=0; L<levels.size(); L++){
+    boost::unordered_map<uint64_t, uint64_t>::iterator p = prefetch_state[L].pending.find(block_addr);
+
+    if(levels[L]->has_block(block_addr)){
+      // The first use of a prefetched block.
+      if(p != prefetch_state[L].pending.end()){
+        const Prefetcher::ptr pf = levels[L]->prefetcher();
+        const bool late = pf and accesses - p->second < pf->latency();
+
+        if(late){
+          prefetch_state[L].stats.late++;
+        }
+        else{
+          prefetch_state[L].stats.useful++;
+        }
+
+        prefetch_info.push_back(CachePrefetchRecord(L, block_addr, L, late ? CachePrefetchRecord::Late : CachePrefetchRecord::Useful));
+        prefetch_state[L].pending.erase(p);
+      }
+
+      break;
+    }
+    else if(p != prefetch_state[L].pending.end()){
+      // The block left the level without an eviction being seen
+      // (e.g., a coherence invalidation), so forget it.
+      prefetch_state[L].pending.erase(p);
+    }
+  }
+
+  return L;
+}
+
+void NewCache::prefetch(const uint64_t block_addr, const unsigned hit_level){
+  // Demand evictions of prefetched blocks.
+  const size_t used_records = prefetch_info.size();
+  this->note_evictions(0);
+
+  // Each level that saw the access (i.e., up to and including the one
+  // that supplied the block) may prefetch.
+  std::vector<uint64_t> candidates;
+  for(unsigned L=0; L<levels.size() and L<=hit_level; L++){
+    const Prefetcher::ptr pf = levels[L]->prefetcher();
+    if(not pf){
+      continue;
+    }
+
+    // Whether the access was the first use of a block this level
+    // prefetched (recorded by demand_level()).
+    const bool used = (L == hit_level and used_records > 0);
+
+    candidates.clear();
+    pf->access(block_addr, L < hit_level, used, candidates);
+
+    foreach(uint64_t b, candidates){
+      const size_t first = eviction_info.size();
+      this->prefetch_block(L, b);
+      this->note_evictions(first);
+    }
+  }
+}
+
+void NewCache::prefetch_block(const unsigned L, const uint64_t block_addr){
+  if(levels[L]->has_block(block_addr)){
+    return;
+  }
+
+  // Find the level that supplies the block, and bring it into each
+  // level in between, as a demand miss would.
+  unsigned source;
+  for(source=L+1; source<levels.size(); source++){
+    if(levels[source]->has_block(block_addr)){
+      break;
+    }
+  }
+
+  if(inclusion == Exclusive){
+    // The block may not be duplicated above the prefetching level
+    // either; below it, the block moves rather than being copied.
+    for(unsigned M=0; M<L; M++){
+      if(levels[M]->has_block(block_addr)){
+        return;
+      }
+    }
+
+    this->move_block(source, L, block_addr);
+  }
+  else{
+    for(unsigned M=L; M<source; M++){
+      Eviction e = levels[M]->allocate(block_addr, shared_from_this(), M);
+      entrance_info.push_back(Daly::CacheEntranceRecord(block_addr*blocksize, M, block_addr));
+
+      if(e.eviction){
+        this->evicted(M, e);
+      }
+    }
+  }
+
+  prefetch_state[L].pending[block_addr] = accesses;
+  prefetch_state[L].stats.issued++;
+  prefetch_info.push_back(CachePrefetchRecord(L, block_addr, source, CachePrefetchRecord::Issued));
+}
+
+void NewCache::note_evictions(size_t first){
+  for(size_t i=first; i<eviction_info.size(); i++){
+    const Daly::CacheEvictionRecord& e = eviction_info[i];
+    if(e.L >= prefetch_state.size()){
+      continue;
+    }
+
+    boost::unordered_map<uint64_t, uint64_t>::iterator p = prefetch_state[e.L].pending.find(e.blockaddr);
+    if(p != prefetch_state[e.L].pending.end()){
+      prefetch_state[e.L].stats.polluting++;
+      prefetch_info.push_back(CachePrefetchRecord(e.L, e.blockaddr, e.L, CachePrefetchRecord::Polluting));
+      prefetch_state[e.L].pending.erase(p);
+    }
+  }
+}
+
+void NewCache::evicted(const unsigned L, const Eviction& e){
+  const bool writeback = levels[L]->write_policy() == CacheLevel::WriteBack;
+
+  if(inclusion == Exclusive and L+1 < levels.size()){
+    // The victim moves down a level instead of leaving the cache.  A
+    // dirty victim has already gone there, as allocate()'s write-back
+    // (see write_exclusive()); a clean one is moved here.
+    eviction_info.push_back(Daly::CacheEvictionRecord(L, e.block_addr, writeback, e.dirty, Daly::CacheEvictionRecord::Swap, L+1));
+
+    // NOTE(choudhury): the victim's entry already holds the new
+    // block, so it is moved as if from memory.
+    if(not e.dirty){
+      this->move_block(levels.size(), L+1, e.block_addr);
+    }
+
+    return;
+  }
+
+  eviction_info.push_back(Daly::CacheEvictionRecord(L, e.block_addr, writeback, e.dirty));
+
+  if(inclusion == Inclusive and L > 0){
+    this->back_invalidate(L, e.block_addr);
+  }
+}
+
+void NewCache::back_invalidate(const unsigned L, const uint64_t block_addr){
+  bool dirty = false;
+  for(unsigned U=0; U<L; U++){
+    if(not levels[U]->has_block(block_addr)){
+      continue;
+    }
+
+    const bool writeback = levels[U]->write_policy() == CacheLevel::WriteBack;
+    const bool d = levels[U]->invalidate(block_addr);
+    dirty = dirty or (d and writeback);
+
+    eviction_info.push_back(Daly::CacheEvictionRecord(U, block_addr, writeback, d, Daly::CacheEvictionRecord::BackInvalidation, L));
+  }
+
+  // A dirty copy above is newer than the evicted one, so it is written
+  // past the evicting level.
+  if(dirty){
+    this->write_at_level(L+1, block_addr*blocksize);
+  }
+}
+
+void NewCache::move_block(const unsigned from, const unsigned to, const uint64_t block_addr, const bool write){
+  // Take the block out of its current level (unless it comes from
+  // memory), freeing its entry before the new level makes room for
+  // it.
+  bool dirty = false;
+  if(from < levels.size()){
+    const bool writeback = levels[from]->write_policy() == CacheLevel::WriteBack;
+    const bool d = levels[from]->invalidate(block_addr);
+    dirty = d and writeback;
+
+    eviction_info.push_back(Daly::CacheEvictionRecord(from, block_addr, writeback, d, Daly::CacheEvictionRecord::Swap, to));
+  }
+
+  Eviction e = levels[to]->allocate(block_addr, shared_from_this(), to);
+  entrance_info.push_back(Daly::CacheEntranceRecord(block_addr*blocksize, to, block_addr));
+
+  levels[to]->fill(block_addr, dirty or write);
+
+  if(e.eviction){
+    this->evicted(to, e);
+  }
+}
+
+void NewCache::load_exclusive(const uint64_t addr){
+  const uint64_t block_addr = addr / blocksize;
+
+  unsigned H;
+  for(H=0; H<levels.size(); H++){
+    if(levels[H]->has_block(block_addr)){
+      break;
+    }
+  }
+
+  // A hit below the first level (or a miss) moves the block into the
+  // first level alone.
+  unsigned cell = 0;
+  if(H == 0){
+    levels[0]->read(block_addr);
+    cell = levels[0]->find(block_addr)->cell;
+  }
+  else{
+    if(H < levels.size()){
+      cell = levels[H]->find(block_addr)->cell;
+    }
+
+    this->move_block(H, 0, block_addr);
+  }
+
+  hit_info.push_back(CacheHitRecord(addr, H, cell, 'R'));
+}
+
+void NewCache::write_exclusive(const unsigned L, const uint64_t addr){
+  const uint64_t block_addr = addr / blocksize;
+
+  // The block moves into level L from wherever it is, and the write
+  // stops there.  Only the levels below L are searched: a write to
+  // L > 0 is a victim's write-back from the level above (see
+  // evicted()), which is in the middle of evicting it.
+  if(not levels[L]->has_block(block_addr)){
+    unsigned from;
+    for(from=L+1; from<levels.size(); from++){
+      if(levels[from]->has_block(block_addr)){
+        break;
+      }
+    }
+
+    // The move's fill is the write itself.
+    this->move_block(from, L, block_addr, true);
+  }
+  else{
+    levels[L]->write(block_addr);
+  }
+
+  // The victim's swap record accounts for its write-back.
+  if(L > 0){
+    return;
+  }
+
+  hit_info.push_back(CacheHitRecord(addr, L, levels[L]->find(block_addr)->cell, 'W'));
+
+  // A write-through level writes through to memory, since the levels
+  // below it do not hold the block.
+  if(levels[L]->write_policy() == CacheLevel::WriteThrough){
+    hit_info.push_back(CacheHitRecord(addr, levels.size(), 0, 'W'));
+  }
 }
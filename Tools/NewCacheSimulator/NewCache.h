@@ -15,9 +15,11 @@
 #include <Core/Util/BoostPointers.h>
 #include <Tools/CacheSimulator/Cache.h>
 #include <Tools/NewCacheSimulator/CacheLevel.h>
+#include <Tools/NewCacheSimulator/MissStream.h>
 using Daly::CacheEntranceRecord;
 using Daly::CacheEvictionRecord;
 using Daly::CacheHitRecord;
+using Daly::CachePrefetchRecord;
 
 // Boost headers.
 #include <boost/enable_shared_from_this.hpp>
@@ -52,6 +54,13 @@ namespace MTV{
     {}
   };
 
+  class IllegalAssociativity : public std::logic_error {
+  public:
+    IllegalAssociativity()
+      : std::logic_error("Tree-PLRU replacement requires a power-of-two associativity.")
+    {}
+  };
+
   class NewCache : public boost::enable_shared_from_this<NewCache> {
     friend class CacheLevel;
 
@@ -61,12 +70,35 @@ namespace MTV{
   public:
     class UnevenSets {};
 
+    // Running totals of a level's prefetches.
+    struct PrefetchStats{
+      PrefetchStats()
+        : issued(0),
+          useful(0),
+          late(0),
+          polluting(0)
+      {}
+
+      uint64_t issued, useful, late, polluting;
+    };
+
   public:
     enum WriteMissPolicy{
       WriteAllocate,
       WriteNoAllocate
     };
 
+    // Non-inclusive non-exclusive hierarchies fill every level above
+    // the hit and evict from each level independently; inclusive ones
+    // also invalidate a block in the levels above the one evicting it;
+    // exclusive ones hold a block in one level at a time, moving
+    // victims down a level.
+    enum InclusionPolicy{
+      NonInclusive,
+      Inclusive,
+      Exclusive
+    };
+
   public:
     static NewCache::ptr create(uint64_t blocksize, WriteMissPolicy write_miss_pol){
       NewCache::ptr p(new NewCache(blocksize, write_miss_pol));
@@ -88,6 +120,15 @@ namespace MTV{
       return write_miss_pol;
     }
 
+    InclusionPolicy inclusion_policy() const {
+      return inclusion;
+    }
+
+    // Should be set before any accesses.
+    void set_inclusion_policy(InclusionPolicy policy){
+      inclusion = policy;
+    }
+
     uint64_t block_size() const {
       return blocksize;
     }
@@ -100,6 +141,10 @@ namespace MTV{
       return levels[i];
     }
 
+    CacheLevel::ptr level(unsigned i){
+      return levels[i];
+    }
+
     void set_trace_reader(TraceReader::const_ptr _trace){
       trace = _trace;
     }
@@ -127,10 +172,34 @@ namespace MTV{
       return entrance_info;
     }
 
+    const std::vector<CachePrefetchRecord>& prefetchInfo() const {
+      return prefetch_info;
+    }
+
+    // Zero for levels without a prefetcher.
+    PrefetchStats prefetch_stats(unsigned L) const {
+      return L < prefetch_state.size() ? prefetch_state[L].stats : PrefetchStats();
+    }
+
     void load(const uint64_t addr);
 
     void store(const uint64_t addr);
 
+    // Records the requests each access sends below the writer's split
+    // level.
+    void set_miss_stream(MissStreamWriter::ptr writer){
+      miss_stream = writer;
+    }
+
+    // Replays a recorded access through the levels below "split":
+    // begin_replay() clears the info records, and replay() sends one of
+    // the access's requests to level "split".
+    void begin_replay(){
+      this->clear_info();
+    }
+
+    void replay(const MissRequest& r, const unsigned split);
+
     void print(std::ostream& out) const {
       for(unsigned L=0; L<levels.size(); L++){
         out << "L" << (L+1) << ":" << std::endl;
@@ -167,23 +236,62 @@ namespace MTV{
   private:
     NewCache(uint64_t blocksize, WriteMissPolicy write_miss_pol)
       : blocksize(blocksize),
-        write_miss_pol(write_miss_pol)
+        write_miss_pol(write_miss_pol),
+        inclusion(NonInclusive),
+        accesses(0)
     {}
 
   private:
+    void clear_info();
+    void read_at_level(const unsigned level, const uint64_t addr);
     void write_at_level(const unsigned level, const uint64_t addr);
 
+    // Inclusion support.  evicted() records a level's eviction and
+    // enforces the inclusion policy: back_invalidate() removes the
+    // victim from the levels above (inclusive), and move_block() moves
+    // a block between levels, or in from memory (exclusive), filling it
+    // with a write if it was dirty or "write" is set.
+    void evicted(const unsigned L, const Eviction& e);
+    void back_invalidate(const unsigned L, const uint64_t block_addr);
+    void move_block(const unsigned from, const unsigned to, const uint64_t block_addr, const bool write = false);
+    void load_exclusive(const uint64_t addr);
+    void write_exclusive(const unsigned L, const uint64_t addr);
+
+    // Prefetch support.  Before a demand access, demand_level() finds
+    // the level that will supply the block, crediting a prefetch that
+    // brought it there; afterwards, prefetch() lets each level's
+    // prefetcher react to the access.
+    bool prefetching();
+    unsigned demand_level(const uint64_t block_addr);
+    void prefetch(const uint64_t block_addr, const unsigned hit_level);
+    void prefetch_block(const unsigned L, const uint64_t block_addr);
+    void note_evictions(size_t first);
+
   private:
     std::vector<CacheLevel::ptr> levels;
     const unsigned blocksize;
     const WriteMissPolicy write_miss_pol;
+    InclusionPolicy inclusion;
 
     BlockStreamReader::ptr bs_reader;
     TraceReader::const_ptr trace;
 
+    MissStreamWriter::ptr miss_stream;
+
     std::vector<Daly::CacheHitRecord> hit_info;
     std::vector<Daly::CacheEvictionRecord> eviction_info;
     std::vector<Daly::CacheEntranceRecord> entrance_info;
+    std::vector<Daly::CachePrefetchRecord> prefetch_info;
+
+    // Per level: prefetched blocks not yet used (with the access count
+    // at which they were issued), and the running totals.
+    struct PrefetchState{
+      boost::unordered_map<uint64_t, uint64_t> pending;
+      PrefetchStats stats;
+    };
+
+    std::vector<PrefetchState> prefetch_state;
+    uint64_t accesses;
 
 #ifdef USE_STRING_INFO
     // String versions of the info records (to be obsoleted).
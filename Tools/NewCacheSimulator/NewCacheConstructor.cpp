@@ -9,11 +9,15 @@
 using MTV::CacheLevel;
 using MTV::NewCache;
 using MTV::NewCacheConstructor;
+using MTV::Prefetcher;
 
 // TinyXML includes.
 #define TIXML_USE_STL
 #include <tinyxml.h>
 
+// System headers.
+#include <algorithm>
+
 NewCacheConstructor::NewCacheConstructor(const std::string& filename, const SharedLevelTable& shared)
   : error_message("")
 {
@@ -70,6 +74,24 @@ NewCacheConstructor::NewCacheConstructor(const std::string& filename, const Shar
     return;
   }
 
+  // ...the inclusion policy (optional)...
+  text = root->Attribute("inclusion_policy");
+  if(!text or std::string(text) == "NonInclusive"){
+    this->inclusionPolicy = NewCache::NonInclusive;
+  }
+  else if(std::string(text) == "Inclusive"){
+    this->inclusionPolicy = NewCache::Inclusive;
+  }
+  else if(std::string(text) == "Exclusive"){
+    this->inclusionPolicy = NewCache::Exclusive;
+  }
+  else{
+    std::stringstream ss;
+    ss << "error: inclusion_policy attribute of Cache element must be one of 'NonInclusive', 'Inclusive', or 'Exclusive'.";
+    error_message = ss.str();
+    return;
+  }
+
   // ...and block replacement policy.
   text = root->Attribute("replacement_policy");
   CacheLevel::ReplacementPolicy repl_policy;
@@ -93,9 +115,27 @@ NewCacheConstructor::NewCacheConstructor(const std::string& filename, const Shar
   else if(std::string(text) == "RANDOM"){
     repl_policy = CacheLevel::Random;
   }
+  else if(std::string(text) == "TreePLRU"){
+    repl_policy = CacheLevel::TreePLRU;
+  }
+  else if(std::string(text) == "BitPLRU"){
+    repl_policy = CacheLevel::BitPLRU;
+  }
+  else if(std::string(text) == "SRRIP"){
+    repl_policy = CacheLevel::SRRIP;
+  }
+  else if(std::string(text) == "BRRIP"){
+    repl_policy = CacheLevel::BRRIP;
+  }
+  else if(std::string(text) == "DRRIP"){
+    repl_policy = CacheLevel::DRRIP;
+  }
+  else if(std::string(text) == "SHiP"){
+    repl_policy = CacheLevel::SHiP;
+  }
   else{
     std::stringstream ss;
-    ss << "error: replacement_policy attribute of Cache element does not contain either 'LRU' or 'ApproxOPT'.";
+    ss << "error: replacement_policy attribute of Cache element must be one of 'LRU', 'MRU', 'OPT', 'PES', 'RANDOM', 'TreePLRU', 'BitPLRU', 'SRRIP', 'BRRIP', 'DRRIP', or 'SHiP'.";
     error_message = ss.str();
     return;
   }
@@ -172,20 +212,58 @@ NewCacheConstructor::NewCacheConstructor(const std::string& filename, const Shar
         return;
       }
 
-      this->addLevelConstructor(numBlocks, associativity, writePolicy, repl_policy);
+      // Optional prefetcher.
+      Prefetcher::Params prefetch;
+      text = e->Attribute("prefetcher");
+      if(text){
+        prefetch.kind = Prefetcher::kind(text);
+        if(prefetch.kind == Prefetcher::None and std::string(text) != "None"){
+          std::stringstream ss;
+          ss << "error: prefetcher attribute of CacheLevel element must be one of 'None', 'NextLine', 'Stride', or 'Stream'.";
+          error_message = ss.str();
+          return;
+        }
+
+        if((text = e->Attribute("prefetch_degree"))){
+          prefetch.degree = lexical_cast<unsigned>(text);
+        }
+
+        if((text = e->Attribute("prefetch_streams"))){
+          prefetch.streams = lexical_cast<unsigned>(text);
+        }
+
+        if((text = e->Attribute("prefetch_region"))){
+          // The region is given in bytes.
+          prefetch.region_blocks = std::max(lexical_cast<unsigned>(text) / this->blocksize, 1u);
+        }
+
+        if((text = e->Attribute("prefetch_table"))){
+          prefetch.table_size = lexical_cast<unsigned>(text);
+        }
+
+        if((text = e->Attribute("prefetch_latency"))){
+          prefetch.latency = lexical_cast<unsigned>(text);
+        }
+      }
+
+      this->addLevelConstructor(numBlocks, associativity, writePolicy, repl_policy, prefetch);
     }
   }
 }
 
 NewCache::ptr NewCacheConstructor::constructCache(TraceReader::ptr trace, BlockStreamReader::ptr bsreader) const {
   NewCache::ptr p = NewCache::create(this->blocksize, this->writeMissPolicy);
+  p->set_inclusion_policy(this->inclusionPolicy);
   for(unsigned i=0; i<levels.size(); i++){
     if(levels[i].level){
       p->add_level(levels[i].level);
     }
     else{
       const CacheLevelParams& params = levels[i].params;
-      p->add_level(params.num_blocks, params.num_sets, params.write_policy, params.repl_policy);
+      CacheLevel::ptr level = p->add_level(params.num_blocks, params.num_sets, params.write_policy, params.repl_policy);
+
+      // Each cache gets its own prefetcher state.
+      level->set_prefetcher(Prefetcher::create(params.prefetch));
     }
   }
 
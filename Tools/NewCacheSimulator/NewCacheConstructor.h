@@ -36,6 +36,7 @@ namespace MTV{
     unsigned num_sets;
     CacheLevel::WritePolicy write_policy;
     CacheLevel::ReplacementPolicy repl_policy;
+    Prefetcher::Params prefetch;
   };
 
   class NewCacheConstructor{
@@ -89,8 +90,11 @@ namespace MTV{
 
     const std::string& error() const { return error_message; }
 
-    void addLevelConstructor(unsigned num_blocks, unsigned num_sets, CacheLevel::WritePolicy write_policy, CacheLevel::ReplacementPolicy repl_policy){
-      levels.push_back(NewCacheLevelConstructor(CacheLevelParams(num_blocks, num_sets, write_policy, repl_policy)));
+    void addLevelConstructor(unsigned num_blocks, unsigned num_sets, CacheLevel::WritePolicy write_policy, CacheLevel::ReplacementPolicy repl_policy, const Prefetcher::Params& prefetch = Prefetcher::Params()){
+      CacheLevelParams params(num_blocks, num_sets, write_policy, repl_policy);
+      params.prefetch = prefetch;
+
+      levels.push_back(NewCacheLevelConstructor(params));
     }
 
     void addLevelConstructor(CacheLevel::ptr p){
@@ -105,6 +109,7 @@ namespace MTV{
   private:
     unsigned blocksize;
     NewCache::WriteMissPolicy writeMissPolicy;
+    NewCache::InclusionPolicy inclusionPolicy;
     std::vector<NewCacheLevelConstructor> levels;
     std::string evictionPolicy;
 
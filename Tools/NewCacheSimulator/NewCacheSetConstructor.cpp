@@ -78,6 +78,24 @@ NewCacheSetConstructor::NewCacheSetConstructor(const std::string& filename, Trac
     else if(policy_text == "Random"){
       repl_policy = CacheLevel::Random;
     }
+    else if(policy_text == "TreePLRU"){
+      repl_policy = CacheLevel::TreePLRU;
+    }
+    else if(policy_text == "BitPLRU"){
+      repl_policy = CacheLevel::BitPLRU;
+    }
+    else if(policy_text == "SRRIP"){
+      repl_policy = CacheLevel::SRRIP;
+    }
+    else if(policy_text == "BRRIP"){
+      repl_policy = CacheLevel::BRRIP;
+    }
+    else if(policy_text == "DRRIP"){
+      repl_policy = CacheLevel::DRRIP;
+    }
+    else if(policy_text == "SHiP"){
+      repl_policy = CacheLevel::SHiP;
+    }
     else{
       *this << "error: illegal replacement policy '" << policy_text << "' in CacheSet tag";
       return;
@@ -0,0 +1,146 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// Prefetcher.cpp
+
+// MTV headers.
+#include <Tools/NewCacheSimulator/Prefetcher.h>
+using MTV::NextLinePrefetcher;
+using MTV::Prefetcher;
+using MTV::StreamPrefetcher;
+using MTV::StridePrefetcher;
+
+// Boost headers.
+#include <boost/make_shared.hpp>
+
+// System headers.
+#include <algorithm>
+
+Prefetcher::ptr Prefetcher::create(const Params& params){
+  switch(params.kind){
+  case NextLine:
+    return boost::make_shared<NextLinePrefetcher>(params.degree, params.latency);
+
+  case Stride:
+    return boost::make_shared<StridePrefetcher>(params.region_blocks, params.table_size, params.degree, params.latency);
+
+  case Stream:
+    return boost::make_shared<StreamPrefetcher>(params.streams, params.degree, params.latency);
+
+  case None:
+  default:
+    return Prefetcher::ptr();
+  }
+}
+
+Prefetcher::Kind Prefetcher::kind(const std::string& name){
+  if(name == "NextLine"){
+    return NextLine;
+  }
+  else if(name == "Stride"){
+    return Stride;
+  }
+  else if(name == "Stream"){
+    return Stream;
+  }
+  else{
+    return None;
+  }
+}
+
+void NextLinePrefetcher::access(uint64_t block_addr, bool miss, bool prefetched, std::vector<uint64_t>& prefetches){
+  if(not (miss or prefetched)){
+    return;
+  }
+
+  for(unsigned i=1; i<=degree; i++){
+    prefetches.push_back(block_addr + i);
+  }
+}
+
+StridePrefetcher::StridePrefetcher(unsigned region_blocks, unsigned table_size, unsigned degree, unsigned latency)
+  : Prefetcher(latency),
+    region_blocks(std::max(region_blocks, 1u)),
+    degree(degree),
+    table(std::max(table_size, 1u))
+{}
+
+void StridePrefetcher::access(uint64_t block_addr, bool miss, bool prefetched, std::vector<uint64_t>& prefetches){
+  const uint64_t region = block_addr / region_blocks;
+  Entry& e = table[region % table.size()];
+
+  // A new region replaces whatever was tracked in its slot.
+  if(e.region != region){
+    e = Entry();
+    e.region = region;
+    e.last = block_addr;
+    return;
+  }
+
+  const int64_t stride = static_cast<int64_t>(block_addr - e.last);
+  if(stride == 0){
+    return;
+  }
+
+  if(stride == e.stride){
+    e.confidence = std::min(e.confidence + 1, 3u);
+  }
+  else{
+    e.stride = stride;
+    e.confidence = 0;
+  }
+  e.last = block_addr;
+
+  // Two matching strides in a row establish the pattern.
+  if(e.confidence >= 1){
+    for(unsigned i=1; i<=degree; i++){
+      const int64_t target = static_cast<int64_t>(block_addr) + i*e.stride;
+      if(target >= 0){
+        prefetches.push_back(target);
+      }
+    }
+  }
+}
+
+StreamPrefetcher::StreamPrefetcher(unsigned num_streams, unsigned depth, unsigned latency)
+  : Prefetcher(latency),
+    depth(std::max(depth, 1u)),
+    buffers(std::max(num_streams, 1u)),
+    tick(0)
+{}
+
+void StreamPrefetcher::access(uint64_t block_addr, bool miss, bool prefetched, std::vector<uint64_t>& prefetches){
+  tick++;
+
+  // Look for a stream whose window holds the block; using it advances
+  // the stream by one block.
+  for(unsigned i=0; i<buffers.size(); i++){
+    Buffer& b = buffers[i];
+    if(b.valid and block_addr < b.head and block_addr + depth >= b.head){
+      b.used = tick;
+
+      prefetches.push_back(b.head);
+      b.head++;
+      return;
+    }
+  }
+
+  if(not miss){
+    return;
+  }
+
+  // Start a new stream in the least recently used buffer.
+  unsigned victim = 0;
+  for(unsigned i=1; i<buffers.size(); i++){
+    if(not buffers[i].valid or (buffers[victim].valid and buffers[i].used < buffers[victim].used)){
+      victim = i;
+    }
+  }
+
+  Buffer& b = buffers[victim];
+  b.valid = true;
+  b.used = tick;
+  for(unsigned i=1; i<=depth; i++){
+    prefetches.push_back(block_addr + i);
+  }
+  b.head = block_addr + depth + 1;
+}
@@ -0,0 +1,172 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// Prefetcher.h - Hardware prefetcher models that can be attached to a
+// CacheLevel.  A prefetcher watches the demand accesses reaching its
+// level and proposes blocks to bring into the level ahead of use.
+
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+// MTV headers.
+#include <Core/Util/BoostPointers.h>
+
+// System headers.
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace MTV{
+  class Prefetcher{
+  public:
+    BoostPointers(Prefetcher);
+
+  public:
+    enum Kind{
+      None,
+      NextLine,
+      Stride,
+      Stream
+    };
+
+    // Describes a prefetcher, so that each cache built from a spec
+    // gets its own prefetcher state.
+    struct Params{
+      Params()
+        : kind(None),
+          degree(1),
+          streams(8),
+          region_blocks(64),
+          table_size(64),
+          latency(0)
+      {}
+
+      Kind kind;
+
+      // Blocks fetched ahead per trigger (for a stream, how far ahead
+      // of the stream it runs).
+      unsigned degree;
+
+      // Number of stream buffers.
+      unsigned streams;
+
+      // For stride detection: the size of a region (in blocks), and
+      // the number of regions tracked.
+      unsigned region_blocks;
+      unsigned table_size;
+
+      // Accesses that a prefetch takes to complete; a demand use that
+      // comes sooner counts as late.
+      unsigned latency;
+    };
+
+  public:
+    static Prefetcher::ptr create(const Params& params);
+
+    // Returns the kind named by a spec file string ("NextLine",
+    // "Stride", or "Stream"), or None.
+    static Kind kind(const std::string& name);
+
+  public:
+    Prefetcher(unsigned latency)
+      : _latency(latency)
+    {}
+
+    virtual ~Prefetcher(){}
+
+    unsigned latency() const {
+      return _latency;
+    }
+
+    // Observes a demand access to "block_addr" in the prefetcher's
+    // level: whether it missed, and whether it was the first use of a
+    // prefetched block.  Candidate blocks to prefetch are appended to
+    // "prefetches".
+    virtual void access(uint64_t block_addr, bool miss, bool prefetched, std::vector<uint64_t>& prefetches) = 0;
+
+  private:
+    const unsigned _latency;
+  };
+
+  // Tagged next-line prefetching: a miss, or the first use of a
+  // prefetched block, fetches the next "degree" blocks.
+  class NextLinePrefetcher : public Prefetcher {
+  public:
+    NextLinePrefetcher(unsigned degree, unsigned latency)
+      : Prefetcher(latency),
+        degree(degree)
+    {}
+
+    void access(uint64_t block_addr, bool miss, bool prefetched, std::vector<uint64_t>& prefetches);
+
+  private:
+    const unsigned degree;
+  };
+
+  // Stride detection without instruction addresses: accesses are
+  // grouped by memory region, and a stride seen twice in a row within
+  // a region triggers prefetches along it.
+  class StridePrefetcher : public Prefetcher {
+  public:
+    StridePrefetcher(unsigned region_blocks, unsigned table_size, unsigned degree, unsigned latency);
+
+    void access(uint64_t block_addr, bool miss, bool prefetched, std::vector<uint64_t>& prefetches);
+
+  private:
+    struct Entry{
+      Entry()
+        : region(static_cast<uint64_t>(-1)),
+          last(0),
+          stride(0),
+          confidence(0)
+      {}
+
+      uint64_t region, last;
+      int64_t stride;
+      unsigned confidence;
+    };
+
+  private:
+    const unsigned region_blocks, degree;
+    std::vector<Entry> table;
+  };
+
+  // Stream buffers: a miss that no stream expects starts a new stream
+  // (replacing the least recently used one), fetching the next
+  // "depth" blocks; using a block within a stream's window fetches
+  // one more block at its head.
+  //
+  // NOTE(choudhury): the prefetched blocks go into the cache level
+  // itself rather than into separate buffers.
+  class StreamPrefetcher : public Prefetcher {
+  public:
+    StreamPrefetcher(unsigned num_streams, unsigned depth, unsigned latency);
+
+    void access(uint64_t block_addr, bool miss, bool prefetched, std::vector<uint64_t>& prefetches);
+
+  private:
+    struct Buffer{
+      Buffer()
+        : head(0),
+          used(0),
+          valid(false)
+      {}
+
+      // The next block the stream will fetch.
+      uint64_t head;
+
+      // When the stream was last used (for LRU replacement).
+      uint64_t used;
+
+      bool valid;
+    };
+
+  private:
+    const unsigned depth;
+    std::vector<Buffer> buffers;
+    uint64_t tick;
+  };
+}
+
+#endif
@@ -0,0 +1,383 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// TLB.cpp
+
+// MTV headers.
+#include <Core/Util/Boost.h>
+#include <Core/Util/BoostForeach.h>
+#include <Tools/NewCacheSimulator/TLB.h>
+using MTV::TLB;
+
+// TinyXML headers.
+#define TIXML_USE_STL
+#include <tinyxml.h>
+
+// System headers.
+#include <iomanip>
+#include <sstream>
+
+const unsigned TLB::AllPageSizes = (1u << TLB::NumPageSizes) - 1;
+
+namespace{
+  double percent(uint64_t part, uint64_t whole){
+    return whole > 0 ? 100.0 * part / whole : 0.0;
+  }
+
+  // Parses a comma separated list of page sizes into a mask.
+  bool page_sizes(const std::string& list, unsigned& sizes){
+    sizes = 0;
+
+    std::stringstream ss(list);
+    std::string name;
+    while(std::getline(ss, name, ',')){
+      TLB::PageSize page;
+      if(not TLB::page_size(name, page)){
+        return false;
+      }
+
+      sizes |= (1u << page);
+    }
+
+    return sizes != 0;
+  }
+}
+
+uint64_t TLB::Stats::misses(unsigned level) const {
+  uint64_t hits = 0;
+  for(unsigned L=0; L<=level and L<found.size(); L++){
+    hits += found[L];
+  }
+
+  return accesses - hits;
+}
+
+void TLB::Stats::print(std::ostream& out, const TLB& tlb, const std::string& indent) const {
+  out << indent << "accesses: " << accesses << std::endl;
+  for(unsigned L=0; L<tlb.num_levels(); L++){
+    out << indent << tlb.level_name(L) << " misses: " << this->misses(L) << " (" << percent(this->misses(L), accesses) << "%)" << std::endl;
+  }
+
+  const uint64_t walks = found.size() > tlb.num_levels() ? found[tlb.num_levels()] : 0;
+  out << indent << "page walks: " << walks << std::endl
+      << indent << "walk references: " << walk_refs << " (" << (walks > 0 ? static_cast<double>(walk_refs) / walks : 0.0) << " per walk)" << std::endl;
+}
+
+unsigned TLB::page_shift(PageSize page){
+  // Each level of the page table translates 9 more bits above the
+  // 4K page offset.
+  return 12 + 9*page;
+}
+
+bool TLB::page_size(const std::string& name, PageSize& page){
+  if(name == "4K"){
+    page = Page4K;
+  }
+  else if(name == "2M"){
+    page = Page2M;
+  }
+  else if(name == "1G"){
+    page = Page1G;
+  }
+  else{
+    return false;
+  }
+
+  return true;
+}
+
+const char *TLB::page_name(PageSize page){
+  switch(page){
+  case Page4K:
+    return "4K";
+
+  case Page2M:
+    return "2M";
+
+  case Page1G:
+    return "1G";
+
+  default:
+    return "?";
+  }
+}
+
+TLB::ptr TLB::newFromSpec(const std::string& specfile, std::string& error){
+  TiXmlDocument doc(specfile);
+  if(!doc.LoadFile()){
+    std::stringstream ss;
+    ss << "error: could not load file '" << specfile << "'.";
+    error = ss.str();
+    return TLB::ptr();
+  }
+
+  TiXmlElement *root = doc.RootElement();
+  if(std::string(root->Value()) != "TLB"){
+    std::stringstream ss;
+    ss << "error: xml document does not contain a root TLB element.";
+    error = ss.str();
+    return TLB::ptr();
+  }
+
+  // The page size for addresses outside any region (optional).
+  PageSize default_page = Page4K;
+  const char *text = root->Attribute("default_page_size");
+  if(text and not TLB::page_size(text, default_page)){
+    std::stringstream ss;
+    ss << "error: default_page_size attribute of TLB element must be one of '4K', '2M', or '1G'.";
+    error = ss.str();
+    return TLB::ptr();
+  }
+
+  TLB::ptr tlb = boost::make_shared<TLB>(default_page);
+
+  // The page-walk cache (optional).
+  text = root->Attribute("walk_cache_entries");
+  if(text){
+    tlb->set_walk_cache(lexical_cast<unsigned>(text));
+  }
+
+  // The TLB levels.  A level either describes a single array holding
+  // every page size with its own attributes, or holds one Array
+  // element per group of page sizes.
+  for(TiXmlElement *e = root->FirstChildElement("TLBLevel"); e; e = e->NextSiblingElement("TLBLevel")){
+    text = e->Attribute("name");
+    if(!text){
+      std::stringstream ss;
+      ss << "error: TLBLevel element missing 'name' attribute.";
+      error = ss.str();
+      return TLB::ptr();
+    }
+    tlb->add_level(text);
+
+    std::vector<TiXmlElement *> arrays;
+    if(e->FirstChildElement("Array")){
+      for(TiXmlElement *a = e->FirstChildElement("Array"); a; a = a->NextSiblingElement("Array")){
+        arrays.push_back(a);
+      }
+    }
+    else{
+      arrays.push_back(e);
+    }
+
+    foreach(TiXmlElement *a, arrays){
+      unsigned num_entries, associativity, sizes = AllPageSizes;
+
+      text = a->Attribute("num_entries");
+      if(!text){
+        std::stringstream ss;
+        ss << "error: " << a->Value() << " element missing 'num_entries' attribute.";
+        error = ss.str();
+        return TLB::ptr();
+      }
+      num_entries = lexical_cast<unsigned>(text);
+
+      text = a->Attribute("associativity");
+      if(!text){
+        std::stringstream ss;
+        ss << "error: " << a->Value() << " element missing 'associativity' attribute.";
+        error = ss.str();
+        return TLB::ptr();
+      }
+      associativity = lexical_cast<unsigned>(text);
+
+      if(associativity == 0 or num_entries % associativity != 0){
+        std::stringstream ss;
+        ss << "error: num_entries of " << a->Value() << " element must be a positive multiple of its associativity.";
+        error = ss.str();
+        return TLB::ptr();
+      }
+
+      text = a->Attribute("page_sizes");
+      if(text and not page_sizes(text, sizes)){
+        std::stringstream ss;
+        ss << "error: page_sizes attribute of " << a->Value() << " element must be a comma separated list of '4K', '2M', and '1G'.";
+        error = ss.str();
+        return TLB::ptr();
+      }
+
+      tlb->add_array(sizes, num_entries, associativity);
+    }
+  }
+
+  if(tlb->num_levels() == 0){
+    std::stringstream ss;
+    ss << "error: TLB element contains no TLBLevel elements.";
+    error = ss.str();
+    return TLB::ptr();
+  }
+
+  return tlb;
+}
+
+TLB::TLB(PageSize default_page)
+  : default_page(default_page),
+    last_page(default_page),
+    last_refs(0)
+{}
+
+void TLB::add_level(const std::string& name){
+  Level level;
+  level.name = name;
+
+  levels.push_back(level);
+}
+
+void TLB::add_array(unsigned sizes, unsigned num_entries, unsigned associativity){
+  if(levels.size() == 0){
+    throw NoLevel();
+  }
+
+  levels.back().arrays.push_back(Array(sizes, num_entries, associativity));
+}
+
+void TLB::set_walk_cache(unsigned num_entries){
+  if(num_entries == 0){
+    walk_cache.reset();
+  }
+  else{
+    walk_cache = boost::make_shared<Array>(AllPageSizes, num_entries, num_entries);
+  }
+}
+
+void TLB::addRegion(const std::string& name, uint64_t base, uint64_t limit, PageSize page){
+  Region r;
+  r.name = name;
+  r.limit = limit;
+  r.page = page;
+
+  regions[base] = r;
+}
+
+unsigned TLB::access(uint64_t addr){
+  // Find the region (and so the page size) of the address.
+  Region *region = 0;
+  last_page = default_page;
+
+  std::map<uint64_t, Region>::iterator r = regions.upper_bound(addr);
+  if(r != regions.begin()){
+    --r;
+    if(addr < r->second.limit){
+      region = &r->second;
+      last_page = region->page;
+    }
+  }
+
+  // Translations are tagged with their page size, so that pages of
+  // different sizes can share an array.
+  const uint64_t vpn = addr >> TLB::page_shift(last_page);
+  const uint64_t key = (vpn << 2) | last_page;
+
+  // Look the page up in each level in turn, filling it into every
+  // level that misses on the way down.
+  unsigned L;
+  for(L=0; L<levels.size(); L++){
+    bool hit = false;
+    foreach(Array& a, levels[L].arrays){
+      if(a.holds(last_page) and a.access(key, vpn)){
+        hit = true;
+      }
+    }
+
+    if(hit){
+      break;
+    }
+  }
+
+  last_refs = (L == levels.size()) ? this->walk(addr, last_page) : 0;
+
+  total.record(L, last_refs);
+  if(region){
+    region->stats.record(L, last_refs);
+  }
+
+  return L;
+}
+
+unsigned TLB::walk(uint64_t addr, PageSize page){
+  // A four-level (x86-64 style) page table: a 4K translation reads a
+  // PML4, PDPT, PD, and PT entry; 2M pages end the walk at the PD, and
+  // 1G pages at the PDPT.
+  const unsigned depth = 4 - page;
+  if(not walk_cache){
+    return depth;
+  }
+
+  // The walk cache holds the non-leaf entries, each tagged by the
+  // address bits that select it (the PML4 entry by the bits above 39,
+  // and so on).  A hit on the deepest cached entry skips the reads of
+  // it and everything above it.
+  unsigned refs = depth;
+  for(unsigned k=depth-1; k>0; k--){
+    const uint64_t key = ((addr >> (48 - 9*k)) << 2) | k;
+    if(walk_cache->access(key, 0) and refs == depth){
+      refs = depth - k;
+    }
+  }
+
+  return refs;
+}
+
+void TLB::report(std::ostream& out) const {
+  out << std::fixed << std::setprecision(2);
+
+  out << "tlb levels: " << levels.size() << std::endl;
+  foreach(const Level& level, levels){
+    out << "  " << level.name << ":";
+    foreach(const Array& a, level.arrays){
+      out << " [";
+      for(unsigned p=0; p<NumPageSizes; p++){
+        if(a.holds(static_cast<PageSize>(p))){
+          out << ' ' << TLB::page_name(static_cast<PageSize>(p));
+        }
+      }
+      out << " ] " << a.num_entries() << " entries, " << a.associativity() << "-way";
+    }
+    out << std::endl;
+  }
+
+  out << "default page size: " << TLB::page_name(default_page) << std::endl;
+  out << "walk cache: " << (walk_cache ? walk_cache->num_entries() : 0) << " entries" << std::endl;
+
+  out << "total:" << std::endl;
+  total.print(out, *this, "  ");
+
+  for(std::map<uint64_t, Region>::const_iterator i = regions.begin(); i != regions.end(); i++){
+    out << "region " << i->second.name << " [0x" << std::hex << i->first << ", 0x" << i->second.limit << std::dec << "), " << TLB::page_name(i->second.page) << " pages:" << std::endl;
+    i->second.stats.print(out, *this, "  ");
+  }
+}
+
+TLB::Array::Array(unsigned sizes, unsigned num_entries, unsigned associativity)
+  : sizes(sizes),
+    ways(associativity),
+    sets(associativity > 0 ? num_entries / associativity : 0),
+    tags(num_entries, static_cast<uint64_t>(-1)),
+    used(num_entries, 0),
+    tick(0)
+{
+  if(associativity == 0 or num_entries % associativity != 0){
+    throw UnevenEntries();
+  }
+}
+
+bool TLB::Array::access(uint64_t key, uint64_t index){
+  tick++;
+
+  const unsigned base = (index % sets) * ways;
+  unsigned victim = base;
+  for(unsigned w=base; w<base+ways; w++){
+    if(tags[w] == key){
+      used[w] = tick;
+      return true;
+    }
+
+    if(used[w] < used[victim]){
+      victim = w;
+    }
+  }
+
+  tags[victim] = key;
+  used[victim] = tick;
+
+  return false;
+}
@@ -0,0 +1,211 @@
+// -*- c++ -*-
+//
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// TLB.h - A model of a TLB hierarchy (for instance, an L1 dTLB backed
+// by a shared STLB) with an optional page-walk cache.  Memory regions
+// can be backed by 4K, 2M, or 1G pages, and misses are reported per
+// region.
+
+#ifndef TLB_H
+#define TLB_H
+
+// MTV headers.
+#include <Core/Util/BoostPointers.h>
+
+// System headers.
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace MTV{
+  class TLB{
+  public:
+    BoostPointers(TLB);
+
+  public:
+    enum PageSize{
+      Page4K,
+      Page2M,
+      Page1G,
+      NumPageSizes
+    };
+
+    // The page sizes a TLB array can hold, as a mask of (1 << size).
+    static const unsigned AllPageSizes;
+
+    class UnevenEntries : public std::logic_error {
+    public:
+      UnevenEntries()
+        : std::logic_error("number of entries must be a multiple of the associativity")
+      {}
+    };
+
+    class NoLevel : public std::logic_error {
+    public:
+      NoLevel()
+        : std::logic_error("TLB array added before any TLB level")
+      {}
+    };
+
+    struct Stats{
+      Stats()
+        : accesses(0),
+          walk_refs(0)
+      {}
+
+      void record(unsigned level, unsigned refs){
+        accesses++;
+        if(found.size() <= level){
+          found.resize(level + 1, 0);
+        }
+        found[level]++;
+        walk_refs += refs;
+      }
+
+      // Translations that missed in every level down to and including
+      // "level".
+      uint64_t misses(unsigned level) const;
+
+      void print(std::ostream& out, const TLB& tlb, const std::string& indent) const;
+
+      uint64_t accesses;
+
+      // The number of translations found at each level; the entry past
+      // the last level counts page walks.
+      std::vector<uint64_t> found;
+
+      // Memory references made by page walks.
+      uint64_t walk_refs;
+    };
+
+  public:
+    // The log2 of a page size.
+    static unsigned page_shift(PageSize page);
+
+    // Parses "4K", "2M", or "1G".
+    static bool page_size(const std::string& name, PageSize& page);
+
+    static const char *page_name(PageSize page);
+
+    static TLB::ptr newFromSpec(const std::string& specfile, std::string& error);
+
+  public:
+    TLB(PageSize default_page = Page4K);
+
+    // Adds a level below the existing ones, then arrays to the newest
+    // level.  Each array holds translations for the page sizes in
+    // "sizes"; a level with no array for a page size always misses on
+    // it.
+    void add_level(const std::string& name);
+    void add_array(unsigned sizes, unsigned num_entries, unsigned associativity);
+
+    // A fully associative cache of "num_entries" upper-level page
+    // table entries, which shortens page walks (0 disables it).
+    void set_walk_cache(unsigned num_entries);
+
+    // Backs the addresses in [base, limit) with pages of the given
+    // size, and attributes their translations to the named region
+    // (regions should not overlap).
+    void addRegion(const std::string& name, uint64_t base, uint64_t limit, PageSize page);
+
+    // Translates an address, returning the level the translation was
+    // found in, or num_levels() if it required a page walk.
+    unsigned access(uint64_t addr);
+
+    unsigned num_levels() const {
+      return levels.size();
+    }
+
+    const std::string& level_name(unsigned level) const {
+      return levels[level].name;
+    }
+
+    PageSize default_page_size() const {
+      return default_page;
+    }
+
+    // The page size and page walk memory references of the last
+    // access.
+    PageSize last_page_size() const {
+      return last_page;
+    }
+
+    unsigned last_walk_refs() const {
+      return last_refs;
+    }
+
+    const Stats& stats() const {
+      return total;
+    }
+
+    // Prints the configuration and the overall and per-region
+    // statistics.
+    void report(std::ostream& out) const;
+
+  private:
+    // A set associative array of translations with LRU replacement.
+    class Array{
+    public:
+      Array(unsigned sizes, unsigned num_entries, unsigned associativity);
+
+      bool holds(PageSize page) const {
+        return (sizes & (1u << page)) != 0;
+      }
+
+      unsigned num_entries() const {
+        return tags.size();
+      }
+
+      unsigned associativity() const {
+        return ways;
+      }
+
+      // Looks up "key", filling it in on a miss; "index" selects the
+      // set.  Returns whether the lookup hit.
+      bool access(uint64_t key, uint64_t index);
+
+    private:
+      unsigned sizes, ways, sets;
+
+      std::vector<uint64_t> tags;
+      std::vector<uint64_t> used;
+      uint64_t tick;
+    };
+
+    struct Level{
+      std::string name;
+      std::vector<Array> arrays;
+    };
+
+    struct Region{
+      std::string name;
+      uint64_t limit;
+      PageSize page;
+      Stats stats;
+    };
+
+    // Returns the memory references needed to walk the page table for
+    // "addr".
+    unsigned walk(uint64_t addr, PageSize page);
+
+  private:
+    const PageSize default_page;
+
+    std::vector<Level> levels;
+    boost::shared_ptr<Array> walk_cache;
+
+    // Regions, keyed by base address.
+    std::map<uint64_t, Region> regions;
+
+    PageSize last_page;
+    unsigned last_refs;
+
+    Stats total;
+  };
+}
+
+#endif
@@ -0,0 +1,459 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// layout-sweep.cpp - Evaluates candidate data layouts for the
+// registered regions of a reference trace against a cache spec, by
+// rewriting the trace's addresses on the fly, and ranks the layouts
+// by misses to memory and bandwidth.  The candidates are divided
+// among several threads, each reading the trace once.
+
+// TCLAP headers.
+#include <tclap/CmdLine.h>
+
+// MTV headers.
+#include <Core/Dataflow/CacheAccessRecord.h>
+#include <Core/Dataflow/CachePerformanceCounter.h>
+#include <Core/Dataflow/CacheSimulator.h>
+#include <Core/Dataflow/Consumer.h>
+#include <Core/Dataflow/LayoutRewriter.h>
+#include <Core/Dataflow/MemoryRecordFilter.h>
+#include <Core/Dataflow/TraceReader.h>
+#include <Core/Util/BoostForeach.h>
+#include <Tools/NewCacheSimulator/NewCache.h>
+#include <Tools/ReferenceTrace/mtrtools.h>
+using MTV::BlockStreamReader;
+using MTV::CacheAccessRecord;
+using MTV::Layout;
+using MTV::LayoutRewriter;
+using MTV::MemoryRecordFilter;
+using MTV::NewCache;
+using MTV::NewCacheLevelToLevelBandwidthPolicy;
+using MTV::NewCacheMissCountPolicy;
+using MTV::NewCacheSimulator;
+using MTV::TraceReader;
+
+// Boost headers.
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+// System headers.
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace{
+  struct Region{
+    std::string name;
+    uint64_t base, size, rows, cols, type;
+  };
+
+  // One candidate layout (a layout for each of some of the regions),
+  // with its own cache and counters.
+  class Candidate : public MTV::Consumer<CacheAccessRecord> {
+  public:
+    BoostPointers(Candidate);
+
+  public:
+    // NOTE(choudhury): the performance counter policies count in
+    // floats, which silently drop increments once the totals pass
+    // 2^24; so the policies are drained into exact totals and
+    // replaced every "Drain" accesses.
+    static const unsigned Drain = 16384;
+
+  public:
+    Candidate(const std::string& desc, NewCache::ptr cache)
+      : desc(desc),
+        rewriter(boost::make_shared<LayoutRewriter>()),
+        simulator(boost::make_shared<NewCacheSimulator>(cache)),
+        cache(cache),
+        accesses(0),
+        misses(0),
+        traffic(cache->num_levels(), 0)
+    {
+      rewriter->addConsumer(simulator);
+      this->drain();
+    }
+
+    void consume(const CacheAccessRecord& rec){
+      misspolicy->consume(rec);
+      bandwidthpolicy->consume(rec);
+
+      if(++accesses % Drain == 0){
+        this->drain();
+      }
+    }
+
+    // Finishes counting.
+    void finish(){
+      this->drain();
+    }
+
+    // Misses (and dirty write backs) to memory.
+    uint64_t memory_misses() const {
+      return misses;
+    }
+
+    // Bytes moved between the last level and memory, and between all
+    // pairs of levels.
+    uint64_t memory_traffic() const {
+      return traffic.back();
+    }
+
+    uint64_t total_traffic() const {
+      uint64_t total = 0;
+      foreach(uint64_t t, traffic){
+        total += t;
+      }
+
+      return total;
+    }
+
+  private:
+    void drain(){
+      if(misspolicy){
+        misses += static_cast<uint64_t>(misspolicy->rates()[0]);
+
+        const MTV::CacheHitRates bandwidth = bandwidthpolicy->rates();
+        for(unsigned i=0; i<traffic.size(); i++){
+          traffic[i] += static_cast<uint64_t>(bandwidth[i]);
+        }
+      }
+
+      misspolicy = boost::make_shared<NewCacheMissCountPolicy>(cache);
+      bandwidthpolicy = boost::make_shared<NewCacheLevelToLevelBandwidthPolicy>(cache);
+    }
+
+  public:
+    const std::string desc;
+    LayoutRewriter::ptr rewriter;
+    NewCacheSimulator::ptr simulator;
+
+  private:
+    NewCache::const_ptr cache;
+
+    NewCacheMissCountPolicy::ptr misspolicy;
+    NewCacheLevelToLevelBandwidthPolicy::ptr bandwidthpolicy;
+
+    uint64_t accesses, misses;
+    std::vector<uint64_t> traffic;
+  };
+
+  // One thread's share of the candidates.
+  struct Share{
+    std::vector<Candidate::ptr> candidates;
+    bool ok;
+  };
+
+  bool fewer_misses(Candidate::const_ptr a, Candidate::const_ptr b){
+    if(a->memory_misses() != b->memory_misses()){
+      return a->memory_misses() < b->memory_misses();
+    }
+    return a->total_traffic() < b->total_traffic();
+  }
+
+  bool less_traffic(Candidate::const_ptr a, Candidate::const_ptr b){
+    if(a->memory_traffic() != b->memory_traffic()){
+      return a->memory_traffic() < b->memory_traffic();
+    }
+    return a->memory_misses() < b->memory_misses();
+  }
+
+  // Runs the trace through one thread's share of the candidates.
+  void worker(const std::string& tracefile, uint64_t numrecords, Share *share){
+    TraceReader::ptr trace = boost::make_shared<TraceReader>();
+    if(!trace->open(tracefile)){
+      share->ok = false;
+      return;
+    }
+
+    MemoryRecordFilter::ptr mfilter = boost::make_shared<MemoryRecordFilter>();
+    trace->addConsumer(mfilter);
+    // NOTE(choudhury): each simulator holds its candidate only for the
+    // length of the run; left in place, the pair would keep each other
+    // alive.
+    foreach(Candidate::ptr c, share->candidates){
+      mfilter->addConsumer(c->rewriter);
+      c->simulator->MTV::Producer<CacheAccessRecord>::addConsumer(c);
+    }
+
+    try{
+      for(uint64_t i=0; i<numrecords; i++){
+        trace->nextRecord();
+      }
+    }
+    catch(TraceReader::End){}
+
+    foreach(Candidate::ptr c, share->candidates){
+      c->finish();
+      c->simulator->MTV::Producer<CacheAccessRecord>::removeConsumer(c);
+    }
+
+    share->ok = true;
+  }
+}
+
+int main(int argc, char *argv[]){
+  std::string tracefile, cachefile, regfile, rankby;
+  std::vector<std::string> layoutstrings;
+  uint64_t numrecords;
+  unsigned threads;
+  bool enumerate;
+
+  try{
+    TCLAP::CmdLine cmd("Rank candidate data layouts for the registered regions of a reference trace");
+
+    TCLAP::ValueArg<std::string> tracefileArg("t",
+                                              "trace-file",
+                                              "Reference trace file",
+                                              true,
+                                              "",
+                                              "filename",
+                                              cmd);
+
+    TCLAP::ValueArg<std::string> cachefileArg("c",
+                                              "cache-config-file",
+                                              "XML file describing the cache to simulate",
+                                              true,
+                                              "",
+                                              "filename",
+                                              cmd);
+
+    TCLAP::ValueArg<std::string> regfileArg("r",
+                                            "registration",
+                                            "Region registration file for the trace",
+                                            true,
+                                            "",
+                                            "filename",
+                                            cmd);
+
+    TCLAP::MultiArg<std::string> layoutstringsArg("l",
+                                                  "layout",
+                                                  "A candidate layout, as comma separated region:layout pairs (e.g. \"A:transpose,B:tile=8x8\"); layouts are identity, transpose, pad=N, tile=RxC, morton, and soa=N",
+                                                  false,
+                                                  "strings",
+                                                  cmd);
+
+    TCLAP::SwitchArg enumerateArg("e",
+                                  "enumerate",
+                                  "Add the transposed, padded, tiled, and Morton layouts of each matrix region as candidates",
+                                  cmd,
+                                  false);
+
+    TCLAP::ValueArg<std::string> rankbyArg("",
+                                           "rank-by",
+                                           "Rank candidates by 'misses' (to memory) or 'bandwidth' (to memory)",
+                                           false,
+                                           "misses",
+                                           "metric",
+                                           cmd);
+
+    TCLAP::ValueArg<uint64_t> numrecordsArg("n",
+                                            "num-records",
+                                            "Number of records to process from the trace file (-1 for no limit)",
+                                            false,
+                                            static_cast<uint64_t>(-1),
+                                            "number",
+                                            cmd);
+
+    TCLAP::ValueArg<unsigned> threadsArg("j",
+                                         "threads",
+                                         "Number of simulating threads",
+                                         false,
+                                         std::max(boost::thread::hardware_concurrency(), 1u),
+                                         "threads",
+                                         cmd);
+
+    cmd.parse(argc, argv);
+
+    tracefile = tracefileArg.getValue();
+    cachefile = cachefileArg.getValue();
+    regfile = regfileArg.getValue();
+    layoutstrings = layoutstringsArg.getValue();
+    enumerate = enumerateArg.getValue();
+    rankby = rankbyArg.getValue();
+    numrecords = numrecordsArg.getValue();
+    threads = threadsArg.getValue();
+  }
+  catch(TCLAP::ArgException& e){
+    std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+    exit(1);
+  }
+
+  if(rankby != "misses" and rankby != "bandwidth"){
+    std::cerr << "error: rank-by must be 'misses' or 'bandwidth'." << std::endl;
+    exit(1);
+  }
+
+  if(threads == 0){
+    std::cerr << "error: threads must be positive." << std::endl;
+    exit(1);
+  }
+
+  // Read the regions; an array region is a single row.
+  MTR::RegionRegistration reg;
+  reg.read(regfile.c_str());
+  if(reg.hasError()){
+    std::cerr << "error: " << reg.error() << std::endl;
+    exit(1);
+  }
+
+  std::map<std::string, Region> regions;
+  for(unsigned i=0; i<reg.arrayRegions.size(); i++){
+    const MTR::ArrayRegion& a = reg.arrayRegions[i];
+
+    Region r;
+    r.name = a.title;
+    if(r.name == ""){
+      std::stringstream ss;
+      ss << "array" << i;
+      r.name = ss.str();
+    }
+    r.base = a.base;
+    r.size = a.size;
+    r.type = std::max<uint64_t>(a.type, 1);
+    r.rows = 1;
+    r.cols = a.size / r.type;
+
+    regions[r.name] = r;
+  }
+
+  for(unsigned i=0; i<reg.matrixRegions.size(); i++){
+    const MTR::MatrixRegion& m = reg.matrixRegions[i];
+
+    Region r;
+    r.name = m.title;
+    if(r.name == ""){
+      std::stringstream ss;
+      ss << "matrix" << i;
+      r.name = ss.str();
+    }
+    r.base = m.base;
+    r.size = m.size;
+    r.type = std::max<uint64_t>(m.type, 1);
+    r.rows = m.rows;
+    r.cols = m.cols;
+
+    regions[r.name] = r;
+  }
+
+  // Check the cache spec once, up front.
+  std::string error;
+  NewCache::ptr cache = NewCache::newFromSpec(cachefile, TraceReader::ptr(), BlockStreamReader::ptr(), error);
+  if(!cache){
+    std::cerr << error << std::endl;
+    exit(1);
+  }
+
+  // Collect the candidate descriptions, starting with the layout as
+  // traced.
+  std::vector<std::string> descs(1, "");
+  descs.insert(descs.end(), layoutstrings.begin(), layoutstrings.end());
+  if(enumerate){
+    for(std::map<std::string, Region>::const_iterator i = regions.begin(); i != regions.end(); i++){
+      const Region& r = i->second;
+      if(r.rows < 2 or r.cols < 2){
+        continue;
+      }
+
+      std::stringstream ss;
+      ss << r.name << ":pad=" << cache->block_size();
+
+      descs.push_back(r.name + ":transpose");
+      descs.push_back(ss.str());
+      for(uint64_t t=4; t<=32 and t<=std::min(r.rows, r.cols); t*=2){
+        std::stringstream ts;
+        ts << r.name << ":tile=" << t << "x" << t;
+        descs.push_back(ts.str());
+      }
+      descs.push_back(r.name + ":morton");
+    }
+  }
+
+  // Build the candidates.
+  std::vector<Candidate::ptr> candidates;
+  foreach(const std::string& desc, descs){
+    NewCache::ptr c = NewCache::newFromSpec(cachefile, TraceReader::ptr(), BlockStreamReader::ptr(), error);
+    Candidate::ptr candidate = boost::make_shared<Candidate>(desc == "" ? "(as traced)" : desc, c);
+
+    std::stringstream ss(desc);
+    std::string item;
+    std::map<uint64_t, uint64_t> extents;
+    while(std::getline(ss, item, ',')){
+      const std::string::size_type colon = item.find(':');
+      std::map<std::string, Region>::const_iterator r = regions.find(item.substr(0, colon));
+      if(colon == std::string::npos or r == regions.end()){
+        std::cerr << "error: layout '" << item << "' does not name a registered region." << std::endl;
+        exit(1);
+      }
+
+      Layout::ptr layout = Layout::create(item.substr(colon + 1), r->second.rows, r->second.cols, r->second.type, error);
+      if(!layout){
+        std::cerr << error << std::endl;
+        exit(1);
+      }
+
+      candidate->rewriter->addRegion(r->second.base, r->second.size, layout);
+      extents[r->second.base] = std::max(layout->footprint(), r->second.size);
+    }
+
+    // Warn when a layout grows a region into the next one.
+    for(std::map<std::string, Region>::const_iterator i = regions.begin(); i != regions.end(); i++){
+      if(extents.find(i->second.base) == extents.end()){
+        extents[i->second.base] = i->second.size;
+      }
+    }
+
+    for(std::map<uint64_t, uint64_t>::const_iterator i = extents.begin(); i != extents.end(); i++){
+      std::map<uint64_t, uint64_t>::const_iterator next = i;
+      if(++next != extents.end() and i->first + i->second > next->first){
+        std::cerr << "warning: layout '" << desc << "' makes the region at 0x" << std::hex << i->first << " overlap the one at 0x" << next->first << std::dec << "." << std::endl;
+      }
+    }
+
+    candidates.push_back(candidate);
+  }
+
+  // Deal the candidates out to the threads and run them.
+  threads = std::min<unsigned>(threads, candidates.size());
+  std::vector<Share> shares(threads);
+  for(unsigned i=0; i<candidates.size(); i++){
+    shares[i % threads].candidates.push_back(candidates[i]);
+  }
+
+  boost::thread_group workers;
+  for(unsigned i=0; i<threads; i++){
+    workers.create_thread(boost::bind(worker, tracefile, numrecords, &shares[i]));
+  }
+  workers.join_all();
+
+  foreach(const Share& share, shares){
+    if(not share.ok){
+      std::cerr << "error: could not open file '" << tracefile << "' for reading." << std::endl;
+      exit(1);
+    }
+  }
+
+  // Rank them.
+  std::vector<Candidate::ptr> ranked(candidates);
+  std::stable_sort(ranked.begin(), ranked.end(), rankby == "misses" ? fewer_misses : less_traffic);
+
+  const uint64_t base_misses = candidates[0]->memory_misses();
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "rank  memory misses  (vs. traced)  memory bytes  total bytes  layout" << std::endl;
+  for(unsigned i=0; i<ranked.size(); i++){
+    Candidate::const_ptr c = ranked[i];
+    const double change = base_misses > 0 ? 100.0 * (static_cast<double>(c->memory_misses()) - base_misses) / base_misses : 0.0;
+
+    std::cout << std::setw(4) << (i+1) << "  "
+              << std::setw(13) << c->memory_misses() << "  "
+              << std::setw(11) << change << "%  "
+              << std::setw(12) << c->memory_traffic() << "  "
+              << std::setw(11) << c->total_traffic() << "  "
+              << c->desc << std::endl;
+  }
+
+  return 0;
+}
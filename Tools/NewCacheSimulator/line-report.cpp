@@ -0,0 +1,301 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// line-report.cpp - Reports the hottest source lines of a line
+// profile (as written by debit's line-profile dumper), and optionally
+// annotates the source files around them.
+
+// TCLAP headers.
+#include <tclap/CmdLine.h>
+
+// MTV headers.
+#include <Core/Dataflow/LineProfile.h>
+#include <Core/Util/BoostForeach.h>
+using MTV::LineProfile;
+
+// System headers.
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace{
+  struct Line{
+    uint32_t file, line;
+    const uint64_t *counts;
+  };
+
+  struct MoreOf{
+    MoreOf(unsigned key)
+      : key(key)
+    {}
+
+    bool operator()(const Line& a, const Line& b) const {
+      return a.counts[key] > b.counts[key] or (a.counts[key] == b.counts[key] and a.counts[LineProfile::References] > b.counts[LineProfile::References]);
+    }
+
+    unsigned key;
+  };
+
+  // Reads a file table (lines of "index path", as written by aeon).
+  bool readFileTable(const std::string& path, std::map<unsigned, std::string>& table){
+    std::ifstream in(path.c_str());
+    if(!in){
+      return false;
+    }
+
+    unsigned index;
+    std::string filepath;
+    while(in >> index >> filepath){
+      table[index] = filepath;
+    }
+
+    return true;
+  }
+
+  std::string location(const std::map<unsigned, std::string>& files, uint32_t file, uint32_t line){
+    if(file == LineProfile::NoFile){
+      return "(no line)";
+    }
+
+    std::stringstream ss;
+    std::map<unsigned, std::string>::const_iterator f = files.find(file);
+    if(f != files.end()){
+      ss << f->second;
+    }
+    else{
+      ss << "file" << file;
+    }
+    ss << ':' << line;
+
+    return ss.str();
+  }
+
+  void header(std::ostream& out, unsigned levels){
+    out << std::setw(8) << "percent" << std::setw(12) << "refs";
+    for(unsigned L=0; L<levels; L++){
+      std::stringstream ss;
+      ss << "L" << (L+1) << "-miss";
+      out << std::setw(12) << ss.str();
+    }
+    out << std::setw(12) << "evictions" << std::setw(12) << "writebacks";
+  }
+
+  void columns(std::ostream& out, const uint64_t *c, unsigned levels, unsigned key, uint64_t total){
+    out << std::setw(7) << (total > 0 ? 100.0 * c[key] / total : 0.0) << '%'
+        << std::setw(12) << c[LineProfile::References];
+    for(unsigned L=0; L<levels; L++){
+      out << std::setw(12) << c[LineProfile::Misses + L];
+    }
+    out << std::setw(12) << c[LineProfile::Evictions] << std::setw(12) << c[LineProfile::Writebacks];
+  }
+}
+
+int main(int argc, char *argv[]){
+  std::string profilefile, filetable, sortby;
+  unsigned numlines, context;
+  bool annotate;
+
+  try{
+    TCLAP::CmdLine cmd("Report the source lines with the most cache activity in a line profile.");
+
+    TCLAP::ValueArg<std::string> profilefileArg("p",
+                                                "profile",
+                                                "Line profile file (as written by debit)",
+                                                true,
+                                                "",
+                                                "filename",
+                                                cmd);
+
+    TCLAP::ValueArg<std::string> filetableArg("f",
+                                              "file-table",
+                                              "File table naming the trace's source files",
+                                              false,
+                                              "",
+                                              "filename",
+                                              cmd);
+
+    TCLAP::ValueArg<std::string> sortbyArg("s",
+                                           "sort-by",
+                                           "Counter to rank lines by (references, evictions, writebacks, or a level such as L1; defaults to misses in the last level)",
+                                           false,
+                                           "",
+                                           "counter",
+                                           cmd);
+
+    TCLAP::ValueArg<unsigned> numlinesArg("n",
+                                          "num-lines",
+                                          "Number of lines to report",
+                                          false,
+                                          20,
+                                          "number",
+                                          cmd);
+
+    TCLAP::SwitchArg annotateArg("a",
+                                 "annotate",
+                                 "Print the source around the reported lines",
+                                 cmd);
+
+    TCLAP::ValueArg<unsigned> contextArg("C",
+                                         "context",
+                                         "Number of source lines to show around each reported line",
+                                         false,
+                                         2,
+                                         "number",
+                                         cmd);
+
+    cmd.parse(argc, argv);
+
+    profilefile = profilefileArg.getValue();
+    filetable = filetableArg.getValue();
+    sortby = sortbyArg.getValue();
+    numlines = numlinesArg.getValue();
+    annotate = annotateArg.getValue();
+    context = contextArg.getValue();
+  }
+  catch(TCLAP::ArgException& e){
+    std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+    exit(1);
+  }
+
+  std::string error;
+  LineProfile::const_ptr profile = LineProfile::load(profilefile, error);
+  if(!profile){
+    std::cerr << error << std::endl;
+    exit(1);
+  }
+
+  const unsigned levels = profile->num_levels();
+
+  std::map<unsigned, std::string> files;
+  if(filetable != "" and not readFileTable(filetable, files)){
+    std::cerr << "error: could not open file '" << filetable << "' for reading." << std::endl;
+    exit(1);
+  }
+
+  // Choose the counter to rank by.
+  unsigned key = LineProfile::Misses + levels - 1;
+  if(sortby == "references"){
+    key = LineProfile::References;
+  }
+  else if(sortby == "evictions"){
+    key = LineProfile::Evictions;
+  }
+  else if(sortby == "writebacks"){
+    key = LineProfile::Writebacks;
+  }
+  else if(sortby != ""){
+    std::stringstream ss(sortby.size() > 1 and (sortby[0] == 'L' or sortby[0] == 'l') ? sortby.substr(1) : "");
+    unsigned L;
+    if(not (ss >> L) or not ss.eof() or L < 1 or L > levels){
+      std::cerr << "error: invalid counter '" << sortby << "' (must be references, evictions, writebacks, or L1 through L" << levels << ")." << std::endl;
+      exit(1);
+    }
+
+    key = LineProfile::Misses + L - 1;
+  }
+
+  // Gather the lines and the totals.
+  std::vector<Line> lines;
+  std::vector<uint64_t> totals(profile->num_counters(), 0);
+  for(uint32_t f=0; f<profile->num_files(); f++){
+    for(uint32_t l=0; l<profile->num_lines(f); l++){
+      const Line line = {f, l, profile->counters(f, l)};
+      if(line.counts[LineProfile::References] > 0){
+        lines.push_back(line);
+      }
+    }
+  }
+  {
+    const Line line = {LineProfile::NoFile, 0, profile->counters(LineProfile::NoFile, 0)};
+    if(line.counts[LineProfile::References] > 0){
+      lines.push_back(line);
+    }
+  }
+
+  foreach(const Line& line, lines){
+    for(unsigned i=0; i<totals.size(); i++){
+      totals[i] += line.counts[i];
+    }
+  }
+
+  const unsigned n = std::min<size_t>(numlines, lines.size());
+  std::partial_sort(lines.begin(), lines.begin() + n, lines.end(), MoreOf(key));
+
+  std::cout << std::fixed << std::setprecision(2);
+
+  header(std::cout, levels);
+  std::cout << "  location" << std::endl;
+  for(unsigned i=0; i<n; i++){
+    columns(std::cout, lines[i].counts, levels, key, totals[key]);
+    std::cout << "  " << location(files, lines[i].file, lines[i].line) << std::endl;
+  }
+
+  columns(std::cout, &totals[0], levels, key, totals[key]);
+  std::cout << "  (total over " << lines.size() << " lines)" << std::endl;
+
+  if(not annotate){
+    return 0;
+  }
+
+  // Show each file's reported lines with their surroundings, in file
+  // order.
+  std::map<uint32_t, std::set<uint32_t> > hot;
+  for(unsigned i=0; i<n; i++){
+    if(lines[i].file != LineProfile::NoFile){
+      hot[lines[i].file].insert(lines[i].line);
+    }
+  }
+
+  for(std::map<uint32_t, std::set<uint32_t> >::const_iterator h = hot.begin(); h != hot.end(); ++h){
+    std::map<unsigned, std::string>::const_iterator f = files.find(h->first);
+    if(f == files.end()){
+      std::cerr << "warning: no file table entry for file " << h->first << "." << std::endl;
+      continue;
+    }
+
+    std::ifstream in(f->second.c_str());
+    if(!in){
+      std::cerr << "warning: could not open source file '" << f->second << "'." << std::endl;
+      continue;
+    }
+
+    std::vector<std::string> source(1);
+    std::string text;
+    while(std::getline(in, text)){
+      source.push_back(text);
+    }
+
+    std::cout << std::endl << "Source: " << f->second << std::endl;
+    header(std::cout, levels);
+    std::cout << std::endl;
+
+    uint32_t shown = 0;
+    foreach(uint32_t line, h->second){
+      const uint32_t first = std::max<uint32_t>(line > context ? line - context : 1, shown + 1);
+      const uint32_t last = std::min<uint32_t>(line + context, source.size() - 1);
+      if(shown > 0 and first > shown + 1){
+        std::cout << std::setw(8) << ':' << std::endl;
+      }
+
+      for(uint32_t l=first; l<=last; l++){
+        const uint64_t *c = profile->counters(h->first, l);
+        if(c and c[LineProfile::References] > 0){
+          columns(std::cout, c, levels, key, totals[key]);
+        }
+        else{
+          std::cout << std::setw(20 + 12*(levels + 2)) << ' ';
+        }
+        std::cout << "  " << std::setw(5) << l << ": " << source[l] << std::endl;
+      }
+
+      shown = std::max(shown, last);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,178 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// multicore-sim.cpp - Runs a set of per-thread reference traces
+// through a cache set, one thread per core, and reports coherence
+// behavior (including false sharing).
+
+// TCLAP headers.
+#include <tclap/CmdLine.h>
+
+// MTV headers.
+#include <Core/Dataflow/InterleavingTraceReader.h>
+#include <Tools/NewCacheSimulator/MulticoreCache.h>
+#include <Tools/NewCacheSimulator/NewCacheSet.h>
+#include <Tools/ReferenceTrace/mtrtools.h>
+using MTV::BlockStreamReader;
+using MTV::InterleavingTraceReader;
+using MTV::MulticoreCache;
+using MTV::NewCacheSet;
+using MTV::TraceReader;
+
+// System headers.
+#include <iostream>
+#include <sstream>
+
+int main(int argc, char *argv[]){
+  std::string cachefile, schedule, regfile;
+  std::vector<std::string> tracefiles;
+  unsigned quantum, hotspots;
+
+  try{
+    TCLAP::CmdLine cmd("Simulate a multicore cache hierarchy on per-thread reference traces");
+
+    TCLAP::ValueArg<std::string> cachefileArg("c",
+                                              "cache",
+                                              "cache set spec file (one cache per core)",
+                                              true,
+                                              "",
+                                              "filename",
+                                              cmd);
+
+    TCLAP::MultiArg<std::string> tracefileArg("t",
+                                              "trace",
+                                              "reference trace for the next thread",
+                                              true,
+                                              "filename",
+                                              cmd);
+
+    TCLAP::ValueArg<std::string> scheduleArg("m",
+                                             "schedule",
+                                             "thread interleaving: 'quantum' (round robin) or 'timestamp'",
+                                             false,
+                                             "quantum",
+                                             "mode",
+                                             cmd);
+
+    TCLAP::ValueArg<unsigned> quantumArg("q",
+                                         "quantum",
+                                         "memory records per thread per turn in quantum mode",
+                                         false,
+                                         1,
+                                         "records",
+                                         cmd);
+
+    TCLAP::ValueArg<std::string> regfileArg("r",
+                                            "registration",
+                                            "region registration file; statistics are reported per region",
+                                            false,
+                                            "",
+                                            "filename",
+                                            cmd);
+
+    TCLAP::ValueArg<unsigned> hotspotsArg("n",
+                                          "hotspots",
+                                          "number of false sharing hotspot blocks to report",
+                                          false,
+                                          10,
+                                          "count",
+                                          cmd);
+
+    cmd.parse(argc, argv);
+
+    cachefile = cachefileArg.getValue();
+    tracefiles = tracefileArg.getValue();
+    schedule = scheduleArg.getValue();
+    quantum = quantumArg.getValue();
+    regfile = regfileArg.getValue();
+    hotspots = hotspotsArg.getValue();
+  }
+  catch(TCLAP::ArgException& e){
+    std::cerr << "error: " << e.error() << " for argument " << e.argId() << std::endl;
+    exit(1);
+  }
+
+  InterleavingTraceReader::Schedule sched;
+  if(schedule == "quantum"){
+    sched = InterleavingTraceReader::Quantum;
+  }
+  else if(schedule == "timestamp"){
+    sched = InterleavingTraceReader::Timestamp;
+  }
+  else{
+    std::cerr << "error: schedule must be 'quantum' or 'timestamp'." << std::endl;
+    exit(1);
+  }
+
+  if(quantum == 0){
+    std::cerr << "error: quantum must be positive." << std::endl;
+    exit(1);
+  }
+
+  // Build the cache set.
+  std::string error;
+  NewCacheSet::ptr cacheset = NewCacheSet::newFromSpec(cachefile, TraceReader::ptr(), BlockStreamReader::ptr(), error);
+  if(not cacheset){
+    std::cerr << error << std::endl;
+    exit(1);
+  }
+
+  MulticoreCache mc(cacheset);
+  if(tracefiles.size() > mc.num_cores()){
+    std::cerr << "error: " << tracefiles.size() << " traces given, but the cache set has only " << mc.num_cores() << " caches." << std::endl;
+    exit(1);
+  }
+
+  // Register regions.
+  if(regfile != ""){
+    MTR::RegionRegistration reg;
+    reg.read(regfile.c_str());
+    if(reg.hasError()){
+      std::cerr << "error: " << reg.error() << std::endl;
+      exit(1);
+    }
+
+    for(unsigned i=0; i<reg.arrayRegions.size(); i++){
+      const MTR::ArrayRegion& r = reg.arrayRegions[i];
+
+      std::string name = r.title;
+      if(name == ""){
+        std::stringstream ss;
+        ss << "array" << i;
+        name = ss.str();
+      }
+
+      mc.addRegion(name, r.base, r.base + r.size);
+    }
+  }
+
+  // Open the traces.
+  InterleavingTraceReader reader(sched, quantum);
+  if(not reader.open(tracefiles)){
+    std::cerr << "error: could not open the trace files." << std::endl;
+    exit(1);
+  }
+
+  try{
+    while(true){
+      const MTR::ThreadRecord& rec = reader.nextRecord();
+
+      switch(rec.record.code){
+      case MTR::Record::Read:
+        mc.load(rec.thread, rec.record.addr);
+        break;
+
+      case MTR::Record::Write:
+        mc.store(rec.thread, rec.record.addr);
+        break;
+
+      default:
+        break;
+      }
+    }
+  }
+  catch(InterleavingTraceReader::End){}
+
+  mc.report(std::cout, hotspots);
+
+  return 0;
+}
@@ -0,0 +1,697 @@
+// -*- c++ -*-
+//
+// Copyright 2011 A.N.M. Imroz Choudhury
+//
+// StackIndex.h - A flat, memory-mappable index of the stack info
+// produced by mithril: sorted PC tables, fully resolved type sizes,
+// and variable lifetime intervals.  An index file is opened in
+// constant time (no parsing, no hash tables to rebuild) and queried
+// by binary search.  A plain mithril protobuf file can also be loaded,
+// in which case the same index is built in memory.
+
+#ifndef STACK_INDEX_H
+#define STACK_INDEX_H
+
+// MTV headers.
+#include <Core/LexicalBlock.pb.h>
+#include <Core/Subprogram.pb.h>
+#include <Core/Type.pb.h>
+#include <Core/Variable.pb.h>
+#include <Core/Util/Boost.h>
+#include <Core/Util/ErrorMessage.h>
+#include <Core/Util/Util.h>
+
+// System headers.
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace MTV{
+  class StackIndex : public ErrorMessage {
+  public:
+    // On-disk records.  Every table is sorted by its first field and
+    // begins on an 8-byte boundary.
+    struct FrameEntry{
+      uint64_t pc;
+      int32_t offset;
+      char reg[20];
+    };
+
+    struct ScopeCount{
+      uint64_t pc;
+      uint32_t count;
+      uint32_t pad;
+    };
+
+    struct TypeSize{
+      uint64_t id;
+      uint32_t size;
+      uint32_t count;
+    };
+
+    struct Var{
+      uint64_t id;
+      uint64_t low_pc, high_pc;
+
+      // Either a frame base offset or an absolute address.
+      int64_t location;
+      uint32_t absolute;
+
+      // Element size and element count (count is the array length
+      // for array types and 1 otherwise).
+      uint32_t size, count;
+      uint32_t pad;
+    };
+
+    enum Table{
+      FunctionEntries,
+      FunctionExits,
+      FrameEntries,
+      ScopeEntries,
+      ScopeExits,
+      Types,
+      Vars,
+      VarExits, // Indices into Vars, sorted by high_pc.
+      NumTables
+    };
+
+    struct Header{
+      char magic[8];
+      uint32_t version;
+      uint32_t tables;
+      struct{
+        uint64_t offset, count;
+      } table[NumTables];
+    };
+
+    static const char *magic(){
+      return "MTVXSIDX";
+    }
+
+    static const uint32_t Version = 1;
+
+  public:
+    StackIndex()
+      : base(0),
+        size(0),
+        mapped(0)
+    {}
+
+    ~StackIndex(){
+      this->close();
+    }
+
+    // Opens an index file written by save(), or else reads a mithril
+    // protobuf file and indexes it in memory.
+    bool load(const std::string& filename){
+      this->close();
+
+      if(is_index(filename)){
+        return this->map(filename);
+      }
+
+      std::ifstream in(filename.c_str());
+      if(!in){
+        *this << "could not open file '" << filename << "'";
+        return false;
+      }
+
+      Mithril::TypeList types;
+      Mithril::VariableList vars;
+      Mithril::SubprogramList subprogs;
+      Mithril::LexicalBlockList scopes;
+      readProtocolBuffer(in, types);
+      readProtocolBuffer(in, vars);
+      readProtocolBuffer(in, subprogs);
+      readProtocolBuffer(in, scopes);
+      if(!in){
+        *this << "could not read mithril data from file '" << filename << "'";
+        return false;
+      }
+
+      return this->load(types, vars, subprogs, scopes);
+    }
+
+    // Indexes mithril data that has already been read out, in memory.
+    bool load(const Mithril::TypeList& types,
+              const Mithril::VariableList& vars,
+              const Mithril::SubprogramList& subprogs,
+              const Mithril::LexicalBlockList& scopes){
+      this->close();
+
+      std::string err;
+      if(!build(types, vars, subprogs, scopes, owned, err)){
+        *this << err;
+        return false;
+      }
+
+      base = reinterpret_cast<const char *>(&owned[0]);
+      size = owned.size()*sizeof(owned[0]);
+      return this->validate();
+    }
+
+    static bool is_index(const std::string& filename){
+      std::ifstream in(filename.c_str(), std::ios::binary);
+      char m[8];
+      return in.read(m, sizeof(m)) and std::memcmp(m, magic(), sizeof(m)) == 0;
+    }
+
+    // Builds the index and writes it to a file.
+    static bool save(const std::string& filename,
+                     const Mithril::TypeList& types,
+                     const Mithril::VariableList& vars,
+                     const Mithril::SubprogramList& subprogs,
+                     const Mithril::LexicalBlockList& scopes,
+                     std::string& err){
+      std::vector<uint64_t> buf;
+      if(!build(types, vars, subprogs, scopes, buf, err)){
+        return false;
+      }
+
+      std::ofstream out(filename.c_str(), std::ios::binary);
+      if(!out){
+        err = "could not open file '" + filename + "' for output";
+        return false;
+      }
+      out.write(reinterpret_cast<const char *>(&buf[0]), buf.size()*sizeof(buf[0]));
+      return out.good();
+    }
+
+    // A variable at a fixed address (a global or a static), with its
+    // whole size in bytes.
+    struct Global{
+      std::string name;
+      uint64_t base, size;
+    };
+
+    // Reads the fixed-address variables from a mithril protobuf file
+    // (index files do not keep variable names).
+    static bool read_globals(const std::string& filename, std::vector<Global>& globals, std::string& err){
+      std::ifstream in(filename.c_str());
+      if(!in or is_index(filename)){
+        err = "could not read mithril data from file '" + filename + "'";
+        return false;
+      }
+
+      Mithril::TypeList types;
+      Mithril::VariableList vars;
+      readProtocolBuffer(in, types);
+      readProtocolBuffer(in, vars);
+      if(!in){
+        err = "could not read mithril data from file '" + filename + "'";
+        return false;
+      }
+
+      boost::unordered_map<uint64_t, const Mithril::Type *> type_table;
+      for(int i=0; i<types.type_size(); i++){
+        type_table[types.type(i).id()] = &types.type(i);
+      }
+
+      for(int i=0; i<vars.var_size(); i++){
+        const Mithril::Variable& v = vars.var(i);
+        if(not v.has_absolute_location()){
+          continue;
+        }
+
+        uint32_t count;
+        const uint32_t size = resolve_type_size(type_table, v.type(), count);
+
+        Global g;
+        g.name = v.name();
+        g.base = v.absolute_location().address();
+        g.size = static_cast<uint64_t>(size)*count;
+        if(g.size > 0){
+          globals.push_back(g);
+        }
+      }
+
+      return true;
+    }
+
+    // A function's name and PC range.
+    struct Function{
+      std::string name;
+      uint64_t low_pc, high_pc;
+    };
+
+    // Reads the functions from a mithril protobuf file (index files do
+    // not keep function names).
+    static bool read_functions(const std::string& filename, std::vector<Function>& functions, std::string& err){
+      std::ifstream in(filename.c_str());
+      if(!in or is_index(filename)){
+        err = "could not read mithril data from file '" + filename + "'";
+        return false;
+      }
+
+      Mithril::TypeList types;
+      Mithril::VariableList vars;
+      Mithril::SubprogramList subprogs;
+      readProtocolBuffer(in, types);
+      readProtocolBuffer(in, vars);
+      readProtocolBuffer(in, subprogs);
+      if(!in){
+        err = "could not read mithril data from file '" + filename + "'";
+        return false;
+      }
+
+      for(int i=0; i<subprogs.subprogram_size(); i++){
+        const Mithril::Subprogram& s = subprogs.subprogram(i);
+
+        Function f;
+        f.name = s.name();
+        f.low_pc = s.low_pc();
+        f.high_pc = s.high_pc();
+        functions.push_back(f);
+      }
+
+      return true;
+    }
+
+    // Queries.
+    bool is_function_entry(uint64_t pc) const {
+      const std::pair<const uint64_t *, const uint64_t *> t = this->table<uint64_t>(FunctionEntries);
+      return std::binary_search(t.first, t.second, pc);
+    }
+
+    bool is_function_exit(uint64_t pc) const {
+      const std::pair<const uint64_t *, const uint64_t *> t = this->table<uint64_t>(FunctionExits);
+      return std::binary_search(t.first, t.second, pc);
+    }
+
+    // The returned pointer stays valid for as long as the index is
+    // open.
+    const FrameEntry *frame_entry(uint64_t pc) const {
+      return find(this->table<FrameEntry>(FrameEntries), pc);
+    }
+
+    unsigned scope_entries(uint64_t pc) const {
+      const ScopeCount *s = find(this->table<ScopeCount>(ScopeEntries), pc);
+      return s ? s->count : 0;
+    }
+
+    unsigned scope_exits(uint64_t pc) const {
+      const ScopeCount *s = find(this->table<ScopeCount>(ScopeExits), pc);
+      return s ? s->count : 0;
+    }
+
+    // Returns false for unknown types.
+    bool type_size(uint64_t id, uint32_t& size, uint32_t& count) const {
+      const TypeSize *t = find(this->table<TypeSize>(Types), id);
+      if(!t){
+        return false;
+      }
+      size = t->size;
+      count = t->count;
+      return true;
+    }
+
+    // The variables whose lifetimes begin at pc.
+    std::pair<const Var *, const Var *> vars_entering(uint64_t pc) const {
+      const std::pair<const Var *, const Var *> t = this->table<Var>(Vars);
+      const Var *first = std::lower_bound(t.first, t.second, pc, KeyLess<Var>());
+      const Var *last = first;
+      while(last != t.second and last->low_pc == pc){
+        ++last;
+      }
+      return std::make_pair(first, last);
+    }
+
+    // The variables whose lifetimes end at pc, as indices for var().
+    std::pair<const uint32_t *, const uint32_t *> vars_exiting(uint64_t pc) const {
+      const std::pair<const uint32_t *, const uint32_t *> t = this->table<uint32_t>(VarExits);
+      const uint32_t *first = t.first, *last = t.second;
+
+      // Binary search on the high pc of the referred-to variables.
+      for(size_t n = last - first; n > 0; ){
+        const size_t half = n / 2;
+        if(this->var(first[half]).high_pc < pc){
+          first += half + 1;
+          n -= half + 1;
+        }
+        else{
+          n = half;
+        }
+      }
+
+      last = first;
+      while(last != t.second and this->var(*last).high_pc == pc){
+        ++last;
+      }
+      return std::make_pair(first, last);
+    }
+
+    const Var& var(uint32_t i) const {
+      return this->table<Var>(Vars).first[i];
+    }
+
+    std::pair<const uint64_t *, const uint64_t *> function_entries() const {
+      return this->table<uint64_t>(FunctionEntries);
+    }
+
+  private:
+    // NOTE(choudhury): an index owns its mapping, or points into its own
+    // buffer, so a copy would unmap it twice or point into freed
+    // storage.
+    StackIndex(const StackIndex&);
+    StackIndex& operator=(const StackIndex&);
+
+    template<typename T>
+    struct KeyLess{
+      bool operator()(const T& a, uint64_t b) const { return key(a) < b; }
+      bool operator()(uint64_t a, const T& b) const { return a < key(b); }
+    };
+
+    static uint64_t key(const FrameEntry& f) { return f.pc; }
+    static uint64_t key(const ScopeCount& s) { return s.pc; }
+    static uint64_t key(const TypeSize& t) { return t.id; }
+    static uint64_t key(const Var& v) { return v.low_pc; }
+
+    template<typename T>
+    static const T *find(const std::pair<const T *, const T *>& t, uint64_t k){
+      const T *i = std::lower_bound(t.first, t.second, k, KeyLess<T>());
+      return (i != t.second and key(*i) == k) ? i : 0;
+    }
+
+    template<typename T>
+    static bool less_key(const T& a, const T& b){
+      return key(a) < key(b);
+    }
+
+    template<typename T>
+    std::pair<const T *, const T *> table(Table t) const {
+      // An index that was never loaded behaves as an empty one.
+      if(!base){
+        return std::make_pair(static_cast<const T *>(0), static_cast<const T *>(0));
+      }
+
+      const Header *h = reinterpret_cast<const Header *>(base);
+      const T *first = reinterpret_cast<const T *>(base + h->table[t].offset);
+      return std::make_pair(first, first + h->table[t].count);
+    }
+
+    bool map(const std::string& filename){
+      const int fd = ::open(filename.c_str(), O_RDONLY);
+      if(fd < 0){
+        *this << "could not open file '" << filename << "'";
+        return false;
+      }
+
+      struct stat st;
+      if(fstat(fd, &st) != 0 or st.st_size < static_cast<off_t>(sizeof(Header))){
+        ::close(fd);
+        *this << "index file '" << filename << "' is truncated";
+        return false;
+      }
+
+      void *p = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if(p == MAP_FAILED){
+        *this << "could not map index file '" << filename << "'";
+        return false;
+      }
+
+      mapped = p;
+      base = static_cast<const char *>(p);
+      size = st.st_size;
+      return this->validate();
+    }
+
+    void close(){
+      if(mapped){
+        munmap(mapped, size);
+        mapped = 0;
+      }
+      owned.clear();
+      base = 0;
+      size = 0;
+    }
+
+    bool validate(){
+      static const size_t record[NumTables] = {
+        sizeof(uint64_t),
+        sizeof(uint64_t),
+        sizeof(FrameEntry),
+        sizeof(ScopeCount),
+        sizeof(ScopeCount),
+        sizeof(TypeSize),
+        sizeof(Var),
+        sizeof(uint32_t)
+      };
+
+      const Header *h = reinterpret_cast<const Header *>(base);
+      if(std::memcmp(h->magic, magic(), sizeof(h->magic)) != 0 or h->version != Version or h->tables != NumTables){
+        *this << "unrecognized stack index format";
+        return false;
+      }
+
+      for(unsigned t=0; t<NumTables; t++){
+        if(h->table[t].offset % 8 != 0 or h->table[t].offset > size or
+           h->table[t].count > (size - h->table[t].offset) / record[t]){
+          *this << "stack index table " << t << " is out of bounds";
+          return false;
+        }
+      }
+
+      // Every exit entry must refer to a real variable.
+      const std::pair<const uint32_t *, const uint32_t *> exits = this->table<uint32_t>(VarExits);
+      for(const uint32_t *i = exits.first; i != exits.second; ++i){
+        if(*i >= h->table[Vars].count){
+          *this << "stack index variable exit table is corrupt";
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    // Follows typedef/const chains to a size, reporting the element
+    // count for arrays.
+    static uint32_t resolve_type_size(const boost::unordered_map<uint64_t, const Mithril::Type *>& types, uint64_t id, uint32_t& howmany, unsigned depth = 0){
+      howmany = 1;
+
+      boost::unordered_map<uint64_t, const Mithril::Type *>::const_iterator i = types.find(id);
+      if(i == types.end() or depth > 64){
+        return 0;
+      }
+
+      const Mithril::Type& t = *i->second;
+      if(t.has_base_type()){
+        return t.base_type().size();
+      }
+      else if(t.has_class_type()){
+        return t.class_type().size();
+      }
+      else if(t.has_typedef_type()){
+        return resolve_type_size(types, t.typedef_type().ref(), howmany, depth + 1);
+      }
+      else if(t.has_const_type()){
+        return resolve_type_size(types, t.const_type().ref(), howmany, depth + 1);
+      }
+      else if(t.has_pointer_type()){
+        return t.pointer_type().size();
+      }
+      else if(t.has_reference_type()){
+        return t.reference_type().size();
+      }
+      else if(t.has_array_type()){
+        // For array types, the size field is the array length.
+        uint32_t dummy;
+        const uint32_t elt = resolve_type_size(types, t.array_type().ref(), dummy, depth + 1);
+        howmany = t.array_type().size();
+        return elt;
+      }
+      return 0;
+    }
+
+    template<typename T>
+    static void append(std::vector<uint64_t>& buf, Header& h, Table t, const std::vector<T>& v){
+      h.table[t].offset = buf.size()*sizeof(uint64_t);
+      h.table[t].count = v.size();
+
+      const size_t bytes = v.size()*sizeof(T);
+      const size_t at = buf.size();
+      buf.resize(at + (bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+      if(bytes > 0){
+        std::memcpy(&buf[at], &v[0], bytes);
+      }
+    }
+
+    struct ExitLess{
+      ExitLess(const std::vector<Var>& vars)
+        : vars(vars)
+      {}
+
+      bool operator()(uint32_t a, uint32_t b) const {
+        return vars[a].high_pc < vars[b].high_pc;
+      }
+
+      const std::vector<Var>& vars;
+    };
+
+    static bool build(const Mithril::TypeList& types,
+                      const Mithril::VariableList& vars,
+                      const Mithril::SubprogramList& subprogs,
+                      const Mithril::LexicalBlockList& scopes,
+                      std::vector<uint64_t>& buf,
+                      std::string& err){
+      std::stringstream msg;
+
+      // Function entry and exit points.
+      std::vector<uint64_t> entries, exits;
+      for(int i=0; i<subprogs.subprogram_size(); i++){
+        entries.push_back(subprogs.subprogram(i).low_pc());
+        exits.push_back(subprogs.subprogram(i).high_pc());
+      }
+      // NOTE(choudhury): aliased functions (e.g. the C1/C2 variants of
+      // a C++ constructor) share their PC range, so duplicates are
+      // merged rather than treated as errors.
+      std::sort(entries.begin(), entries.end());
+      std::sort(exits.begin(), exits.end());
+      entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+      exits.erase(std::unique(exits.begin(), exits.end()), exits.end());
+
+      // Frame base locators.  Locator addresses are relative to the
+      // compile unit's low PC.
+      std::vector<FrameEntry> frames;
+      for(int i=0; i<subprogs.subprogram_size(); i++){
+        const Mithril::Loclist& l = subprogs.subprogram(i).loclist();
+        for(int j=0; j<l.locator_size(); j++){
+          FrameEntry f;
+          std::memset(&f, 0, sizeof(f));
+          f.pc = l.cu_low_pc() + l.locator(j).low_pc();
+          f.offset = l.locator(j).offset();
+          std::strncpy(f.reg, l.locator(j).reg().c_str(), sizeof(f.reg) - 1);
+          frames.push_back(f);
+        }
+      }
+      std::stable_sort(frames.begin(), frames.end(), less_key<FrameEntry>);
+      {
+        std::vector<FrameEntry> unique;
+        for(size_t i=0; i<frames.size(); i++){
+          if(unique.size() > 0 and unique.back().pc == frames[i].pc){
+            if(unique.back().offset != frames[i].offset or std::strcmp(unique.back().reg, frames[i].reg) != 0){
+              msg << "conflicting frame base locators at 0x" << std::hex << frames[i].pc;
+              err = msg.str();
+              return false;
+            }
+            continue;
+          }
+          unique.push_back(frames[i]);
+        }
+        frames.swap(unique);
+      }
+
+      // Scope entry/exit counts.
+      std::vector<ScopeCount> scope_in, scope_out;
+      {
+        std::map<uint64_t, uint32_t> in, out;
+        for(int i=0; i<scopes.lexical_block_size(); i++){
+          in[scopes.lexical_block(i).low_pc()]++;
+          out[scopes.lexical_block(i).high_pc()]++;
+        }
+
+        for(std::map<uint64_t, uint32_t>::const_iterator i = in.begin(); i != in.end(); ++i){
+          const ScopeCount s = {i->first, i->second, 0};
+          scope_in.push_back(s);
+        }
+        for(std::map<uint64_t, uint32_t>::const_iterator i = out.begin(); i != out.end(); ++i){
+          const ScopeCount s = {i->first, i->second, 0};
+          scope_out.push_back(s);
+        }
+      }
+
+      // Resolved type sizes.
+      boost::unordered_map<uint64_t, const Mithril::Type *> type_table;
+      for(int i=0; i<types.type_size(); i++){
+        type_table[types.type(i).id()] = &types.type(i);
+      }
+
+      std::vector<TypeSize> sizes;
+      for(boost::unordered_map<uint64_t, const Mithril::Type *>::const_iterator i = type_table.begin(); i != type_table.end(); ++i){
+        TypeSize t;
+        t.id = i->first;
+        t.size = resolve_type_size(type_table, i->first, t.count);
+        sizes.push_back(t);
+      }
+      std::sort(sizes.begin(), sizes.end(), less_key<TypeSize>);
+
+      // Variable lifetimes.
+      std::vector<Var> lifetimes;
+      for(int i=0; i<vars.var_size(); i++){
+        const Mithril::Variable& v = vars.var(i);
+
+        Var r;
+        std::memset(&r, 0, sizeof(r));
+        r.id = v.id();
+        r.low_pc = v.low_pc();
+        r.high_pc = v.high_pc();
+        if(v.has_stack_location()){
+          r.location = v.stack_location().offset();
+          r.absolute = 0;
+        }
+        else if(v.has_absolute_location()){
+          r.location = v.absolute_location().address();
+          r.absolute = 1;
+        }
+        else{
+          msg << "variable " << v.name() << " has no location";
+          err = msg.str();
+          return false;
+        }
+        r.size = resolve_type_size(type_table, v.type(), r.count);
+
+        lifetimes.push_back(r);
+      }
+
+      // NOTE(choudhury): stable sorts keep variables sharing a PC in
+      // their original (declaration) order.
+      std::stable_sort(lifetimes.begin(), lifetimes.end(), less_key<Var>);
+
+      std::vector<uint32_t> var_exits(lifetimes.size());
+      for(uint32_t i=0; i<var_exits.size(); i++){
+        var_exits[i] = i;
+      }
+      std::stable_sort(var_exits.begin(), var_exits.end(), ExitLess(lifetimes));
+
+      // Lay out the header and the tables.
+      Header h;
+      std::memset(&h, 0, sizeof(h));
+      std::memcpy(h.magic, magic(), sizeof(h.magic));
+      h.version = Version;
+      h.tables = NumTables;
+
+      buf.assign((sizeof(Header) + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+      append(buf, h, FunctionEntries, entries);
+      append(buf, h, FunctionExits, exits);
+      append(buf, h, FrameEntries, frames);
+      append(buf, h, ScopeEntries, scope_in);
+      append(buf, h, ScopeExits, scope_out);
+      append(buf, h, Types, sizes);
+      append(buf, h, Vars, lifetimes);
+      append(buf, h, VarExits, var_exits);
+      std::memcpy(&buf[0], &h, sizeof(h));
+
+      return true;
+    }
+
+  private:
+    const char *base;
+    size_t size;
+
+    // Exactly one of these backs the index.
+    void *mapped;
+    std::vector<uint64_t> owned;
+  };
+}
+
+#endif
@@ -18,6 +18,7 @@ using MTV::TraceWriter;
 #include <boost/unordered_map.hpp>
 
 // System headers.
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
@@ -148,7 +149,7 @@ VOID function_exit(const std::string *name, UINT64 addr){
 //   std::cerr << "entering frame" << std::endl;
 // }
 
-VOID frame_entry(CONTEXT *ctx, ADDRINT addr, const StackInfo::FrameBaseLocator *fbl){
+VOID frame_entry(CONTEXT *ctx, ADDRINT addr, const MTV::StackIndex::FrameEntry *fbl){
   std::cerr << "entering frame at 0x" << std::hex << addr << std::dec << std::endl;
   std::cerr << "fbl: " << std::hex << fbl << std::dec << std::endl;
   std::cerr << "fbl->reg: " << fbl->reg << std::endl;
@@ -174,10 +175,10 @@ VOID frame_entry(CONTEXT *ctx, ADDRINT addr, const StackInfo::FrameBaseLocator *
 
   // Determine which symbolic register to use.
   REG reg;
-  if(fbl->reg == "DW_OP_breg7"){
+  if(std::strcmp(fbl->reg, "DW_OP_breg7") == 0){
     reg = REG_RSP;
   }
-  else if(fbl->reg == "DW_OP_breg6"){
+  else if(std::strcmp(fbl->reg, "DW_OP_breg6") == 0){
     reg = REG_RBP;
   }
   else{
@@ -233,7 +234,7 @@ VOID routine(RTN rtn, VOID *){
   const INS ins = RTN_InsHead(rtn);
   const ADDRINT addr = INS_Address(ins);
   const std::string *func_name = &RTN_Name(rtn);
-  if(stack_info.function_entry.find(addr) != stack_info.function_entry.end()){
+  if(stack_info.index.is_function_entry(addr)){
     RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)up_level, IARG_END);
     RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)function_entry, IARG_PTR, func_name, IARG_ADDRINT, addr, IARG_END);
 
@@ -339,17 +340,19 @@ VOID instruction(INS ins, VOID *){
   // }
 
   // Frame entry (no special action for frame exit).
-  boost::unordered_map<uint64_t, StackInfo::FrameBaseLocator>::const_iterator i;
-  i = stack_info.frame_entry.find(addr);
-  if(i != stack_info.frame_entry.end()){
-    const StackInfo::FrameBaseLocator& fbl = i->second;
-    std::cerr << "fbl.reg = " << fbl.reg << std::endl
-              << "fbl.offset = " << fbl.offset << std::endl;
+  //
+  // NOTE(choudhury): the locator lives in the stack index, so the
+  // pointer handed to the analysis routine stays valid for the life
+  // of the run.
+  const MTV::StackIndex::FrameEntry *fbl = stack_info.index.frame_entry(addr);
+  if(fbl){
+    std::cerr << "fbl.reg = " << fbl->reg << std::endl
+              << "fbl.offset = " << fbl->offset << std::endl;
 
     INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)frame_entry,
                    IARG_CONTEXT,
                    IARG_INST_PTR,
-                   IARG_PTR, &fbl,
+                   IARG_PTR, fbl,
                    IARG_END);
 
     // INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)frame_entry_bare,
@@ -361,23 +364,22 @@ VOID instruction(INS ins, VOID *){
   // First test for exit (since this pops the mini-stack, and the same
   // address may indicate the NEW scope that "replaces" the exiting
   // one on the mini-stack).
-  boost::unordered_map<uint64_t, unsigned>::const_iterator j;
-  j = stack_info.scope_exit.find(addr);
-  if(j != stack_info.scope_exit.end()){
+  const unsigned exits = stack_info.index.scope_exits(addr);
+  if(exits > 0){
     INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)scope_exit, 
-                   IARG_ADDRINT, j->first,
-                   IARG_UINT32, j->second,
+                   IARG_ADDRINT, addr,
+                   IARG_UINT32, exits,
                    IARG_END);
   }
 
   // Next check to see if the address begins a new scope.
-  j = stack_info.scope_entry.find(addr);
-  if(j != stack_info.scope_entry.end()){
+  const unsigned entries = stack_info.index.scope_entries(addr);
+  if(entries > 0){
     // // INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)emit_pc, IARG_INST_PTR, IARG_END);
 
     INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)scope_entry,
                    IARG_INST_PTR,
-                   IARG_UINT32, j->second,
+                   IARG_UINT32, entries,
                    IARG_END);
   }
 }
@@ -0,0 +1,155 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// mtrcrop.cpp - Crops a reference trace to the span from its first to
+// its last LineNumber record (or to one invocation of a function),
+// using the trace's index to seek straight to the start, and either
+// lists the result in human-readable form or saves it as a new trace.
+
+// TCLAP headers.
+#include <tclap/CmdLine.h>
+
+// MTV headers.
+#include <Core/Dataflow/Printer.h>
+#include <Core/Dataflow/TraceIndex.h>
+#include <Core/Dataflow/TraceReader.h>
+#include <Core/Dataflow/TraceWriter.h>
+using MTV::Consumer;
+using MTV::Printer;
+using MTV::TraceIndex;
+using MTV::TraceReader;
+using MTV::TraceWriter;
+
+// System headers.
+#include <iostream>
+#include <sstream>
+#include <string>
+
+int main(int argc, char *argv[]){
+  std::string tracefile, outputfile, functionText;
+  uint64_t invocation;
+
+  try{
+    TCLAP::CmdLine cmd("Crop a reference trace to the span of its LineNumber records, or to one invocation of a function.");
+
+    TCLAP::UnlabeledValueArg<std::string> tracefileArg("tracefile",
+                                                       "Trace file to crop.",
+                                                       true,
+                                                       "",
+                                                       "filename",
+                                                       cmd);
+
+    TCLAP::ValueArg<std::string> outputfileArg("o",
+                                               "output",
+                                               "Save the cropped trace (in the input's encoding) instead of listing it.",
+                                               false,
+                                               "",
+                                               "filename",
+                                               cmd);
+
+    TCLAP::ValueArg<std::string> functionArg("f",
+                                             "function",
+                                             "Crop to an invocation of the function at this (hex) address.",
+                                             false,
+                                             "",
+                                             "address",
+                                             cmd);
+
+    TCLAP::ValueArg<uint64_t> invocationArg("i",
+                                            "invocation",
+                                            "Which invocation of the function to crop to, counting from 0 (default 0).",
+                                            false,
+                                            0,
+                                            "count",
+                                            cmd);
+
+    cmd.parse(argc, argv);
+
+    tracefile = tracefileArg.getValue();
+    outputfile = outputfileArg.getValue();
+    functionText = functionArg.getValue();
+    invocation = invocationArg.getValue();
+  }
+  catch(TCLAP::ArgException& e){
+    std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+    exit(1);
+  }
+
+  // Load (or build) the trace's index.
+  TraceIndex index;
+  if(!index.open(tracefile)){
+    std::cerr << "error: " << index.error() << std::endl;
+    exit(1);
+  }
+
+  TraceReader reader;
+  if(!reader.open(tracefile)){
+    std::cerr << "error: could not open trace file '" << tracefile << "'" << std::endl;
+    exit(1);
+  }
+
+  // Find where the cropped trace starts.
+  bool function = false;
+  MTR::addr_t addr = 0;
+  if(functionText != ""){
+    std::stringstream ss(functionText);
+    if(!(ss >> std::hex >> addr) or !ss.eof()){
+      std::cerr << "error: illegal function address '" << functionText << "'" << std::endl;
+      exit(1);
+    }
+
+    if(!reader.seekFunction(index, addr, invocation)){
+      std::cerr << "error: function 0x" << std::hex << addr << std::dec << " was entered " << index.invocations(addr) << " time(s) in the trace" << std::endl;
+      exit(1);
+    }
+
+    function = true;
+  }
+  else{
+    if(index.first_line_record() == TraceIndex::NoPosition){
+      std::cerr << "error: no LineNumber records in trace file." << std::endl;
+      exit(1);
+    }
+
+    reader.seek(index.first_line_record());
+  }
+
+  // Send the records either to a new trace or to the screen.
+  Consumer<MTR::Record>::ptr sink;
+  if(outputfile != ""){
+    TraceWriter::ptr writer(new TraceWriter(reader.getEncoding()));
+    if(!writer->open(outputfile)){
+      std::cerr << "error: could not open output file '" << outputfile << "'" << std::endl;
+      exit(1);
+    }
+    sink = writer;
+  }
+  else{
+    sink = Printer<MTR::Record>::ptr(new Printer<MTR::Record>);
+  }
+
+  // Copy records through the last LineNumber record, or through the
+  // exit matching the function entry (counting recursive calls).
+  unsigned depth = 0;
+  try{
+    while(true){
+      const uint64_t pos = reader.getTracePoint();
+      const MTR::Record& rec = reader.nextRecord();
+      sink->consume(rec);
+
+      if(function){
+        if(rec.code == MTR::Record::FunctionEntry and rec.addr == addr){
+          depth++;
+        }
+        else if(rec.code == MTR::Record::FunctionExit and rec.addr == addr and --depth == 0){
+          break;
+        }
+      }
+      else if(pos == index.last_line_record()){
+        break;
+      }
+    }
+  }
+  catch(TraceReader::End){}
+
+  return 0;
+}
@@ -0,0 +1,827 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// mtrgen.cpp - Generates synthetic reference traces (with a matching
+// region registration), using several threads to keep up with the
+// disk.
+
+// TCLAP headers.
+#include <tclap/CmdLine.h>
+
+// MTV includes.
+#include <Core/Dataflow/TraceWriter.h>
+#include <Tools/ReferenceTrace/mtrtools.h>
+#include <Tools/ReferenceTrace/registration.h>
+using MTV::TraceWriter;
+
+// Boost headers.
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+// System includes.
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+
+namespace{
+  // One memory access produced by a pattern.
+  struct Access{
+    MTR::addr_t addr;
+    bool write;
+    uint32_t line;
+  };
+
+  // Per-chunk random number state (for erand48() and friends).
+  struct Random{
+    Random(uint64_t seed, uint64_t chunk){
+      // Mix the seed and chunk index so that every chunk gets its own
+      // stream, independent of which thread generates it.
+      uint64_t h = (seed + 1) * 0x9e3779b97f4a7c15ULL ^ (chunk + 1) * 0xc2b2ae3d27d4eb4fULL;
+      h ^= h >> 29;
+      h *= 0xbf58476d1ce4e5b9ULL;
+      h ^= h >> 32;
+
+      xsubi[0] = h & 0xffff;
+      xsubi[1] = (h >> 16) & 0xffff;
+      xsubi[2] = (h >> 32) & 0xffff;
+    }
+
+    double uniform(){
+      return erand48(xsubi);
+    }
+
+    uint64_t below(uint64_t n){
+      const uint64_t v = static_cast<uint64_t>(this->uniform() * n);
+      return v < n ? v : n - 1;
+    }
+
+    unsigned short xsubi[3];
+  };
+
+  // A memory access pattern.  The i-th access is a function of i
+  // alone (plus the chunk's random numbers, for the random patterns),
+  // so chunks can be generated independently.
+  class Pattern{
+  public:
+    virtual ~Pattern() {}
+
+    virtual void access(uint64_t i, Random& r, Access& a) const = 0;
+
+    // Registers the regions the pattern touches.
+    virtual void regions(MTR::Registrar& reg) const = 0;
+
+    // A synthetic address for the function records.
+    virtual MTR::addr_t function() const = 0;
+  };
+
+  // Walks an array with a fixed stride, shifting over by one element
+  // on each pass so that every element is eventually touched.
+  class StridePattern : public Pattern {
+  public:
+    StridePattern(MTR::addr_t base, uint64_t footprint, uint64_t stride, uint64_t element, double write_ratio)
+      : base(base),
+        footprint(footprint),
+        stride(stride),
+        element(element),
+        write_ratio(write_ratio),
+        per_pass(std::max<uint64_t>(footprint / stride, 1)),
+        shifts(std::max<uint64_t>(stride / element, 1))
+    {}
+
+    void access(uint64_t i, Random& r, Access& a) const {
+      const uint64_t offset = ((i % per_pass)*stride + element*((i / per_pass) % shifts)) % footprint;
+
+      a.addr = base + offset;
+      a.write = r.uniform() < write_ratio;
+      a.line = a.write ? 11 : 10;
+    }
+
+    void regions(MTR::Registrar& reg) const {
+      reg.array(base, footprint, element, "Array");
+    }
+
+    MTR::addr_t function() const {
+      return 0x400100;
+    }
+
+  private:
+    MTR::addr_t base;
+    uint64_t footprint, stride, element;
+    double write_ratio;
+    uint64_t per_pass, shifts;
+  };
+
+  // Touches elements uniformly at random.
+  class RandomPattern : public Pattern {
+  public:
+    RandomPattern(MTR::addr_t base, uint64_t footprint, uint64_t element, double write_ratio)
+      : base(base),
+        footprint(footprint),
+        element(element),
+        elements(footprint / element),
+        write_ratio(write_ratio)
+    {}
+
+    void access(uint64_t, Random& r, Access& a) const {
+      a.addr = base + element*r.below(elements);
+      a.write = r.uniform() < write_ratio;
+      a.line = a.write ? 21 : 20;
+    }
+
+    void regions(MTR::Registrar& reg) const {
+      reg.array(base, footprint, element, "Array");
+    }
+
+    MTR::addr_t function() const {
+      return 0x400200;
+    }
+
+  private:
+    MTR::addr_t base;
+    uint64_t footprint, element, elements;
+    double write_ratio;
+  };
+
+  // Touches elements with Zipf-distributed popularity (element 0 is
+  // the most popular), sampled by rejection-inversion (Hormann and
+  // Derflinger, 1996), which needs no tables.
+  class ZipfPattern : public Pattern {
+  public:
+    ZipfPattern(MTR::addr_t base, uint64_t footprint, uint64_t element, double exponent, double write_ratio)
+      : base(base),
+        footprint(footprint),
+        element(element),
+        elements(footprint / element),
+        exponent(exponent),
+        write_ratio(write_ratio)
+    {
+      hx1 = this->H(1.5) - 1.0;
+      hn = this->H(elements + 0.5);
+      s = 2.0 - this->Hinv(this->H(2.5) - this->h(2.0));
+    }
+
+    void access(uint64_t, Random& r, Access& a) const {
+      a.addr = base + element*(this->sample(r) - 1);
+      a.write = r.uniform() < write_ratio;
+      a.line = a.write ? 31 : 30;
+    }
+
+    void regions(MTR::Registrar& reg) const {
+      reg.array(base, footprint, element, "Array");
+    }
+
+    MTR::addr_t function() const {
+      return 0x400300;
+    }
+
+  private:
+    uint64_t sample(Random& r) const {
+      while(true){
+        const double u = hn + r.uniform()*(hx1 - hn);
+        const double x = this->Hinv(u);
+
+        uint64_t k = static_cast<uint64_t>(x + 0.5);
+        if(k < 1){
+          k = 1;
+        }
+        else if(k > elements){
+          k = elements;
+        }
+
+        if(k - x <= s or u >= this->H(k + 0.5) - this->h(k)){
+          return k;
+        }
+      }
+    }
+
+    double h(double x) const {
+      return std::exp(-exponent*std::log(x));
+    }
+
+    double H(double x) const {
+      const double lx = std::log(x);
+      return helper2((1.0 - exponent)*lx)*lx;
+    }
+
+    double Hinv(double x) const {
+      double t = x*(1.0 - exponent);
+      if(t < -1.0){
+        t = -1.0;
+      }
+
+      return std::exp(helper1(t)*x);
+    }
+
+    // log(1+x)/x and (exp(x)-1)/x, accurate near zero.
+    static double helper1(double x){
+      return std::fabs(x) > 1e-8 ? log1p(x) / x : 1.0 - x*(0.5 - x*(1.0/3.0 - 0.25*x));
+    }
+
+    static double helper2(double x){
+      return std::fabs(x) > 1e-8 ? expm1(x) / x : 1.0 + x*0.5*(1.0 + x*(1.0/3.0)*(1.0 + 0.25*x));
+    }
+
+  private:
+    MTR::addr_t base;
+    uint64_t footprint, element, elements;
+    double exponent, write_ratio;
+
+    double hx1, hn, s;
+  };
+
+  // Follows a linked list whose nodes are laid out in a random order,
+  // visiting every node once per lap.
+  class ChasePattern : public Pattern {
+  public:
+    ChasePattern(MTR::addr_t base, uint64_t footprint, uint64_t node, uint64_t seed)
+      : base(base),
+        footprint(footprint),
+        node(node),
+        order(footprint / node)
+    {
+      for(uint32_t i=0; i<order.size(); i++){
+        order[i] = i;
+      }
+
+      Random r(seed, ~0ULL);
+      for(uint64_t i=order.size() - 1; i>0; i--){
+        std::swap(order[i], order[r.below(i + 1)]);
+      }
+    }
+
+    void access(uint64_t i, Random&, Access& a) const {
+      a.addr = base + node*order[i % order.size()];
+      a.write = false;
+      a.line = 40;
+    }
+
+    void regions(MTR::Registrar& reg) const {
+      reg.array(base, footprint, node, "Nodes");
+    }
+
+    MTR::addr_t function() const {
+      return 0x400400;
+    }
+
+  private:
+    MTR::addr_t base;
+    uint64_t footprint, node;
+    std::vector<uint32_t> order;
+  };
+
+  // Tiled multiplication of two n x n matrices of doubles (C += A*B),
+  // with loop order ii, jj, kk, i, j, k.
+  class MatmultPattern : public Pattern {
+  public:
+    MatmultPattern(MTR::addr_t base, uint64_t n, uint64_t tile)
+      : base(base),
+        n(n),
+        tile(tile),
+        tiles(n / tile),
+        per_ij(2*tile + 2),
+        per_tile(tile*tile*per_ij),
+        cycle(tiles*tiles*tiles*per_tile)
+    {}
+
+    void access(uint64_t idx, Random&, Access& a) const {
+      idx %= cycle;
+
+      const uint64_t t = idx / per_tile;
+      const uint64_t ii = t / (tiles*tiles);
+      const uint64_t jj = (t / tiles) % tiles;
+      const uint64_t kk = t % tiles;
+
+      const uint64_t r = idx % per_tile;
+      const uint64_t i = ii*tile + (r / per_ij) / tile;
+      const uint64_t j = jj*tile + (r / per_ij) % tile;
+      const uint64_t q = r % per_ij;
+
+      if(q == 0 or q == per_ij - 1){
+        a.addr = this->C() + 8*(i*n + j);
+        a.write = (q != 0);
+        a.line = a.write ? 54 : 51;
+      }
+      else{
+        const uint64_t k = kk*tile + (q - 1)/2;
+        a.addr = (q % 2 == 1) ? this->A() + 8*(i*n + k) : this->B() + 8*(k*n + j);
+        a.write = false;
+        a.line = 53;
+      }
+    }
+
+    void regions(MTR::Registrar& reg) const {
+      reg.matrix(this->A(), 8*n*n, 8, n, n, "A");
+      reg.matrix(this->B(), 8*n*n, 8, n, n, "B");
+      reg.matrix(this->C(), 8*n*n, 8, n, n, "C");
+    }
+
+    MTR::addr_t function() const {
+      return 0x400500;
+    }
+
+  private:
+    MTR::addr_t A() const { return base; }
+    MTR::addr_t B() const { return base + 8*n*n; }
+    MTR::addr_t C() const { return base + 16*n*n; }
+
+  private:
+    MTR::addr_t base;
+    uint64_t n, tile, tiles, per_ij, per_tile, cycle;
+  };
+
+  // Five-point Jacobi sweeps over an n x n grid of doubles, swapping
+  // source and destination grids after each sweep.
+  class StencilPattern : public Pattern {
+  public:
+    StencilPattern(MTR::addr_t base, uint64_t n)
+      : base(base),
+        n(n),
+        per_sweep(6*(n - 2)*(n - 2))
+    {}
+
+    void access(uint64_t idx, Random&, Access& a) const {
+      const uint64_t sweep = (idx / per_sweep) % 2;
+      const uint64_t r = idx % per_sweep;
+      const uint64_t p = r / 6;
+      const uint64_t i = 1 + p / (n - 2);
+      const uint64_t j = 1 + p % (n - 2);
+
+      static const int di[] = {-1, 0, 0, 0, 1};
+      static const int dj[] = {0, -1, 0, 1, 0};
+
+      const unsigned q = r % 6;
+      if(q < 5){
+        a.addr = this->grid(sweep) + 8*((i + di[q])*n + j + dj[q]);
+        a.write = false;
+        a.line = 61;
+      }
+      else{
+        a.addr = this->grid(1 - sweep) + 8*(i*n + j);
+        a.write = true;
+        a.line = 62;
+      }
+    }
+
+    void regions(MTR::Registrar& reg) const {
+      reg.matrix(this->grid(0), 8*n*n, 8, n, n, "Grid0");
+      reg.matrix(this->grid(1), 8*n*n, 8, n, n, "Grid1");
+    }
+
+    MTR::addr_t function() const {
+      return 0x400600;
+    }
+
+  private:
+    MTR::addr_t grid(uint64_t g) const {
+      return base + g*8*n*n;
+    }
+
+  private:
+    MTR::addr_t base;
+    uint64_t n, per_sweep;
+  };
+
+  struct Options{
+    uint64_t records, chunk;
+    bool lines;
+    uint64_t function_period;
+    uint64_t seed;
+  };
+
+  // Fills "out" with the records for memory accesses [first, last).
+  void generate(const Pattern& pattern, const Options& opts, uint64_t c, std::vector<MTR::Record>& out){
+    const uint64_t first = c*opts.chunk;
+    const uint64_t last = std::min(first + opts.chunk, opts.records);
+
+    Random r(opts.seed, c);
+
+    MTR::Record rec;
+    memset(&rec, 0, sizeof(rec));
+
+    out.clear();
+
+    uint32_t line = 0;
+    for(uint64_t i=first; i<last; i++){
+      Access a;
+      pattern.access(i, r, a);
+
+      if(opts.function_period > 0 and i % opts.function_period == 0){
+        rec.code = MTR::Record::FunctionEntry;
+        rec.addr = pattern.function();
+        out.push_back(rec);
+      }
+
+      // Each chunk restates the current line, so that it can be
+      // generated on its own.
+      if(opts.lines and (i == first or a.line != line)){
+        line = a.line;
+
+        rec.addr = 0;
+        rec.code = MTR::Record::LineNumber;
+        rec.file = 0;
+        rec.line = line;
+        out.push_back(rec);
+      }
+
+      rec.code = a.write ? MTR::Record::Write : MTR::Record::Read;
+      rec.addr = a.addr;
+      out.push_back(rec);
+
+      if(opts.function_period > 0 and (i % opts.function_period == opts.function_period - 1 or i == opts.records - 1)){
+        rec.code = MTR::Record::FunctionExit;
+        rec.addr = pattern.function();
+        out.push_back(rec);
+      }
+    }
+  }
+
+  // Hands out chunks to the generating threads and hands finished
+  // chunks back to the writer in order, keeping at most "window"
+  // chunks in memory.
+  class ChunkQueue{
+  public:
+    ChunkQueue(uint64_t chunks, uint64_t window)
+      : chunks(chunks),
+        window(window),
+        next(0),
+        written(0)
+    {}
+
+    // Claims the next chunk to generate; returns false when there are
+    // none left.
+    bool claim(uint64_t& c){
+      boost::unique_lock<boost::mutex> lock(mutex);
+      while(next < chunks and next >= written + window){
+        space.wait(lock);
+      }
+
+      if(next == chunks){
+        return false;
+      }
+
+      c = next++;
+      return true;
+    }
+
+    void finish(uint64_t c, std::vector<MTR::Record>& recs){
+      boost::lock_guard<boost::mutex> lock(mutex);
+      done[c].swap(recs);
+      available.notify_all();
+    }
+
+    // Waits for the next chunk in order.
+    void take(std::vector<MTR::Record>& recs){
+      boost::unique_lock<boost::mutex> lock(mutex);
+      while(done.find(written) == done.end()){
+        available.wait(lock);
+      }
+
+      std::map<uint64_t, std::vector<MTR::Record> >::iterator i = done.find(written);
+      recs.swap(i->second);
+      done.erase(i);
+
+      written++;
+      space.notify_all();
+    }
+
+  private:
+    const uint64_t chunks, window;
+    uint64_t next, written;
+
+    std::map<uint64_t, std::vector<MTR::Record> > done;
+
+    boost::mutex mutex;
+    boost::condition_variable space, available;
+  };
+
+  void worker(const Pattern *pattern, const Options *opts, ChunkQueue *queue){
+    std::vector<MTR::Record> recs;
+
+    uint64_t c;
+    while(queue->claim(c)){
+      generate(*pattern, *opts, c, recs);
+      queue->finish(c, recs);
+    }
+  }
+
+  double now(){
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + 1e-6*tv.tv_usec;
+  }
+}
+
+int main(int argc, char *argv[]){
+  std::string outfile, regfile, patternname;
+  uint64_t records, footprint, stride, element, dimension, tile, chunk, functions, seed;
+  double write_ratio, exponent;
+  unsigned threads;
+  bool lines, gzip;
+  MTR::addr_t base;
+
+  try{
+    TCLAP::CmdLine cmd("Generate a synthetic reference trace");
+
+    TCLAP::ValueArg<std::string> outfileArg("o",
+                                            "output",
+                                            "Output trace file",
+                                            true,
+                                            "",
+                                            "filename",
+                                            cmd);
+
+    TCLAP::ValueArg<std::string> patternArg("p",
+                                            "pattern",
+                                            "Access pattern: 'stride', 'random', 'zipf', 'chase', 'matmult', or 'stencil'",
+                                            false,
+                                            "stride",
+                                            "pattern",
+                                            cmd);
+
+    TCLAP::ValueArg<uint64_t> recordsArg("n",
+                                         "num-records",
+                                         "Number of memory records to generate",
+                                         false,
+                                         1000000,
+                                         "count",
+                                         cmd);
+
+    TCLAP::ValueArg<std::string> regfileArg("r",
+                                            "registration",
+                                            "Write a matching region registration file",
+                                            false,
+                                            "",
+                                            "filename",
+                                            cmd);
+
+    TCLAP::ValueArg<uint64_t> footprintArg("f",
+                                           "footprint",
+                                           "Bytes touched by the stride, random, zipf and chase patterns",
+                                           false,
+                                           64*1024*1024,
+                                           "bytes",
+                                           cmd);
+
+    TCLAP::ValueArg<uint64_t> strideArg("s",
+                                        "stride",
+                                        "Stride of the stride pattern, and node size of the chase pattern",
+                                        false,
+                                        64,
+                                        "bytes",
+                                        cmd);
+
+    TCLAP::ValueArg<uint64_t> elementArg("e",
+                                         "element-size",
+                                         "Element size of the stride, random and zipf patterns",
+                                         false,
+                                         8,
+                                         "bytes",
+                                         cmd);
+
+    TCLAP::ValueArg<double> writeratioArg("w",
+                                          "write-ratio",
+                                          "Fraction of stores in the stride, random and zipf patterns",
+                                          false,
+                                          0.25,
+                                          "fraction",
+                                          cmd);
+
+    TCLAP::ValueArg<double> exponentArg("z",
+                                        "zipf-exponent",
+                                        "Exponent of the zipf pattern",
+                                        false,
+                                        0.99,
+                                        "exponent",
+                                        cmd);
+
+    TCLAP::ValueArg<uint64_t> dimensionArg("d",
+                                           "dimension",
+                                           "Matrix dimension for matmult, grid dimension for stencil",
+                                           false,
+                                           512,
+                                           "n",
+                                           cmd);
+
+    TCLAP::ValueArg<uint64_t> tileArg("",
+                                      "tile",
+                                      "Tile size for matmult (must divide the dimension)",
+                                      false,
+                                      32,
+                                      "n",
+                                      cmd);
+
+    TCLAP::SwitchArg linesArg("l",
+                              "lines",
+                              "Emit line number records",
+                              cmd);
+
+    TCLAP::ValueArg<uint64_t> functionsArg("",
+                                           "function-period",
+                                           "Wrap every this many memory records in function entry/exit records (0 for none)",
+                                           false,
+                                           0,
+                                           "count",
+                                           cmd);
+
+    TCLAP::ValueArg<std::string> baseArg("b",
+                                         "base",
+                                         "Base address of the first region",
+                                         false,
+                                         "0x10000000",
+                                         "hex address",
+                                         cmd);
+
+    TCLAP::ValueArg<uint64_t> seedArg("",
+                                      "seed",
+                                      "Random seed",
+                                      false,
+                                      0,
+                                      "number",
+                                      cmd);
+
+    TCLAP::ValueArg<unsigned> threadsArg("j",
+                                         "threads",
+                                         "Number of generating threads",
+                                         false,
+                                         std::max(boost::thread::hardware_concurrency(), 1u),
+                                         "threads",
+                                         cmd);
+
+    TCLAP::ValueArg<uint64_t> chunkArg("",
+                                       "chunk",
+                                       "Memory records per chunk of work (the output depends on this, but not on the number of threads)",
+                                       false,
+                                       1 << 20,
+                                       "count",
+                                       cmd);
+
+    TCLAP::SwitchArg gzipArg("g",
+                             "gzip",
+                             "Compress the output (much slower)",
+                             cmd);
+
+    cmd.parse(argc, argv);
+
+    outfile = outfileArg.getValue();
+    patternname = patternArg.getValue();
+    records = recordsArg.getValue();
+    regfile = regfileArg.getValue();
+    footprint = footprintArg.getValue();
+    stride = strideArg.getValue();
+    element = elementArg.getValue();
+    write_ratio = writeratioArg.getValue();
+    exponent = exponentArg.getValue();
+    dimension = dimensionArg.getValue();
+    tile = tileArg.getValue();
+    lines = linesArg.getValue();
+    functions = functionsArg.getValue();
+    std::stringstream(baseArg.getValue()) >> std::hex >> base;
+    seed = seedArg.getValue();
+    threads = threadsArg.getValue();
+    chunk = chunkArg.getValue();
+    gzip = gzipArg.getValue();
+  }
+  catch(TCLAP::ArgException& e){
+    std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+    exit(1);
+  }
+
+  if(threads == 0 or chunk == 0){
+    std::cerr << "error: threads and chunk size must be positive." << std::endl;
+    exit(1);
+  }
+
+  if(element == 0 or stride == 0 or footprint < std::max(element, stride)){
+    std::cerr << "error: the footprint must hold at least one element (and one stride)." << std::endl;
+    exit(1);
+  }
+
+  // Build the pattern.
+  Pattern *pattern = 0;
+  if(patternname == "stride"){
+    pattern = new StridePattern(base, footprint, stride, element, write_ratio);
+  }
+  else if(patternname == "random"){
+    pattern = new RandomPattern(base, footprint, element, write_ratio);
+  }
+  else if(patternname == "zipf"){
+    if(exponent <= 0.0){
+      std::cerr << "error: the zipf exponent must be positive." << std::endl;
+      exit(1);
+    }
+
+    pattern = new ZipfPattern(base, footprint, element, exponent, write_ratio);
+  }
+  else if(patternname == "chase"){
+    if(footprint / stride > 0xffffffffULL){
+      std::cerr << "error: too many nodes for the chase pattern." << std::endl;
+      exit(1);
+    }
+
+    pattern = new ChasePattern(base, footprint, stride, seed);
+  }
+  else if(patternname == "matmult"){
+    if(tile == 0 or dimension < tile or dimension % tile != 0){
+      std::cerr << "error: the tile size must be positive and divide the (nonzero) matrix dimension." << std::endl;
+      exit(1);
+    }
+
+    pattern = new MatmultPattern(base, dimension, tile);
+  }
+  else if(patternname == "stencil"){
+    if(dimension < 3){
+      std::cerr << "error: the stencil grid dimension must be at least 3." << std::endl;
+      exit(1);
+    }
+
+    pattern = new StencilPattern(base, dimension);
+  }
+  else{
+    std::cerr << "error: unknown pattern '" << patternname << "'." << std::endl;
+    exit(1);
+  }
+
+  if(regfile != ""){
+    MTR::Registrar reg;
+    pattern->regions(reg);
+    reg.record(regfile.c_str());
+  }
+
+  // Open the output file, writing the same header as TraceWriter.
+  std::ofstream file(outfile.c_str(), std::ios::binary);
+  if(!file){
+    std::cerr << "error: could not open file '" << outfile << "' for output." << std::endl;
+    exit(1);
+  }
+
+  file << TraceWriter::magicphrase << std::flush;
+  const unsigned code = static_cast<unsigned>(gzip ? TraceWriter::Gzip : TraceWriter::Raw);
+  file.write(reinterpret_cast<const char *>(&code), sizeof(code));
+
+  // Raw records go straight to the file; compressed ones go through a
+  // gzip filter.
+  filtering_ostreambuf outbuf;
+  if(gzip){
+    outbuf.push(gzip_compressor());
+    outbuf.push(file);
+  }
+  std::ostream zout(&outbuf);
+  std::ostream& out = gzip ? zout : file;
+
+  // Generate chunks on the worker threads and write them out in
+  // order on this one.
+  Options opts;
+  opts.records = records;
+  opts.chunk = chunk;
+  opts.lines = lines;
+  opts.function_period = functions;
+  opts.seed = seed;
+
+  const uint64_t chunks = (records + chunk - 1) / chunk;
+  ChunkQueue queue(chunks, 2*threads);
+
+  const double start = now();
+
+  boost::thread_group workers;
+  for(unsigned i=0; i<threads; i++){
+    workers.create_thread(boost::bind(worker, pattern, &opts, &queue));
+  }
+
+  uint64_t total = 0;
+  std::vector<MTR::Record> recs;
+  for(uint64_t c=0; c<chunks; c++){
+    queue.take(recs);
+
+    out.write(reinterpret_cast<const char *>(&recs[0]), recs.size()*sizeof(MTR::Record));
+    total += recs.size();
+  }
+
+  workers.join_all();
+
+  // Flush the compressor (if any) before closing the file.
+  if(gzip){
+    outbuf.reset();
+  }
+  file.close();
+
+  const double elapsed = now() - start;
+  if(!file){
+    std::cerr << "error: could not write to '" << outfile << "'." << std::endl;
+    exit(1);
+  }
+
+  std::cout << "wrote " << total << " records (" << records << " memory records) in " << elapsed << "s";
+  if(elapsed > 0.0){
+    std::cout << " (" << (total*sizeof(MTR::Record) / elapsed / (1024*1024)) << " MB/s)";
+  }
+  std::cout << std::endl;
+
+  delete pattern;
+
+  return 0;
+}
@@ -0,0 +1,113 @@
+// Copyright 2012 A.N.M. Imroz Choudhury
+//
+// mtrintern.cpp - A program for interning the distinct block
+// addresses in a reference trace, saving the mapping from dense block
+// IDs to block addresses as a side file next to the trace.
+
+// TCLAP headers.
+#include <tclap/CmdLine.h>
+
+// MTV includes.
+#include <Core/Dataflow/TraceReader.h>
+#include <Core/Util/BlockInterner.h>
+using MTV::BlockInterner;
+using MTV::TraceReader;
+
+// System headers.
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char *argv[]){
+  std::string inputfile, outputfile;
+  unsigned blocksize;
+
+  try{
+    // Create a command line parser.
+    TCLAP::CmdLine cmd("Intern the distinct block addresses in a reference trace");
+
+    // The input file.
+    TCLAP::ValueArg<std::string> inputfileArg("i",
+                                              "input",
+                                              "input reference trace file",
+                                              true,
+                                              "",
+                                              "filename",
+                                              cmd);
+
+    // The output file.
+    TCLAP::ValueArg<std::string> outputfileArg("o",
+                                               "output",
+                                               "output block ID file (defaults to the input filename plus '.blockids')",
+                                               false,
+                                               "",
+                                               "filename",
+                                               cmd);
+
+    // Block size.
+    TCLAP::ValueArg<unsigned> blocksizeArg("b",
+                                           "block-size",
+                                           "Size of cache blocks (in bytes; 1 interns whole addresses)",
+                                           false,
+                                           64,
+                                           "size",
+                                           cmd);
+
+    // Parse the command line.
+    cmd.parse(argc, argv);
+
+    // Extract the arguments.
+    inputfile = inputfileArg.getValue();
+    outputfile = outputfileArg.getValue();
+    blocksize = blocksizeArg.getValue();
+  }
+  catch(TCLAP::ArgException& e){
+    std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+    exit(1);
+  }
+
+  if(blocksize == 0){
+    std::cerr << "error: block size must be positive." << std::endl;
+    exit(1);
+  }
+
+  if(outputfile == ""){
+    outputfile = BlockInterner::sidefile(inputfile);
+  }
+
+  TraceReader::ptr trace = boost::make_shared<TraceReader>();
+  if(!trace->open(inputfile)){
+    std::cerr << "error: could not open file '" << inputfile << "' for reading." << std::endl;
+    exit(1);
+  }
+
+  // Intern the block address of every memory record.
+  BlockInterner blocks(blocksize);
+  uint64_t records = 0;
+  try{
+    while(true){
+      const MTR::Record& rec = trace->nextRecord();
+      if(MTR::type(rec) != MTR::Record::MType){
+        continue;
+      }
+
+      if(blocks.size() == BlockInterner::None - 1){
+        std::cerr << "error: too many distinct blocks for 32-bit IDs." << std::endl;
+        exit(1);
+      }
+
+      blocks.intern(rec.addr);
+      records++;
+    }
+  }
+  catch(TraceReader::End){}
+
+  if(!blocks.save(outputfile)){
+    std::cerr << "error: could not write block IDs to '" << outputfile << "'." << std::endl;
+    exit(1);
+  }
+
+  std::cerr << records << " memory records, " << blocks.size() << " distinct blocks." << std::endl;
+
+  return 0;
+}
@@ -1,13 +1,11 @@
 // MTV headers.
-#include <Core/Type.pb.h>
-#include <Core/Variable.pb.h>
 #include <Core/Dataflow/AddressRangeFilter.h>
 #include <Core/Dataflow/TraceReader.h>
 #include <Core/Dataflow/TraceWriter.h>
 #include <Core/Util/Util.h>
-#include <Tools/ReferenceTrace/StackInfo.h>
+#include <Tools/ReferenceTrace/StackIndex.h>
 using MTV::AddressRangePass;
-using MTV::StackInfo;
+using MTV::StackIndex;
 using MTV::TraceReader;
 using MTV::TraceWriter;
 
@@ -15,6 +13,7 @@ using MTV::TraceWriter;
 #include <tclap/CmdLine.h>
 
 // System headers.
+#include <stack>
 #include <string>
 
 int main(int argc, char *argv[]){
@@ -124,58 +123,22 @@ int main(int argc, char *argv[]){
     std::cerr << "warning: no registration file specified." << std::endl;
   }
 
-  // If there is a mithril file, open it and process its contents.
+  // If there is a mithril file, open it.  An index file (see
+  // "mithril --index-file") is mapped directly; a plain mithril file
+  // is indexed in memory.
   //
-  // TODO(choudhury): this function should be abstracted into a header
-  // file so it can be called from waxlamp.cpp.
-  boost::unordered_map<uint64_t, MTV::Mithril::Type> type_table;
-  boost::unordered_map<uint64_t, std::vector<MTV::Mithril::Variable> > var_entry, var_exit;
+  // The index answers two queries by binary search: which variables
+  // start their influence at a lexical block's start address, and
+  // which end it at a block's end address.  When such variables are
+  // introduced into the visualization, their address will be computed
+  // from the current value of the frame base pointer (which also is
+  // reported in the trace).
+  MTV::StackIndex index;
   if(mithrilfile != ""){
-    std::ifstream mithril(mithrilfile.c_str());
-    if(!mithril){
-      std::cerr << "error: could not open file '" << mithrilfile << "' for reading." << std::endl;
+    if(!index.load(mithrilfile)){
+      std::cerr << "error: " << index.error() << std::endl;
       exit(1);
     }
-
-    // Read out the type information.
-    MTV::Mithril::TypeList types;
-    MTV::readProtocolBuffer(mithril, types);
-    
-    // Read out the variable information.
-    MTV::Mithril::VariableList vars;
-    MTV::readProtocolBuffer(mithril, vars);
-
-    // // Read out the subprogram information.
-    // MTV::Mithril::SubprogramList subprogs;
-    // MTV::readProtocolBuffer(mithril, subprogs);
-
-    // // Read out the lexical scope information.
-    // MTV::Mithril::LexicalBlockList scopes;
-    // MTV::readProtocolBuffer(mithril, scopes);
-    
-    if(!mithril){
-      std::cerr << "error: could not read out data from file '" << mithrilfile << "'" << std::endl;
-      exit(1);
-    }
-
-    // Make a table of the types.
-    for(int i=0; i<types.type_size(); i++){
-      const MTV::Mithril::Type& t = types.type(i);
-      type_table[t.id()] = t;
-    }
-
-    // Create two tables mapping from address to variable - one for
-    // ENTRY addresses and one for EXIT.  Each table maps a lexical
-    // block start/end address to a list of variables that
-    // started/ended their influence at that address.  When such
-    // variables are introduced into the visualization, their address
-    // will be computed from the current value of the frame base
-    // pointer (which also is reported in the trace).
-    for(int i=0; i<vars.var_size(); i++){
-      const MTV::Mithril::Variable& v = vars.var(i);
-      var_entry[v.low_pc()].push_back(v);
-      var_exit[v.high_pc()].push_back(v);
-    }
   }
   else{
     std::cerr << "warning: no mithril file specified." << std::endl;
@@ -290,42 +253,24 @@ int main(int argc, char *argv[]){
         // "vars" stack (which represents all variables in the current
         // function).
         //
-        // Get an iterator to the vector containing the vars list for
-        // this address.
-        boost::unordered_map<uint64_t, std::vector<MTV::Mithril::Variable> >::const_iterator i = var_entry.find(rec.addr);
-        if(i != var_entry.end()){
-          const std::vector<MTV::Mithril::Variable>& varlist = i->second;
-          for(unsigned j=0; j<varlist.size(); j++){
-            // Compute the size of the variable.
-            unsigned num;
-            const uint32_t type = StackInfo::get_type_size(type_table, varlist[j].type(), num);
-
+        // Get the range of variables starting at this address.
+        const std::pair<const StackIndex::Var *, const StackIndex::Var *> entering = index.vars_entering(rec.addr);
+        if(entering.first != entering.second){
+          for(const StackIndex::Var *v = entering.first; v != entering.second; v++){
             // Compute its base address.
-            uint64_t base;
-            if(varlist[j].has_stack_location()){
-              base = frame_base.top() + varlist[j].stack_location().offset();
-            }
-            else if(varlist[j].has_absolute_location()){
-              base = varlist[j].absolute_location().address();
-            }
-            else{
-              std::cerr << "fatal error: variable has no address locator method" << std::endl;
-              abort();
-            }
-
-            // Grab its id.
-            const uint64_t id = varlist[j].id();
+            const uint64_t base = v->absolute ? static_cast<uint64_t>(v->location) : frame_base.top() + v->location;
 
             // Create an address range filter to represent the
-            // variable's addresses.
-            AddressRangePass pass(base, base + num*type);
+            // variable's addresses (the type size is already resolved
+            // in the index).
+            AddressRangePass pass(base, base + v->count*v->size);
 
             // Place this filter in the table on top of the vars stack.
-            if(vars.back().find(id) != vars.back().end()){
-              std::cerr << "fatal error: variable (id " << id << ") already present in vars table." << std::endl;
+            if(vars.back().find(v->id) != vars.back().end()){
+              std::cerr << "fatal error: variable (id " << v->id << ") already present in vars table." << std::endl;
               abort();
             }
-            vars.back()[id] = pass;
+            vars.back()[v->id] = pass;
           }
 
           // Copy the record to the output.
@@ -336,14 +281,10 @@ int main(int argc, char *argv[]){
       else if(rec.code == MTR::Record::ScopeExit){
         // Get the set of variables ending on this address and remove
         // them from the table at the top of the vars stack.
-        boost::unordered_map<uint64_t, std::vector<MTV::Mithril::Variable> >::const_iterator i = var_exit.find(rec.addr);      
-        if(i != var_exit.end()){
-          const std::vector<MTV::Mithril::Variable>& varlist = i->second;
-          for(unsigned j=0; j<vars.size(); j++){
-            // Remove the variable from the top table of the vars stack.
-            const uint64_t id = varlist[j].id();
-            vars.back().erase(id);
-          }
+        const std::pair<const uint32_t *, const uint32_t *> exiting = index.vars_exiting(rec.addr);
+        for(const uint32_t *i = exiting.first; i != exiting.second; i++){
+          // Remove the variable from the top table of the vars stack.
+          vars.back().erase(index.var(*i).id);
         }
 
         // Copy the record to the output.
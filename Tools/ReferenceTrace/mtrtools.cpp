@@ -30,6 +30,7 @@ Record::Type MTR::type(const Record& rec){
   case Record::ScopeExit:
   case Record::FunctionEntry:
   case Record::FunctionExit:
+  case Record::Timestamp:
     type = Record::OtherType;
     break;
 
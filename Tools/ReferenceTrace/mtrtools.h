@@ -35,7 +35,8 @@ namespace MTR{
       ScopeEntry,    //5
       ScopeExit,     //6
       FunctionEntry, //7
-      FunctionExit   //8
+      FunctionExit,  //8
+      Timestamp      //9
     };
 
     enum Type {
@@ -71,6 +72,20 @@ namespace MTR{
     friend std::ostream& operator<<(std::ostream& out, const MTR::Record& rec);
   };
 
+  // A trace record tagged with the thread that issued it, as produced
+  // by merging several per-thread traces into one stream.
+  //
+  // NOTE(choudhury): per-thread traces are ordinary traces; a tracer
+  // may place Timestamp records (carrying a time in the addr field)
+  // in them to say when the following records happened, which lets
+  // the threads be interleaved faithfully.
+  struct ThreadRecord{
+    Record record;
+    uint32_t thread;
+
+    char pad[4];
+  };
+
   // Returns a type code based on the record's code field.
   Record::Type type(const Record& rec);
 
@@ -157,6 +172,10 @@ namespace MTR{
       ss << "FunctionExit";
       break;
 
+    case MTR::Record::Timestamp:
+      ss << "Timestamp";
+      break;
+
     case MTR::Record::NoCode:
       ss << "NoCode";
       break;
@@ -186,6 +205,10 @@ namespace MTR{
           ss << ", 0x" << std::hex << rec.addr << ")";
           break;
 
+        case MTR::Record::Timestamp:
+          ss << ", " << std::dec << rec.addr << ")";
+          break;
+
         default:
           ss << ", ERROR)" << std::endl;
           break;
@@ -0,0 +1,30 @@
+# Find the OSMesa (offscreen Mesa) library.
+#
+# Defines:
+# OSMESA_FOUND
+# OSMESA_INCLUDE_DIRS
+# OSMESA_LIBRARIES
+
+include(FindPackageHandleStandardArgs)
+
+set(OSMESA_PATH "/usr" CACHE PATH "install location for OSMesa")
+
+find_path(OSMESA_INCLUDE_DIR
+  NAMES GL/osmesa.h
+  PATHS ${OSMESA_PATH}/include
+)
+
+find_library(OSMESA_LIBRARY
+  NAMES OSMesa
+  PATHS ${OSMESA_PATH}/lib
+)
+
+set(OSMESA_INCLUDE_DIRS
+  ${OSMESA_INCLUDE_DIR}
+)
+
+set(OSMESA_LIBRARIES
+  ${OSMESA_LIBRARY}
+)
+
+find_package_handle_standard_args(OSMESA DEFAULT_MSG OSMESA_LIBRARIES OSMESA_INCLUDE_DIRS)